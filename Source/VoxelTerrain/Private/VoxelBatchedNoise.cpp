@@ -0,0 +1,618 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#include "VoxelBatchedNoise.h"
+#include "VoxelTerrain.h"
+
+#include <cmath>
+
+// ANL
+#include "VM/noise_lut.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define VOXEL_NOISE_X86 1
+#else
+	#define VOXEL_NOISE_X86 0
+#endif
+
+#if VOXEL_NOISE_X86
+	#include <immintrin.h>
+
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+
+		// MSVC lets any function use AVX2 intrinsics
+		#define VOXEL_NOISE_AVX2_TARGET
+	#else
+		#include <cpuid.h>
+
+		// GCC and Clang need to be told which functions are allowed to use AVX2
+		#define VOXEL_NOISE_AVX2_TARGET __attribute__((target("avx2")))
+	#endif
+#endif
+
+constexpr float FVoxelBatchedNoise::Tolerance;
+constexpr float FVoxelBatchedNoise::AnlTolerance;
+constexpr double FVoxelBatchedNoise::SimplexScale;
+constexpr double FVoxelBatchedNoise::SimplexOffset;
+
+// Skewing factors for 3D simplex noise
+static const float SimplexF3 = 1.f / 3.f;
+static const float SimplexG3 = 1.f / 6.f;
+
+// ANL hashes the lattice points with 32 bit FNV-1a
+static const uint32 FnvOffsetBasis = 2166136261u;
+static const uint32 FnvPrime = 16777619u;
+
+// The gradient tables, passed to the functions below in one go
+struct FVoxelGradientTables
+{
+	const float* X;
+	const float* Y;
+	const float* Z;
+};
+
+// ANL's KISS random number generator, which is what its fractals draw the seed and rotation of every layer from
+struct FAnlKiss
+{
+	uint32 Z, W, Jsr, Jcong;
+
+	explicit FAnlKiss(uint32 Seed)
+	{
+		// ANL seeds the four states from its LCG
+		uint32 Lcg = Seed;
+		auto NextLcg = [&Lcg]() { Lcg = 69069u * Lcg + 362437u; return Lcg; };
+
+		Z = NextLcg();
+		W = NextLcg();
+		Jsr = NextLcg();
+		Jcong = NextLcg();
+	}
+
+	uint32 Get()
+	{
+		Z = 36969u * (Z & 65535u) + (Z >> 16);
+		W = 18000u * (W & 65535u) + (W >> 16);
+		const uint32 Mwc = (Z << 16) + W;
+
+		Jsr ^= Jsr << 17;
+		Jsr ^= Jsr >> 13;
+		Jsr ^= Jsr << 5;
+
+		Jcong = 69069u * Jcong + 1234567u;
+
+		return (Mwc ^ Jcong) + Jsr;
+	}
+
+	double Get01()
+	{
+		return double(Get()) / 4294967295.0;
+	}
+};
+
+float FVoxelNoiseFractal::GetAmplitudeSum() const
+{
+	float Sum = 0.f;
+	for (const FVoxelNoiseLayer& Layer : Layers)
+		Sum += FMath::Abs(Layer.Amplitude);
+
+	return Sum;
+}
+
+FVoxelBatchedNoise::FVoxelBatchedNoise()
+{
+	for (int32 i = 0; i < NumGradients; i++)
+	{
+		GradientX[i] = float(anl::gradient3D_lut[i][0]);
+		GradientY[i] = float(anl::gradient3D_lut[i][1]);
+		GradientZ[i] = float(anl::gradient3D_lut[i][2]);
+	}
+}
+
+FVoxelNoiseFractal FVoxelBatchedNoise::MakeFractal(EVoxelFractalType Type, int32 Octaves, double Frequency, uint32 Seed)
+{
+	FVoxelNoiseFractal Fractal;
+	Fractal.Type = Type;
+
+	FAnlKiss Random(Seed);
+
+	for (int32 Layer = 0; Layer < Octaves; Layer++)
+	{
+		// ANL adds the first layer at the base frequency, then starts its loop over the rest from 2^0 again.
+		// So the first two layers are both at full strength and the base frequency, and only the ones after that halve and double.
+		const double Scale = Layer == 0 ? 1.0 : 1.0 / std::pow(2.0, double(Layer - 1));
+		const double LayerFrequency = Layer == 0 ? Frequency : std::pow(2.0, double(Layer - 1)) * Frequency;
+
+		// ANL draws these inside the argument list of a single call, seed first and then the angle and axis, and leaves the order to its compiler.
+		// MSVC evaluates the arguments from right to left, and that is what the ANL libraries in ThirdParty are built with, so the draws are sequenced that way here.
+		double AxisZ = Random.Get01();
+		double AxisY = Random.Get01();
+		double AxisX = Random.Get01();
+		const double Angle = Random.Get01() * 3.14159265;
+		const uint32 LayerSeed = Random.Get();
+
+		// This is all in doubles, like ANL, so the layers come out exactly the same. FMath only has float versions of these.
+		const double Length = std::sqrt(AxisX * AxisX + AxisY * AxisY + AxisZ * AxisZ);
+		AxisX /= Length;
+		AxisY /= Length;
+		AxisZ /= Length;
+
+		// The rotation ANL's rotateDomain builds from the angle and the axis
+		const double Cos = std::cos(Angle);
+		const double Sin = std::sin(Angle);
+		const double OneMinusCos = 1.0 - Cos;
+		const double Rotation[3][3] =
+		{
+			{ 1.0 + OneMinusCos * (AxisX * AxisX - 1.0), -AxisZ * Sin + OneMinusCos * AxisX * AxisY, AxisY * Sin + OneMinusCos * AxisX * AxisZ },
+			{ AxisZ * Sin + OneMinusCos * AxisX * AxisY, 1.0 + OneMinusCos * (AxisY * AxisY - 1.0), -AxisX * Sin + OneMinusCos * AxisY * AxisZ },
+			{ -AxisY * Sin + OneMinusCos * AxisX * AxisZ, AxisX * Sin + OneMinusCos * AxisY * AxisZ, 1.0 + OneMinusCos * (AxisZ * AxisZ - 1.0) }
+		};
+
+		FVoxelNoiseLayer& NewLayer = Fractal.Layers[Fractal.Layers.AddDefaulted()];
+		NewLayer.Seed = LayerSeed;
+		NewLayer.Amplitude = float(Scale);
+
+		// The position is scaled by the frequency and then rotated, so both go into one matrix
+		for (int32 Row = 0; Row < 3; Row++)
+		{
+			for (int32 Column = 0; Column < 3; Column++)
+				NewLayer.Transform[Row][Column] = float(Rotation[Row][Column] * LayerFrequency);
+		}
+	}
+
+	return Fractal;
+}
+
+uint32 FVoxelBatchedNoise::HashLatticePoint(int32 I, int32 J, int32 K, uint32 Seed)
+{
+	// FNV-1a over the bytes of the coordinates and the seed, the way they sit in memory on a little endian CPU.
+	// ANL folds the top of the hash onto the bottom byte to pick a gradient.
+	const uint32 Words[4] = { uint32(I), uint32(J), uint32(K), Seed };
+
+	uint32 Hash = FnvOffsetBasis;
+	for (uint32 Word : Words)
+	{
+		for (int32 Shift = 0; Shift < 32; Shift += 8)
+			Hash = (Hash ^ ((Word >> Shift) & 0xff)) * FnvPrime;
+	}
+
+	return ((Hash >> 8) ^ Hash) & 0xff;
+}
+
+////////////////////// Scalar //////////////////////////////////////
+
+// ANL's fast_floor, which steps zero and negative whole numbers down one further than floor does.
+// The noise is continuous across cells, so this only changes which cell a point on a boundary is worked out from.
+static FORCEINLINE int32 FastFloorScalar(float V)
+{
+	return V > 0.f ? int32(V) : int32(V) - 1;
+}
+
+// The contribution of a single simplex corner
+static FORCEINLINE float CornerScalar(const FVoxelGradientTables& Gradients, uint32 Hash, float X, float Y, float Z)
+{
+	float T = FMath::Max(0.6f - (X * X + Y * Y + Z * Z), 0.f);
+	T = T * T;
+	return T * T * (Gradients.X[Hash] * X + Gradients.Y[Hash] * Y + Gradients.Z[Hash] * Z);
+}
+
+static float SimplexScalar(const FVoxelGradientTables& Gradients, uint32 Seed, float X, float Y, float Z)
+{
+	// Skew the input space to work out which simplex cell we're in
+	const float S = (X + Y + Z) * SimplexF3;
+	const int32 I = FastFloorScalar(X + S);
+	const int32 J = FastFloorScalar(Y + S);
+	const int32 K = FastFloorScalar(Z + S);
+
+	// Unskew the cell origin back to X, Y, Z space and get the offset from it
+	const float T = float(I + J + K) * SimplexG3;
+	const float X0 = X - (float(I) - T);
+	const float Y0 = Y - (float(J) - T);
+	const float Z0 = Z - (float(K) - T);
+
+	// Work out which of the six tetrahedra we're in
+	const int32 I1 = (X0 >= Y0 && X0 >= Z0) ? 1 : 0;
+	const int32 J1 = (Y0 > X0 && Y0 >= Z0) ? 1 : 0;
+	const int32 K1 = (Z0 > X0 && Z0 > Y0) ? 1 : 0;
+	const int32 I2 = (X0 >= Y0 || X0 >= Z0) ? 1 : 0;
+	const int32 J2 = (Y0 > X0 || Y0 >= Z0) ? 1 : 0;
+	const int32 K2 = (Z0 > X0 || Z0 > Y0) ? 1 : 0;
+
+	// Offsets from the other three corners
+	const float X1 = X0 - float(I1) + SimplexG3;
+	const float Y1 = Y0 - float(J1) + SimplexG3;
+	const float Z1 = Z0 - float(K1) + SimplexG3;
+	const float X2 = X0 - float(I2) + 2.f * SimplexG3;
+	const float Y2 = Y0 - float(J2) + 2.f * SimplexG3;
+	const float Z2 = Z0 - float(K2) + 2.f * SimplexG3;
+	const float X3 = X0 - 1.f + 3.f * SimplexG3;
+	const float Y3 = Y0 - 1.f + 3.f * SimplexG3;
+	const float Z3 = Z0 - 1.f + 3.f * SimplexG3;
+
+	// Hash the four corners
+	const uint32 Hash0 = FVoxelBatchedNoise::HashLatticePoint(I, J, K, Seed);
+	const uint32 Hash1 = FVoxelBatchedNoise::HashLatticePoint(I + I1, J + J1, K + K1, Seed);
+	const uint32 Hash2 = FVoxelBatchedNoise::HashLatticePoint(I + I2, J + J2, K + K2, Seed);
+	const uint32 Hash3 = FVoxelBatchedNoise::HashLatticePoint(I + 1, J + 1, K + 1, Seed);
+
+	const float N = CornerScalar(Gradients, Hash0, X0, Y0, Z0) + CornerScalar(Gradients, Hash1, X1, Y1, Z1) + CornerScalar(Gradients, Hash2, X2, Y2, Z2) + CornerScalar(Gradients, Hash3, X3, Y3, Z3);
+	return N * float(FVoxelBatchedNoise::SimplexScale) + float(FVoxelBatchedNoise::SimplexOffset);
+}
+
+// Adds one layer of a fractal to the output
+static void AccumulateLayerScalar(const FVoxelGradientTables& Gradients, bool bRidged, const FVoxelNoiseLayer& Layer, const float* X, const float* Y, const float* Z, float* OutValues, int32 Count)
+{
+	const float (&M)[3][3] = Layer.Transform;
+
+	for (int32 i = 0; i < Count; i++)
+	{
+		const float PX = M[0][0] * X[i] + M[0][1] * Y[i] + M[0][2] * Z[i];
+		const float PY = M[1][0] * X[i] + M[1][1] * Y[i] + M[1][2] * Z[i];
+		const float PZ = M[2][0] * X[i] + M[2][1] * Y[i] + M[2][2] * Z[i];
+
+		const float N = SimplexScalar(Gradients, Layer.Seed, PX, PY, PZ);
+		const float Value = bRidged ? 1.f - FMath::Abs(N) : N;
+		OutValues[i] = OutValues[i] + Layer.Amplitude * Value;
+	}
+}
+
+#if VOXEL_NOISE_X86
+
+////////////////////// SSE2 ////////////////////////////////////////
+
+// The same as FastFloorScalar: truncate, then step down wherever the input wasn't positive
+static FORCEINLINE __m128i FastFloorSSE2(__m128 V)
+{
+	return _mm_add_epi32(_mm_cvttps_epi32(V), _mm_castps_si128(_mm_cmple_ps(V, _mm_setzero_ps())));
+}
+
+// SSE2 has no 32 bit multiply, but the FNV prime is 2^24 + 403 and 403 is 256 + 128 + 16 + 2 + 1, so it can be done with shifts and adds
+static FORCEINLINE __m128i MultiplyFnvPrimeSSE2(__m128i H)
+{
+	__m128i Result = _mm_add_epi32(H, _mm_slli_epi32(H, 1));
+	Result = _mm_add_epi32(Result, _mm_slli_epi32(H, 4));
+	Result = _mm_add_epi32(Result, _mm_slli_epi32(H, 7));
+	Result = _mm_add_epi32(Result, _mm_slli_epi32(H, 8));
+	return _mm_add_epi32(Result, _mm_slli_epi32(H, 24));
+}
+
+// Adds the four bytes of a word to the hash, lowest first
+static FORCEINLINE __m128i HashWordSSE2(__m128i Hash, __m128i Word)
+{
+	const __m128i ByteMask = _mm_set1_epi32(0xff);
+	Hash = MultiplyFnvPrimeSSE2(_mm_xor_si128(Hash, _mm_and_si128(Word, ByteMask)));
+	Hash = MultiplyFnvPrimeSSE2(_mm_xor_si128(Hash, _mm_and_si128(_mm_srli_epi32(Word, 8), ByteMask)));
+	Hash = MultiplyFnvPrimeSSE2(_mm_xor_si128(Hash, _mm_and_si128(_mm_srli_epi32(Word, 16), ByteMask)));
+	return MultiplyFnvPrimeSSE2(_mm_xor_si128(Hash, _mm_srli_epi32(Word, 24)));
+}
+
+static FORCEINLINE __m128i HashSSE2(__m128i I, __m128i J, __m128i K, __m128i Seed)
+{
+	__m128i Hash = _mm_set1_epi32(int32(FnvOffsetBasis));
+	Hash = HashWordSSE2(Hash, I);
+	Hash = HashWordSSE2(Hash, J);
+	Hash = HashWordSSE2(Hash, K);
+	Hash = HashWordSSE2(Hash, Seed);
+	return _mm_and_si128(_mm_xor_si128(_mm_srli_epi32(Hash, 8), Hash), _mm_set1_epi32(0xff));
+}
+
+static FORCEINLINE __m128 CornerSSE2(const FVoxelGradientTables& Gradients, __m128i Hash, __m128 X, __m128 Y, __m128 Z)
+{
+	// SSE2 has no gather, so look the gradients up one lane at a time
+	alignas(16) int32 Indices[4];
+	_mm_store_si128(reinterpret_cast<__m128i*>(Indices), Hash);
+
+	const __m128 GX = _mm_set_ps(Gradients.X[Indices[3]], Gradients.X[Indices[2]], Gradients.X[Indices[1]], Gradients.X[Indices[0]]);
+	const __m128 GY = _mm_set_ps(Gradients.Y[Indices[3]], Gradients.Y[Indices[2]], Gradients.Y[Indices[1]], Gradients.Y[Indices[0]]);
+	const __m128 GZ = _mm_set_ps(Gradients.Z[Indices[3]], Gradients.Z[Indices[2]], Gradients.Z[Indices[1]], Gradients.Z[Indices[0]]);
+	const __m128 Dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(GX, X), _mm_mul_ps(GY, Y)), _mm_mul_ps(GZ, Z));
+
+	__m128 T = _mm_max_ps(_mm_sub_ps(_mm_set1_ps(0.6f), _mm_add_ps(_mm_add_ps(_mm_mul_ps(X, X), _mm_mul_ps(Y, Y)), _mm_mul_ps(Z, Z))), _mm_setzero_ps());
+	T = _mm_mul_ps(T, T);
+	return _mm_mul_ps(_mm_mul_ps(T, T), Dot);
+}
+
+static FORCEINLINE __m128 SimplexSSE2(const FVoxelGradientTables& Gradients, __m128i Seed, __m128 X, __m128 Y, __m128 Z)
+{
+	const __m128 S = _mm_mul_ps(_mm_add_ps(_mm_add_ps(X, Y), Z), _mm_set1_ps(SimplexF3));
+	const __m128i I = FastFloorSSE2(_mm_add_ps(X, S));
+	const __m128i J = FastFloorSSE2(_mm_add_ps(Y, S));
+	const __m128i K = FastFloorSSE2(_mm_add_ps(Z, S));
+
+	const __m128 T = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_add_epi32(I, J), K)), _mm_set1_ps(SimplexG3));
+	const __m128 X0 = _mm_sub_ps(X, _mm_sub_ps(_mm_cvtepi32_ps(I), T));
+	const __m128 Y0 = _mm_sub_ps(Y, _mm_sub_ps(_mm_cvtepi32_ps(J), T));
+	const __m128 Z0 = _mm_sub_ps(Z, _mm_sub_ps(_mm_cvtepi32_ps(K), T));
+
+	const __m128 XGreaterEqualY = _mm_cmpge_ps(X0, Y0);
+	const __m128 XGreaterEqualZ = _mm_cmpge_ps(X0, Z0);
+	const __m128 YGreaterX = _mm_cmpgt_ps(Y0, X0);
+	const __m128 YGreaterEqualZ = _mm_cmpge_ps(Y0, Z0);
+	const __m128 ZGreaterX = _mm_cmpgt_ps(Z0, X0);
+	const __m128 ZGreaterY = _mm_cmpgt_ps(Z0, Y0);
+
+	const __m128i One = _mm_set1_epi32(1);
+	const __m128i I1 = _mm_and_si128(_mm_castps_si128(_mm_and_ps(XGreaterEqualY, XGreaterEqualZ)), One);
+	const __m128i J1 = _mm_and_si128(_mm_castps_si128(_mm_and_ps(YGreaterX, YGreaterEqualZ)), One);
+	const __m128i K1 = _mm_and_si128(_mm_castps_si128(_mm_and_ps(ZGreaterX, ZGreaterY)), One);
+	const __m128i I2 = _mm_and_si128(_mm_castps_si128(_mm_or_ps(XGreaterEqualY, XGreaterEqualZ)), One);
+	const __m128i J2 = _mm_and_si128(_mm_castps_si128(_mm_or_ps(YGreaterX, YGreaterEqualZ)), One);
+	const __m128i K2 = _mm_and_si128(_mm_castps_si128(_mm_or_ps(ZGreaterX, ZGreaterY)), One);
+
+	const __m128 G3 = _mm_set1_ps(SimplexG3);
+	const __m128 TwoG3 = _mm_set1_ps(2.f * SimplexG3);
+	const __m128 ThreeG3 = _mm_set1_ps(3.f * SimplexG3);
+	const __m128 OneF = _mm_set1_ps(1.f);
+
+	const __m128 X1 = _mm_add_ps(_mm_sub_ps(X0, _mm_cvtepi32_ps(I1)), G3);
+	const __m128 Y1 = _mm_add_ps(_mm_sub_ps(Y0, _mm_cvtepi32_ps(J1)), G3);
+	const __m128 Z1 = _mm_add_ps(_mm_sub_ps(Z0, _mm_cvtepi32_ps(K1)), G3);
+	const __m128 X2 = _mm_add_ps(_mm_sub_ps(X0, _mm_cvtepi32_ps(I2)), TwoG3);
+	const __m128 Y2 = _mm_add_ps(_mm_sub_ps(Y0, _mm_cvtepi32_ps(J2)), TwoG3);
+	const __m128 Z2 = _mm_add_ps(_mm_sub_ps(Z0, _mm_cvtepi32_ps(K2)), TwoG3);
+	const __m128 X3 = _mm_add_ps(_mm_sub_ps(X0, OneF), ThreeG3);
+	const __m128 Y3 = _mm_add_ps(_mm_sub_ps(Y0, OneF), ThreeG3);
+	const __m128 Z3 = _mm_add_ps(_mm_sub_ps(Z0, OneF), ThreeG3);
+
+	const __m128i Hash0 = HashSSE2(I, J, K, Seed);
+	const __m128i Hash1 = HashSSE2(_mm_add_epi32(I, I1), _mm_add_epi32(J, J1), _mm_add_epi32(K, K1), Seed);
+	const __m128i Hash2 = HashSSE2(_mm_add_epi32(I, I2), _mm_add_epi32(J, J2), _mm_add_epi32(K, K2), Seed);
+	const __m128i Hash3 = HashSSE2(_mm_add_epi32(I, One), _mm_add_epi32(J, One), _mm_add_epi32(K, One), Seed);
+
+	const __m128 N = _mm_add_ps(_mm_add_ps(_mm_add_ps(CornerSSE2(Gradients, Hash0, X0, Y0, Z0), CornerSSE2(Gradients, Hash1, X1, Y1, Z1)), CornerSSE2(Gradients, Hash2, X2, Y2, Z2)), CornerSSE2(Gradients, Hash3, X3, Y3, Z3));
+	return _mm_add_ps(_mm_mul_ps(N, _mm_set1_ps(float(FVoxelBatchedNoise::SimplexScale))), _mm_set1_ps(float(FVoxelBatchedNoise::SimplexOffset)));
+}
+
+static void AccumulateLayerSSE2(const FVoxelGradientTables& Gradients, bool bRidged, const FVoxelNoiseLayer& Layer, const float* X, const float* Y, const float* Z, float* OutValues, int32 Count)
+{
+	const float (&M)[3][3] = Layer.Transform;
+	const __m128i Seed = _mm_set1_epi32(int32(Layer.Seed));
+	const __m128 AmplitudeV = _mm_set1_ps(Layer.Amplitude);
+	const __m128 SignMask = _mm_set1_ps(-0.f);
+
+	int32 i = 0;
+	for (; i + 4 <= Count; i += 4)
+	{
+		const __m128 VX = _mm_loadu_ps(X + i);
+		const __m128 VY = _mm_loadu_ps(Y + i);
+		const __m128 VZ = _mm_loadu_ps(Z + i);
+
+		const __m128 PX = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(M[0][0]), VX), _mm_mul_ps(_mm_set1_ps(M[0][1]), VY)), _mm_mul_ps(_mm_set1_ps(M[0][2]), VZ));
+		const __m128 PY = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(M[1][0]), VX), _mm_mul_ps(_mm_set1_ps(M[1][1]), VY)), _mm_mul_ps(_mm_set1_ps(M[1][2]), VZ));
+		const __m128 PZ = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(M[2][0]), VX), _mm_mul_ps(_mm_set1_ps(M[2][1]), VY)), _mm_mul_ps(_mm_set1_ps(M[2][2]), VZ));
+
+		__m128 Value = SimplexSSE2(Gradients, Seed, PX, PY, PZ);
+		if (bRidged)
+			Value = _mm_sub_ps(_mm_set1_ps(1.f), _mm_andnot_ps(SignMask, Value));
+
+		_mm_storeu_ps(OutValues + i, _mm_add_ps(_mm_loadu_ps(OutValues + i), _mm_mul_ps(AmplitudeV, Value)));
+	}
+
+	// Whatever doesn't fit in a whole vector goes through the scalar path
+	AccumulateLayerScalar(Gradients, bRidged, Layer, X + i, Y + i, Z + i, OutValues + i, Count - i);
+}
+
+////////////////////// AVX2 ////////////////////////////////////////
+
+VOXEL_NOISE_AVX2_TARGET static FORCEINLINE __m256i FastFloorAVX2(__m256 V)
+{
+	return _mm256_add_epi32(_mm256_cvttps_epi32(V), _mm256_castps_si256(_mm256_cmp_ps(V, _mm256_setzero_ps(), _CMP_LE_OQ)));
+}
+
+// Adds the four bytes of a word to the hash, lowest first
+VOXEL_NOISE_AVX2_TARGET static FORCEINLINE __m256i HashWordAVX2(__m256i Hash, __m256i Word)
+{
+	const __m256i ByteMask = _mm256_set1_epi32(0xff);
+	const __m256i Prime = _mm256_set1_epi32(int32(FnvPrime));
+	Hash = _mm256_mullo_epi32(_mm256_xor_si256(Hash, _mm256_and_si256(Word, ByteMask)), Prime);
+	Hash = _mm256_mullo_epi32(_mm256_xor_si256(Hash, _mm256_and_si256(_mm256_srli_epi32(Word, 8), ByteMask)), Prime);
+	Hash = _mm256_mullo_epi32(_mm256_xor_si256(Hash, _mm256_and_si256(_mm256_srli_epi32(Word, 16), ByteMask)), Prime);
+	return _mm256_mullo_epi32(_mm256_xor_si256(Hash, _mm256_srli_epi32(Word, 24)), Prime);
+}
+
+VOXEL_NOISE_AVX2_TARGET static FORCEINLINE __m256i HashAVX2(__m256i I, __m256i J, __m256i K, __m256i Seed)
+{
+	__m256i Hash = _mm256_set1_epi32(int32(FnvOffsetBasis));
+	Hash = HashWordAVX2(Hash, I);
+	Hash = HashWordAVX2(Hash, J);
+	Hash = HashWordAVX2(Hash, K);
+	Hash = HashWordAVX2(Hash, Seed);
+	return _mm256_and_si256(_mm256_xor_si256(_mm256_srli_epi32(Hash, 8), Hash), _mm256_set1_epi32(0xff));
+}
+
+VOXEL_NOISE_AVX2_TARGET static FORCEINLINE __m256 CornerAVX2(const FVoxelGradientTables& Gradients, __m256i Hash, __m256 X, __m256 Y, __m256 Z)
+{
+	const __m256 GX = _mm256_i32gather_ps(Gradients.X, Hash, 4);
+	const __m256 GY = _mm256_i32gather_ps(Gradients.Y, Hash, 4);
+	const __m256 GZ = _mm256_i32gather_ps(Gradients.Z, Hash, 4);
+	const __m256 Dot = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(GX, X), _mm256_mul_ps(GY, Y)), _mm256_mul_ps(GZ, Z));
+
+	__m256 T = _mm256_max_ps(_mm256_sub_ps(_mm256_set1_ps(0.6f), _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(X, X), _mm256_mul_ps(Y, Y)), _mm256_mul_ps(Z, Z))), _mm256_setzero_ps());
+	T = _mm256_mul_ps(T, T);
+	return _mm256_mul_ps(_mm256_mul_ps(T, T), Dot);
+}
+
+VOXEL_NOISE_AVX2_TARGET static FORCEINLINE __m256 SimplexAVX2(const FVoxelGradientTables& Gradients, __m256i Seed, __m256 X, __m256 Y, __m256 Z)
+{
+	const __m256 S = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(X, Y), Z), _mm256_set1_ps(SimplexF3));
+	const __m256i I = FastFloorAVX2(_mm256_add_ps(X, S));
+	const __m256i J = FastFloorAVX2(_mm256_add_ps(Y, S));
+	const __m256i K = FastFloorAVX2(_mm256_add_ps(Z, S));
+
+	const __m256 T = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_add_epi32(I, J), K)), _mm256_set1_ps(SimplexG3));
+	const __m256 X0 = _mm256_sub_ps(X, _mm256_sub_ps(_mm256_cvtepi32_ps(I), T));
+	const __m256 Y0 = _mm256_sub_ps(Y, _mm256_sub_ps(_mm256_cvtepi32_ps(J), T));
+	const __m256 Z0 = _mm256_sub_ps(Z, _mm256_sub_ps(_mm256_cvtepi32_ps(K), T));
+
+	const __m256 XGreaterEqualY = _mm256_cmp_ps(X0, Y0, _CMP_GE_OQ);
+	const __m256 XGreaterEqualZ = _mm256_cmp_ps(X0, Z0, _CMP_GE_OQ);
+	const __m256 YGreaterX = _mm256_cmp_ps(Y0, X0, _CMP_GT_OQ);
+	const __m256 YGreaterEqualZ = _mm256_cmp_ps(Y0, Z0, _CMP_GE_OQ);
+	const __m256 ZGreaterX = _mm256_cmp_ps(Z0, X0, _CMP_GT_OQ);
+	const __m256 ZGreaterY = _mm256_cmp_ps(Z0, Y0, _CMP_GT_OQ);
+
+	const __m256i One = _mm256_set1_epi32(1);
+	const __m256i I1 = _mm256_and_si256(_mm256_castps_si256(_mm256_and_ps(XGreaterEqualY, XGreaterEqualZ)), One);
+	const __m256i J1 = _mm256_and_si256(_mm256_castps_si256(_mm256_and_ps(YGreaterX, YGreaterEqualZ)), One);
+	const __m256i K1 = _mm256_and_si256(_mm256_castps_si256(_mm256_and_ps(ZGreaterX, ZGreaterY)), One);
+	const __m256i I2 = _mm256_and_si256(_mm256_castps_si256(_mm256_or_ps(XGreaterEqualY, XGreaterEqualZ)), One);
+	const __m256i J2 = _mm256_and_si256(_mm256_castps_si256(_mm256_or_ps(YGreaterX, YGreaterEqualZ)), One);
+	const __m256i K2 = _mm256_and_si256(_mm256_castps_si256(_mm256_or_ps(ZGreaterX, ZGreaterY)), One);
+
+	const __m256 G3 = _mm256_set1_ps(SimplexG3);
+	const __m256 TwoG3 = _mm256_set1_ps(2.f * SimplexG3);
+	const __m256 ThreeG3 = _mm256_set1_ps(3.f * SimplexG3);
+	const __m256 OneF = _mm256_set1_ps(1.f);
+
+	const __m256 X1 = _mm256_add_ps(_mm256_sub_ps(X0, _mm256_cvtepi32_ps(I1)), G3);
+	const __m256 Y1 = _mm256_add_ps(_mm256_sub_ps(Y0, _mm256_cvtepi32_ps(J1)), G3);
+	const __m256 Z1 = _mm256_add_ps(_mm256_sub_ps(Z0, _mm256_cvtepi32_ps(K1)), G3);
+	const __m256 X2 = _mm256_add_ps(_mm256_sub_ps(X0, _mm256_cvtepi32_ps(I2)), TwoG3);
+	const __m256 Y2 = _mm256_add_ps(_mm256_sub_ps(Y0, _mm256_cvtepi32_ps(J2)), TwoG3);
+	const __m256 Z2 = _mm256_add_ps(_mm256_sub_ps(Z0, _mm256_cvtepi32_ps(K2)), TwoG3);
+	const __m256 X3 = _mm256_add_ps(_mm256_sub_ps(X0, OneF), ThreeG3);
+	const __m256 Y3 = _mm256_add_ps(_mm256_sub_ps(Y0, OneF), ThreeG3);
+	const __m256 Z3 = _mm256_add_ps(_mm256_sub_ps(Z0, OneF), ThreeG3);
+
+	const __m256i Hash0 = HashAVX2(I, J, K, Seed);
+	const __m256i Hash1 = HashAVX2(_mm256_add_epi32(I, I1), _mm256_add_epi32(J, J1), _mm256_add_epi32(K, K1), Seed);
+	const __m256i Hash2 = HashAVX2(_mm256_add_epi32(I, I2), _mm256_add_epi32(J, J2), _mm256_add_epi32(K, K2), Seed);
+	const __m256i Hash3 = HashAVX2(_mm256_add_epi32(I, One), _mm256_add_epi32(J, One), _mm256_add_epi32(K, One), Seed);
+
+	const __m256 N = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(CornerAVX2(Gradients, Hash0, X0, Y0, Z0), CornerAVX2(Gradients, Hash1, X1, Y1, Z1)), CornerAVX2(Gradients, Hash2, X2, Y2, Z2)), CornerAVX2(Gradients, Hash3, X3, Y3, Z3));
+	return _mm256_add_ps(_mm256_mul_ps(N, _mm256_set1_ps(float(FVoxelBatchedNoise::SimplexScale))), _mm256_set1_ps(float(FVoxelBatchedNoise::SimplexOffset)));
+}
+
+VOXEL_NOISE_AVX2_TARGET static void AccumulateLayerAVX2(const FVoxelGradientTables& Gradients, bool bRidged, const FVoxelNoiseLayer& Layer, const float* X, const float* Y, const float* Z, float* OutValues, int32 Count)
+{
+	const float (&M)[3][3] = Layer.Transform;
+	const __m256i Seed = _mm256_set1_epi32(int32(Layer.Seed));
+	const __m256 AmplitudeV = _mm256_set1_ps(Layer.Amplitude);
+	const __m256 SignMask = _mm256_set1_ps(-0.f);
+
+	int32 i = 0;
+	for (; i + 8 <= Count; i += 8)
+	{
+		const __m256 VX = _mm256_loadu_ps(X + i);
+		const __m256 VY = _mm256_loadu_ps(Y + i);
+		const __m256 VZ = _mm256_loadu_ps(Z + i);
+
+		const __m256 PX = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(M[0][0]), VX), _mm256_mul_ps(_mm256_set1_ps(M[0][1]), VY)), _mm256_mul_ps(_mm256_set1_ps(M[0][2]), VZ));
+		const __m256 PY = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(M[1][0]), VX), _mm256_mul_ps(_mm256_set1_ps(M[1][1]), VY)), _mm256_mul_ps(_mm256_set1_ps(M[1][2]), VZ));
+		const __m256 PZ = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(M[2][0]), VX), _mm256_mul_ps(_mm256_set1_ps(M[2][1]), VY)), _mm256_mul_ps(_mm256_set1_ps(M[2][2]), VZ));
+
+		__m256 Value = SimplexAVX2(Gradients, Seed, PX, PY, PZ);
+		if (bRidged)
+			Value = _mm256_sub_ps(_mm256_set1_ps(1.f), _mm256_andnot_ps(SignMask, Value));
+
+		_mm256_storeu_ps(OutValues + i, _mm256_add_ps(_mm256_loadu_ps(OutValues + i), _mm256_mul_ps(AmplitudeV, Value)));
+	}
+
+	// Whatever doesn't fit in a whole vector goes through the SSE2 and then the scalar path
+	AccumulateLayerSSE2(Gradients, bRidged, Layer, X + i, Y + i, Z + i, OutValues + i, Count - i);
+}
+
+// Returns true if both the CPU and the OS support AVX2
+static bool IsAVX2Supported()
+{
+#if defined(_MSC_VER)
+	int32 Registers[4] = { 0 };
+	__cpuid(Registers, 0);
+	if (Registers[0] < 7)
+		return false;
+
+	__cpuid(Registers, 1);
+	const bool bOSXSave = (Registers[2] & (1 << 27)) != 0;
+	const bool bAVX = (Registers[2] & (1 << 28)) != 0;
+	if (!bOSXSave || !bAVX)
+		return false;
+
+	// The OS has to save the YMM registers when switching threads
+	if ((_xgetbv(0) & 0x6) != 0x6)
+		return false;
+
+	__cpuidex(Registers, 7, 0);
+	return (Registers[1] & (1 << 5)) != 0;
+#else
+	uint32 EAX, EBX, ECX, EDX;
+	if (__get_cpuid_max(0, nullptr) < 7)
+		return false;
+
+	__cpuid(1, EAX, EBX, ECX, EDX);
+	const bool bOSXSave = (ECX & (1 << 27)) != 0;
+	const bool bAVX = (ECX & (1 << 28)) != 0;
+	if (!bOSXSave || !bAVX)
+		return false;
+
+	// The OS has to save the YMM registers when switching threads
+	uint32 XCR0Low, XCR0High;
+	__asm__ __volatile__("xgetbv" : "=a"(XCR0Low), "=d"(XCR0High) : "c"(0));
+	if ((XCR0Low & 0x6) != 0x6)
+		return false;
+
+	__cpuid_count(7, 0, EAX, EBX, ECX, EDX);
+	return (EBX & (1 << 5)) != 0;
+#endif
+}
+
+#endif // VOXEL_NOISE_X86
+
+EVoxelNoiseInstructionSet FVoxelBatchedNoise::GetSupportedInstructionSet()
+{
+#if VOXEL_NOISE_X86
+	// Every x86 CPU UE4 runs on has SSE2, so the only thing worth checking for is AVX2
+	static const EVoxelNoiseInstructionSet SupportedInstructionSet = IsAVX2Supported() ? EVoxelNoiseInstructionSet::AVX2 : EVoxelNoiseInstructionSet::SSE2;
+	return SupportedInstructionSet;
+#else
+	return EVoxelNoiseInstructionSet::Scalar;
+#endif
+}
+
+const TCHAR* FVoxelBatchedNoise::GetInstructionSetName(EVoxelNoiseInstructionSet InstructionSet)
+{
+	switch (InstructionSet)
+	{
+	case EVoxelNoiseInstructionSet::SSE2:
+		return TEXT("SSE2");
+
+	case EVoxelNoiseInstructionSet::AVX2:
+		return TEXT("AVX2");
+
+	case EVoxelNoiseInstructionSet::Scalar:
+	default:
+		return TEXT("Scalar");
+	}
+}
+
+void FVoxelBatchedNoise::EvaluateFractal(const FVoxelNoiseFractal& Fractal, const float* X, const float* Y, const float* Z, float* OutValues, int32 Count) const
+{
+	EvaluateFractal(GetSupportedInstructionSet(), Fractal, X, Y, Z, OutValues, Count);
+}
+
+void FVoxelBatchedNoise::EvaluateFractal(EVoxelNoiseInstructionSet InstructionSet, const FVoxelNoiseFractal& Fractal, const float* X, const float* Y, const float* Z, float* OutValues, int32 Count) const
+{
+	FMemory::Memzero(OutValues, Count * sizeof(float));
+
+	const FVoxelGradientTables Gradients = { GradientX, GradientY, GradientZ };
+	const bool bRidged = Fractal.Type == EVoxelFractalType::Ridged;
+
+	// The layers are added up in the same order ANL adds them
+	for (const FVoxelNoiseLayer& Layer : Fractal.Layers)
+	{
+		switch (InstructionSet)
+		{
+#if VOXEL_NOISE_X86
+		case EVoxelNoiseInstructionSet::AVX2:
+			AccumulateLayerAVX2(Gradients, bRidged, Layer, X, Y, Z, OutValues, Count);
+			break;
+
+		case EVoxelNoiseInstructionSet::SSE2:
+			AccumulateLayerSSE2(Gradients, bRidged, Layer, X, Y, Z, OutValues, Count);
+			break;
+#endif
+
+		default:
+			AccumulateLayerScalar(Gradients, bRidged, Layer, X, Y, Z, OutValues, Count);
+			break;
+		}
+	}
+}
@@ -0,0 +1,104 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// The instruction sets the batched noise can run on
+enum class EVoxelNoiseInstructionSet : uint8
+{
+	Scalar,
+	SSE2,
+	AVX2
+};
+
+// The kinds of fractal the batched noise can evaluate
+enum class EVoxelFractalType : uint8
+{
+	// Fractal Brownian motion, like ANL's simplefBm: the layers are added together
+	Fbm,
+
+	// Ridged multifractal, like ANL's simpleRidgedMultifractal: each layer adds 1 - |noise|, which turns the zero crossings of the noise into sharp ridges
+	Ridged
+};
+
+// One layer of a fractal: the simplex basis with its own seed, sampled at the rotated and scaled position and multiplied by Amplitude
+struct FVoxelNoiseLayer
+{
+	// The seed of the basis, which goes into the hash of every lattice point
+	uint32 Seed = 0;
+
+	// How much the layer adds to the fractal
+	float Amplitude = 1.f;
+
+	// The frequency times the rotation of the layer. Row r gives coordinate r of the point the basis is sampled at.
+	float Transform[3][3];
+};
+
+// A fractal the batched noise can evaluate, laid out the same way ANL builds it
+struct FVoxelNoiseFractal
+{
+	EVoxelFractalType Type = EVoxelFractalType::Fbm;
+
+	// The layers, in the order ANL adds them up
+	TArray<FVoxelNoiseLayer> Layers;
+
+	// Returns the furthest the fractal can get from zero, if the basis stays within -1 to 1
+	float GetAmplitudeSum() const;
+};
+
+// Evaluates ANL's simplex fractals for lots of points at once, using SSE2 or AVX2 when the CPU has them.
+// The points are passed as separate X, Y and Z arrays so whole vectors can be loaded at a time.
+//
+// This is a port of ANL's simplex basis: the same skew, the same corner hash, the same scale and ANL's own table of gradients. ANL works in doubles and this works in floats, so the results match ANL to within AnlTolerance for positions
+// within AnlToleranceExtent voxels of the origin. Every instruction set does the same operations in the same order, so the vector paths match the scalar path to within Tolerance.
+class FVoxelBatchedNoise
+{
+public:
+	// The largest difference between the results of the vector paths and the scalar path
+	static constexpr float Tolerance = 1e-5f;
+
+	// The largest difference from ANL the pager accepts before it falls back to ANL, in the units of the unscaled fractal
+	static constexpr float AnlTolerance = 1e-3f;
+
+	// How far from the origin AnlTolerance holds, in voxels. Floats lose precision further out, and ANL's corners reach a little past the edges of their simplex,
+	// so a point that floats put in a different simplex than doubles do comes out slightly different.
+	static const int32 AnlToleranceExtent = 8192;
+
+	// The number of points callers should aim to pass in at once
+	static const int32 BatchSize = 256;
+
+	// The number of gradients in ANL's table
+	static const int32 NumGradients = 256;
+
+	// ANL scales the sum of the corners by this and adds the offset, to stretch the output out to -1 to 1
+	static constexpr double SimplexScale = 32.0 * 1.25086885;
+	static constexpr double SimplexOffset = 0.0003194984;
+
+	// Copies ANL's table of gradients
+	FVoxelBatchedNoise();
+
+	// Builds the layers of a fractal the way ANL's simplefBm or simpleRidgedMultifractal does for the same arguments
+	static FVoxelNoiseFractal MakeFractal(EVoxelFractalType Type, int32 Octaves, double Frequency, uint32 Seed);
+
+	// Returns the index of the gradient ANL uses for a lattice point of the simplex grid
+	static uint32 HashLatticePoint(int32 I, int32 J, int32 K, uint32 Seed);
+
+	// Evaluates a fractal at Count points using the best instruction set the CPU supports
+	void EvaluateFractal(const FVoxelNoiseFractal& Fractal, const float* X, const float* Y, const float* Z, float* OutValues, int32 Count) const;
+
+	// Evaluates a fractal at Count points with a specific instruction set. The instruction set must be supported by the CPU.
+	void EvaluateFractal(EVoxelNoiseInstructionSet InstructionSet, const FVoxelNoiseFractal& Fractal, const float* X, const float* Y, const float* Z, float* OutValues, int32 Count) const;
+
+	// Returns the best instruction set the CPU supports. This is only worked out once.
+	static EVoxelNoiseInstructionSet GetSupportedInstructionSet();
+
+	// Returns the name of an instruction set for logging
+	static const TCHAR* GetInstructionSetName(EVoxelNoiseInstructionSet InstructionSet);
+
+private:
+	// ANL's gradients, split into one table per axis so they can be gathered a component at a time
+	float GradientX[NumGradients];
+	float GradientY[NumGradients];
+	float GradientZ[NumGradients];
+};
@@ -0,0 +1,235 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#include "VoxelChunkMeshBuilder.h"
+#include "VoxelTerrain.h"
+#include "VoxelTerrainStats.h"
+
+using namespace PolyVox;
+
+// Describes one of the six directions a blocky face can point in
+struct FVoxelFaceDirection
+{
+	// The normal of the face
+	FVector Normal;
+
+	// The texture U and V directions across the face. U is also used as the tangent.
+	FVector UAxis;
+	FVector VAxis;
+};
+
+// +X, -X, +Y, -Y, +Z, -Z
+// V runs down the side faces so that textures aren't upside down.
+static const FVoxelFaceDirection FaceDirections[6] =
+{
+	{ FVector( 1.f,  0.f,  0.f), FVector( 0.f,  1.f,  0.f), FVector(0.f,  0.f, -1.f) },
+	{ FVector(-1.f,  0.f,  0.f), FVector( 0.f, -1.f,  0.f), FVector(0.f,  0.f, -1.f) },
+	{ FVector( 0.f,  1.f,  0.f), FVector(-1.f,  0.f,  0.f), FVector(0.f,  0.f, -1.f) },
+	{ FVector( 0.f, -1.f,  0.f), FVector( 1.f,  0.f,  0.f), FVector(0.f,  0.f, -1.f) },
+	{ FVector( 0.f,  0.f,  1.f), FVector( 1.f,  0.f,  0.f), FVector(0.f,  1.f,  0.f) },
+	{ FVector( 0.f,  0.f, -1.f), FVector( 1.f,  0.f,  0.f), FVector(0.f, -1.f,  0.f) },
+};
+
+// Returns the index into FaceDirections that is closest to the given (not necessarily normalized) direction
+static FORCEINLINE int32 GetFaceDirection(const FVector& Direction)
+{
+	const FVector AbsDirection = Direction.GetAbs();
+
+	if (AbsDirection.X >= AbsDirection.Y && AbsDirection.X >= AbsDirection.Z)
+		return Direction.X > 0.f ? 0 : 1;
+
+	if (AbsDirection.Y >= AbsDirection.Z)
+		return Direction.Y > 0.f ? 2 : 3;
+
+	return Direction.Z > 0.f ? 4 : 5;
+}
+
+// Returns the section a triangle of the given terrain material goes into
+static FORCEINLINE FVoxelChunkMeshSection& GetMaterialSection(FVoxelChunkMeshData& MeshData, int32 MaterialIndex)
+{
+	return MeshData.Sections[MeshData.bSingleSection ? 0 : MaterialIndex];
+}
+
+// Single section meshes tell the material which terrain material a vertex is with its vertex color
+static FORCEINLINE void AddMaterialColor(FVoxelChunkMeshSection& Section, bool bSingleSection, int32 MaterialIndex)
+{
+	if (bSingleSection)
+		Section.Colors.Add(FColor(uint8(MaterialIndex), 0, 0, 255));
+}
+
+// Adds a vertex with the given face direction to the section, unless it has already been added.
+// Returns the index of the vertex within the section.
+static FORCEINLINE int32 AddFaceVertex(FVoxelChunkMeshSection& Section, int32& RemappedIndex, const FVector& Position, const FVoxelFaceDirection& Face, bool bSingleSection, int32 MaterialIndex)
+{
+	if (RemappedIndex == INDEX_NONE)
+	{
+		// The UVs are in voxels, so each voxel gets one copy of the texture however big the face is
+		RemappedIndex = Section.Vertices.Add(Position * 100.f);
+		Section.Normals.Add(Face.Normal);
+		Section.Tangents.Add(FProcMeshTangent(Face.UAxis, ((Face.Normal ^ Face.UAxis) | Face.VAxis) < 0.f));
+		Section.UV0.Add(FVector2D(Position | Face.UAxis, Position | Face.VAxis));
+		AddMaterialColor(Section, bSingleSection, MaterialIndex);
+	}
+
+	return RemappedIndex;
+}
+
+void FVoxelChunkMeshBuilder::BuildCubicMesh(const Mesh<CubicVertex<MaterialDensityPair88>>& ExtractedMesh, const FVector& OffsetLocation, FVoxelChunkMeshData& OutMeshData, float VoxelSize)
+{
+	VOXEL_TERRAIN_SCOPE(STAT_VoxelTerrain_BuildMesh);
+
+	const int32 NumMaterials = OutMeshData.NumMaterials;
+	const bool bSingleSection = OutMeshData.bSingleSection;
+	const uint32 NumIndices = ExtractedMesh.getNoOfIndices();
+
+	// A PolyVox vertex can be shared by faces pointing in different directions, and each direction needs its own normal.
+	// So every PolyVox vertex gets one slot per direction.
+	VertexRemap.Reset();
+	VertexRemap.SetNumUninitialized(ExtractedMesh.getNoOfVertices() * 6);
+	FMemory::Memset(VertexRemap.GetData(), 0xFF, VertexRemap.Num() * sizeof(int32));
+
+	for (uint32 i = 0; i + 2 < NumIndices; i += 3)
+	{
+		const uint32 Index0 = ExtractedMesh.getIndex(i);
+		const uint32 Index1 = ExtractedMesh.getIndex(i + 1);
+		const uint32 Index2 = ExtractedMesh.getIndex(i + 2);
+
+		// Every vertex of a blocky face has the same material, so any of them will do
+		const auto& Vertex2 = ExtractedMesh.getVertex(Index2);
+		const int32 MaterialIndex = int32(Vertex2.data.getMaterial()) - 1;
+
+		if (MaterialIndex < 0 || MaterialIndex >= NumMaterials)
+			continue;
+
+		FVoxelChunkMeshSection& Section = GetMaterialSection(OutMeshData, MaterialIndex);
+
+		const FVector Position0 = FPolyVoxVector(decodeVertex(ExtractedMesh.getVertex(Index0)).position) * VoxelSize + OffsetLocation;
+		const FVector Position1 = FPolyVoxVector(decodeVertex(ExtractedMesh.getVertex(Index1)).position) * VoxelSize + OffsetLocation;
+		const FVector Position2 = FPolyVoxVector(decodeVertex(Vertex2).position) * VoxelSize + OffsetLocation;
+
+		// The winding tells us which way the face points, so there's no need to normalize anything
+		const int32 Direction = GetFaceDirection((Position1 - Position0) ^ (Position2 - Position0));
+		const FVoxelFaceDirection& Face = FaceDirections[Direction];
+
+		// We need to add the vertices of each triangle in reverse or the mesh will be upside down
+		Section.Indices.Add(AddFaceVertex(Section, VertexRemap[Index2 * 6 + Direction], Position2, Face, bSingleSection, MaterialIndex));
+		Section.Indices.Add(AddFaceVertex(Section, VertexRemap[Index1 * 6 + Direction], Position1, Face, bSingleSection, MaterialIndex));
+		Section.Indices.Add(AddFaceVertex(Section, VertexRemap[Index0 * 6 + Direction], Position0, Face, bSingleSection, MaterialIndex));
+	}
+}
+
+void FVoxelChunkMeshBuilder::BuildMarchingCubesMesh(const Mesh<MarchingCubesVertex<MaterialDensityPair88>>& ExtractedMesh, const FVector& OffsetLocation, FVoxelChunkMeshData& OutMeshData, float VoxelSize, const FVoxelDensityField* DensityField)
+{
+	VOXEL_TERRAIN_SCOPE(STAT_VoxelTerrain_BuildMesh);
+
+	const int32 NumMaterials = OutMeshData.NumMaterials;
+	const bool bSingleSection = OutMeshData.bSingleSection;
+	const uint32 NumIndices = ExtractedMesh.getNoOfIndices();
+
+	// Triangles of different materials can share a vertex, so every PolyVox vertex gets one slot per material
+	VertexRemap.Reset();
+	VertexRemap.SetNumUninitialized(ExtractedMesh.getNoOfVertices() * NumMaterials);
+	FMemory::Memset(VertexRemap.GetData(), 0xFF, VertexRemap.Num() * sizeof(int32));
+
+	for (uint32 i = 0; i + 2 < NumIndices; i += 3)
+	{
+		// The material of a smooth triangle is taken from its last vertex
+		const uint32 TriangleIndices[3] = { ExtractedMesh.getIndex(i + 2), ExtractedMesh.getIndex(i + 1), ExtractedMesh.getIndex(i) };
+		const int32 MaterialIndex = int32(ExtractedMesh.getVertex(TriangleIndices[0]).data.getMaterial()) - 1;
+
+		if (MaterialIndex < 0 || MaterialIndex >= NumMaterials)
+			continue;
+
+		FVoxelChunkMeshSection& Section = GetMaterialSection(OutMeshData, MaterialIndex);
+
+		// We need to add the vertices of each triangle in reverse or the mesh will be upside down
+		for (uint32 Index : TriangleIndices)
+		{
+			int32& RemappedIndex = VertexRemap[Index * NumMaterials + MaterialIndex];
+
+			if (RemappedIndex == INDEX_NONE)
+			{
+				const auto DecodedVertex = decodeVertex(ExtractedMesh.getVertex(Index));
+				const FVector Position = FPolyVoxVector(DecodedVertex.position) * VoxelSize + OffsetLocation;
+
+				// PolyVox packs its normals into a few bits, which bands the lighting across smooth slopes
+				FVector Normal = DensityField ? DensityField->GetNormal(FPolyVoxVector(DecodedVertex.position)) : FVector::ZeroVector;
+				if (Normal.IsZero())
+					Normal = FPolyVoxVector(DecodedVertex.normal);
+
+				// Project the texture along whichever axis the surface faces the most
+				const FVoxelFaceDirection& Face = FaceDirections[GetFaceDirection(Normal)];
+				const FVector TangentX = (Face.UAxis - Normal * (Face.UAxis | Normal)).GetSafeNormal();
+
+				RemappedIndex = Section.Vertices.Add(Position * 100.f);
+				Section.Normals.Add(Normal);
+				Section.Tangents.Add(FProcMeshTangent(TangentX, ((Normal ^ TangentX) | Face.VAxis) < 0.f));
+				Section.UV0.Add(FVector2D(Position | Face.UAxis, Position | Face.VAxis));
+				AddMaterialColor(Section, bSingleSection, MaterialIndex);
+			}
+
+			Section.Indices.Add(RemappedIndex);
+		}
+	}
+}
+
+// Copies the positions and triangles of a PolyVox mesh into the collision mesh
+template<typename VertexType>
+static void BuildCollisionFromMesh(const Mesh<VertexType>& ExtractedMesh, const FVector& OffsetLocation, FVoxelChunkMeshData& OutMeshData)
+{
+	const uint32 NumVertices = ExtractedMesh.getNoOfVertices();
+	const uint32 NumIndices = ExtractedMesh.getNoOfIndices();
+
+	OutMeshData.CollisionVertices.Reset(NumVertices);
+	OutMeshData.CollisionIndices.Reset(NumIndices);
+
+	for (uint32 i = 0; i < NumVertices; i++)
+		OutMeshData.CollisionVertices.Add((FPolyVoxVector(decodeVertex(ExtractedMesh.getVertex(i)).position) + OffsetLocation) * 100.f);
+
+	// Reversed like the render triangles, so the collision faces point the same way
+	for (uint32 i = 0; i + 2 < NumIndices; i += 3)
+	{
+		OutMeshData.CollisionIndices.Add(ExtractedMesh.getIndex(i + 2));
+		OutMeshData.CollisionIndices.Add(ExtractedMesh.getIndex(i + 1));
+		OutMeshData.CollisionIndices.Add(ExtractedMesh.getIndex(i));
+	}
+}
+
+void FVoxelChunkMeshBuilder::BuildCollisionMesh(const Mesh<CubicVertex<MaterialDensityPair88>>& ExtractedMesh, const FVector& OffsetLocation, FVoxelChunkMeshData& OutMeshData)
+{
+	BuildCollisionFromMesh(ExtractedMesh, OffsetLocation, OutMeshData);
+}
+
+void FVoxelChunkMeshBuilder::BuildCollisionMesh(const Mesh<MarchingCubesVertex<MaterialDensityPair88>>& ExtractedMesh, const FVector& OffsetLocation, FVoxelChunkMeshData& OutMeshData)
+{
+	BuildCollisionFromMesh(ExtractedMesh, OffsetLocation, OutMeshData);
+}
+
+FVector FVoxelDensityField::GetGradient(int32 X, int32 Y, int32 Z) const
+{
+	return FVector(
+		GetDensity(X + 1, Y, Z) - GetDensity(X - 1, Y, Z),
+		GetDensity(X, Y + 1, Z) - GetDensity(X, Y - 1, Z),
+		GetDensity(X, Y, Z + 1) - GetDensity(X, Y, Z - 1)) * 0.5f;
+}
+
+FVector FVoxelDensityField::GetNormal(const FVector& Position) const
+{
+	const FIntVector Base(FMath::FloorToInt(Position.X), FMath::FloorToInt(Position.Y), FMath::FloorToInt(Position.Z));
+	const FVector Fraction = Position - FVector(Base);
+
+	// Marching cubes vertices sit on the edges of the cells, so at most two of the corners have any weight.
+	// The corners without any are skipped rather than read, so nothing past the edge of the box is ever needed.
+	FVector Gradient = FVector::ZeroVector;
+	for (int32 Corner = 0; Corner < 8; Corner++)
+	{
+		const float WeightX = (Corner & 1) ? Fraction.X : 1.f - Fraction.X;
+		const float WeightY = (Corner & 2) ? Fraction.Y : 1.f - Fraction.Y;
+		const float WeightZ = (Corner & 4) ? Fraction.Z : 1.f - Fraction.Z;
+		const float Weight = WeightX * WeightY * WeightZ;
+
+		if (Weight > 0.f)
+			Gradient += GetGradient(Base.X + (Corner & 1), Base.Y + ((Corner >> 1) & 1), Base.Z + ((Corner >> 2) & 1)) * Weight;
+	}
+
+	return (-Gradient).GetSafeNormal();
+}
@@ -0,0 +1,252 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProceduralMeshComponent.h"
+#include "VoxelChunkVisibility.h"
+#include "VoxelPolyVoxVector.h"
+
+// PolyVox
+#include "PolyVox/CubicSurfaceExtractor.h"
+#include "PolyVox/MaterialDensityPair.h"
+#include "PolyVox/MarchingCubesSurfaceExtractor.h"
+#include "PolyVox/Mesh.h"
+
+// The buffers for a single material section of a chunk mesh.
+// These are exactly the arrays that UProceduralMeshComponent::CreateMeshSection expects.
+// Colors is only filled in for single section meshes, where it carries the material of each vertex.
+struct FVoxelChunkMeshSection
+{
+	TArray<FVector> Vertices;
+	TArray<int32> Indices;
+	TArray<FVector> Normals;
+	TArray<FVector2D> UV0;
+	TArray<FColor> Colors;
+	TArray<FProcMeshTangent> Tangents;
+
+	// Empties the section but keeps the memory around for the next chunk
+	void Reset()
+	{
+		Vertices.Reset();
+		Indices.Reset();
+		Normals.Reset();
+		UV0.Reset();
+		Colors.Reset();
+		Tangents.Reset();
+	}
+};
+
+// Everything a worker thread produces for a single chunk.
+// The game thread turns this into a mesh component.
+struct FVoxelChunkMeshData
+{
+	// The chunk coordinates this mesh belongs to. For coarser levels of detail these are the coordinates of the node at that level.
+	FIntVector ChunkCoord;
+
+	// The level of detail the mesh was built at. Zero is full resolution.
+	int32 Lod = 0;
+
+	// How long the worker spent building the mesh, in seconds
+	double GenerationSeconds = 0;
+
+	// How much of GenerationSeconds went to each stage
+	double NoiseSeconds = 0;
+	double ExtractSeconds = 0;
+	double MeshBuildSeconds = 0;
+
+	// How long the worker spent building the collision mesh, in seconds. This is part of GenerationSeconds too.
+	double CollisionSeconds = 0;
+
+	// True if the render sections were built. Chunks that only needed collision leave them empty.
+	bool bHasMesh = true;
+
+	// True if the collision mesh was built. An empty collision mesh still counts, it just means there is nothing to collide with.
+	bool bHasCollision = false;
+
+	// True if the chunk was skipped without extracting it, because the noise couldn't have a surface in it
+	bool bSkipped = false;
+
+	// True if the chunk was read from the mesh cache instead of being generated
+	bool bCached = false;
+
+	// The generation epoch this chunk was requested in. Used to throw away chunks that were cancelled.
+	int32 Epoch = 0;
+
+	// True if the chunk was cancelled before it could be built
+	bool bCancelled = false;
+
+	// True if the faces the chunk's air connects were worked out. Only full resolution chunks have them, and only when they were asked for.
+	bool bHasVisibility = false;
+
+	// Which faces of the chunk can see each other, for hiding the chunks behind it
+	FVoxelChunkVisibility Visibility;
+
+	// One section per terrain material, or a single section for every material when bSingleSection is set
+	TArray<FVoxelChunkMeshSection> Sections;
+
+	// The number of terrain materials. Voxels with a material past this aren't drawn.
+	int32 NumMaterials = 0;
+
+	// True if every material goes into the first section, with the index of its terrain material in the red channel of the vertex colors
+	bool bSingleSection = false;
+
+	// The collision mesh, in the same space as the sections. This comes from the voxels rather than the render triangles,
+	// with faces merged regardless of material, so it is only positions and triangles.
+	TArray<FVector> CollisionVertices;
+	TArray<int32> CollisionIndices;
+
+	// Returns true if none of the sections contain any triangles
+	bool IsEmpty() const
+	{
+		for (const FVoxelChunkMeshSection& Section : Sections)
+		{
+			if (Section.Indices.Num() > 0)
+				return false;
+		}
+
+		return true;
+	}
+
+	// Returns the number of sections with any triangles in them, which is how many draw calls the chunk takes
+	int32 GetNumSections() const
+	{
+		int32 NumSections = 0;
+		for (const FVoxelChunkMeshSection& Section : Sections)
+		{
+			if (Section.Indices.Num() > 0)
+				NumSections++;
+		}
+
+		return NumSections;
+	}
+
+	// Returns the number of triangles in every section
+	int32 GetNumTriangles() const
+	{
+		int32 NumIndices = 0;
+		for (const FVoxelChunkMeshSection& Section : Sections)
+			NumIndices += Section.Indices.Num();
+
+		return NumIndices / 3;
+	}
+
+	// Returns the number of vertices in every section
+	int32 GetNumVertices() const
+	{
+		int32 NumVertices = 0;
+		for (const FVoxelChunkMeshSection& Section : Sections)
+			NumVertices += Section.Vertices.Num();
+
+		return NumVertices;
+	}
+
+	// Returns roughly how much memory the mesh takes up. This is what the mesh component keeps a copy of.
+	int64 GetMeshBytes() const
+	{
+		int64 Bytes = 0;
+		for (const FVoxelChunkMeshSection& Section : Sections)
+		{
+			Bytes += Section.Vertices.Num() * sizeof(FVector);
+			Bytes += Section.Indices.Num() * sizeof(int32);
+			Bytes += Section.Normals.Num() * sizeof(FVector);
+			Bytes += Section.UV0.Num() * sizeof(FVector2D);
+			Bytes += Section.Colors.Num() * sizeof(FColor);
+			Bytes += Section.Tangents.Num() * sizeof(FProcMeshTangent);
+		}
+
+		return Bytes;
+	}
+
+	// Empties the mesh data so it can be reused for another chunk without reallocating
+	void Reset(int32 InNumMaterials, bool bInSingleSection = false)
+	{
+		ChunkCoord = FIntVector::ZeroValue;
+		Lod = 0;
+		GenerationSeconds = 0;
+		NoiseSeconds = 0;
+		ExtractSeconds = 0;
+		MeshBuildSeconds = 0;
+		CollisionSeconds = 0;
+		bHasMesh = true;
+		bHasCollision = false;
+		bSkipped = false;
+		bCached = false;
+		Epoch = 0;
+		bCancelled = false;
+		bHasVisibility = false;
+		Visibility = FVoxelChunkVisibility();
+
+		NumMaterials = InNumMaterials;
+		bSingleSection = bInSingleSection;
+
+		Sections.SetNum(bSingleSection ? 1 : NumMaterials);
+		for (FVoxelChunkMeshSection& Section : Sections)
+			Section.Reset();
+
+		CollisionVertices.Reset();
+		CollisionIndices.Reset();
+	}
+};
+
+// A box of voxels copied out of the volume, with X varying fastest, that a smooth mesh was extracted from.
+// The mesh takes its normals from the gradient of the densities, instead of from the normals PolyVox packs into its vertices.
+struct FVoxelDensityField
+{
+	FVoxelDensityField(const PolyVox::MaterialDensityPair88* InVoxels, const FIntVector& InOrigin, const FIntVector& InSize)
+		: Voxels(InVoxels)
+		, Origin(InOrigin)
+		, Size(InSize)
+	{}
+
+	// Returns the density of a voxel. Voxels outside of the box take the density of the closest one inside it.
+	FORCEINLINE float GetDensity(int32 X, int32 Y, int32 Z) const
+	{
+		X = FMath::Clamp(X - Origin.X, 0, Size.X - 1);
+		Y = FMath::Clamp(Y - Origin.Y, 0, Size.Y - 1);
+		Z = FMath::Clamp(Z - Origin.Z, 0, Size.Z - 1);
+		return Voxels[X + Y * Size.X + Z * Size.X * Size.Y].getDensity();
+	}
+
+	// Returns the gradient of the densities at a voxel, from the central differences of its neighbours
+	FVector GetGradient(int32 X, int32 Y, int32 Z) const;
+
+	// Returns the surface normal at a position, blending the gradients of the eight voxels around it.
+	// The densities rise going into the ground, so the normal points down the gradient. Returns zero if the gradient is flat.
+	// This only depends on the voxels around the position, so two chunks sharing a vertex always give it the same normal.
+	FVector GetNormal(const FVector& Position) const;
+
+	const PolyVox::MaterialDensityPair88* Voxels;
+
+	// Where the first voxel is, in the same space as the positions of the mesh's vertices
+	FIntVector Origin;
+
+	// The number of voxels along each side of the box
+	FIntVector Size;
+};
+
+// Converts PolyVox meshes into per-material mesh sections.
+// Triangles are sorted into their material's section in a single pass, and vertices that PolyVox shares
+// between triangles of the same material stay shared. Single section meshes keep them apart too, since each one carries its material. A builder keeps its scratch memory between chunks, so reuse them.
+class FVoxelChunkMeshBuilder
+{
+public:
+	// Builds the sections from a blocky mesh.
+	// PolyVox doesn't generate normals for these, so the normal, tangent and UV of every vertex come from the direction the face points in.
+	// Every vertex position is multiplied by VoxelSize before OffsetLocation is added, which is how coarser levels of detail are scaled up.
+	void BuildCubicMesh(const PolyVox::Mesh<PolyVox::CubicVertex<PolyVox::MaterialDensityPair88>>& ExtractedMesh, const FVector& OffsetLocation, FVoxelChunkMeshData& OutMeshData, float VoxelSize = 1.f);
+
+	// Builds the sections from a smooth mesh. The normals come from the gradient of DensityField when it is given, which should be the voxels
+	// the mesh was extracted from, and from the normals PolyVox generated otherwise.
+	void BuildMarchingCubesMesh(const PolyVox::Mesh<PolyVox::MarchingCubesVertex<PolyVox::MaterialDensityPair88>>& ExtractedMesh, const FVector& OffsetLocation, FVoxelChunkMeshData& OutMeshData, float VoxelSize = 1.f, const FVoxelDensityField* DensityField = nullptr);
+
+	// Builds the collision mesh from a blocky mesh. Collision doesn't need normals, so PolyVox's vertices are used as they are.
+	void BuildCollisionMesh(const PolyVox::Mesh<PolyVox::CubicVertex<PolyVox::MaterialDensityPair88>>& ExtractedMesh, const FVector& OffsetLocation, FVoxelChunkMeshData& OutMeshData);
+
+	// Builds the collision mesh from a smooth mesh, so the collision follows the surface that is drawn. Every material collides, drawn or not.
+	void BuildCollisionMesh(const PolyVox::Mesh<PolyVox::MarchingCubesVertex<PolyVox::MaterialDensityPair88>>& ExtractedMesh, const FVector& OffsetLocation, FVoxelChunkMeshData& OutMeshData);
+
+private:
+	// Maps a PolyVox vertex (and face direction for blocky meshes) to its index in the section it was added to
+	TArray<int32> VertexRemap;
+};
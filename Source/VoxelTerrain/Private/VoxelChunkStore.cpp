@@ -0,0 +1,98 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#include "VoxelChunkStore.h"
+#include "VoxelTerrain.h"
+
+using namespace PolyVox;
+
+// "VXRG" in a little endian file
+static const uint32 RegionFileMagic = 0x47525856;
+
+// Bump this whenever the layout of a region file changes. Files with a different version are ignored.
+static const uint32 RegionFileVersion = 1;
+
+// The longest run a single entry of the run-length encoding can hold
+static const int32 MaxRunLength = MAX_uint16;
+
+// The size of a single run: a 16 bit length followed by the material and density
+static const int32 RunSize = 4;
+
+FVoxelChunkStore::FVoxelChunkStore(const FString& InDirectory, int32 InChunkSideLength, uint32 InSettingsHash)
+	: ChunkSideLength(InChunkSideLength)
+	, Store(InDirectory, TEXT("vxr"), RegionFileMagic, RegionFileVersion, InSettingsHash, InChunkSideLength)
+{
+}
+
+bool FVoxelChunkStore::HasChunk(const FIntVector& ChunkKey)
+{
+	return Store.HasChunk(ChunkKey);
+}
+
+bool FVoxelChunkStore::ReadChunk(const FIntVector& ChunkKey, MaterialDensityPair88* OutVoxels)
+{
+	const int32 NumVoxels = ChunkSideLength * ChunkSideLength * ChunkSideLength;
+
+	return Store.ReadChunk(ChunkKey, [OutVoxels, NumVoxels](const uint8* Data, int32 DataSize)
+	{
+		return DecompressChunk(Data, DataSize, OutVoxels, NumVoxels);
+	});
+}
+
+void FVoxelChunkStore::WriteChunk(const FIntVector& ChunkKey, const MaterialDensityPair88* Voxels)
+{
+	// Compress before the store is locked, so other threads can keep reading in the meantime
+	TArray<uint8> Data;
+	CompressChunk(Voxels, ChunkSideLength * ChunkSideLength * ChunkSideLength, Data);
+
+	Store.WriteChunk(ChunkKey, MoveTemp(Data));
+}
+
+void FVoxelChunkStore::Flush()
+{
+	Store.Flush();
+}
+
+void FVoxelChunkStore::CompressChunk(const MaterialDensityPair88* Voxels, int32 NumVoxels, TArray<uint8>& OutData)
+{
+	OutData.Reset();
+
+	int32 RunStart = 0;
+	while (RunStart < NumVoxels)
+	{
+		const MaterialDensityPair88 Voxel = Voxels[RunStart];
+
+		// Extend the run for as long as the voxels are the same
+		int32 RunEnd = RunStart + 1;
+		while (RunEnd < NumVoxels && RunEnd - RunStart < MaxRunLength && Voxels[RunEnd] == Voxel)
+			RunEnd++;
+
+		const uint16 RunLength = uint16(RunEnd - RunStart);
+		OutData.Add(uint8(RunLength & 0xFF));
+		OutData.Add(uint8(RunLength >> 8));
+		OutData.Add(Voxel.getMaterial());
+		OutData.Add(Voxel.getDensity());
+
+		RunStart = RunEnd;
+	}
+}
+
+bool FVoxelChunkStore::DecompressChunk(const uint8* Data, int32 DataSize, MaterialDensityPair88* OutVoxels, int32 NumVoxels)
+{
+	if (DataSize % RunSize != 0)
+		return false;
+
+	int32 VoxelIndex = 0;
+	for (int32 RunOffset = 0; RunOffset < DataSize; RunOffset += RunSize)
+	{
+		const int32 RunLength = Data[RunOffset] | (Data[RunOffset + 1] << 8);
+		const MaterialDensityPair88 Voxel(Data[RunOffset + 2], Data[RunOffset + 3]);
+
+		if (RunLength == 0 || VoxelIndex + RunLength > NumVoxels)
+			return false;
+
+		for (int32 i = 0; i < RunLength; i++)
+			OutVoxels[VoxelIndex++] = Voxel;
+	}
+
+	return VoxelIndex == NumVoxels;
+}
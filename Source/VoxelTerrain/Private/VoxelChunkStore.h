@@ -0,0 +1,52 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VoxelRegionStore.h"
+
+// PolyVox
+#include "PolyVox/MaterialDensityPair.h"
+
+// Saves volume chunks to disk so they don't have to be regenerated, and so edits survive the chunk being paged out.
+// The chunks are run-length encoded and kept in region files, see FVoxelRegionStore.
+//
+// Every function is safe to call from any thread.
+class FVoxelChunkStore
+{
+public:
+	// Opens the chunk store in the given directory. Region files that were written with a different SettingsHash are ignored,
+	// since their chunks came from different noise settings.
+	FVoxelChunkStore(const FString& InDirectory, int32 InChunkSideLength, uint32 InSettingsHash);
+
+	// Returns true if the given chunk has been saved
+	bool HasChunk(const FIntVector& ChunkKey);
+
+	// Reads a chunk. The voxels are written with X varying fastest, then Y, then Z. Returns false if the chunk hasn't been saved.
+	bool ReadChunk(const FIntVector& ChunkKey, PolyVox::MaterialDensityPair88* OutVoxels);
+
+	// Saves a chunk. It is only written to disk when Flush is called, or when enough chunks are waiting.
+	void WriteChunk(const FIntVector& ChunkKey, const PolyVox::MaterialDensityPair88* Voxels);
+
+	// Adds the key of every chunk that has been saved to OutChunkKeys. This opens every region file, so it is only for things that happen rarely.
+	void GetChunkKeys(TArray<FIntVector>& OutChunkKeys) { Store.GetChunkKeys(OutChunkKeys); }
+
+	// Writes every pending chunk to disk
+	void Flush();
+
+	// Returns the directory the region files are in
+	const FString& GetDirectory() const { return Store.GetDirectory(); }
+
+	// Run-length encodes a chunk
+	static void CompressChunk(const PolyVox::MaterialDensityPair88* Voxels, int32 NumVoxels, TArray<uint8>& OutData);
+
+	// Decodes a chunk. Returns false if the data is corrupt or doesn't hold exactly NumVoxels voxels.
+	static bool DecompressChunk(const uint8* Data, int32 DataSize, PolyVox::MaterialDensityPair88* OutVoxels, int32 NumVoxels);
+
+private:
+	// The side length of the chunks in voxels
+	int32 ChunkSideLength;
+
+	// The region files the compressed chunks are kept in
+	FVoxelRegionStore Store;
+};
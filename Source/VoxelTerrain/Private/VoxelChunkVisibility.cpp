@@ -0,0 +1,151 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#include "VoxelChunkVisibility.h"
+
+void FVoxelChunkVisibility::ConnectFaces(uint32 FaceMask)
+{
+	for (int32 FaceA = 0; FaceA < NumFaces; FaceA++)
+	{
+		if (!(FaceMask & (1 << FaceA)))
+			continue;
+
+		for (int32 FaceB = FaceA + 1; FaceB < NumFaces; FaceB++)
+		{
+			if (FaceMask & (1 << FaceB))
+				Bits |= GetPairBit(FaceA, FaceB);
+		}
+	}
+}
+
+FIntVector FVoxelChunkVisibility::GetFaceDirection(int32 Face)
+{
+	FIntVector Direction = FIntVector::ZeroValue;
+	Direction[Face / 2] = (Face & 1) ? 1 : -1;
+	return Direction;
+}
+
+FVoxelChunkVisibility FVoxelChunkVisibility::Compute(const PolyVox::MaterialDensityPair88* Voxels, int32 Size, TArray<uint8>& Visited, TArray<int32>& Stack)
+{
+	const int32 SizeSquared = Size * Size;
+	const int32 NumVoxels = SizeSquared * Size;
+
+	Visited.SetNumUninitialized(NumVoxels);
+	FMemory::Memzero(Visited.GetData(), NumVoxels);
+
+	// The step to the neighbour through each face, in the index
+	const int32 Strides[NumFaces] = { -1, 1, -Size, Size, -SizeSquared, SizeSquared };
+
+	FVoxelChunkVisibility Visibility(0);
+
+	for (int32 Z = 0; Z < Size; Z++)
+	{
+		for (int32 Y = 0; Y < Size; Y++)
+		{
+			// Only the boundary can start a pocket that connects anything, so the inside of each row is skipped
+			const bool bBoundaryRow = Z == 0 || Z == Size - 1 || Y == 0 || Y == Size - 1;
+			const int32 StepX = bBoundaryRow ? 1 : Size - 1;
+
+			for (int32 X = 0; X < Size; X += StepX)
+			{
+				const int32 SeedIndex = X + Y * Size + Z * SizeSquared;
+				if (Visited[SeedIndex] || Voxels[SeedIndex].getMaterial() != 0)
+					continue;
+
+				// Flood the pocket, noting every face it touches
+				uint32 FaceMask = 0;
+				Visited[SeedIndex] = 1;
+				Stack.Reset();
+				Stack.Add(SeedIndex);
+
+				while (Stack.Num() > 0)
+				{
+					const int32 Index = Stack.Pop(false);
+					const int32 Coords[3] = { Index % Size, (Index / Size) % Size, Index / SizeSquared };
+
+					for (int32 Face = 0; Face < NumFaces; Face++)
+					{
+						// Stepping out of the chunk means the pocket reaches that face
+						const int32 Coord = Coords[Face / 2];
+						if (Coord == ((Face & 1) ? Size - 1 : 0))
+						{
+							FaceMask |= 1 << Face;
+							continue;
+						}
+
+						const int32 Neighbour = Index + Strides[Face];
+						if (!Visited[Neighbour] && Voxels[Neighbour].getMaterial() == 0)
+						{
+							Visited[Neighbour] = 1;
+							Stack.Add(Neighbour);
+						}
+					}
+				}
+
+				Visibility.ConnectFaces(FaceMask);
+
+				// Nothing else can be added once every face sees every other
+				if (Visibility.Bits == AllFaces)
+					return Visibility;
+			}
+		}
+	}
+
+	return Visibility;
+}
+
+void FVoxelChunkVisibility::FindVisibleChunks(const TArray<FIntVector>& ViewerChunks, const FIntVector& LowerBound, const FIntVector& UpperBound,
+	TFunctionRef<FVoxelChunkVisibility(const FIntVector& ChunkCoord)> GetVisibility, TSet<FIntVector>& OutVisibleChunks)
+{
+	// A chunk being entered, with the face it was entered through and every direction taken to get there
+	struct FStep
+	{
+		FIntVector ChunkCoord;
+		int32 EntryFace;
+		uint32 Directions;
+	};
+
+	// The faces each chunk has been entered through. A chunk is only stepped through again when it is entered through a new face,
+	// since that can lead somewhere the first way in couldn't.
+	TMap<FIntVector, uint32> EnteredFaces;
+
+	TArray<FStep> Steps;
+	int32 NextStep = 0;
+
+	OutVisibleChunks.Reset();
+
+	for (const FIntVector& ViewerChunk : ViewerChunks)
+	{
+		OutVisibleChunks.Add(ViewerChunk);
+		Steps.Add(FStep{ ViewerChunk, -1, 0 });
+	}
+
+	// Breadth first, so the chunks closest to the viewers are reached first and with the fewest turns
+	while (NextStep < Steps.Num())
+	{
+		const FStep Step = Steps[NextStep++];
+		const FVoxelChunkVisibility Visibility = Step.EntryFace >= 0 ? GetVisibility(Step.ChunkCoord) : FVoxelChunkVisibility();
+
+		for (int32 Face = 0; Face < NumFaces; Face++)
+		{
+			// Never turn back against a direction already taken
+			if (Step.Directions & (1 << GetOppositeFace(Face)))
+				continue;
+
+			if (Step.EntryFace >= 0 && !Visibility.CanSeeThrough(Step.EntryFace, Face))
+				continue;
+
+			const FIntVector Next = Step.ChunkCoord + GetFaceDirection(Face);
+			if (Next.X < LowerBound.X || Next.Y < LowerBound.Y || Next.Z < LowerBound.Z || Next.X > UpperBound.X || Next.Y > UpperBound.Y || Next.Z > UpperBound.Z)
+				continue;
+
+			const int32 EntryFace = GetOppositeFace(Face);
+			uint32& Entered = EnteredFaces.FindOrAdd(Next);
+			if (Entered & (1 << EntryFace))
+				continue;
+
+			Entered |= 1 << EntryFace;
+			OutVisibleChunks.Add(Next);
+			Steps.Add(FStep{ Next, EntryFace, Step.Directions | (1 << Face) });
+		}
+	}
+}
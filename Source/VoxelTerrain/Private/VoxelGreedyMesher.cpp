@@ -0,0 +1,176 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#include "VoxelGreedyMesher.h"
+#include "VoxelTerrain.h"
+
+using namespace PolyVox;
+
+PolyVox::Region FVoxelGreedyMesher::BeginGather(const PolyVox::Region& Region, bool bInIncludeUpperFaces)
+{
+	GatheredRegion = Region;
+	bIncludeUpperFaces = bInIncludeUpperFaces;
+
+	// One extra voxel on the negative side of every axis, and on the positive side if the upper faces are wanted
+	const int32 UpperPadding = bIncludeUpperFaces ? 1 : 0;
+	SizeX = Region.getWidthInVoxels() + 1 + UpperPadding;
+	SizeY = Region.getHeightInVoxels() + 1 + UpperPadding;
+	SizeZ = Region.getDepthInVoxels() + 1 + UpperPadding;
+
+	Materials.Reset();
+	Materials.SetNumUninitialized(SizeX * SizeY * SizeZ);
+
+	return PolyVox::Region(Region.getLowerCorner() - Vector3DInt32(1, 1, 1), Region.getUpperCorner() + Vector3DInt32(UpperPadding, UpperPadding, UpperPadding));
+}
+
+void FVoxelGreedyMesher::GatherVoxels(FVoxelPaletteVolume* Volume, const PolyVox::Region& Region, bool bInIncludeUpperFaces)
+{
+	const PolyVox::Region PaddedRegion = BeginGather(Region, bInIncludeUpperFaces);
+
+	Voxels.Reset();
+	Voxels.SetNumUninitialized(Materials.Num());
+	Volume->ReadRegion(PaddedRegion, Voxels.GetData());
+
+	for (int32 VoxelIndex = 0; VoxelIndex < Voxels.Num(); VoxelIndex++)
+		Materials[VoxelIndex] = Voxels[VoxelIndex].getMaterial();
+}
+
+PolyVox::Mesh<CubicVertex<MaterialDensityPair88>> FVoxelGreedyMesher::ExtractMesh(bool bMergeMaterials)
+{
+	Mesh<CubicVertex<MaterialDensityPair88>> Result;
+	Result.setOffset(GatheredRegion.getLowerCorner());
+
+	const int32 UpperPadding = bIncludeUpperFaces ? 1 : 0;
+	const int32 RegionSize[3] = { SizeX - 1 - UpperPadding, SizeY - 1 - UpperPadding, SizeZ - 1 - UpperPadding };
+
+	// Sweep a plane along each axis in turn
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		// U and V are the two axes that lie in the plane
+		const int32 AxisU = (Axis + 1) % 3;
+		const int32 AxisV = (Axis + 2) % 3;
+		const int32 SizeU = RegionSize[AxisU];
+		const int32 SizeV = RegionSize[AxisV];
+
+		Mask.Reset();
+		Mask.SetNumUninitialized(SizeU * SizeV);
+
+		// The extra slice is the upper boundary of the region, between its last voxel and the one after it
+		for (int32 Slice = 0; Slice < RegionSize[Axis] + UpperPadding; Slice++)
+		{
+			// Fill the mask with the faces between this slice and the one behind it
+			int32 Position[3];
+			Position[Axis] = Slice;
+
+			for (int32 V = 0; V < SizeV; V++)
+			{
+				Position[AxisV] = V;
+
+				for (int32 U = 0; U < SizeU; U++)
+				{
+					Position[AxisU] = U;
+
+					const uint8 Front = GetMaterial(Position[0], Position[1], Position[2]);
+					const uint8 Back = GetMaterial(Position[0] - (Axis == 0), Position[1] - (Axis == 1), Position[2] - (Axis == 2));
+
+					// A face is only needed where a solid voxel meets air
+					int32 Face = 0;
+					if (Back != 0 && Front == 0)
+						Face = Back;
+					else if (Front != 0 && Back == 0)
+						Face = -int32(Front);
+
+					if (bMergeMaterials)
+						Face = FMath::Sign(Face);
+
+					Mask[U + V * SizeU] = Face;
+				}
+			}
+
+			// Merge the mask into rectangles
+			for (int32 V = 0; V < SizeV; V++)
+			{
+				for (int32 U = 0; U < SizeU; )
+				{
+					const int32 Face = Mask[U + V * SizeU];
+
+					if (Face == 0)
+					{
+						U++;
+						continue;
+					}
+
+					// Grow the rectangle along U as far as it will go...
+					int32 Width = 1;
+					while (U + Width < SizeU && Mask[U + Width + V * SizeU] == Face)
+						Width++;
+
+					// ...and then along V, as long as every face on the next row matches
+					int32 Height = 1;
+					for (; V + Height < SizeV; Height++)
+					{
+						bool bRowMatches = true;
+						for (int32 k = 0; k < Width; k++)
+						{
+							if (Mask[U + k + (V + Height) * SizeU] != Face)
+							{
+								bRowMatches = false;
+								break;
+							}
+						}
+
+						if (!bRowMatches)
+							break;
+					}
+
+					// Clear the faces we just used so they aren't added again
+					for (int32 l = 0; l < Height; l++)
+					{
+						for (int32 k = 0; k < Width; k++)
+						{
+							Mask[U + k + (V + l) * SizeU] = 0;
+						}
+					}
+
+					// Cubic vertices are stored half a voxel up from where they are, so the face between a voxel and
+					// the one behind it sits at the voxel's own position, and the corners sit at U and U + Width.
+					CubicVertex<MaterialDensityPair88> Corners[4];
+					const int32 CornerU[4] = { U, U + Width, U + Width, U };
+					const int32 CornerV[4] = { V, V, V + Height, V + Height };
+
+					MaterialDensityPair88 Voxel;
+					Voxel.setMaterial(FMath::Abs(Face));
+					Voxel.setDensity(Voxel.getMaxDensity());
+
+					uint32 CornerIndices[4];
+					for (int32 c = 0; c < 4; c++)
+					{
+						uint8 Encoded[3];
+						Encoded[Axis] = uint8(Slice);
+						Encoded[AxisU] = uint8(CornerU[c]);
+						Encoded[AxisV] = uint8(CornerV[c]);
+
+						Corners[c].encodedPosition = Vector3DUint8(Encoded[0], Encoded[1], Encoded[2]);
+						Corners[c].data = Voxel;
+						CornerIndices[c] = Result.addVertex(Corners[c]);
+					}
+
+					// U cross V points along the axis, so the corners are counter-clockwise for faces that point along it
+					if (Face > 0)
+					{
+						Result.addTriangle(CornerIndices[0], CornerIndices[1], CornerIndices[2]);
+						Result.addTriangle(CornerIndices[0], CornerIndices[2], CornerIndices[3]);
+					}
+					else
+					{
+						Result.addTriangle(CornerIndices[0], CornerIndices[2], CornerIndices[1]);
+						Result.addTriangle(CornerIndices[0], CornerIndices[3], CornerIndices[2]);
+					}
+
+					U += Width;
+				}
+			}
+		}
+	}
+
+	return Result;
+}
@@ -0,0 +1,82 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VoxelPaletteVolume.h"
+
+// PolyVox
+#include "PolyVox/CubicSurfaceExtractor.h"
+#include "PolyVox/MaterialDensityPair.h"
+#include "PolyVox/Mesh.h"
+
+// A blocky surface extractor that merges neighbouring faces with the same material and direction into as few rectangles as possible.
+// The output is the same kind of mesh extractCubicMesh produces, so it goes through the same mesh building path.
+//
+// Faces are generated between every voxel in the region and its neighbour on the negative side of each axis.
+// So the region needs one extra voxel on the negative side to be readable, and two regions that sit next to each other
+// don't generate the same faces twice.
+//
+// A region can also be closed off on the positive side, so it gets the faces on its upper boundary as well. This is used for
+// level of detail nodes, which have to own every face of the voxels inside them because their neighbours might be at another level.
+class FVoxelGreedyMesher
+{
+public:
+	// Copies the voxels needed to extract the given region. This is the only part that reads the volume.
+	// When bInIncludeUpperFaces is set, one extra voxel is read on the positive side too and the faces between it and the region are generated.
+	template<typename VolumeType>
+	void GatherVoxels(VolumeType* Volume, const PolyVox::Region& Region, bool bInIncludeUpperFaces = false)
+	{
+		const PolyVox::Region PaddedRegion = BeginGather(Region, bInIncludeUpperFaces);
+
+		int32 VoxelIndex = 0;
+		for (int32 z = PaddedRegion.getLowerZ(); z <= PaddedRegion.getUpperZ(); z++)
+		{
+			for (int32 y = PaddedRegion.getLowerY(); y <= PaddedRegion.getUpperY(); y++)
+			{
+				for (int32 x = PaddedRegion.getLowerX(); x <= PaddedRegion.getUpperX(); x++)
+				{
+					Materials[VoxelIndex++] = Volume->getVoxel(x, y, z).getMaterial();
+				}
+			}
+		}
+	}
+
+	// The same, but reads the palette volume a chunk at a time instead of voxel by voxel
+	void GatherVoxels(FVoxelPaletteVolume* Volume, const PolyVox::Region& Region, bool bInIncludeUpperFaces = false);
+
+	// Builds the merged mesh from the voxels copied by GatherVoxels.
+	// When bMergeMaterials is set every solid voxel is treated as the same material, so faces merge across material boundaries as well.
+	// The mesh is no good for rendering then, but it has the same shape with fewer triangles, which is what collision wants.
+	PolyVox::Mesh<PolyVox::CubicVertex<PolyVox::MaterialDensityPair88>> ExtractMesh(bool bMergeMaterials = false);
+
+private:
+	// Sets up the gathered size for a region and returns the region of voxels that has to be read, including the extra voxels outside of it
+	PolyVox::Region BeginGather(const PolyVox::Region& Region, bool bInIncludeUpperFaces);
+
+	// Returns the material of a gathered voxel. The coordinates are relative to the lower corner of the region, so -1 is valid.
+	FORCEINLINE uint8 GetMaterial(int32 X, int32 Y, int32 Z) const
+	{
+		return Materials[(X + 1) + (Y + 1) * SizeX + (Z + 1) * SizeX * SizeY];
+	}
+
+	// The region the voxels were gathered from
+	PolyVox::Region GatheredRegion;
+
+	// True if the faces on the upper boundary of the region are generated as well
+	bool bIncludeUpperFaces = false;
+
+	// The size of the gathered voxels, including the extra voxels outside of the region
+	int32 SizeX = 0;
+	int32 SizeY = 0;
+	int32 SizeZ = 0;
+
+	// The material of every gathered voxel. A material of zero is air.
+	TArray<uint8> Materials;
+
+	// The voxels read from a palette volume, before they are cut down to their materials
+	TArray<PolyVox::MaterialDensityPair88> Voxels;
+
+	// The faces in the slice that is currently being merged. Positive values face along the axis, negative values face against it.
+	TArray<int32> Mask;
+};
@@ -0,0 +1,225 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#include "VoxelMeshCache.h"
+#include "VoxelTerrain.h"
+#include "VoxelChunkMeshBuilder.h"
+
+// "VXMC" in a little endian file
+static const uint32 MeshCacheFileMagic = 0x434D5856;
+
+// Bump this whenever the layout of a cached mesh changes, or the mesh builders start producing different meshes. Files with a different version are ignored.
+static const uint32 MeshCacheFileVersion = 3;
+
+// Set in the stored visibility of a chunk whose visibility was worked out when it was baked
+static const uint32 CachedVisibilityBit = 1 << 16;
+
+// The arrays are stored exactly as they are in memory
+static_assert(sizeof(FVector) == 3 * sizeof(float), "Cached vertices are stored as three floats");
+static_assert(sizeof(FVector2D) == 2 * sizeof(float), "Cached UVs are stored as two floats");
+static_assert(sizeof(FColor) == sizeof(uint32), "Cached vertex colors are stored as four bytes");
+
+// Appends the raw contents of an array
+template<typename ElementType>
+static void WriteArray(TArray<uint8>& OutData, const ElementType* Elements, int32 NumElements)
+{
+	OutData.Append(reinterpret_cast<const uint8*>(Elements), NumElements * sizeof(ElementType));
+}
+
+// Copies NumElements elements out of the data into an array, and moves past them
+template<typename ElementType>
+static void ReadArray(const uint8*& Data, TArray<ElementType>& OutElements, int32 NumElements)
+{
+	OutElements.SetNumUninitialized(NumElements);
+	FMemory::Memcpy(OutElements.GetData(), Data, NumElements * sizeof(ElementType));
+	Data += NumElements * sizeof(ElementType);
+}
+
+// The number of bytes the flip flags of a section take up. They are padded so the indices after them stay aligned.
+static FORCEINLINE int64 GetFlipBytes(int64 NumVertices)
+{
+	return (NumVertices + 3) & ~int64(3);
+}
+
+// The number of bytes a section with the given number of vertices and indices takes up.
+// Only single section meshes have vertex colors, and whether a mesh is one is part of the settings hash.
+static FORCEINLINE int64 GetSectionBytes(int64 NumVertices, int64 NumIndices, bool bHasColors)
+{
+	// Positions, normals, UVs, colors and tangents, then the tangent flips and the indices
+	const int64 VertexBytes = sizeof(FVector) * 3 + sizeof(FVector2D) + (bHasColors ? sizeof(FColor) : 0);
+	return NumVertices * VertexBytes + GetFlipBytes(NumVertices) + NumIndices * sizeof(int32);
+}
+
+FVoxelMeshCache::FVoxelMeshCache(const FString& InDirectory, int32 InChunkSideLength, uint32 InSettingsHash)
+	: Store(InDirectory, TEXT("vxm"), MeshCacheFileMagic, MeshCacheFileVersion, InSettingsHash, InChunkSideLength)
+{
+}
+
+bool FVoxelMeshCache::HasChunk(const FIntVector& ChunkCoord)
+{
+	return Store.HasChunk(ChunkCoord);
+}
+
+bool FVoxelMeshCache::ReadChunk(const FIntVector& ChunkCoord, bool bReadSections, bool bReadCollision, FVoxelChunkMeshData& OutMeshData)
+{
+	return Store.ReadChunk(ChunkCoord, [bReadSections, bReadCollision, &OutMeshData](const uint8* Data, int32 DataSize)
+	{
+		return DeserializeMesh(Data, DataSize, bReadSections, bReadCollision, OutMeshData);
+	});
+}
+
+void FVoxelMeshCache::WriteChunk(const FIntVector& ChunkCoord, const FVoxelChunkMeshData& MeshData)
+{
+	// Lay the mesh out before the store is locked, so the other workers can keep reading in the meantime
+	TArray<uint8> Data;
+	SerializeMesh(MeshData, Data);
+
+	Store.WriteChunk(ChunkCoord, MoveTemp(Data));
+}
+
+void FVoxelMeshCache::InvalidateChunk(const FIntVector& ChunkCoord)
+{
+	Store.RemoveChunk(ChunkCoord);
+}
+
+void FVoxelMeshCache::Flush()
+{
+	Store.Flush();
+}
+
+void FVoxelMeshCache::SerializeMesh(const FVoxelChunkMeshData& MeshData, TArray<uint8>& OutData)
+{
+	// The counts come first, so the size of everything else can be checked before any of it is read
+	TArray<uint32> Counts;
+	Counts.Add(MeshData.Sections.Num());
+
+	int64 NumBytes = 0;
+	for (const FVoxelChunkMeshSection& Section : MeshData.Sections)
+	{
+		Counts.Add(Section.Vertices.Num());
+		Counts.Add(Section.Indices.Num());
+		NumBytes += GetSectionBytes(Section.Vertices.Num(), Section.Indices.Num(), MeshData.bSingleSection);
+	}
+
+	Counts.Add(MeshData.CollisionVertices.Num());
+	Counts.Add(MeshData.CollisionIndices.Num());
+
+	// The faces the chunk's air connects go in with the counts, with the bit above them set if they were worked out at all
+	Counts.Add(MeshData.bHasVisibility ? (MeshData.Visibility.Bits | CachedVisibilityBit) : 0);
+
+	NumBytes += MeshData.CollisionVertices.Num() * sizeof(FVector) + MeshData.CollisionIndices.Num() * sizeof(int32);
+
+	OutData.Reset(Counts.Num() * sizeof(uint32) + NumBytes);
+	WriteArray(OutData, Counts.GetData(), Counts.Num());
+
+	TArray<FVector> TangentX;
+	TArray<uint8> FlipTangentY;
+
+	for (const FVoxelChunkMeshSection& Section : MeshData.Sections)
+	{
+		// The builders always fill in normals, UVs and tangents for every vertex, and colors too for single section meshes
+		check(Section.Normals.Num() == Section.Vertices.Num() && Section.UV0.Num() == Section.Vertices.Num() && Section.Tangents.Num() == Section.Vertices.Num());
+		check(Section.Colors.Num() == (MeshData.bSingleSection ? Section.Vertices.Num() : 0));
+
+		TangentX.Reset(Section.Tangents.Num());
+		FlipTangentY.Reset(GetFlipBytes(Section.Tangents.Num()));
+
+		for (const FProcMeshTangent& Tangent : Section.Tangents)
+		{
+			TangentX.Add(Tangent.TangentX);
+			FlipTangentY.Add(Tangent.bFlipTangentY ? 1 : 0);
+		}
+
+		FlipTangentY.AddZeroed(GetFlipBytes(Section.Tangents.Num()) - FlipTangentY.Num());
+
+		WriteArray(OutData, Section.Vertices.GetData(), Section.Vertices.Num());
+		WriteArray(OutData, Section.Normals.GetData(), Section.Normals.Num());
+		WriteArray(OutData, Section.UV0.GetData(), Section.UV0.Num());
+		WriteArray(OutData, Section.Colors.GetData(), Section.Colors.Num());
+		WriteArray(OutData, TangentX.GetData(), TangentX.Num());
+		WriteArray(OutData, FlipTangentY.GetData(), FlipTangentY.Num());
+		WriteArray(OutData, Section.Indices.GetData(), Section.Indices.Num());
+	}
+
+	WriteArray(OutData, MeshData.CollisionVertices.GetData(), MeshData.CollisionVertices.Num());
+	WriteArray(OutData, MeshData.CollisionIndices.GetData(), MeshData.CollisionIndices.Num());
+}
+
+bool FVoxelMeshCache::DeserializeMesh(const uint8* Data, int32 DataSize, bool bReadSections, bool bReadCollision, FVoxelChunkMeshData& OutMeshData)
+{
+	if (DataSize < int32(sizeof(uint32)))
+		return false;
+
+	uint32 NumSections;
+	FMemory::Memcpy(&NumSections, Data, sizeof(uint32));
+
+	// The number of materials and whether they share a section are part of the settings hash, so this only happens if the file is corrupt
+	if (NumSections != uint32(OutMeshData.Sections.Num()))
+		return false;
+
+	const int64 CountsBytes = (1 + NumSections * 2 + 3) * sizeof(uint32);
+	if (DataSize < CountsBytes)
+		return false;
+
+	TArray<uint32> Counts;
+	Counts.SetNumUninitialized(NumSections * 2 + 3);
+	FMemory::Memcpy(Counts.GetData(), Data + sizeof(uint32), Counts.Num() * sizeof(uint32));
+
+	// Check everything adds up before touching the mesh data
+	int64 NumBytes = CountsBytes;
+	for (uint32 SectionIndex = 0; SectionIndex < NumSections; SectionIndex++)
+		NumBytes += GetSectionBytes(Counts[SectionIndex * 2], Counts[SectionIndex * 2 + 1], OutMeshData.bSingleSection);
+
+	const int32 NumCollisionVertices = Counts[NumSections * 2];
+	const int32 NumCollisionIndices = Counts[NumSections * 2 + 1];
+	NumBytes += int64(NumCollisionVertices) * sizeof(FVector) + int64(NumCollisionIndices) * sizeof(int32);
+
+	if (NumBytes != DataSize)
+		return false;
+
+	// The visibility is tiny, so it is always read
+	const uint32 CachedVisibility = Counts[NumSections * 2 + 2];
+	OutMeshData.bHasVisibility = (CachedVisibility & CachedVisibilityBit) != 0;
+	if (OutMeshData.bHasVisibility)
+		OutMeshData.Visibility = FVoxelChunkVisibility(uint16(CachedVisibility & FVoxelChunkVisibility::AllFaces));
+
+	const uint8* Cursor = Data + CountsBytes;
+
+	for (uint32 SectionIndex = 0; SectionIndex < NumSections; SectionIndex++)
+	{
+		const int32 NumVertices = Counts[SectionIndex * 2];
+		const int32 NumIndices = Counts[SectionIndex * 2 + 1];
+
+		if (!bReadSections)
+		{
+			Cursor += GetSectionBytes(NumVertices, NumIndices, OutMeshData.bSingleSection);
+			continue;
+		}
+
+		FVoxelChunkMeshSection& Section = OutMeshData.Sections[SectionIndex];
+		ReadArray(Cursor, Section.Vertices, NumVertices);
+		ReadArray(Cursor, Section.Normals, NumVertices);
+		ReadArray(Cursor, Section.UV0, NumVertices);
+		ReadArray(Cursor, Section.Colors, OutMeshData.bSingleSection ? NumVertices : 0);
+
+		Section.Tangents.SetNumUninitialized(NumVertices);
+		const uint8* FlipTangentY = Cursor + NumVertices * sizeof(FVector);
+
+		for (int32 VertexIndex = 0; VertexIndex < NumVertices; VertexIndex++)
+		{
+			FVector TangentX;
+			FMemory::Memcpy(&TangentX, Cursor + VertexIndex * sizeof(FVector), sizeof(FVector));
+			Section.Tangents[VertexIndex] = FProcMeshTangent(TangentX, FlipTangentY[VertexIndex] != 0);
+		}
+
+		Cursor += NumVertices * sizeof(FVector) + GetFlipBytes(NumVertices);
+		ReadArray(Cursor, Section.Indices, NumIndices);
+	}
+
+	if (bReadCollision)
+	{
+		ReadArray(Cursor, OutMeshData.CollisionVertices, NumCollisionVertices);
+		ReadArray(Cursor, OutMeshData.CollisionIndices, NumCollisionIndices);
+	}
+
+	return true;
+}
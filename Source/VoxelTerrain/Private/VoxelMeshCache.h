@@ -0,0 +1,54 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VoxelRegionStore.h"
+
+struct FVoxelChunkMeshData;
+
+// Keeps the finished meshes of full resolution chunks on disk, so a world with fixed settings doesn't have to generate them every time it loads.
+// The cache is baked by the VoxelTerrainBake commandlet, and the workers read a chunk from it instead of generating it whenever they can.
+//
+// A chunk is stored as the arrays its mesh data holds, one after the other, so reading it back is a copy of the chunk out of the region file
+// and then a single copy per array. Edited chunks are removed from the cache, and the next bake only builds the chunks that are missing.
+// The meshes are always baked from the noise, so the terrain doesn't read chunks from here that have saved or edited voxels.
+//
+// Every function is safe to call from any thread. Only finding and copying a chunk locks the store, so the workers lay out the meshes they
+// read in parallel.
+class FVoxelMeshCache
+{
+public:
+	// Opens the cache in the given directory. Chunks baked with a different SettingsHash or chunk size are ignored.
+	FVoxelMeshCache(const FString& InDirectory, int32 InChunkSideLength, uint32 InSettingsHash);
+
+	// Returns true if the given chunk has been baked
+	bool HasChunk(const FIntVector& ChunkCoord);
+
+	// Reads a baked chunk into the mesh data, which has to have been reset for the number of sections the chunk was baked with.
+	// The render sections are only read when bReadSections is set, and the collision mesh only when bReadCollision is.
+	// Returns false, and leaves the mesh data alone, if the chunk hasn't been baked.
+	bool ReadChunk(const FIntVector& ChunkCoord, bool bReadSections, bool bReadCollision, FVoxelChunkMeshData& OutMeshData);
+
+	// Bakes a chunk. Its render sections and its collision mesh are both stored, so it should have been built with collision.
+	void WriteChunk(const FIntVector& ChunkCoord, const FVoxelChunkMeshData& MeshData);
+
+	// Removes a chunk whose voxels have changed since it was baked
+	void InvalidateChunk(const FIntVector& ChunkCoord);
+
+	// Writes the baked and removed chunks to disk
+	void Flush();
+
+	// Returns the directory the region files are in
+	const FString& GetDirectory() const { return Store.GetDirectory(); }
+
+	// Lays out the arrays of a chunk's mesh data one after the other
+	static void SerializeMesh(const FVoxelChunkMeshData& MeshData, TArray<uint8>& OutData);
+
+	// Copies the arrays laid out by SerializeMesh back into mesh data. Returns false if the data is corrupt or has the wrong number of sections.
+	static bool DeserializeMesh(const uint8* Data, int32 DataSize, bool bReadSections, bool bReadCollision, FVoxelChunkMeshData& OutMeshData);
+
+private:
+	// The region files the meshes are kept in
+	FVoxelRegionStore Store;
+};
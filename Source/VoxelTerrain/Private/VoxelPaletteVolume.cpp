@@ -0,0 +1,755 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#include "VoxelPaletteVolume.h"
+#include "VoxelTerrain.h"
+#include "VoxelTerrainStats.h"
+
+using namespace PolyVox;
+
+FVoxelPaletteVolume::Chunk::Chunk(const FIntVector& InChunkKey, int32 InSideLength)
+	: BitsPerIndex(0)
+	, IndicesPerWordPower(0)
+	, IndexMask(0)
+	, SideLength(InSideLength)
+	, SideLengthPower(FMath::FloorLog2(InSideLength))
+	, ChunkKey(InChunkKey)
+	, LastAccessed(0)
+	, bDataModified(false)
+	, PinCount(0)
+{
+	Palette.Add(VoxelType());
+}
+
+int32 FVoxelPaletteVolume::Chunk::GetBitsForPaletteSize(int32 PaletteSize)
+{
+	if (PaletteSize <= 1)
+		return 0;
+
+	if (PaletteSize <= 2)
+		return 1;
+
+	if (PaletteSize <= 4)
+		return 2;
+
+	if (PaletteSize <= 16)
+		return 4;
+
+	if (PaletteSize <= 256)
+		return 8;
+
+	// MaterialDensityPair88 is 16 bits, so there can't be more than this
+	return 16;
+}
+
+void FVoxelPaletteVolume::Chunk::Repack(int32 NewBitsPerIndex)
+{
+	const int32 NumVoxels = 1 << (SideLengthPower * 3);
+
+	TArray<uint32> OldIndices = MoveTemp(Indices);
+	const int32 OldBitsPerIndex = BitsPerIndex;
+	const int32 OldIndicesPerWordPower = IndicesPerWordPower;
+	const uint32 OldIndexMask = IndexMask;
+
+	BitsPerIndex = NewBitsPerIndex;
+	IndicesPerWordPower = NewBitsPerIndex > 0 ? 5 - FMath::FloorLog2(NewBitsPerIndex) : 0;
+	IndexMask = NewBitsPerIndex > 0 ? (1u << NewBitsPerIndex) - 1 : 0;
+
+	if (BitsPerIndex == 0)
+	{
+		Indices.Empty();
+		return;
+	}
+
+	const int32 NumWords = NumVoxels >> IndicesPerWordPower;
+	Indices.Empty(NumWords);
+	Indices.SetNumZeroed(NumWords);
+
+	// A uniform chunk had every voxel at palette index zero, which the zeroed indices already are
+	if (OldBitsPerIndex == 0)
+		return;
+
+	for (int32 VoxelIndex = 0; VoxelIndex < NumVoxels; VoxelIndex++)
+	{
+		const int32 OldShift = (VoxelIndex & ((1 << OldIndicesPerWordPower) - 1)) * OldBitsPerIndex;
+		SetPaletteIndex(VoxelIndex, (OldIndices[VoxelIndex >> OldIndicesPerWordPower] >> OldShift) & OldIndexMask);
+	}
+}
+
+void FVoxelPaletteVolume::Chunk::setVoxel(uint32 X, uint32 Y, uint32 Z, const VoxelType& Voxel)
+{
+	bDataModified = true;
+
+	const int32 VoxelIndex = X + (Y << SideLengthPower) + (Z << (SideLengthPower * 2));
+
+	// Palettes are small, a handful of entries in the terrain, so a linear search is fine
+	int32 PaletteIndex = Palette.IndexOfByKey(Voxel);
+	if (PaletteIndex == INDEX_NONE)
+	{
+		// The indices might have to get wider to address the new entry
+		PaletteIndex = Palette.Add(Voxel);
+
+		const int32 NeededBits = GetBitsForPaletteSize(Palette.Num());
+		if (NeededBits != BitsPerIndex)
+			Repack(NeededBits);
+	}
+
+	if (BitsPerIndex > 0)
+		SetPaletteIndex(VoxelIndex, PaletteIndex);
+}
+
+void FVoxelPaletteVolume::Chunk::Fill(const VoxelType& Voxel)
+{
+	bDataModified = true;
+
+	Palette.Reset();
+	Palette.Add(Voxel);
+	Palette.Shrink();
+	Repack(0);
+}
+
+void FVoxelPaletteVolume::Chunk::SetVoxels(const VoxelType* Voxels)
+{
+	bDataModified = true;
+
+	const int32 NumVoxels = 1 << (SideLengthPower * 3);
+
+	// Voxels come in long runs of the same value, so remember the last one rather than searching the palette every time
+	Palette.Reset();
+	Palette.Add(Voxels[0]);
+
+	VoxelType LastVoxel = Voxels[0];
+	for (int32 VoxelIndex = 1; VoxelIndex < NumVoxels; VoxelIndex++)
+	{
+		if (Voxels[VoxelIndex] != LastVoxel)
+		{
+			LastVoxel = Voxels[VoxelIndex];
+			Palette.AddUnique(LastVoxel);
+		}
+	}
+
+	Palette.Shrink();
+
+	// Start from uniform so Repack doesn't try to carry over the old indices
+	BitsPerIndex = 0;
+	Repack(GetBitsForPaletteSize(Palette.Num()));
+
+	if (BitsPerIndex == 0)
+		return;
+
+	LastVoxel = Palette[0];
+	uint32 LastPaletteIndex = 0;
+
+	for (int32 VoxelIndex = 0; VoxelIndex < NumVoxels; VoxelIndex++)
+	{
+		if (Voxels[VoxelIndex] != LastVoxel)
+		{
+			LastVoxel = Voxels[VoxelIndex];
+			LastPaletteIndex = Palette.IndexOfByKey(LastVoxel);
+		}
+
+		// The indices start out zeroed
+		if (LastPaletteIndex != 0)
+			SetPaletteIndex(VoxelIndex, LastPaletteIndex);
+	}
+}
+
+void FVoxelPaletteVolume::Chunk::GetVoxels(VoxelType* OutVoxels) const
+{
+	ReadVoxels(FIntVector(0), FIntVector(SideLength), OutVoxels, SideLength, SideLength * SideLength);
+}
+
+void FVoxelPaletteVolume::Chunk::ReadVoxels(const FIntVector& LocalLower, const FIntVector& Size, VoxelType* OutVoxels, int32 OutStrideY, int32 OutStrideZ) const
+{
+	if (BitsPerIndex == 0)
+	{
+		const VoxelType Voxel = Palette[0];
+
+		for (int32 z = 0; z < Size.Z; z++)
+		{
+			for (int32 y = 0; y < Size.Y; y++)
+			{
+				VoxelType* OutRow = OutVoxels + y * OutStrideY + z * OutStrideZ;
+
+				for (int32 x = 0; x < Size.X; x++)
+					OutRow[x] = Voxel;
+			}
+		}
+
+		return;
+	}
+
+	for (int32 z = 0; z < Size.Z; z++)
+	{
+		for (int32 y = 0; y < Size.Y; y++)
+		{
+			VoxelType* OutRow = OutVoxels + y * OutStrideY + z * OutStrideZ;
+			const int32 RowStart = LocalLower.X + ((LocalLower.Y + y) << SideLengthPower) + ((LocalLower.Z + z) << (SideLengthPower * 2));
+
+			for (int32 x = 0; x < Size.X; x++)
+				OutRow[x] = Palette[GetPaletteIndex(RowStart + x)];
+		}
+	}
+}
+
+uint32 FVoxelPaletteVolume::Chunk::calculateSizeInBytes() const
+{
+	return sizeof(Chunk) + Palette.GetAllocatedSize() + Indices.GetAllocatedSize();
+}
+
+FVoxelPaletteVolume::Sampler::Sampler(FVoxelPaletteVolume* Volume)
+	: PolyVox::BaseVolume<MaterialDensityPair88>::Sampler<FVoxelPaletteVolume>(Volume)
+	, CurrentChunk(nullptr)
+	, NeighbourChunk(nullptr)
+	, LocalX(0)
+	, LocalY(0)
+	, LocalZ(0)
+	, ChunkSideLength(Volume->ChunkSideLength)
+{
+}
+
+FVoxelPaletteVolume::Sampler::Sampler(const Sampler& Other)
+	: PolyVox::BaseVolume<MaterialDensityPair88>::Sampler<FVoxelPaletteVolume>(Other)
+	, CurrentChunk(Other.CurrentChunk)
+	, NeighbourChunk(nullptr)
+	, LocalX(Other.LocalX)
+	, LocalY(Other.LocalY)
+	, LocalZ(Other.LocalZ)
+	, ChunkSideLength(Other.ChunkSideLength)
+{
+	// The other sampler has it pinned, so it can't be evicted in the meantime
+	if (CurrentChunk)
+		++CurrentChunk->PinCount;
+}
+
+FVoxelPaletteVolume::Sampler::~Sampler()
+{
+	if (CurrentChunk)
+		UnpinChunk(CurrentChunk);
+
+	if (NeighbourChunk)
+		UnpinChunk(NeighbourChunk);
+}
+
+FVoxelPaletteVolume::Sampler& FVoxelPaletteVolume::Sampler::operator=(const Sampler& Other)
+{
+	if (this == &Other)
+		return *this;
+
+	if (Other.CurrentChunk)
+		++Other.CurrentChunk->PinCount;
+
+	if (CurrentChunk)
+		UnpinChunk(CurrentChunk);
+
+	if (NeighbourChunk)
+		UnpinChunk(NeighbourChunk);
+
+	PolyVox::BaseVolume<MaterialDensityPair88>::Sampler<FVoxelPaletteVolume>::operator=(Other);
+	CurrentChunk = Other.CurrentChunk;
+	NeighbourChunk = nullptr;
+	LocalX = Other.LocalX;
+	LocalY = Other.LocalY;
+	LocalZ = Other.LocalZ;
+	ChunkSideLength = Other.ChunkSideLength;
+
+	return *this;
+}
+
+void FVoxelPaletteVolume::Sampler::setPosition(int32 X, int32 Y, int32 Z)
+{
+	this->mXPosInVolume = X;
+	this->mYPosInVolume = Y;
+	this->mZPosInVolume = Z;
+
+	UpdateChunk();
+}
+
+void FVoxelPaletteVolume::Sampler::UpdateChunk()
+{
+	const int32 Power = this->mVolume->ChunkSideLengthPower;
+
+	// Shifting rounds towards negative infinity, so negative positions end up in the right chunk
+	const FIntVector ChunkKey(this->mXPosInVolume >> Power, this->mYPosInVolume >> Power, this->mZPosInVolume >> Power);
+
+	if (!CurrentChunk || CurrentChunk->ChunkKey != ChunkKey)
+	{
+		Chunk* NewChunk = this->mVolume->PinChunk(ChunkKey.X, ChunkKey.Y, ChunkKey.Z);
+
+		if (CurrentChunk)
+			UnpinChunk(CurrentChunk);
+
+		CurrentChunk = NewChunk;
+	}
+
+	LocalX = this->mXPosInVolume & (ChunkSideLength - 1);
+	LocalY = this->mYPosInVolume & (ChunkSideLength - 1);
+	LocalZ = this->mZPosInVolume & (ChunkSideLength - 1);
+}
+
+FVoxelPaletteVolume::VoxelType FVoxelPaletteVolume::Sampler::PeekNeighbour(int32 X, int32 Y, int32 Z) const
+{
+	const int32 Power = this->mVolume->ChunkSideLengthPower;
+	const FIntVector ChunkKey(X >> Power, Y >> Power, Z >> Power);
+
+	if (!NeighbourChunk || NeighbourChunk->ChunkKey != ChunkKey)
+	{
+		Chunk* NewChunk = this->mVolume->PinChunk(ChunkKey.X, ChunkKey.Y, ChunkKey.Z);
+
+		if (NeighbourChunk)
+			UnpinChunk(NeighbourChunk);
+
+		NeighbourChunk = NewChunk;
+	}
+
+	const int32 Mask = ChunkSideLength - 1;
+	return NeighbourChunk->getVoxel(X & Mask, Y & Mask, Z & Mask);
+}
+
+FVoxelPaletteVolume::FVoxelPaletteVolume(Pager* InPager, uint32 TargetMemoryUsageInBytes, uint16 InChunkSideLength)
+	: VolumePager(InPager)
+	, ChunkSideLength(InChunkSideLength)
+	, ChunkSideLengthPower(FMath::FloorLog2(InChunkSideLength))
+	, TargetMemoryBytes(TargetMemoryUsageInBytes)
+	, AccessClock(0)
+{
+	check(VolumePager);
+	checkf(FMath::IsPowerOfTwo(InChunkSideLength), TEXT("The chunk side length has to be a power of two"));
+
+	for (TAtomic<Chunk*>& RecentChunk : RecentChunks)
+		RecentChunk.Store(nullptr);
+}
+
+FVoxelPaletteVolume::~FVoxelPaletteVolume()
+{
+	flushAll();
+}
+
+FVoxelPaletteVolume::VoxelType FVoxelPaletteVolume::getVoxel(int32 X, int32 Y, int32 Z) const
+{
+	Chunk* FoundChunk = PinChunk(X >> ChunkSideLengthPower, Y >> ChunkSideLengthPower, Z >> ChunkSideLengthPower);
+
+	const int32 Mask = ChunkSideLength - 1;
+
+	FoundChunk->ChunkLock.ReadLock();
+	const VoxelType Voxel = FoundChunk->getVoxel(X & Mask, Y & Mask, Z & Mask);
+	FoundChunk->ChunkLock.ReadUnlock();
+
+	UnpinChunk(FoundChunk);
+	return Voxel;
+}
+
+const FVoxelPaletteVolume::Chunk* FVoxelPaletteVolume::LockChunkForReading(const FIntVector& ChunkKey) const
+{
+	Chunk* FoundChunk = PinChunk(ChunkKey.X, ChunkKey.Y, ChunkKey.Z);
+	FoundChunk->ChunkLock.ReadLock();
+	return FoundChunk;
+}
+
+void FVoxelPaletteVolume::UnlockChunkForReading(const Chunk* LockedChunk) const
+{
+	Chunk* UnlockedChunk = const_cast<Chunk*>(LockedChunk);
+	UnlockedChunk->ChunkLock.ReadUnlock();
+	UnpinChunk(UnlockedChunk);
+}
+
+void FVoxelPaletteVolume::setVoxel(int32 X, int32 Y, int32 Z, const VoxelType& Voxel)
+{
+	Chunk* FoundChunk = PinChunk(X >> ChunkSideLengthPower, Y >> ChunkSideLengthPower, Z >> ChunkSideLengthPower);
+
+	const int32 Mask = ChunkSideLength - 1;
+
+	FoundChunk->ChunkLock.WriteLock();
+
+	// The indices might get wider
+	const uint32 OldSize = FoundChunk->calculateSizeInBytes();
+	FoundChunk->setVoxel(X & Mask, Y & Mask, Z & Mask, Voxel);
+	const uint32 NewSize = FoundChunk->calculateSizeInBytes();
+
+	FoundChunk->ChunkLock.WriteUnlock();
+
+	AddSizeInBytes(int64(NewSize) - OldSize);
+	UnpinChunk(FoundChunk);
+}
+
+void FVoxelPaletteVolume::prefetch(PolyVox::Region Region)
+{
+	for (int32 ChunkZ = Region.getLowerZ() >> ChunkSideLengthPower; ChunkZ <= Region.getUpperZ() >> ChunkSideLengthPower; ChunkZ++)
+	{
+		for (int32 ChunkY = Region.getLowerY() >> ChunkSideLengthPower; ChunkY <= Region.getUpperY() >> ChunkSideLengthPower; ChunkY++)
+		{
+			for (int32 ChunkX = Region.getLowerX() >> ChunkSideLengthPower; ChunkX <= Region.getUpperX() >> ChunkSideLengthPower; ChunkX++)
+			{
+				UnpinChunk(PinChunk(ChunkX, ChunkY, ChunkZ));
+			}
+		}
+	}
+}
+
+void FVoxelPaletteVolume::flushAll()
+{
+	// Nothing else is using the volume, so the chunks can be deleted outright rather than kept for reuse
+	for (TAtomic<Chunk*>& RecentChunk : RecentChunks)
+		RecentChunk.Store(nullptr);
+
+	for (FShard& Shard : Shards)
+	{
+		FScopeLock ShardScopeLock(&Shard.Lock);
+
+		for (TPair<FIntVector, TUniquePtr<Chunk>>& Pair : Shard.Chunks)
+		{
+			checkf(Pair.Value->PinCount.Load() == 0, TEXT("The volume was flushed while a chunk was still in use"));
+			ReleaseChunk(*Pair.Value);
+		}
+
+		NumChunks.Add(-Shard.Chunks.Num());
+		Shard.Chunks.Empty();
+	}
+
+	FScopeLock FreeChunksScopeLock(&FreeChunksLock);
+	FreeChunks.Empty();
+}
+
+uint32 FVoxelPaletteVolume::calculateSizeInBytes()
+{
+	return uint32(FMath::Clamp<int64>(SizeInBytes.GetValue(), 0, MAX_uint32));
+}
+
+void FVoxelPaletteVolume::ReadRegion(const PolyVox::Region& Region, VoxelType* OutVoxels) const
+{
+	const FIntVector Lower(Region.getLowerX(), Region.getLowerY(), Region.getLowerZ());
+	const FIntVector Upper(Region.getUpperX(), Region.getUpperY(), Region.getUpperZ());
+	const int32 StrideY = Region.getWidthInVoxels();
+	const int32 StrideZ = StrideY * Region.getHeightInVoxels();
+
+	TArray<Chunk*> RegionChunks;
+	PinRegionChunks(Region, RegionChunks);
+
+	// Locking them all before reading any of them is what makes this a snapshot
+	for (Chunk* RegionChunk : RegionChunks)
+		RegionChunk->ChunkLock.ReadLock();
+
+	for (Chunk* RegionChunk : RegionChunks)
+	{
+		// The part of the region inside this chunk, in voxels
+		const FIntVector ChunkLower = RegionChunk->ChunkKey * ChunkSideLength;
+		const FIntVector BoxLower(FMath::Max(Lower.X, ChunkLower.X), FMath::Max(Lower.Y, ChunkLower.Y), FMath::Max(Lower.Z, ChunkLower.Z));
+		const FIntVector BoxUpper(FMath::Min(Upper.X, ChunkLower.X + ChunkSideLength - 1), FMath::Min(Upper.Y, ChunkLower.Y + ChunkSideLength - 1), FMath::Min(Upper.Z, ChunkLower.Z + ChunkSideLength - 1));
+
+		const FIntVector Offset = BoxLower - Lower;
+		VoxelType* OutBox = OutVoxels + Offset.X + Offset.Y * StrideY + Offset.Z * StrideZ;
+
+		RegionChunk->ReadVoxels(BoxLower - ChunkLower, BoxUpper - BoxLower + FIntVector(1), OutBox, StrideY, StrideZ);
+	}
+
+	for (Chunk* RegionChunk : RegionChunks)
+	{
+		RegionChunk->ChunkLock.ReadUnlock();
+		UnpinChunk(RegionChunk);
+	}
+}
+
+void FVoxelPaletteVolume::EditRegion(const PolyVox::Region& Region, TFunctionRef<void(int32 X, int32 Y, int32 Z, VoxelType& InOutVoxel)> EditVoxel)
+{
+	const FIntVector Lower(Region.getLowerX(), Region.getLowerY(), Region.getLowerZ());
+	const FIntVector Upper(Region.getUpperX(), Region.getUpperY(), Region.getUpperZ());
+
+	TArray<Chunk*> RegionChunks;
+	PinRegionChunks(Region, RegionChunks);
+
+	for (Chunk* RegionChunk : RegionChunks)
+		RegionChunk->ChunkLock.WriteLock();
+
+	int64 SizeChange = 0;
+
+	for (Chunk* RegionChunk : RegionChunks)
+	{
+		const FIntVector ChunkLower = RegionChunk->ChunkKey * ChunkSideLength;
+		const FIntVector BoxLower(FMath::Max(Lower.X, ChunkLower.X), FMath::Max(Lower.Y, ChunkLower.Y), FMath::Max(Lower.Z, ChunkLower.Z));
+		const FIntVector BoxUpper(FMath::Min(Upper.X, ChunkLower.X + ChunkSideLength - 1), FMath::Min(Upper.Y, ChunkLower.Y + ChunkSideLength - 1), FMath::Min(Upper.Z, ChunkLower.Z + ChunkSideLength - 1));
+
+		const uint32 OldSize = RegionChunk->calculateSizeInBytes();
+
+		for (int32 Z = BoxLower.Z; Z <= BoxUpper.Z; Z++)
+		{
+			for (int32 Y = BoxLower.Y; Y <= BoxUpper.Y; Y++)
+			{
+				for (int32 X = BoxLower.X; X <= BoxUpper.X; X++)
+				{
+					const uint32 LocalX = X - ChunkLower.X;
+					const uint32 LocalY = Y - ChunkLower.Y;
+					const uint32 LocalZ = Z - ChunkLower.Z;
+
+					// Only the voxels that change are written, so a chunk the edit doesn't change isn't marked as modified
+					const VoxelType OldVoxel = RegionChunk->getVoxel(LocalX, LocalY, LocalZ);
+					VoxelType NewVoxel = OldVoxel;
+					EditVoxel(X, Y, Z, NewVoxel);
+
+					if (NewVoxel != OldVoxel)
+						RegionChunk->setVoxel(LocalX, LocalY, LocalZ, NewVoxel);
+				}
+			}
+		}
+
+		SizeChange += int64(RegionChunk->calculateSizeInBytes()) - OldSize;
+	}
+
+	for (Chunk* RegionChunk : RegionChunks)
+	{
+		RegionChunk->ChunkLock.WriteUnlock();
+		UnpinChunk(RegionChunk);
+	}
+
+	AddSizeInBytes(SizeChange);
+}
+
+int32 FVoxelPaletteVolume::GetNumUniformChunks() const
+{
+	int32 NumUniform = 0;
+
+	for (FShard& Shard : Shards)
+	{
+		FScopeLock ShardScopeLock(&Shard.Lock);
+
+		for (const TPair<FIntVector, TUniquePtr<Chunk>>& Pair : Shard.Chunks)
+		{
+			// A chunk that is still being paged in is skipped. The thread paging it in might be waiting on this shard to evict chunks.
+			if (!Pair.Value->bPagedIn)
+				continue;
+
+			Pair.Value->ChunkLock.ReadLock();
+			if (Pair.Value->IsUniform())
+				NumUniform++;
+			Pair.Value->ChunkLock.ReadUnlock();
+		}
+	}
+
+	return NumUniform;
+}
+
+uint32 FVoxelPaletteVolume::GetChunkHash(const FIntVector& ChunkKey)
+{
+	// Each axis is multiplied by a different large odd number, so neighbouring chunks land in different shards along every axis
+	return (uint32(ChunkKey.X) * 73856093u) ^ (uint32(ChunkKey.Y) * 19349663u) ^ (uint32(ChunkKey.Z) * 83492791u);
+}
+
+FVoxelPaletteVolume::Chunk* FVoxelPaletteVolume::PinChunk(int32 ChunkX, int32 ChunkY, int32 ChunkZ) const
+{
+	const FIntVector ChunkKey(ChunkX, ChunkY, ChunkZ);
+	const uint32 ChunkHash = GetChunkHash(ChunkKey);
+
+	if (Chunk* RecentChunk = PinRecentChunk(ChunkKey, ChunkHash))
+		return RecentChunk;
+
+	FShard& Shard = GetShard(ChunkHash);
+
+	Chunk* PinnedChunk;
+	bool bPageIn = false;
+	{
+		FScopeLock ShardScopeLock(&Shard.Lock);
+
+		TUniquePtr<Chunk>& FoundChunk = Shard.Chunks.FindOrAdd(ChunkKey);
+		if (!FoundChunk.IsValid())
+		{
+			// The chunk is locked before anyone else can find it, so they wait for it to be paged in instead of paging it in themselves
+			FoundChunk = AllocateChunk(ChunkKey);
+			FoundChunk->ChunkLock.WriteLock();
+			NumChunks.Increment();
+			bPageIn = true;
+		}
+		else
+		{
+			// A chunk in the map is never being evicted, so this can't be racing an eviction
+			++FoundChunk->PinCount;
+		}
+
+		PinnedChunk = FoundChunk.Get();
+	}
+
+	if (!bPageIn)
+	{
+		// Some other thread is still paging the chunk in, and holds its lock until it's done
+		if (!PinnedChunk->bPagedIn)
+		{
+			PinnedChunk->ChunkLock.ReadLock();
+			PinnedChunk->ChunkLock.ReadUnlock();
+		}
+
+		TouchChunk(PinnedChunk);
+		RecentChunks[ChunkHash & (NumRecentChunks - 1)].Store(PinnedChunk);
+		return PinnedChunk;
+	}
+
+	// Make room before paging in. The new chunk is pinned, so it can't be the one that gets evicted.
+	if (SizeInBytes.GetValue() > TargetMemoryBytes && NumChunks.GetValue() > MinResidentChunks)
+		EvictChunks();
+
+	VolumePager->pageIn(GetChunkRegion(ChunkKey), PinnedChunk);
+
+	// Filling the chunk in doesn't count as modifying it
+	PinnedChunk->bDataModified = false;
+	AddSizeInBytes(PinnedChunk->calculateSizeInBytes());
+
+	PinnedChunk->LastAccessed.Store(++AccessClock);
+	PinnedChunk->bPagedIn = true;
+	PinnedChunk->ChunkLock.WriteUnlock();
+
+	RecentChunks[ChunkHash & (NumRecentChunks - 1)].Store(PinnedChunk);
+	return PinnedChunk;
+}
+
+FVoxelPaletteVolume::Chunk* FVoxelPaletteVolume::PinRecentChunk(const FIntVector& ChunkKey, uint32 ChunkHash) const
+{
+	Chunk* RecentChunk = RecentChunks[ChunkHash & (NumRecentChunks - 1)].Load();
+	if (!RecentChunk)
+		return nullptr;
+
+	// Pinning first means the chunk can't be evicted while it's checked. If it already has been, the count stays far below zero.
+	// A chunk is only given a new key while it is evicted, so once the pin has held the key can be trusted.
+	if (++RecentChunk->PinCount > 0 && RecentChunk->ChunkKey == ChunkKey && RecentChunk->bPagedIn)
+	{
+		TouchChunk(RecentChunk);
+		return RecentChunk;
+	}
+
+	UnpinChunk(RecentChunk);
+	return nullptr;
+}
+
+TUniquePtr<FVoxelPaletteVolume::Chunk> FVoxelPaletteVolume::AllocateChunk(const FIntVector& ChunkKey) const
+{
+	TUniquePtr<Chunk> NewChunk;
+	{
+		FScopeLock FreeChunksScopeLock(&FreeChunksLock);
+
+		if (FreeChunks.Num() > 0)
+			NewChunk = FreeChunks.Pop(false);
+	}
+
+	if (!NewChunk.IsValid())
+	{
+		NewChunk = MakeUnique<Chunk>(ChunkKey, ChunkSideLength);
+		NewChunk->PinCount.Store(1);
+		return NewChunk;
+	}
+
+	// Threads holding a stale pointer to the chunk might still be adding to its pin count and taking it off again, so the count
+	// is moved back up from EvictedPinCount rather than overwritten. The key has to be set first, since a pin that holds can trust it.
+	NewChunk->ChunkKey = ChunkKey;
+	NewChunk->bPagedIn = false;
+	NewChunk->bDataModified = false;
+	NewChunk->PinCount += 1 - Chunk::EvictedPinCount;
+
+	return NewChunk;
+}
+
+void FVoxelPaletteVolume::TouchChunk(Chunk* UsedChunk) const
+{
+	// Most pins land on a chunk that is already up to date, and only reading the clock keeps its cache line shared between the threads
+	const uint64 Now = AccessClock.Load(EMemoryOrder::Relaxed);
+	if (UsedChunk->LastAccessed.Load(EMemoryOrder::Relaxed) != Now)
+		UsedChunk->LastAccessed.Store(Now, EMemoryOrder::Relaxed);
+}
+
+void FVoxelPaletteVolume::PinRegionChunks(const PolyVox::Region& Region, TArray<Chunk*>& OutChunks) const
+{
+	const FIntVector LowerChunk(Region.getLowerX() >> ChunkSideLengthPower, Region.getLowerY() >> ChunkSideLengthPower, Region.getLowerZ() >> ChunkSideLengthPower);
+	const FIntVector UpperChunk(Region.getUpperX() >> ChunkSideLengthPower, Region.getUpperY() >> ChunkSideLengthPower, Region.getUpperZ() >> ChunkSideLengthPower);
+
+	OutChunks.Reset((UpperChunk.X - LowerChunk.X + 1) * (UpperChunk.Y - LowerChunk.Y + 1) * (UpperChunk.Z - LowerChunk.Z + 1));
+
+	for (int32 ChunkZ = LowerChunk.Z; ChunkZ <= UpperChunk.Z; ChunkZ++)
+	{
+		for (int32 ChunkY = LowerChunk.Y; ChunkY <= UpperChunk.Y; ChunkY++)
+		{
+			for (int32 ChunkX = LowerChunk.X; ChunkX <= UpperChunk.X; ChunkX++)
+			{
+				OutChunks.Add(PinChunk(ChunkX, ChunkY, ChunkZ));
+			}
+		}
+	}
+}
+
+void FVoxelPaletteVolume::EvictChunks() const
+{
+	if (!EvictionLock.TryLock())
+		return;
+
+	// Evicting a batch at a time keeps the sort from happening on every page in.
+	// Going a little under the budget leaves room for the next few chunks.
+	const int64 EvictUntilBytes = TargetMemoryBytes - TargetMemoryBytes / 8;
+
+	TArray<TPair<uint64, FIntVector>> ChunksByAge;
+	ChunksByAge.Reserve(NumChunks.GetValue());
+
+	for (FShard& Shard : Shards)
+	{
+		FScopeLock ShardScopeLock(&Shard.Lock);
+
+		for (const TPair<FIntVector, TUniquePtr<Chunk>>& Pair : Shard.Chunks)
+		{
+			if (Pair.Value->PinCount.Load() == 0)
+				ChunksByAge.Emplace(Pair.Value->LastAccessed.Load(EMemoryOrder::Relaxed), Pair.Key);
+		}
+	}
+
+	ChunksByAge.Sort([](const TPair<uint64, FIntVector>& A, const TPair<uint64, FIntVector>& B) { return A.Key < B.Key; });
+
+	for (int32 i = 0; i < ChunksByAge.Num() && NumChunks.GetValue() > MinResidentChunks && SizeInBytes.GetValue() > EvictUntilBytes; i++)
+	{
+		const uint32 ChunkHash = GetChunkHash(ChunksByAge[i].Value);
+		FShard& Shard = GetShard(ChunkHash);
+		FScopeLock ShardScopeLock(&Shard.Lock);
+
+		// Leave the chunk alone if it has been used since the ages were gathered
+		TUniquePtr<Chunk>* FoundChunk = Shard.Chunks.Find(ChunksByAge[i].Value);
+		if (!FoundChunk || (*FoundChunk)->LastAccessed.Load(EMemoryOrder::Relaxed) != ChunksByAge[i].Key)
+			continue;
+
+		// This fails if another thread has pinned the chunk, even one that got it from RecentChunks without the shard
+		int32 UnpinnedCount = 0;
+		if (!(*FoundChunk)->PinCount.CompareExchange(UnpinnedCount, Chunk::EvictedPinCount))
+			continue;
+
+		TUniquePtr<Chunk> EvictedChunk = MoveTemp(*FoundChunk);
+		Shard.Chunks.Remove(ChunksByAge[i].Value);
+		NumChunks.Decrement();
+
+		Chunk* EvictedChunkPtr = EvictedChunk.Get();
+		RecentChunks[ChunkHash & (NumRecentChunks - 1)].CompareExchange(EvictedChunkPtr, nullptr);
+
+		// Paging out with the shard locked means nobody can page the chunk back in before its changes have been saved
+		ReleaseChunk(*EvictedChunk);
+
+		// Threads with a stale pointer might still look at the chunk, so it is emptied and kept for reuse rather than deleted
+		EvictedChunk->Fill(VoxelType());
+
+		FScopeLock FreeChunksScopeLock(&FreeChunksLock);
+		FreeChunks.Add(MoveTemp(EvictedChunk));
+	}
+
+	EvictionLock.Unlock();
+}
+
+void FVoxelPaletteVolume::ReleaseChunk(Chunk& ReleasedChunk) const
+{
+	if (ReleasedChunk.bDataModified)
+		VolumePager->pageOut(GetChunkRegion(ReleasedChunk.ChunkKey), &ReleasedChunk);
+
+	AddSizeInBytes(-int64(ReleasedChunk.calculateSizeInBytes()));
+}
+
+PolyVox::Region FVoxelPaletteVolume::GetChunkRegion(const FIntVector& ChunkKey) const
+{
+	const Vector3DInt32 Lower(ChunkKey.X * ChunkSideLength, ChunkKey.Y * ChunkSideLength, ChunkKey.Z * ChunkSideLength);
+	return PolyVox::Region(Lower, Lower + Vector3DInt32(ChunkSideLength - 1, ChunkSideLength - 1, ChunkSideLength - 1));
+}
+
+void FVoxelPaletteVolume::AddSizeInBytes(int64 Bytes) const
+{
+	SizeInBytes.Add(Bytes);
+
+	if (Bytes >= 0)
+		INC_MEMORY_STAT_BY(STAT_VoxelTerrain_VolumeMemory, Bytes);
+	else
+		DEC_MEMORY_STAT_BY(STAT_VoxelTerrain_VolumeMemory, -Bytes);
+}
@@ -0,0 +1,406 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#include "VoxelRegionStore.h"
+#include "VoxelTerrain.h"
+#include "HAL/PlatformFilemanager.h"
+#include "HAL/FileManager.h"
+#include "Async/MappedFileHandle.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+// The start of every region file. The offset table follows straight after it.
+struct FVoxelRegionFileHeader
+{
+	uint32 Magic;
+	uint32 Version;
+	uint32 SettingsHash;
+	uint32 ChunkSideLength;
+};
+
+// The number of region files kept open at once
+static const int32 MaxOpenRegions = 64;
+
+// Pending chunks are written out once they take up this much memory
+static const int64 MaxPendingBytes = 8 * 1024 * 1024;
+
+FVoxelRegionStore::FRegionFile::FRegionFile()
+{
+	Entries.SetNum(ChunksPerRegion);
+}
+
+// This lives here because the mapped file classes are only forward declared in the header
+FVoxelRegionStore::FRegionFile::~FRegionFile()
+{
+	// The region has to be unmapped before the file is closed
+	MappedRegion.Reset();
+	MappedFile.Reset();
+}
+
+FVoxelRegionStore::FVoxelRegionStore(const FString& InDirectory, const FString& InFileExtension, uint32 InMagic, uint32 InVersion, uint32 InSettingsHash, int32 InChunkSideLength)
+	: Directory(InDirectory)
+	, FileExtension(InFileExtension)
+	, Magic(InMagic)
+	, Version(InVersion)
+	, SettingsHash(InSettingsHash)
+	, ChunkSideLength(InChunkSideLength)
+{
+}
+
+FVoxelRegionStore::~FVoxelRegionStore()
+{
+	Flush();
+}
+
+bool FVoxelRegionStore::HasChunk(const FIntVector& ChunkKey)
+{
+	FIntVector RegionKey;
+	int32 ChunkIndex;
+	GetRegionLocation(ChunkKey, RegionKey, ChunkIndex);
+
+	FScopeLock StoreScopeLock(&StoreLock);
+	FRegionFile& Region = GetRegion(RegionKey);
+
+	if (const TArray<uint8>* PendingChunk = Region.PendingChunks.Find(ChunkIndex))
+		return PendingChunk->Num() > 0;
+
+	return Region.Entries[ChunkIndex].Size > 0;
+}
+
+bool FVoxelRegionStore::ReadChunk(const FIntVector& ChunkKey, TFunctionRef<bool(const uint8* Data, int32 DataSize)> Reader)
+{
+	FIntVector RegionKey;
+	int32 ChunkIndex;
+	GetRegionLocation(ChunkKey, RegionKey, ChunkIndex);
+
+	// Only the copy happens under the lock. Decoding is what takes the time, and doing that here would stop every other thread reading.
+	TArray<uint8> ChunkData;
+	bool bFromFile = false;
+	{
+		FScopeLock StoreScopeLock(&StoreLock);
+		FRegionFile& Region = GetRegion(RegionKey);
+
+		// Chunks that haven't been flushed yet are newer than whatever is in the file
+		if (const TArray<uint8>* PendingChunk = Region.PendingChunks.Find(ChunkIndex))
+		{
+			ChunkData = *PendingChunk;
+		}
+		else
+		{
+			const FChunkEntry& Entry = Region.Entries[ChunkIndex];
+
+			int64 FileSize;
+			const uint8* FileData = GetRegionData(Region, FileSize);
+			if (FileData && Entry.Size > 0)
+			{
+				ChunkData.Append(FileData + Entry.Offset, Entry.Size);
+				bFromFile = true;
+			}
+		}
+	}
+
+	if (ChunkData.Num() == 0)
+		return false;
+
+	if (!Reader(ChunkData.GetData(), ChunkData.Num()))
+	{
+		if (bFromFile)
+			UE_LOG(LogVoxelTerrain, Warning, TEXT("Chunk %s in %s is corrupt, it will be regenerated"), *ChunkKey.ToString(), *GetRegionPath(RegionKey));
+
+		return false;
+	}
+
+	return true;
+}
+
+void FVoxelRegionStore::WriteChunk(const FIntVector& ChunkKey, TArray<uint8>&& Data)
+{
+	check(Data.Num() > 0);
+
+	FScopeLock StoreScopeLock(&StoreLock);
+	AddPendingChunk(ChunkKey, MoveTemp(Data));
+}
+
+void FVoxelRegionStore::RemoveChunk(const FIntVector& ChunkKey)
+{
+	FIntVector RegionKey;
+	int32 ChunkIndex;
+	GetRegionLocation(ChunkKey, RegionKey, ChunkIndex);
+
+	FScopeLock StoreScopeLock(&StoreLock);
+	FRegionFile& Region = GetRegion(RegionKey);
+
+	// There's nothing to write if the chunk was never there
+	const TArray<uint8>* PendingChunk = Region.PendingChunks.Find(ChunkIndex);
+	if (PendingChunk ? PendingChunk->Num() > 0 : Region.Entries[ChunkIndex].Size > 0)
+		AddPendingChunk(ChunkKey, TArray<uint8>());
+}
+
+void FVoxelRegionStore::GetChunkKeys(TArray<FIntVector>& OutChunkKeys)
+{
+	// Region files are named after their keys
+	TArray<FString> FileNames;
+	IFileManager::Get().FindFiles(FileNames, *Directory, *FileExtension);
+
+	TSet<FIntVector> RegionKeys;
+	for (const FString& FileName : FileNames)
+	{
+		TArray<FString> Parts;
+		if (FileName.ParseIntoArray(Parts, TEXT(".")) == 5 && Parts[0] == TEXT("r"))
+			RegionKeys.Add(FIntVector(FCString::Atoi(*Parts[1]), FCString::Atoi(*Parts[2]), FCString::Atoi(*Parts[3])));
+	}
+
+	FScopeLock StoreScopeLock(&StoreLock);
+
+	// Regions that have only been written to memory so far don't have a file yet
+	for (const auto& Region : Regions)
+		RegionKeys.Add(Region.Key);
+
+	for (const FIntVector& RegionKey : RegionKeys)
+	{
+		const FRegionFile& Region = GetRegion(RegionKey);
+
+		for (int32 ChunkIndex = 0; ChunkIndex < ChunksPerRegion; ChunkIndex++)
+		{
+			const TArray<uint8>* PendingChunk = Region.PendingChunks.Find(ChunkIndex);
+			if (PendingChunk ? PendingChunk->Num() == 0 : Region.Entries[ChunkIndex].Size == 0)
+				continue;
+
+			const FIntVector Local(ChunkIndex % RegionSideLength, (ChunkIndex / RegionSideLength) % RegionSideLength, ChunkIndex / (RegionSideLength * RegionSideLength));
+			OutChunkKeys.Add(RegionKey * RegionSideLength + Local);
+		}
+	}
+}
+
+void FVoxelRegionStore::Flush()
+{
+	FScopeLock StoreScopeLock(&StoreLock);
+
+	for (auto& Region : Regions)
+		FlushRegion(Region.Key, *Region.Value);
+
+	CloseUnusedRegions();
+}
+
+void FVoxelRegionStore::AddPendingChunk(const FIntVector& ChunkKey, TArray<uint8>&& Data)
+{
+	FIntVector RegionKey;
+	int32 ChunkIndex;
+	GetRegionLocation(ChunkKey, RegionKey, ChunkIndex);
+
+	FRegionFile& Region = GetRegion(RegionKey);
+
+	if (const TArray<uint8>* OldChunk = Region.PendingChunks.Find(ChunkIndex))
+		PendingBytes -= OldChunk->Num();
+
+	PendingBytes += Data.Num();
+	Region.PendingChunks.Add(ChunkIndex, MoveTemp(Data));
+
+	if (PendingBytes > MaxPendingBytes)
+	{
+		for (auto& PendingRegion : Regions)
+			FlushRegion(PendingRegion.Key, *PendingRegion.Value);
+	}
+}
+
+FVoxelRegionStore::FRegionFile& FVoxelRegionStore::GetRegion(const FIntVector& RegionKey)
+{
+	if (TUniquePtr<FRegionFile>* ExistingRegion = Regions.Find(RegionKey))
+	{
+		(*ExistingRegion)->LastUsed = ++RegionClock;
+		return **ExistingRegion;
+	}
+
+	CloseUnusedRegions();
+
+	FRegionFile& Region = *Regions.Add(RegionKey, MakeUnique<FRegionFile>());
+	Region.LastUsed = ++RegionClock;
+	OpenRegion(RegionKey, Region);
+
+	return Region;
+}
+
+void FVoxelRegionStore::OpenRegion(const FIntVector& RegionKey, FRegionFile& Region)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	const FString Path = GetRegionPath(RegionKey);
+
+	Region.MappedRegion.Reset();
+	Region.MappedFile.Reset();
+	Region.FileData.Empty();
+	Region.Entries.Reset();
+	Region.Entries.SetNum(ChunksPerRegion);
+
+	if (!PlatformFile.FileExists(*Path))
+		return;
+
+	// Map the file if we can, otherwise just load the whole thing
+	Region.MappedFile.Reset(PlatformFile.OpenMapped(*Path));
+	if (Region.MappedFile.IsValid())
+		Region.MappedRegion.Reset(Region.MappedFile->MapRegion(0, Region.MappedFile->GetFileSize()));
+
+	if (!Region.MappedRegion.IsValid())
+	{
+		Region.MappedFile.Reset();
+		FFileHelper::LoadFileToArray(Region.FileData, *Path);
+	}
+
+	int64 FileSize;
+	const uint8* FileData = GetRegionData(Region, FileSize);
+	const int64 TableSize = ChunksPerRegion * sizeof(FChunkEntry);
+
+	// Ignore files that are too small, are from an older version or were generated with different settings
+	bool bValid = FileData && FileSize >= int64(sizeof(FVoxelRegionFileHeader)) + TableSize;
+	if (bValid)
+	{
+		FVoxelRegionFileHeader Header;
+		FMemory::Memcpy(&Header, FileData, sizeof(Header));
+		bValid = Header.Magic == Magic && Header.Version == Version && Header.SettingsHash == SettingsHash && Header.ChunkSideLength == uint32(ChunkSideLength);
+	}
+
+	if (!bValid)
+	{
+		UE_LOG(LogVoxelTerrain, Log, TEXT("Ignoring %s, it was saved with different terrain settings or by an older version"), *Path);
+
+		Region.MappedRegion.Reset();
+		Region.MappedFile.Reset();
+		Region.FileData.Empty();
+		return;
+	}
+
+	FMemory::Memcpy(Region.Entries.GetData(), FileData + sizeof(FVoxelRegionFileHeader), TableSize);
+
+	// Drop any entries that point outside of the file, rather than reading garbage later
+	for (FChunkEntry& Entry : Region.Entries)
+	{
+		if (int64(Entry.Offset) + int64(Entry.Size) > FileSize)
+			Entry = FChunkEntry();
+	}
+}
+
+const uint8* FVoxelRegionStore::GetRegionData(const FRegionFile& Region, int64& OutSize)
+{
+	if (Region.MappedRegion.IsValid())
+	{
+		OutSize = Region.MappedRegion->GetMappedSize();
+		return Region.MappedRegion->GetMappedPtr();
+	}
+
+	OutSize = Region.FileData.Num();
+	return Region.FileData.Num() > 0 ? Region.FileData.GetData() : nullptr;
+}
+
+void FVoxelRegionStore::FlushRegion(const FIntVector& RegionKey, FRegionFile& Region)
+{
+	if (Region.PendingChunks.Num() == 0)
+		return;
+
+	// The whole file is rewritten, which also throws away the space used by old versions of chunks
+	const int64 TableSize = ChunksPerRegion * sizeof(FChunkEntry);
+	TArray<FChunkEntry> Entries;
+	Entries.SetNum(ChunksPerRegion);
+
+	TArray<uint8> NewFile;
+	NewFile.AddZeroed(sizeof(FVoxelRegionFileHeader) + TableSize);
+
+	int64 OldFileSize;
+	const uint8* OldFileData = GetRegionData(Region, OldFileSize);
+
+	for (int32 ChunkIndex = 0; ChunkIndex < ChunksPerRegion; ChunkIndex++)
+	{
+		const uint8* ChunkData = nullptr;
+		int32 ChunkSize = 0;
+
+		// Removed chunks are pending with no data, so they are left out
+		if (const TArray<uint8>* PendingChunk = Region.PendingChunks.Find(ChunkIndex))
+		{
+			ChunkData = PendingChunk->GetData();
+			ChunkSize = PendingChunk->Num();
+		}
+		else if (OldFileData && Region.Entries[ChunkIndex].Size > 0)
+		{
+			ChunkData = OldFileData + Region.Entries[ChunkIndex].Offset;
+			ChunkSize = Region.Entries[ChunkIndex].Size;
+		}
+
+		if (ChunkSize == 0)
+			continue;
+
+		Entries[ChunkIndex].Offset = uint32(NewFile.Num());
+		Entries[ChunkIndex].Size = uint32(ChunkSize);
+		NewFile.Append(ChunkData, ChunkSize);
+	}
+
+	FVoxelRegionFileHeader Header;
+	Header.Magic = Magic;
+	Header.Version = Version;
+	Header.SettingsHash = SettingsHash;
+	Header.ChunkSideLength = uint32(ChunkSideLength);
+
+	FMemory::Memcpy(NewFile.GetData(), &Header, sizeof(Header));
+	FMemory::Memcpy(NewFile.GetData() + sizeof(Header), Entries.GetData(), TableSize);
+
+	// Some platforms can't replace a file that is mapped
+	Region.MappedRegion.Reset();
+	Region.MappedFile.Reset();
+	Region.FileData.Empty();
+
+	// Write to a temporary file first, so a crash part way through never leaves a broken region behind
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	const FString Path = GetRegionPath(RegionKey);
+	const FString TempPath = Path + TEXT(".tmp");
+
+	PlatformFile.CreateDirectoryTree(*Directory);
+
+	if (FFileHelper::SaveArrayToFile(NewFile, *TempPath) && (!PlatformFile.FileExists(*Path) || PlatformFile.DeleteFile(*Path)) && PlatformFile.MoveFile(*Path, *TempPath))
+	{
+		for (const auto& PendingChunk : Region.PendingChunks)
+			PendingBytes -= PendingChunk.Value.Num();
+
+		Region.PendingChunks.Empty();
+	}
+	else
+	{
+		// Keep the chunks pending so they can be written next time
+		UE_LOG(LogVoxelTerrain, Warning, TEXT("Failed to write %s"), *Path);
+	}
+
+	OpenRegion(RegionKey, Region);
+}
+
+void FVoxelRegionStore::CloseUnusedRegions()
+{
+	while (Regions.Num() >= MaxOpenRegions)
+	{
+		FIntVector OldestKey;
+		uint64 OldestUse = MAX_uint64;
+
+		for (const auto& Region : Regions)
+		{
+			if (Region.Value->PendingChunks.Num() == 0 && Region.Value->LastUsed < OldestUse)
+			{
+				OldestUse = Region.Value->LastUsed;
+				OldestKey = Region.Key;
+			}
+		}
+
+		// Every open region has pending chunks, so nothing can be closed until they are flushed
+		if (OldestUse == MAX_uint64)
+			break;
+
+		Regions.Remove(OldestKey);
+	}
+}
+
+FString FVoxelRegionStore::GetRegionPath(const FIntVector& RegionKey) const
+{
+	return FPaths::Combine(Directory, FString::Printf(TEXT("r.%d.%d.%d.%s"), RegionKey.X, RegionKey.Y, RegionKey.Z, *FileExtension));
+}
+
+void FVoxelRegionStore::GetRegionLocation(const FIntVector& ChunkKey, FIntVector& OutRegionKey, int32& OutChunkIndex)
+{
+	// Round towards negative infinity so negative chunks end up in the right region
+	OutRegionKey = FIntVector(FMath::FloorToInt(float(ChunkKey.X) / RegionSideLength), FMath::FloorToInt(float(ChunkKey.Y) / RegionSideLength), FMath::FloorToInt(float(ChunkKey.Z) / RegionSideLength));
+
+	const FIntVector Local = ChunkKey - OutRegionKey * RegionSideLength;
+	OutChunkIndex = Local.X + Local.Y * RegionSideLength + Local.Z * RegionSideLength * RegionSideLength;
+}
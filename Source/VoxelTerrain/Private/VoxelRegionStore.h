@@ -0,0 +1,141 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+// Keeps a blob of data for every chunk on disk. This is what the chunk store and the mesh cache are built on; neither cares how the other
+// encodes its chunks, only that they can find them again quickly.
+//
+// Chunks are grouped into region files of RegionSideLength^3 chunks. Each file starts with a header and a table with the offset
+// and size of every chunk in it, followed by the data of the chunks.
+// Region files are memory mapped for reading. Written chunks are held in memory until Flush is called, or until too many of them
+// build up, and then every region with pending chunks is rewritten in one go.
+//
+// Every function is safe to call from any thread. The store is locked while it looks chunks up and copies them, but not while
+// they are decoded.
+class FVoxelRegionStore
+{
+public:
+	// The number of chunks along each side of a region file
+	static const int32 RegionSideLength = 8;
+
+	// The number of chunks in a region file
+	static const int32 ChunksPerRegion = RegionSideLength * RegionSideLength * RegionSideLength;
+
+	// Opens the store in the given directory. Region files end in FileExtension, and only the ones that start with the given Magic and Version
+	// and were written with the same SettingsHash and ChunkSideLength are used. Anything else is ignored, and overwritten when its region is next written.
+	FVoxelRegionStore(const FString& InDirectory, const FString& InFileExtension, uint32 InMagic, uint32 InVersion, uint32 InSettingsHash, int32 InChunkSideLength);
+
+	// Writes any pending chunks
+	~FVoxelRegionStore();
+
+	// Returns true if the given chunk has been stored
+	bool HasChunk(const FIntVector& ChunkKey);
+
+	// Calls Reader with the data of a chunk. The data is copied out of the store first, so the store isn't locked while Reader runs and
+	// several threads can read at once. The data is only valid during the call. Reader returns false if the data is corrupt. Returns false if the chunk hasn't been stored, or if Reader did.
+	bool ReadChunk(const FIntVector& ChunkKey, TFunctionRef<bool(const uint8* Data, int32 DataSize)> Reader);
+
+	// Stores a chunk. It is only written to disk when Flush is called, or when enough chunks are waiting. The data can't be empty.
+	void WriteChunk(const FIntVector& ChunkKey, TArray<uint8>&& Data);
+
+	// Forgets a chunk, so HasChunk returns false for it. Like a write, this only reaches the disk when the region is next written.
+	void RemoveChunk(const FIntVector& ChunkKey);
+
+	// Adds the key of every chunk that has been stored, in the region files and not written yet, to OutChunkKeys.
+	// This opens every region file in the directory, so it is only for things that happen rarely.
+	void GetChunkKeys(TArray<FIntVector>& OutChunkKeys);
+
+	// Writes every pending chunk to disk
+	void Flush();
+
+	// Returns the directory the region files are in
+	const FString& GetDirectory() const { return Directory; }
+
+private:
+	// Where a chunk is in its region file. A size of zero means the chunk isn't there.
+	struct FChunkEntry
+	{
+		uint32 Offset = 0;
+		uint32 Size = 0;
+	};
+
+	// A region file that has been opened
+	struct FRegionFile
+	{
+		// The offset table from the file
+		TArray<FChunkEntry> Entries;
+
+		// The file mapped into memory. This is null if the file doesn't exist yet or the platform can't map files.
+		TUniquePtr<IMappedFileHandle> MappedFile;
+		TUniquePtr<IMappedFileRegion> MappedRegion;
+
+		// The whole file, on platforms that can't map files
+		TArray<uint8> FileData;
+
+		// Chunks written since the last flush. An empty array is a chunk that has been removed.
+		TMap<int32, TArray<uint8>> PendingChunks;
+
+		// When this region was last used. The least recently used region is closed when too many are open.
+		uint64 LastUsed = 0;
+
+		FRegionFile();
+		~FRegionFile();
+	};
+
+	// Returns the opened region file, opening it if needed. The lock must be held.
+	FRegionFile& GetRegion(const FIntVector& RegionKey);
+
+	// Reads the header and offset table of a region file. The lock must be held.
+	void OpenRegion(const FIntVector& RegionKey, FRegionFile& Region);
+
+	// Returns the contents of an opened region file, or null if it doesn't exist
+	static const uint8* GetRegionData(const FRegionFile& Region, int64& OutSize);
+
+	// Adds a chunk to the pending chunks of its region, and writes them all out if too many have built up. The lock must be held.
+	void AddPendingChunk(const FIntVector& ChunkKey, TArray<uint8>&& Data);
+
+	// Rewrites a region file with its pending chunks. The lock must be held.
+	void FlushRegion(const FIntVector& RegionKey, FRegionFile& Region);
+
+	// Closes the least recently used regions that don't have pending chunks, until there are few enough open. The lock must be held.
+	void CloseUnusedRegions();
+
+	// Returns the path of the region file with the given key
+	FString GetRegionPath(const FIntVector& RegionKey) const;
+
+	// Splits a chunk key into the key of its region and its index within the region
+	static void GetRegionLocation(const FIntVector& ChunkKey, FIntVector& OutRegionKey, int32& OutChunkIndex);
+
+	// The directory the region files are in
+	FString Directory;
+
+	// The extension of the region files, without the dot
+	FString FileExtension;
+
+	// What every region file has to start with
+	uint32 Magic;
+	uint32 Version;
+
+	// The hash of the settings used to generate the chunks
+	uint32 SettingsHash;
+
+	// The side length of the chunks in voxels
+	int32 ChunkSideLength;
+
+	// Every region file that is open
+	TMap<FIntVector, TUniquePtr<FRegionFile>> Regions;
+
+	// Incremented every time a region is used, to keep track of which region was used least recently
+	uint64 RegionClock = 0;
+
+	// The total size of the chunks waiting to be written
+	int64 PendingBytes = 0;
+
+	// Protects everything above
+	FCriticalSection StoreLock;
+};
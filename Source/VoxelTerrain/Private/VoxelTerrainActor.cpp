@@ -2,21 +2,51 @@
 
 #include "VoxelTerrainActor.h"
 #include "VoxelTerrain.h"
+#include "VoxelTerrainGeneration.h"
+#include "VoxelChunkStore.h"
+#include "VoxelTerrainStats.h"
+#include "VoxelTerrainNetComponent.h"
+#include "Async/ParallelFor.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/FileManager.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+#include "Net/UnrealNetwork.h"
 
 // PolyVox
-#include "PolyVox/CubicSurfaceExtractor.h"
-#include "PolyVox/MarchingCubesSurfaceExtractor.h"
-#include "PolyVox/Mesh.h"
 using namespace PolyVox;
 
-// ANL
-#include "VM/kernel.h"
-using namespace anl;
+// Adds a loaded chunk's mesh to the VoxelTerrain stats
+static void AddLoadedChunkStats(const FVoxelLoadedChunk& Chunk)
+{
+	INC_DWORD_STAT_BY(STAT_VoxelTerrain_Triangles, Chunk.NumTriangles);
+	INC_DWORD_STAT_BY(STAT_VoxelTerrain_Vertices, Chunk.NumVertices);
+	INC_DWORD_STAT_BY(STAT_VoxelTerrain_MeshSections, Chunk.NumSections);
+	INC_MEMORY_STAT_BY(STAT_VoxelTerrain_MeshMemory, Chunk.MeshBytes);
+}
+
+// Takes a chunk that is being unloaded or remeshed back out of the VoxelTerrain stats
+static void RemoveLoadedChunkStats(const FVoxelLoadedChunk& Chunk)
+{
+	DEC_DWORD_STAT_BY(STAT_VoxelTerrain_Triangles, Chunk.NumTriangles);
+	DEC_DWORD_STAT_BY(STAT_VoxelTerrain_Vertices, Chunk.NumVertices);
+	DEC_DWORD_STAT_BY(STAT_VoxelTerrain_MeshSections, Chunk.NumSections);
+	DEC_MEMORY_STAT_BY(STAT_VoxelTerrain_MeshMemory, Chunk.MeshBytes);
+}
 
 // Sets default values
 AVoxelTerrainActor::AVoxelTerrainActor()
 {
+	// Finished chunks are turned into components during Tick
+	PrimaryActorTick.bCanEverTick = true;
+
 	// Default values for our noise control variables.
+	SurfaceExtractor = EVoxelSurfaceExtractor::Cubic;
+	MeshCacheSurfaceExtractor = EVoxelSurfaceExtractor::Cubic;
+	bSingleMeshSection = false;
+	SingleSectionMaterial = nullptr;
 	bIsSpherical = false;
 	Seed = 123;
 	NoiseOctaves = 3;
@@ -31,29 +61,216 @@ AVoxelTerrainActor::AVoxelTerrainActor()
 	MaxChunksY = 5;
 	MaxChunksZ = 5;
 
+	// Default values for the generation pipeline
+	bGenerateAsynchronously = true;
+	NumWorkerThreads = 0;
+	GameThreadBudgetMs = 4.f;
+	bUseBatchedNoise = false;
+	bHideBuriedChunks = false;
+	bDeferBuriedChunkMeshes = false;
+
+	// Default values for saving
+	bSaveChunks = true;
+	bUseMeshCache = true;
+
+	// Default values for streaming
+	bStreamChunks = false;
+	StreamingLoadRadius = 5.f;
+	StreamingUnloadRadius = 7.f;
+	NumLodLevels = 0;
+	VolumeMemoryMB = 256;
+	MeshMemoryBudgetMB = 512;
+
+	// Default values for collision
+	bGenerateCollision = true;
+	CollisionRadius = 2.f;
+
+	// Default values for profiling
+	bWriteChunkCsv = false;
+
+	// The server sends its settings and edits to the clients. The terrain is huge, so it is always relevant to every one of them.
+	bReplicates = true;
+	bAlwaysRelevant = true;
+	NetSnapshotBytesPerSecond = 65536;
+	bHasNetSettings = false;
+	bWaitingForNetSettings = false;
+	NetEditSequence = 0;
+
+	WorkerPool = nullptr;
+	LastQueryBatchId = 0;
+	QueryBatchesInFlight = 0;
+	bPendingChunksNeedSort = false;
+	ChunksInFlight = 0;
+	ChunksQueuedTotal = 0;
+	ChunksCompleted = 0;
+	MeshMemoryBytes = 0;
+	BudgetLoadRadius = 0.f;
+	NumMeshComponentsCreated = 0;
+	bUnloadStaleChunks = false;
+	VisibleLowerBound = FIntVector::ZeroValue;
+	VisibleUpperBound = FIntVector::ZeroValue;
+	bChunkVisibilityChanged = false;
+	NumHiddenChunks = 0;
+
 	Scene = CreateDefaultSubobject<USceneComponent>(FName(TEXT("Terrain")));
 	SetRootComponent(Scene);
-
-	Meshes.Empty();
 }
 
 // Called after the C++ constructor and after the properties have been initialized.
 void AVoxelTerrainActor::PostInitializeComponents()
 {
-	// Initialize our paged volume.
-	VoxelVolume = MakeShareable(new PagedVolume<MaterialDensityPair88>(new VoxelTerrainPager(bIsSpherical, Seed, NoiseOctaves, NoiseFrequency, NoiseScale, NoiseOffset, TerrainHeight)));
+	InitializeGeneration();
 
-	// Clear all of the data in our array of meshes and recreate it with all zeros
-	Meshes.Empty();
-	Meshes.AddZeroed((MaxChunksX * 2) * (MaxChunksY * 2) * (MaxChunksZ * 2));
+	// Edits can arrive before BeginPlay, and have to wait for the snapshot like the ones after it
+	if (IsNetClient())
+		NetReplicator.WaitForSnapshot();
 
 	// Call the base class's function.
 	Super::PostInitializeComponents();
 }
 
+void AVoxelTerrainActor::InitializeGeneration()
+{
+	GenerationContext = CreateGenerationContext(bSaveChunks);
+	VoxelPager = GenerationContext->Pager;
+	VoxelVolume = GenerationContext->Volume;
+
+	// Replicated edits and snapshots go straight into the new volume, and the chunks they change are remeshed
+	NetReplicator.SetVolume(VoxelPager.Get(), VoxelVolume.Get(), VoxelToVolume(FIntVector::ZeroValue));
+	NetReplicator.OnVoxelsChanged = [this](const FIntVector& Lower, const FIntVector& Upper) { MarkVoxelsDirty(Lower, Upper); };
+
+	if (bUseMeshCache)
+	{
+		GenerationContext->MeshCache = MakeShareable(new FVoxelMeshCache(FPaths::Combine(GetSaveDirectory(), TEXT("Meshes")), FVoxelChunkTraits::Size, GetMeshCacheHash()));
+		MeshCacheSurfaceExtractor = SurfaceExtractor;
+	}
+
+	Chunks.Empty();
+	LodNodes.Empty();
+	DirtyChunks.Empty();
+	DirtyLodNodes.Empty();
+	LodStats.Reset();
+	LodStats.SetNum(NumLodLevels + 1);
+	MeshMemoryBytes = 0;
+	BudgetLoadRadius = StreamingLoadRadius;
+}
+
+TSharedRef<FVoxelGenerationContext, ESPMode::ThreadSafe> AVoxelTerrainActor::CreateGenerationContext(bool bLoadSavedChunks) const
+{
+	// Initialize our paged volume.
+	TSharedPtr<VoxelTerrainPager, ESPMode::ThreadSafe> Pager = MakeShareable(new VoxelTerrainPager(bIsSpherical, Seed, NoiseOctaves, NoiseFrequency, NoiseScale, NoiseOffset, TerrainHeight, bUseBatchedNoise));
+
+	// The chunk store has to be in place before the volume pages anything in.
+	// A client's edits all come from the server, so anything it saved from an earlier game would only put it out of step.
+	if (bLoadSavedChunks && !IsNetClient())
+		Pager->SetChunkStore(MakeShareable(new FVoxelChunkStore(GetSaveDirectory(), VoxelTerrainPager::VolumeChunkSideLength, Pager->GetSettingsHash())));
+
+	// The pager only needs to remember the chunks with a surface in them, since it never stages uniform ones.
+	// Those take at least one bit per voxel in the volume.
+	const int64 VolumeMemoryBytes = int64(VolumeMemoryMB) * 1024 * 1024;
+	const int64 VolumeChunkBytes = VoxelTerrainPager::FVolumeChunkTraits::NumVoxels / 8;
+	Pager->SetMaxResidentChunks(int32(FMath::Min<int64>(VolumeMemoryBytes / VolumeChunkBytes, MAX_int32)));
+
+	TSharedPtr<FVoxelPaletteVolume, ESPMode::ThreadSafe> Volume = MakeShareable(new FVoxelPaletteVolume(Pager.Get(), uint32(FMath::Min<int64>(VolumeMemoryBytes, MAX_uint32)), VoxelTerrainPager::VolumeChunkSideLength));
+
+	// Everything the worker threads need to generate chunks
+	TSharedRef<FVoxelGenerationContext, ESPMode::ThreadSafe> Context = MakeShareable(new FVoxelGenerationContext(Pager, Volume, TerrainMaterials.Num()));
+	Context->bSingleMeshSection = bSingleMeshSection;
+	return Context;
+}
+
+FString AVoxelTerrainActor::GetSaveDirectory() const
+{
+	return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("VoxelTerrain"), SaveName.IsEmpty() ? GetName() : SaveName);
+}
+
+uint32 AVoxelTerrainActor::GetMeshCacheHash() const
+{
+	// The pager covers the voxels, and the rest is how they are turned into meshes and where the chunks sit in the noise
+	uint32 Hash = VoxelPager->GetSettingsHash();
+	Hash = HashCombine(Hash, GetTypeHash(uint8(SurfaceExtractor)));
+	Hash = HashCombine(Hash, GetTypeHash(TerrainMaterials.Num()));
+	Hash = HashCombine(Hash, GetTypeHash(bSingleMeshSection));
+	Hash = HashCombine(Hash, GetTypeHash(VoxelToVolume(FIntVector::ZeroValue)));
+	return Hash;
+}
+
+UMaterialInterface* AVoxelTerrainActor::GetSectionMaterial(int32 SectionIndex) const
+{
+	if (bSingleMeshSection && SingleSectionMaterial)
+		return SingleSectionMaterial;
+
+	return TerrainMaterials.IsValidIndex(SectionIndex) ? TerrainMaterials[SectionIndex] : nullptr;
+}
+
 // Called when the actor has begun playing in the level
 void AVoxelTerrainActor::BeginPlay()
 {
+	Super::BeginPlay();
+
+	// This is opened before anything generates, so the chunks made in BeginPlay are in it too
+	if (bWriteChunkCsv || FParse::Param(FCommandLine::Get(), TEXT("VoxelChunkCsv")))
+	{
+		const FString CsvPath = FPaths::Combine(FPaths::ProfilingDir(), TEXT("VoxelTerrain"), GetName() + TEXT(".csv"));
+		ChunkCsv.Reset(IFileManager::Get().CreateFileWriter(*CsvPath));
+
+		if (ChunkCsv.IsValid())
+		{
+			FTCHARToUTF8 Header(TEXT("ChunkX,ChunkY,ChunkZ,Lod,Remesh,Skipped,Cached,GenerationMs,NoiseMs,ExtractMs,MeshBuildMs,CollisionMs,CreateMs,Triangles,Vertices,Sections,MeshBytes,CollisionTriangles\n"));
+			ChunkCsv->Serialize((void*)Header.Get(), Header.Length());
+		}
+		else
+		{
+			UE_LOG(LogVoxelTerrain, Warning, TEXT("Couldn't open %s for writing"), *CsvPath);
+		}
+	}
+
+	// The clients generate the same voxels the server does from these
+	if (HasAuthority())
+	{
+		NetSettings.bIsSet = true;
+		NetSettings.bIsSpherical = bIsSpherical;
+		NetSettings.Seed = Seed;
+		NetSettings.NoiseOctaves = NoiseOctaves;
+		NetSettings.NoiseFrequency = NoiseFrequency;
+		NetSettings.NoiseScale = NoiseScale;
+		NetSettings.NoiseOffset = NoiseOffset;
+		NetSettings.TerrainHeight = TerrainHeight;
+		NetSettings.MaxChunks = FIntVector(MaxChunksX, MaxChunksY, MaxChunksZ);
+		NetSettings.bUseBatchedNoise = bUseBatchedNoise;
+	}
+
+	// Anything a client generated before the server's settings arrive would only be thrown away
+	if (IsNetClient() && !bHasNetSettings)
+	{
+		bWaitingForNetSettings = true;
+		return;
+	}
+
+	StartGeneration();
+}
+
+void AVoxelTerrainActor::StartGeneration()
+{
+	if (bGenerateAsynchronously)
+	{
+		// Leave a couple of cores for the game and render threads
+		int32 ThreadCount = NumWorkerThreads > 0 ? NumWorkerThreads : FMath::Max(1, FPlatformMisc::NumberOfCoresIncludingHyperthreads() - 2);
+
+		WorkerPool = FQueuedThreadPool::Allocate();
+		verify(WorkerPool->Create(ThreadCount, 128 * 1024, TPri_BelowNormal));
+	}
+
+	// Work out which chunks want collision first, so the ones generated now are built with it
+	UpdateCollisionStreaming();
+
+	// Streaming queues the chunks around the viewers itself
+	if (bStreamChunks)
+	{
+		UpdateStreaming();
+		return;
+	}
+
 	// This will generate all the chunks in the area specified by the ChunksToGenerate settings
 	for (int32 X = -(ChunksToGenerateX - 1); X < ChunksToGenerateX; X++)
 	{
@@ -61,316 +278,1879 @@ void AVoxelTerrainActor::BeginPlay()
 		{
 			for (int32 Z = -(ChunksToGenerateZ - 1); Z < ChunksToGenerateZ; Z++)
 			{
-				GenerateChunk(X, Y, Z);
+				if (bGenerateAsynchronously)
+					QueueChunk(X, Y, Z);
+				else
+					GenerateChunk(X, Y, Z);
 			}
 		}
 	}
 }
 
-bool AVoxelTerrainActor::GenerateChunk(int32 X, int32 Y, int32 Z)
+// Called when the actor is being removed from the level
+void AVoxelTerrainActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	// Extract the voxel mesh from PolyVox
+	CancelGeneration();
+
+	// Destroying the pool waits for the worker threads to finish the chunk they are on.
+	// The cancelled chunks bail out early, so this doesn't take long.
+	if (WorkerPool)
+	{
+		WorkerPool->Destroy();
+		delete WorkerPool;
+		WorkerPool = nullptr;
+	}
 
-	// Get the index of the new chunk. This is used to prevent duplicate chunks.
-	int32 ChunkIndex = (Z + MaxChunksZ) * (MaxChunksX * 2) * (MaxChunksY * 2) + (Y + MaxChunksY) * (MaxChunksX * 2) + (X + MaxChunksX);
+	// Page out every chunk, which saves the ones that were modified, and then write them to disk. The workers are gone, so nothing else is using the volume.
+	if (GenerationContext.IsValid())
+		VoxelVolume->flushAll();
 
-	// Make sure the chunk hasn't already been loaded.
-	// This array should always fit a chunk index if a valid chunk was specified.
-	if (Meshes[ChunkIndex] != nullptr)
-		return false;
+	if (VoxelPager.IsValid() && VoxelPager->GetChunkStore().IsValid())
+		VoxelPager->GetChunkStore()->Flush();
 
-	// Convert to the actual location of the chunk
-	// 32 is the size of each side of the chunk, this can be adjusted in the ToExtract region below.
-	// If you change the chunk size make sure to adjust the OffsetLocation as well!
-	int32 ChunkX;
-	int32 ChunkY;
-	int32 ChunkZ;
+	// This writes out the chunks that were dropped from the cache by edits
+	if (GenerationContext.IsValid() && GenerationContext->MeshCache.IsValid())
+		GenerationContext->MeshCache->Flush();
 
-	// Spherical terrains don't work with the offset X/Y/Z location, so disable it.
-	if (bIsSpherical)
-	{
-		ChunkX = X * 32;
-		ChunkY = Y * 32;
-		ChunkZ = Z * 32;
-	}
+	// The stats are totals over every terrain, so this one's meshes have to come back out of them
+	for (const TPair<FIntVector, FVoxelLoadedChunk>& Pair : Chunks)
+		RemoveLoadedChunkStats(Pair.Value);
 
-	// Otherwise, enable the offset. This is will be used to slightly simplify a future section of code
-	// Until that is added this doesn't really do anything useful though!
-	else
+	for (const TPair<FVoxelChunkKey, FVoxelLoadedChunk>& Pair : LodNodes)
+		RemoveLoadedChunkStats(Pair.Value);
+
+	for (const FIntVector& ChunkCoord : CollisionChunks)
+		DEC_DWORD_STAT_BY(STAT_VoxelTerrain_CollisionTriangles, Chunks.FindChecked(ChunkCoord).NumCollisionTriangles);
+
+	DEC_DWORD_STAT_BY(STAT_VoxelTerrain_CollisionChunks, CollisionChunks.Num());
+
+	ChunkCsv.Reset();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+// Called every frame
+void AVoxelTerrainActor::Tick(float DeltaSeconds)
+{
+	VOXEL_TERRAIN_SCOPE(STAT_VoxelTerrain_Tick);
+
+	Super::Tick(DeltaSeconds);
+
+	// The edits made since the last frame go out together
+	if (IsReplicatingEdits())
 	{
-		ChunkX = (X + MaxChunksX) * 32;
-		ChunkY = (Y + MaxChunksY) * 32;
-		ChunkZ = (Z + MaxChunksZ) * 32;
+		UpdateNetClients();
+		SendPendingEdits();
 	}
 
-	// Spherical terrains need to be able to generate chunks on the Z axis.
-	// If you're not working with spherical terrain in your project you might consider
-	// removing the Z axis from this function.
-	PolyVox::Region ToExtract(Vector3DInt32(ChunkX - 31, ChunkY - 31, ChunkZ - 31), Vector3DInt32(ChunkX + 31, ChunkY + 31, ChunkZ + 31));
-	
-	// Generate a blocky mesh from the voxels.
-	auto ExtractedMesh = extractCubicMesh(VoxelVolume.Get(), ToExtract);
+	if (!GenerationContext.IsValid() || bWaitingForNetSettings)
+		return;
 
-	// Uncomment this line to generate a smooth mesh from the voxels.
-	// This is mostly intended for use on spherical terrain.
-	//auto ExtractedMesh = extractMarchingCubesMesh(VoxelVolume.Get(), ToExtract);
+	if (QueryBatchesInFlight > 0)
+		DeliverQueryResults();
 
-	auto DecodedMesh = decodeMesh(ExtractedMesh);
+	if (bStreamChunks)
+		UpdateStreaming();
 
-	if (DecodedMesh.getNoOfIndices() == 0)
-		return false;
+	TArray<FIntVector> ViewerChunks;
+	if (bStreamChunks)
+		GetViewerChunks(ViewerChunks);
 
-	// Create a new mesh component to render and add it to the list of meshes.
-	UProceduralMeshComponent* Mesh = NewObject<UProceduralMeshComponent>(this, FName(*FString::Printf(TEXT("VoxelMesh_%d"), ChunkIndex)));
-	Mesh->RegisterComponent();
-	Mesh->AttachToComponent(GetRootComponent(), FAttachmentTransformRules(EAttachmentRule::KeepRelative, false));
-	Meshes[ChunkIndex] = Mesh;
+	const double StartTime = FPlatformTime::Seconds();
+	const double BudgetSeconds = GameThreadBudgetMs / 1000.0;
 
-	// Get the offset location of the chunk to apply to the mesh
-	FVector OffsetLocation(X * 32, Y * 32,  Z * 32);
-
-	// This isn't the most efficient way to handle this, but it works.
-	// To improve the performance of this code, you'll want to modify 
-	// the code so that you only run this section of code once.
-	for (int32 Material = 0; Material < TerrainMaterials.Num(); Material++)
-	{
-		// Define variables to pass into the CreateMeshSection function
-		auto Vertices = TArray<FVector>();
-		auto Indices = TArray<int32>();
-		auto Normals = TArray<FVector>();
-		auto UV0 = TArray<FVector2D>();
-		auto Colors = TArray<FColor>();
-		auto Tangents = TArray<FProcMeshTangent>();
-
-		// Loop over all of the triangle vertex indices
-		for (uint32 i = 0; i < DecodedMesh.getNoOfIndices() - 2; i += 3)
-		{
-			// We need to add the vertices of each triangle in reverse or the mesh will be upside down
-			auto Index = DecodedMesh.getIndex(i + 2);
-			auto Vertex2 = DecodedMesh.getVertex(Index);
-			auto TriangleMaterial = Vertex2.data.getMaterial();
+	// Create components for the chunks the workers have finished, until we run out of time for this frame.
+	// At least one chunk is always created so generation can't stall completely.
+	TSharedPtr<FVoxelChunkMeshData, ESPMode::ThreadSafe> MeshData;
+	while (GenerationContext->CompletedChunks.Dequeue(MeshData))
+	{
+		ChunksInFlight--;
+
+		const FVoxelChunkKey Key(MeshData->ChunkCoord, MeshData->Lod);
+		QueuedChunks.Remove(Key);
 
-			// Before we continue, we need to be sure that the triangle is the right material; we don't want to use verticies from other materials
-			if (TriangleMaterial == (Material + 1))
+		// A loaded chunk only comes back from the workers when it has been remeshed after an edit, or when it only needed collision.
+		// A loaded node only comes back when it has been remeshed with another surface extractor.
+		// It is kept up to date for as long as it stays loaded, and a cancelled remesh still has to happen.
+		// A cancelled collision build is queued again by UpdateCollisionStreaming.
+		if (IsChunkNodeLoaded(Key))
+		{
+			if (MeshData->bCancelled || GenerationContext->IsCancelled(MeshData->Epoch))
+			{
+				if (Key.Lod > 0)
+					DirtyLodNodes.Add(Key);
+				else if (MeshData->bHasMesh || MeshData->bHasVisibility)
+					DirtyChunks.Add(Key.Coord);
+			}
+			else
 			{
-				// If it is of the same material, then we need to add the correct indices now
-				Indices.Add(Vertices.Add((FPolyVoxVector(Vertex2.position) + OffsetLocation) * 100.f));
+				if (MeshData->bHasMesh)
+					UpdateChunkComponent(*MeshData);
 
-				Index = DecodedMesh.getIndex(i + 1);
-				auto Vertex1 = DecodedMesh.getVertex(Index);
-				Indices.Add(Vertices.Add((FPolyVoxVector(Vertex1.position) + OffsetLocation) * 100.f));
+				if (MeshData->bHasCollision)
+					UpdateChunkCollision(*MeshData);
 
-				Index = DecodedMesh.getIndex(i);
-				auto Vertex0 = DecodedMesh.getVertex(Index);
-				Indices.Add(Vertices.Add((FPolyVoxVector(Vertex0.position) + OffsetLocation) * 100.f));
+				if (MeshData->bHasVisibility)
+					UpdateChunkVisibility(*MeshData);
+			}
 
-				// Calculate the tangents of our triangle
-				const FVector Edge01 = FPolyVoxVector(Vertex1.position - Vertex0.position);
-				const FVector Edge02 = FPolyVoxVector(Vertex2.position - Vertex0.position);
+			GenerationContext->ReleaseMeshData(MeshData);
+			continue;
+		}
 
-				const FVector TangentX = Edge01.GetSafeNormal();
-				FVector TangentZ = (Edge01 ^ Edge02).GetSafeNormal();
+		// A buried chunk that was only built for its visibility still loads, and is meshed once it can be seen
+		const bool bUnmeshed = !MeshData->bHasMesh && MeshData->bHasVisibility && Key.Lod == 0;
 
-				for (int32 i = 0; i < 3; i++)
-				{
-					Tangents.Add(FProcMeshTangent(TangentX, false));
-					Normals.Add(TangentZ);
-				}
-			}
+		// Chunks from a cancelled epoch are thrown away, and so are chunks the viewers moved away from while they were being generated.
+		// Collision on its own is no use either if the chunk was unloaded while it was being built.
+		if ((!MeshData->bHasMesh && !bUnmeshed) || MeshData->bCancelled || GenerationContext->IsCancelled(MeshData->Epoch) || (bStreamChunks && !IsChunkWanted(Key, ViewerChunks)))
+		{
+			GenerationContext->ReleaseMeshData(MeshData);
+			continue;
 		}
 
-		// Finally create the mesh
-		Mesh->CreateMeshSection(Material, Vertices, Indices, Normals, UV0, Colors, Tangents, true);
-		Mesh->SetMaterial(Material, TerrainMaterials[Material]);
+		CreateChunkComponent(*MeshData);
+		ChunksCompleted++;
+
+		if (bUnmeshed)
+			UnmeshedChunks.Add(Key.Coord);
+
+		// Level of detail nodes aren't chunks as far as the game is concerned
+		if (MeshData->Lod == 0)
+			OnChunkGenerated.Broadcast(MeshData->ChunkCoord.X, MeshData->ChunkCoord.Y, MeshData->ChunkCoord.Z);
+
+		// Whatever this chunk replaces might be able to go now
+		if (bStreamChunks && NumLodLevels > 0)
+			bUnloadStaleChunks = true;
+
+		// The component has its own copy of the buffers now, so they can go back to the pool
+		GenerationContext->ReleaseMeshData(MeshData);
+
+		if (FPlatformTime::Seconds() - StartTime >= BudgetSeconds)
+			break;
 	}
 
-	return true;
+	// Hide whatever the new chunks have buried, before any of them are drawn. This can queue remeshes for chunks that have been opened up.
+	if (bHideBuriedChunks)
+	{
+		if (!bStreamChunks)
+			GetViewerChunks(ViewerChunks);
+
+		HideBuriedChunks(ViewerChunks);
+	}
+
+	// Edits go to the workers ahead of anything that is streaming in, since the player is waiting to see them
+	RemeshDirtyChunks();
+
+	// So does collision, since something might be about to fall through the chunks that don't have it yet
+	UpdateCollisionStreaming();
+
+	// Keep the workers busy
+	DispatchPendingChunks();
+
+	INC_DWORD_STAT_BY(STAT_VoxelTerrain_PendingChunks, PendingChunks.Num());
+	INC_DWORD_STAT_BY(STAT_VoxelTerrain_ChunksInFlight, ChunksInFlight);
+	INC_DWORD_STAT_BY(STAT_VoxelTerrain_DirtyChunks, DirtyChunks.Num());
+	INC_DWORD_STAT_BY(STAT_VoxelTerrain_HiddenChunks, NumHiddenChunks);
+	INC_DWORD_STAT_BY(STAT_VoxelTerrain_UnmeshedChunks, UnmeshedChunks.Num());
+
+	// The mesh budget is only checked once the selection has fully loaded, since until then the chunks it replaces are still around
+	if (bUnloadStaleChunks)
+	{
+		bUnloadStaleChunks = false;
+
+		if (UnloadStaleChunks() && !IsGenerating())
+			EnforceMeshMemoryBudget(ViewerChunks);
+	}
+
+	if (ChunksQueuedTotal > 0 && !IsGenerating())
+	{
+		ChunksQueuedTotal = 0;
+		ChunksCompleted = 0;
+		OnGenerationComplete.Broadcast();
+	}
 }
 
-// VoxelTerrainPager Definitions
-// Constructor
-VoxelTerrainPager::VoxelTerrainPager(bool bIsSphericalTerrain, uint32 NoiseSeed, uint32 Octaves, float Frequency, float Scale, float Offset, float Height) : PagedVolume<MaterialDensityPair88>::Pager(), bIsSpherical(bIsSphericalTerrain), Seed(NoiseSeed), NoiseOctaves(Octaves), NoiseFrequency(Frequency), NoiseScale(Scale), NoiseOffset(Offset), TerrainHeight(Height)
+bool AVoxelTerrainActor::GenerateChunk(int32 X, int32 Y, int32 Z)
 {
+	// Make sure the chunk hasn't already been loaded.
+	if (Chunks.Contains(FIntVector(X, Y, Z)))
+		return false;
+
+	// Run every stage of the pipeline right here
+	FVoxelChunkMeshData MeshData;
+	GenerationContext->BuildChunkMesh(MakeChunkRequest(X, Y, Z), MeshData);
+
+	return CreateChunkComponent(MeshData);
+}
 
+bool AVoxelTerrainActor::QueueChunk(int32 X, int32 Y, int32 Z)
+{
+	return QueueChunkNode(FVoxelChunkKey(FIntVector(X, Y, Z), 0));
 }
 
-// Called when a new chunk is paged in
-// This function will automatically generate our voxel-based terrain from simplex noise
-void VoxelTerrainPager::pageIn(const PolyVox::Region& region, PagedVolume<MaterialDensityPair88>::Chunk* Chunk)
+bool AVoxelTerrainActor::QueueChunkNode(const FVoxelChunkKey& Key)
 {
-	// This is our kernel. It is responsible for generating our noise.
-	CKernel NoiseKernel;
+	// Skip chunks that already exist or are already on their way
+	if (IsChunkNodeLoaded(Key) || QueuedChunks.Contains(Key))
+		return false;
 
-	// Commonly used constants
-	auto Zero = NoiseKernel.constant(0);
-	auto One = NoiseKernel.constant(1);
-	auto VerticalHeight = NoiseKernel.constant(TerrainHeight);
-	auto HalfVerticalHeight = NoiseKernel.constant(TerrainHeight / 2.f);
-	
-	// This if statement has a lot of copy pasting, and could definitely be done better...
-	// It works though, so we're just going to go with it to keep things simple.
-	if (bIsSpherical)
+	// Without a worker pool there is nothing to queue on, so just do it now
+	if (!WorkerPool)
 	{
-		// Select an area around 0, 0, 0 to become our sphere
-		//	- This is done by comparing the result of NoiseKernel.radial() with the radius of our sphere
-		//	- NoiseKernel.radial() returns the distance from 0, 0, 0 in case you don't know!
-		auto SphereSelect = NoiseKernel.select(One, Zero, NoiseKernel.radial(), HalfVerticalHeight, Zero);
+		FVoxelChunkMeshData MeshData;
+		GenerationContext->BuildChunkMesh(MakeChunkRequest(Key), MeshData);
+		return CreateChunkComponent(MeshData);
+	}
 
-		// This is the actual noise generator we'll be using.
-		// In this case I've gone with a simple fBm generator, which will create terrain that looks like smooth, rolling hills.
-		auto TerrainFractal = NoiseKernel.simplefBm(BasisTypes::BASIS_SIMPLEX, InterpolationTypes::INTERP_LINEAR, NoiseOctaves, NoiseFrequency, Seed);
+	QueuedChunks.Add(Key);
+	PendingChunks.Add(Key);
+	bPendingChunksNeedSort = true;
+	ChunksQueuedTotal++;
 
-		// Scale and offset the generated noise value. 
-		// Scaling the noise makes the features bigger or smaller, and offsetting it will move the terrain up and down.
-		// 
-		// Generally speaking it is probably better to avoid using NoiseOffset with a spherical terrain, it might not do what you expect!
-		//	- You should probably just change the TerrainHeight from the editor instead.
-		auto TerrainScale = NoiseKernel.scaleOffset(TerrainFractal, NoiseScale, NoiseOffset);
+	return true;
+}
 
-		// Finally, apply the offset we just calculated from the fractal to our sphere.
-		auto PerturbGradient = NoiseKernel.translateDomain(SphereSelect, TerrainScale);
+void AVoxelTerrainActor::CancelGeneration()
+{
+	if (GenerationContext.IsValid())
+		GenerationContext->Epoch.Increment();
 
-		CNoiseExecutor TerrainExecutor(NoiseKernel);
+	// Chunks already handed to the workers stay in QueuedChunks until they report back
+	for (const FVoxelChunkKey& Key : PendingChunks)
+		QueuedChunks.Remove(Key);
 
-		// Now that we have our noise setup, let's loop over our chunk and apply it.
-		for (int x = region.getLowerX(); x <= region.getUpperX(); x++)
-		{
-			for (int y = region.getLowerY(); y <= region.getUpperY(); y++)
-			{
-				for (int z = region.getLowerZ(); z <= region.getUpperZ(); z++)
-				{
-					// Evaluate the noise
-					auto EvaluatedNoise = TerrainExecutor.evaluateScalar(x, y, z, PerturbGradient);
-					MaterialDensityPair88 Voxel;
-
-					// For the sake of making this code shorter, I've opted to only use two materials: Air and Stone
-					bool bSolid = EvaluatedNoise > 0.5;
-					Voxel.setDensity(FMath::FloorToInt(FMath::Clamp(EvaluatedNoise, 0.0, 1.0) * Voxel.getMaxDensity()));
-					Voxel.setMaterial(bSolid ? 1 : 0);
-
-					// Voxel position within a chunk always start from zero. So if a chunk represents region (4, 8, 12) to (11, 19, 15)
-					// then the valid chunk voxels are from (0, 0, 0) to (7, 11, 3). Hence we subtract the lower corner position of the
-					// region from the volume space position in order to get the chunk space position.
-					Chunk->setVoxel(x - region.getLowerX(), y - region.getLowerY(), z - region.getLowerZ(), Voxel);
-				}
-			}
-		}
+	PendingChunks.Empty();
+	ChunksQueuedTotal = 0;
+	ChunksCompleted = 0;
+}
+
+bool AVoxelTerrainActor::IsGenerating() const
+{
+	return PendingChunks.Num() > 0 || ChunksInFlight > 0;
+}
+
+float AVoxelTerrainActor::GetGenerationProgress() const
+{
+	return ChunksQueuedTotal > 0 ? FMath::Clamp(float(ChunksCompleted) / float(ChunksQueuedTotal), 0.f, 1.f) : 1.f;
+}
+
+bool AVoxelTerrainActor::UnloadChunk(int32 X, int32 Y, int32 Z)
+{
+	return UnloadChunkNode(FVoxelChunkKey(FIntVector(X, Y, Z), 0));
+}
+
+bool AVoxelTerrainActor::UnloadChunkNode(const FVoxelChunkKey& Key)
+{
+	if (Key.Lod == 0)
+		ClearChunkCollision(Key.Coord);
+
+	FVoxelLoadedChunk Chunk;
+	if (Key.Lod == 0 ? !Chunks.RemoveAndCopyValue(Key.Coord, Chunk) : !LodNodes.RemoveAndCopyValue(Key, Chunk))
+		return false;
+
+	MeshMemoryBytes -= Chunk.MeshBytes;
+	RemoveLoadedChunkStats(Chunk);
+
+	if (Key.Lod == 0)
+	{
+		DirtyChunks.Remove(Key.Coord);
+		UnmeshedChunks.Remove(Key.Coord);
+		bChunkVisibilityChanged = true;
 	}
 	else
 	{
-		// Create a gradient on the vertical axis to form our ground plane.
-		auto VerticalGradient = NoiseKernel.divide(NoiseKernel.clamp(NoiseKernel.subtract(VerticalHeight, NoiseKernel.z()), Zero, VerticalHeight), VerticalHeight);
+		DirtyLodNodes.Remove(Key);
+	}
+
+	if (LodStats.IsValidIndex(Key.Lod))
+	{
+		FVoxelLodStats& Stats = LodStats[Key.Lod];
+		Stats.NumChunks--;
+		Stats.NumTriangles -= Chunk.NumTriangles;
+		Stats.NumSections -= Chunk.NumSections;
+		Stats.MeshBytes -= Chunk.MeshBytes;
+	}
+
+	if (Chunk.Mesh)
+		ReleaseMeshComponent(Chunk.Mesh);
+
+	return true;
+}
 
-		// Turn our gradient into two solids that represent the ground and air. This prevents floating terrain from forming later.
-		auto VerticalSelect = NoiseKernel.select(Zero, One, VerticalGradient, NoiseKernel.constant(0.5), Zero);
+bool AVoxelTerrainActor::IsChunkNodeLoaded(const FVoxelChunkKey& Key) const
+{
+	return Key.Lod == 0 ? Chunks.Contains(Key.Coord) : LodNodes.Contains(Key);
+}
 
-		// This is the actual noise generator we'll be using.
-		// In this case I've gone with a simple fBm generator, which will create terrain that looks like smooth, rolling hills.
-		auto TerrainFractal = NoiseKernel.simplefBm(BasisTypes::BASIS_SIMPLEX, InterpolationTypes::INTERP_LINEAR, NoiseOctaves, NoiseFrequency, Seed);
+UProceduralMeshComponent* AVoxelTerrainActor::GetChunkMesh(int32 X, int32 Y, int32 Z) const
+{
+	const FVoxelLoadedChunk* Chunk = Chunks.Find(FIntVector(X, Y, Z));
+	return Chunk ? Chunk->Mesh : nullptr;
+}
 
-		// Scale and offset the generated noise value. 
-		// Scaling the noise makes the features bigger or smaller, and offsetting it will move the terrain up and down.
-		auto TerrainScale = NoiseKernel.scaleOffset(TerrainFractal, NoiseScale, NoiseOffset);
+FVoxelLodStats AVoxelTerrainActor::GetLodStats(int32 Lod) const
+{
+	FVoxelLodStats Stats = LodStats.IsValidIndex(Lod) ? LodStats[Lod] : FVoxelLodStats();
+	Stats.MeshMemoryMB = Stats.MeshBytes / (1024.f * 1024.f);
+	Stats.AverageGenerationMs = Stats.NumGenerated > 0 ? float(Stats.TotalGenerationSeconds * 1000.0 / Stats.NumGenerated) : 0.f;
+	return Stats;
+}
 
-		// Setting the Z scale of the fractal to 0 will effectively turn the fractal into a heightmap.
-		auto TerrainZScale = NoiseKernel.scaleZ(TerrainScale, Zero);
+bool AVoxelTerrainActor::SetVoxel(int32 X, int32 Y, int32 Z, uint8 Material)
+{
+	const FIntVector Voxel(X, Y, Z);
+	return SubmitEdit(FVoxelNetEdit::MakeBox(Voxel, Voxel, uint8(EVoxelEditMode::Fill), Material));
+}
 
-		// Finally, apply the Z offset we just calculated from the fractal to our ground plane.
-		auto PerturbGradient = NoiseKernel.translateZ(VerticalSelect, TerrainZScale);
+uint8 AVoxelTerrainActor::GetVoxel(int32 X, int32 Y, int32 Z) const
+{
+	if (!GenerationContext.IsValid())
+		return 0;
 
-		// Now we want to determine different materials based on a variety of factors.
-		// This is made easier by the fact that we're basically generating a heightmap.
+	const FIntVector VolumeVoxel = VoxelToVolume(FIntVector(X, Y, Z));
+	return VoxelVolume->getVoxel(VolumeVoxel.X, VolumeVoxel.Y, VolumeVoxel.Z).getMaterial();
+}
 
-		// For now our grass is always going to appear at the top level, so we don't need to do anything fancy.
-		auto GrassZ = NoiseKernel.subtract(HalfVerticalHeight, TerrainZScale);
+bool AVoxelTerrainActor::EditSphere(FVector Center, float Radius, EVoxelEditMode Mode, uint8 Material)
+{
+	// Work in voxels, relative to the terrain
+	const FVector LocalCenter = GetActorTransform().InverseTransformPosition(Center) / 100.f;
+	const float LocalRadius = Radius / (100.f * GetActorTransform().GetMaximumAxisScale());
 
-		// To generate pockets of ore we're going to need another noise generator.
-		auto OreFractal = NoiseKernel.simpleRidgedMultifractal(BasisTypes::BASIS_SIMPLEX, InterpolationTypes::INTERP_LINEAR, 2, 1.2 * NoiseFrequency, Seed);
-		auto FractalGradient = NoiseKernel.multiply(OreFractal, NoiseKernel.bias(VerticalGradient, NoiseKernel.constant(1.015)));
+	return SubmitEdit(FVoxelNetEdit::MakeSphere(LocalCenter, LocalRadius, uint8(Mode), Material));
+}
 
-		CNoiseExecutor TerrainExecutor(NoiseKernel);
+bool AVoxelTerrainActor::EditBox(FVector Min, FVector Max, EVoxelEditMode Mode, uint8 Material)
+{
+	const FVector LocalMin = GetActorTransform().InverseTransformPosition(Min) / 100.f;
+	const FVector LocalMax = GetActorTransform().InverseTransformPosition(Max) / 100.f;
 
-		// Now that we have our noise setup, let's loop over our chunk and apply it.
-		for (int x = region.getLowerX(); x <= region.getUpperX(); x++)
-		{
-			for (int y = region.getLowerY(); y <= region.getUpperY(); y++)
-			{
-				for (int z = region.getLowerZ(); z <= region.getUpperZ(); z++)
-				{
-					// Evaluate the noise
-					auto EvaluatedNoise = TerrainExecutor.evaluateScalar(x, y, z, PerturbGradient);
-					MaterialDensityPair88 Voxel;
-
-					// Determine the solidity of the voxel
-					bool bSolid = EvaluatedNoise > 0.5;
-
-					// Determine what material should be set on the voxel
-					// Air = 0
-					// Stone = 1
-					// Dirt = 2
-					// Grass = 3
-					// Ore = 4
-
-					int ActualGrassZ = FMath::FloorToInt(TerrainExecutor.evaluateScalar(x, y, z, GrassZ));
-					int DirtZ = ActualGrassZ - 1;
-					int DirtThickness = 10;
-
-					// Set all the solid blocks to something
-					if (bSolid)
-					{
-						auto EvaluatedOreFractal = TerrainExecutor.evaluateScalar(x, y, z, OreFractal);
-						auto EvaluatedFractalGradient = TerrainExecutor.evaluateScalar(x, y, z, FractalGradient);
-
-						// Place a cave
-						if (EvaluatedOreFractal > 1.88 && EvaluatedFractalGradient > 0.875)
-							bSolid = false;
-
-						// Make the top layer into grass
-						else if (z >= ActualGrassZ)
-						{
-							Voxel.setMaterial(3);
-						}
-
-						// Make a layer of dirt below the grass
-						else if (z <= DirtZ && z > (DirtZ - DirtThickness))
-						{
-							Voxel.setMaterial(2);
-						}
-
-						// Make the stone below the dirt
-						else
-						{
-							// Place an air pocket
-							if (EvaluatedOreFractal > 1.85)
-								bSolid = false;
-
-							// Place an underground dirt pocket
-							else if (EvaluatedOreFractal > 1.6 && EvaluatedOreFractal < 1.8)
-								Voxel.setMaterial(2);
-
-							// Place an ore deposit
-							else if (EvaluatedOreFractal < 1.5 || EvaluatedOreFractal > 1.848)
-								Voxel.setMaterial(4);
-
-							// Place stone
-							else
-								Voxel.setMaterial(1);
-						}
-					}
+	// The terrain might be rotated, so the corners can come out the other way around
+	const FVector BoxMin = LocalMin.ComponentMin(LocalMax);
+	const FVector BoxMax = LocalMin.ComponentMax(LocalMax);
 
-					Voxel.setDensity(FMath::FloorToInt(FMath::Clamp(bSolid ? EvaluatedNoise : 0.0, 0.0, 1.0) * Voxel.getMaxDensity()));
+	const FIntVector Lower(FMath::CeilToInt(BoxMin.X), FMath::CeilToInt(BoxMin.Y), FMath::CeilToInt(BoxMin.Z));
+	const FIntVector Upper(FMath::FloorToInt(BoxMax.X), FMath::FloorToInt(BoxMax.Y), FMath::FloorToInt(BoxMax.Z));
 
-					// Voxel position within a chunk always start from zero. So if a chunk represents region (4, 8, 12) to (11, 19, 15)
-					// then the valid chunk voxels are from (0, 0, 0) to (7, 11, 3). Hence we subtract the lower corner position of the
-					// region from the volume space position in order to get the chunk space position.
-					Chunk->setVoxel(x - region.getLowerX(), y - region.getLowerY(), z - region.getLowerZ(), Voxel);
-				}
-			}
-		}
+	return SubmitEdit(FVoxelNetEdit::MakeBox(Lower, Upper, uint8(Mode), Material));
+}
+
+FIntVector AVoxelTerrainActor::WorldToVoxel(FVector WorldLocation) const
+{
+	// Voxels are 100 units wide and centred on whole numbers
+	const FVector LocalLocation = GetActorTransform().InverseTransformPosition(WorldLocation) / 100.f;
+	return FIntVector(FMath::RoundToInt(LocalLocation.X), FMath::RoundToInt(LocalLocation.Y), FMath::RoundToInt(LocalLocation.Z));
+}
+
+FVector AVoxelTerrainActor::VoxelToWorld(FIntVector Voxel) const
+{
+	return GetActorTransform().TransformPosition(FVector(Voxel) * 100.f);
+}
+
+bool AVoxelTerrainActor::CanRunQueries() const
+{
+	// A client's volume is made again when the server's settings arrive, so until then it isn't the server's terrain
+	return GenerationContext.IsValid() && !(IsNetClient() && !bHasNetSettings);
+}
+
+bool AVoxelTerrainActor::RunSingleQuery(const FVoxelQuery& Query, FVoxelQueryHit& OutHit) const
+{
+	OutHit = FVoxelQueryHit();
+
+	if (!CanRunQueries())
+		return false;
+
+	VOXEL_TERRAIN_SCOPE(STAT_VoxelTerrain_Queries);
+	INC_DWORD_STAT(STAT_VoxelTerrain_QueriesAnswered);
+
+	const FVoxelTerrainQuery VoxelQuery(*VoxelVolume, VoxelToVolume(FIntVector::ZeroValue));
+	FVoxelQueryBatch::RunQuery(VoxelQuery, GetActorTransform(), Query, OutHit);
+	return OutHit.bHit;
+}
+
+bool AVoxelTerrainActor::RaycastVoxels(FVector Start, FVector End, FVoxelQueryHit& OutHit) const
+{
+	FVoxelQuery Query;
+	Query.Type = EVoxelQueryType::Raycast;
+	Query.Start = Start;
+	Query.End = End;
+	return RunSingleQuery(Query, OutHit);
+}
+
+bool AVoxelTerrainActor::GetSurfaceHeight(FVector Location, float MaxDistance, FVoxelQueryHit& OutHit) const
+{
+	FVoxelQuery Query;
+	Query.Type = EVoxelQueryType::SurfaceHeight;
+	Query.Start = Location;
+	Query.Distance = MaxDistance;
+	return RunSingleQuery(Query, OutHit);
+}
+
+bool AVoxelTerrainActor::OverlapsSolidSphere(FVector Center, float Radius) const
+{
+	FVoxelQuery Query;
+	Query.Type = EVoxelQueryType::OverlapSphere;
+	Query.Start = Center;
+	Query.Distance = Radius;
+
+	FVoxelQueryHit Hit;
+	return RunSingleQuery(Query, Hit);
+}
+
+bool AVoxelTerrainActor::OverlapsSolidBox(FVector Min, FVector Max) const
+{
+	FVoxelQuery Query;
+	Query.Type = EVoxelQueryType::OverlapBox;
+	Query.Start = Min;
+	Query.End = Max;
+
+	FVoxelQueryHit Hit;
+	return RunSingleQuery(Query, Hit);
+}
+
+void AVoxelTerrainActor::RunQueries(const TArray<FVoxelQuery>& Queries, TArray<FVoxelQueryHit>& OutResults) const
+{
+	if (!CanRunQueries() || Queries.Num() == 0)
+	{
+		OutResults.Reset();
+		OutResults.SetNum(Queries.Num());
+		return;
+	}
+
+	FVoxelQueryBatch Batch(*VoxelVolume, VoxelToVolume(FIntVector::ZeroValue));
+	Batch.TerrainTransform = GetActorTransform();
+	Batch.Queries = Queries;
+	Batch.Results.SetNum(Queries.Num());
+
+	// The same split the workers get, so each task has enough queries to be worth handing out
+	const int32 NumTasks = FMath::DivideAndRoundUp(Queries.Num(), FVoxelQueryBatch::QueriesPerTask);
+	ParallelFor(NumTasks, [&Batch](int32 TaskIndex)
+	{
+		const int32 First = TaskIndex * FVoxelQueryBatch::QueriesPerTask;
+		Batch.RunQueries(First, FMath::Min(First + FVoxelQueryBatch::QueriesPerTask, Batch.Queries.Num()));
+	});
+
+	OutResults = MoveTemp(Batch.Results);
+}
+
+int32 AVoxelTerrainActor::QueueQueries(const TArray<FVoxelQuery>& Queries)
+{
+	return QueueQueryBatch(Queries, [this](int32 BatchId, const TArray<FVoxelQueryHit>& Results)
+	{
+		OnQueriesComplete.Broadcast(BatchId, Results);
+	});
+}
+
+int32 AVoxelTerrainActor::QueueQueryBatch(const TArray<FVoxelQuery>& Queries, TFunction<void(int32 BatchId, const TArray<FVoxelQueryHit>& Results)> OnComplete)
+{
+	if (!CanRunQueries())
+		return INDEX_NONE;
+
+	TSharedRef<FVoxelQueryBatch, ESPMode::ThreadSafe> Batch = MakeShareable(new FVoxelQueryBatch(*VoxelVolume, VoxelToVolume(FIntVector::ZeroValue)));
+	Batch->BatchId = ++LastQueryBatchId;
+	Batch->TerrainTransform = GetActorTransform();
+	Batch->Queries = Queries;
+	Batch->Results.SetNum(Queries.Num());
+	Batch->OnComplete = MoveTemp(OnComplete);
+
+	const int32 NumTasks = FMath::DivideAndRoundUp(Queries.Num(), FVoxelQueryBatch::QueriesPerTask);
+	Batch->NumTasksRemaining.Set(NumTasks);
+	QueryBatchesInFlight++;
+
+	// Without a worker pool, or without any queries, the batch is answered right away. The results still arrive next frame, like they would from the workers.
+	if (!WorkerPool || NumTasks == 0)
+	{
+		Batch->RunQueries(0, Queries.Num());
+		GenerationContext->CompletedQueryBatches.Enqueue(Batch);
+		return Batch->BatchId;
+	}
+
+	TSharedRef<FVoxelGenerationContext, ESPMode::ThreadSafe> Context = GenerationContext.ToSharedRef();
+	for (int32 TaskIndex = 0; TaskIndex < NumTasks; TaskIndex++)
+	{
+		const int32 First = TaskIndex * FVoxelQueryBatch::QueriesPerTask;
+		const int32 Last = FMath::Min(First + FVoxelQueryBatch::QueriesPerTask, Queries.Num());
+		(new FAutoDeleteAsyncTask<FVoxelQueryTask>(Context, Batch, First, Last))->StartBackgroundTask(WorkerPool);
+	}
+
+	return Batch->BatchId;
+}
+
+void AVoxelTerrainActor::DeliverQueryResults()
+{
+	TSharedPtr<FVoxelQueryBatch, ESPMode::ThreadSafe> Batch;
+	while (GenerationContext->CompletedQueryBatches.Dequeue(Batch))
+	{
+		QueryBatchesInFlight--;
+
+		if (Batch->OnComplete)
+			Batch->OnComplete(Batch->BatchId, Batch->Results);
 	}
 }
 
-// Called when a chunk is paged out
-void VoxelTerrainPager::pageOut(const PolyVox::Region& region, PagedVolume<MaterialDensityPair88>::Chunk* Chunk)
+// FVoxelNetEdit::ApplyMode is given the edit modes as numbers
+static_assert(uint8(EVoxelEditMode::Carve) == 0 && uint8(EVoxelEditMode::Fill) == 1 && uint8(EVoxelEditMode::Paint) == 2, "FVoxelNetEdit::ApplyMode has to be updated to match EVoxelEditMode");
+
+bool AVoxelTerrainActor::IsNetClient() const
+{
+	return GetIsReplicated() && GetNetMode() == NM_Client;
+}
+
+bool AVoxelTerrainActor::IsReplicatingEdits() const
 {
-}
\ No newline at end of file
+	return HasAuthority() && GetIsReplicated() && GetNetMode() != NM_Standalone;
+}
+
+bool AVoxelTerrainActor::SubmitEdit(FVoxelNetEdit Edit)
+{
+	// Clients get every edit from the server, so one made here would only put them out of step
+	if (IsNetClient())
+	{
+		UE_LOG(LogVoxelTerrain, Warning, TEXT("%s is replicated, so it can only be edited on the server"), *GetName());
+		return false;
+	}
+
+	if (IsReplicatingEdits())
+	{
+		Edit.Sequence = ++NetEditSequence;
+		PendingNetEdits.Add(Edit);
+	}
+
+	return NetReplicator.ApplyEdit(Edit);
+}
+
+void AVoxelTerrainActor::SendPendingEdits()
+{
+	if (PendingNetEdits.Num() == 0)
+		return;
+
+	// Each batch is written from scratch, so a client can read it without the ones before it
+	FVoxelNetEditWriter Writer;
+
+	auto SendBatch = [this, &Writer]()
+	{
+		INC_DWORD_STAT_BY(STAT_VoxelTerrain_NetEditsSent, Writer.Num());
+		INC_DWORD_STAT_BY(STAT_VoxelTerrain_NetEditBytesSent, Writer.GetData().Num());
+
+		MulticastApplyEdits(Writer.GetData());
+		Writer.Reset();
+	};
+
+	for (const FVoxelNetEdit& Edit : PendingNetEdits)
+	{
+		Writer.Write(Edit);
+
+		if (Writer.GetData().Num() >= FVoxelNetCodec::MaxPayloadBytes)
+			SendBatch();
+	}
+
+	if (Writer.Num() > 0)
+		SendBatch();
+
+	PendingNetEdits.Reset();
+}
+
+void AVoxelTerrainActor::MulticastApplyEdits_Implementation(const TArray<uint8>& Data)
+{
+	// The server applied them as they were made
+	if (HasAuthority())
+		return;
+
+	// Edits that arrive before the snapshot is in are held back until it is
+	if (!NetReplicator.ReceiveEdits(Data.GetData(), Data.Num()))
+	{
+		UE_LOG(LogVoxelTerrain, Error, TEXT("Received a corrupt batch of edits for %s"), *GetName());
+	}
+}
+
+void AVoxelTerrainActor::UpdateNetClients()
+{
+	// A component goes away with its player controller when the client leaves
+	NetClients.RemoveAll([](UVoxelTerrainNetComponent* NetClient) { return NetClient == nullptr || NetClient->IsPendingKill(); });
+
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		APlayerController* PlayerController = It->Get();
+
+		// A listen server's own player is looking at the server's voxels
+		if (!PlayerController || PlayerController->IsLocalController())
+			continue;
+
+		if (NetClients.ContainsByPredicate([PlayerController](UVoxelTerrainNetComponent* NetClient) { return NetClient->GetOwner() == PlayerController; }))
+			continue;
+
+		UVoxelTerrainNetComponent* NetClient = NewObject<UVoxelTerrainNetComponent>(PlayerController);
+		NetClient->SetTerrain(this);
+		NetClient->RegisterComponent();
+		NetClients.Add(NetClient);
+	}
+}
+
+void AVoxelTerrainActor::WriteNetSnapshotChunk(const FIntVector& ChunkCoord, TArray<uint8>& OutData)
+{
+	if (GenerationContext.IsValid())
+		NetReplicator.WriteSnapshotChunk(ChunkCoord, OutData);
+}
+
+void AVoxelTerrainActor::ReceiveNetSnapshot(const TArray<uint8>& Data)
+{
+	NetReplicator.ReceiveSnapshot(Data.GetData(), Data.Num());
+
+	ProcessNetSnapshot();
+}
+
+void AVoxelTerrainActor::FinishNetSnapshot()
+{
+	NetReplicator.FinishSnapshot();
+
+	ProcessNetSnapshot();
+}
+
+void AVoxelTerrainActor::ProcessNetSnapshot()
+{
+	// The baselines can't be generated until the settings are in
+	if (!bHasNetSettings)
+		return;
+
+	const bool bWasWaitingForSnapshot = NetReplicator.IsWaitingForSnapshot();
+
+	if (!NetReplicator.ApplySnapshot())
+	{
+		UE_LOG(LogVoxelTerrain, Error, TEXT("Received a corrupt snapshot for %s"), *GetName());
+	}
+
+	if (bWasWaitingForSnapshot && !NetReplicator.IsWaitingForSnapshot())
+	{
+		UE_LOG(LogVoxelTerrain, Log, TEXT("%s caught up from a snapshot of %d chunks in %lld bytes, with %d edits made while it was sent"),
+			*GetName(), NetReplicator.GetNumSnapshotChunks(), NetReplicator.GetNumSnapshotBytes(), NetReplicator.GetNumHeldBackEdits());
+	}
+}
+
+void AVoxelTerrainActor::OnRep_NetSettings()
+{
+	// The settings are only sent once. Taking them again would throw away everything the terrain has generated and been sent.
+	if (bHasNetSettings || !NetSettings.bIsSet)
+		return;
+
+	bIsSpherical = NetSettings.bIsSpherical;
+	Seed = NetSettings.Seed;
+	NoiseOctaves = NetSettings.NoiseOctaves;
+	NoiseFrequency = NetSettings.NoiseFrequency;
+	NoiseScale = NetSettings.NoiseScale;
+	NoiseOffset = NetSettings.NoiseOffset;
+	TerrainHeight = NetSettings.TerrainHeight;
+	MaxChunksX = NetSettings.MaxChunks.X;
+	MaxChunksY = NetSettings.MaxChunks.Y;
+	MaxChunksZ = NetSettings.MaxChunks.Z;
+	bUseBatchedNoise = NetSettings.bUseBatchedNoise;
+	bHasNetSettings = true;
+
+	// Nothing has been generated yet, so the volume can just be made again with the server's settings
+	InitializeGeneration();
+
+	if (bWaitingForNetSettings)
+	{
+		bWaitingForNetSettings = false;
+		StartGeneration();
+	}
+
+	// Any of the snapshot that got here first can go in now
+	ProcessNetSnapshot();
+}
+
+void AVoxelTerrainActor::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	// The settings never change once the terrain has started, so they are only sent when a client first sees it
+	DOREPLIFETIME_CONDITION_NOTIFY(AVoxelTerrainActor, NetSettings, COND_InitialOnly, REPNOTIFY_Always);
+}
+
+void AVoxelTerrainActor::MarkVoxelsDirty(const FIntVector& Lower, const FIntVector& Upper)
+{
+	FIntVector LowerChunk, UpperChunk;
+	FVoxelChunkTraits::GetChunksReadingVoxels(Lower, Upper, LowerChunk, UpperChunk, SurfaceExtractor == EVoxelSurfaceExtractor::MarchingCubes);
+
+	FVoxelMeshCache* MeshCache = GenerationContext->MeshCache.Get();
+
+	for (int32 Z = LowerChunk.Z; Z <= UpperChunk.Z; Z++)
+	{
+		for (int32 Y = LowerChunk.Y; Y <= UpperChunk.Y; Y++)
+		{
+			for (int32 X = LowerChunk.X; X <= UpperChunk.X; X++)
+			{
+				// The baked mesh is out of date whether or not the chunk is loaded.
+				// This happens before the remesh is sent off, so the remesh can't read the old mesh back.
+				const FIntVector ChunkCoord(X, Y, Z);
+				if (MeshCache)
+					MeshCache->InvalidateChunk(ChunkCoord);
+
+				// Chunks that are still being generated might have read the voxels from before the edit
+				if (Chunks.Contains(ChunkCoord) || QueuedChunks.Contains(FVoxelChunkKey(ChunkCoord, 0)))
+					DirtyChunks.Add(ChunkCoord);
+			}
+		}
+	}
+}
+
+void AVoxelTerrainActor::RemeshDirtyChunks()
+{
+	for (auto It = DirtyChunks.CreateIterator(); It; ++It)
+	{
+		const FVoxelChunkKey Key(*It, 0);
+
+		// Wait for the chunk to come back from the workers, then remesh it with whatever has been edited since
+		if (QueuedChunks.Contains(Key))
+			continue;
+
+		It.RemoveCurrent();
+		RemeshChunkNode(Key);
+	}
+
+	for (auto It = DirtyLodNodes.CreateIterator(); It; ++It)
+	{
+		const FVoxelChunkKey Key = *It;
+
+		if (QueuedChunks.Contains(Key))
+			continue;
+
+		It.RemoveCurrent();
+		RemeshChunkNode(Key);
+	}
+}
+
+void AVoxelTerrainActor::RemeshChunkNode(const FVoxelChunkKey& Key)
+{
+	if (!IsChunkNodeLoaded(Key))
+		return;
+
+	// A chunk that is still buried only needs its visibility again, in case the edit has opened it up
+	FVoxelChunkRequest Request = MakeChunkRequest(Key);
+	if (Key.Lod == 0 && UnmeshedChunks.Contains(Key.Coord))
+		Request.bBuildMesh = false;
+
+	TSharedRef<FVoxelGenerationContext, ESPMode::ThreadSafe> Context = GenerationContext.ToSharedRef();
+
+	// Without a worker pool there is nothing to queue on, so just do it now
+	if (!WorkerPool)
+	{
+		FVoxelChunkMeshData MeshData;
+		Context->BuildChunkMesh(Request, MeshData);
+
+		if (MeshData.bHasMesh)
+			UpdateChunkComponent(MeshData);
+
+		if (MeshData.bHasCollision)
+			UpdateChunkCollision(MeshData);
+
+		if (MeshData.bHasVisibility)
+			UpdateChunkVisibility(MeshData);
+
+		return;
+	}
+
+	// These skip the pending chunks, so an edit shows up as soon as a worker is free
+	QueuedChunks.Add(Key);
+	ChunksInFlight++;
+	(new FAutoDeleteAsyncTask<FVoxelChunkGenerationTask>(Context, Request))->StartBackgroundTask(WorkerPool);
+}
+
+void AVoxelTerrainActor::SetSurfaceExtractor(EVoxelSurfaceExtractor NewSurfaceExtractor)
+{
+	if (NewSurfaceExtractor == SurfaceExtractor)
+		return;
+
+	SurfaceExtractor = NewSurfaceExtractor;
+
+	if (!GenerationContext.IsValid())
+		return;
+
+	// Chunks that are still with the workers were requested with the old extractor, so they are remeshed again once they're back.
+	// Anything still waiting for a worker is requested when it is handed out, so it gets the new one anyway.
+	for (const auto& Chunk : Chunks)
+		DirtyChunks.Add(Chunk.Key);
+
+	for (const auto& Node : LodNodes)
+		DirtyLodNodes.Add(Node.Key);
+
+	for (const FVoxelChunkKey& Key : QueuedChunks)
+	{
+		if (Key.Lod == 0)
+			DirtyChunks.Add(Key.Coord);
+	}
+}
+
+FIntVector AVoxelTerrainActor::VoxelToVolume(const FIntVector& Voxel) const
+{
+	// Flat terrain is moved by the MaxChunks offset. This and the 31 voxel shift are in the 32 voxel chunks the terrain used to be
+	// generated in, so the world stays where it was whatever the chunk size is.
+	const FIntVector NoiseOffset = bIsSpherical ? FIntVector::ZeroValue : FIntVector(MaxChunksX, MaxChunksY, MaxChunksZ) * 32;
+	return Voxel + NoiseOffset - FIntVector(31);
+}
+
+void AVoxelTerrainActor::AddStreamingViewer(AActor* Viewer)
+{
+	if (Viewer)
+	{
+		StreamingViewers.AddUnique(Viewer);
+		LastViewerChunks.Empty();
+	}
+}
+
+void AVoxelTerrainActor::RemoveStreamingViewer(AActor* Viewer)
+{
+	StreamingViewers.Remove(Viewer);
+	LastViewerChunks.Empty();
+}
+
+void AVoxelTerrainActor::AddCollisionActor(AActor* Actor)
+{
+	if (Actor)
+	{
+		CollisionActors.AddUnique(Actor);
+		LastCollisionActorChunks.Empty();
+	}
+}
+
+void AVoxelTerrainActor::RemoveCollisionActor(AActor* Actor)
+{
+	CollisionActors.Remove(Actor);
+	LastCollisionActorChunks.Empty();
+}
+
+int32 AVoxelTerrainActor::BakeMeshCache(FIntVector LowerChunk, FIntVector UpperChunk, bool bRebuildAll)
+{
+	// Commandlets never initialize the actor's components
+	if (!GenerationContext.IsValid())
+		InitializeGeneration();
+
+	// Baking doesn't need the terrain to read from the cache
+	if (!GenerationContext->MeshCache.IsValid())
+	{
+		GenerationContext->MeshCache = MakeShareable(new FVoxelMeshCache(FPaths::Combine(GetSaveDirectory(), TEXT("Meshes")), FVoxelChunkTraits::Size, GetMeshCacheHash()));
+		MeshCacheSurfaceExtractor = SurfaceExtractor;
+	}
+
+	// The cache is keyed on the extractor it was opened with, so meshes from another one can't go in it
+	if (SurfaceExtractor != MeshCacheSurfaceExtractor)
+	{
+		UE_LOG(LogVoxelTerrain, Warning, TEXT("Can't bake %s: the surface extractor has changed since its mesh cache was opened"), *GetName());
+		return 0;
+	}
+
+	FVoxelMeshCache& MeshCache = *GenerationContext->MeshCache;
+
+	// The bake gets a volume of its own without the chunk store, so the chunks saved in a game and anything edited since the terrain
+	// started never end up in the cache
+	TSharedRef<FVoxelGenerationContext, ESPMode::ThreadSafe> Context = CreateGenerationContext(false);
+
+	// Edited chunks have been dropped from the cache, so this bakes them again from the noise along with anything that was never baked.
+	// The terrain doesn't read those back while it has saved voxels for them.
+	// Every chunk is baked with collision, since whether it gets used depends on where the collision actors end up.
+	TArray<FVoxelChunkRequest> Requests;
+	for (int32 Z = LowerChunk.Z; Z <= UpperChunk.Z; Z++)
+	{
+		for (int32 Y = LowerChunk.Y; Y <= UpperChunk.Y; Y++)
+		{
+			for (int32 X = LowerChunk.X; X <= UpperChunk.X; X++)
+			{
+				if (!bRebuildAll && MeshCache.HasChunk(FIntVector(X, Y, Z)))
+					continue;
+
+				FVoxelChunkRequest Request = MakeChunkRequest(X, Y, Z);
+				Request.bBuildCollision = true;
+				Request.bBuildVisibility = true;
+				Request.bUseMeshCache = false;
+				Request.Epoch = Context->Epoch.GetValue();
+				Requests.Add(Request);
+			}
+		}
+	}
+
+	UE_LOG(LogVoxelTerrain, Log, TEXT("Baking %d chunks of %s into %s"), Requests.Num(), *GetName(), *MeshCache.GetDirectory());
+
+	// The chunks are baked in batches so there is some progress to report on large ranges
+	const int32 BatchSize = 256;
+	const double StartTime = FPlatformTime::Seconds();
+
+	for (int32 BatchStart = 0; BatchStart < Requests.Num(); BatchStart += BatchSize)
+	{
+		const int32 NumInBatch = FMath::Min(BatchSize, Requests.Num() - BatchStart);
+
+		ParallelFor(NumInBatch, [&Context, &MeshCache, &Requests, BatchStart](int32 Index)
+		{
+			const FVoxelChunkRequest& Request = Requests[BatchStart + Index];
+
+			TSharedPtr<FVoxelChunkMeshData, ESPMode::ThreadSafe> MeshData = Context->AcquireMeshData();
+			Context->BuildChunkMesh(Request, *MeshData);
+
+			if (!MeshData->bCancelled)
+				MeshCache.WriteChunk(Request.ChunkCoord, *MeshData);
+
+			Context->ReleaseMeshData(MeshData);
+		});
+
+		UE_LOG(LogVoxelTerrain, Log, TEXT("Baked %d of %d chunks (%.1fs)"), BatchStart + NumInBatch, Requests.Num(), FPlatformTime::Seconds() - StartTime);
+	}
+
+	MeshCache.Flush();
+
+	return Requests.Num();
+}
+
+FVoxelChunkRequest AVoxelTerrainActor::MakeChunkRequest(int32 X, int32 Y, int32 Z) const
+{
+	// Chunks tile the volume exactly. The extractors read one voxel of apron below the region, which belongs to the chunk before.
+	const FIntVector FirstVoxel = FVoxelChunkTraits::ChunkToVoxel(FIntVector(X, Y, Z));
+	const FIntVector Lower = VoxelToVolume(FirstVoxel);
+	const FIntVector Upper = Lower + FIntVector(FVoxelChunkTraits::Size - 1);
+
+	FVoxelChunkRequest Request;
+	Request.ChunkCoord = FIntVector(X, Y, Z);
+
+	// Spherical terrains need to be able to generate chunks on the Z axis.
+	// If you're not working with spherical terrain in your project you might consider
+	// removing the Z axis from this function.
+	Request.Region = PolyVox::Region(Vector3DInt32(Lower.X, Lower.Y, Lower.Z), Vector3DInt32(Upper.X, Upper.Y, Upper.Z));
+
+	// Get the offset location of the chunk to apply to the mesh
+	Request.OffsetLocation = FVector(FirstVoxel);
+
+	Request.Epoch = GenerationContext->Epoch.GetValue();
+
+	// Collision is built in the same pass as the mesh when the chunk is close enough to need it
+	Request.bBuildCollision = IsCollisionWanted(Request.ChunkCoord);
+
+	Request.bBuildVisibility = bHideBuriedChunks;
+
+	// The baked meshes are only any use while the terrain is using the extractor they were baked with
+	Request.SurfaceExtractor = SurfaceExtractor;
+	Request.bUseMeshCache = SurfaceExtractor == MeshCacheSurfaceExtractor;
+
+	return Request;
+}
+
+FVoxelChunkRequest AVoxelTerrainActor::MakeChunkRequest(const FVoxelChunkKey& Key) const
+{
+	if (Key.Lod == 0)
+		return MakeChunkRequest(Key.Coord.X, Key.Coord.Y, Key.Coord.Z);
+
+	// A node covers 2^Lod chunks along each axis, starting with this one
+	const int32 NodeSize = 1 << Key.Lod;
+	const FIntVector FirstChunk = Key.Coord * NodeSize;
+
+	// The same mapping from mesh positions to the volume as above
+	const FIntVector FirstVoxel = FVoxelChunkTraits::ChunkToVoxel(FirstChunk);
+	const FIntVector Lower = VoxelToVolume(FirstVoxel);
+	const FIntVector Upper = Lower + FIntVector(NodeSize * FVoxelChunkTraits::Size - 1);
+
+	FVoxelChunkRequest Request;
+	Request.ChunkCoord = Key.Coord;
+	Request.Lod = Key.Lod;
+	Request.Region = PolyVox::Region(Vector3DInt32(Lower.X, Lower.Y, Lower.Z), Vector3DInt32(Upper.X, Upper.Y, Upper.Z));
+	Request.OffsetLocation = FVector(FirstVoxel);
+	Request.SurfaceExtractor = SurfaceExtractor;
+	Request.Epoch = GenerationContext->Epoch.GetValue();
+
+	return Request;
+}
+
+bool AVoxelTerrainActor::CreateChunkComponent(const FVoxelChunkMeshData& MeshData)
+{
+	const FVoxelChunkKey Key(MeshData.ChunkCoord, MeshData.Lod);
+	if (IsChunkNodeLoaded(Key))
+		return false;
+
+	// Empty chunks are still remembered, so they aren't generated again
+	FVoxelLoadedChunk& Chunk = Key.Lod == 0 ? Chunks.Add(Key.Coord) : LodNodes.Add(Key);
+
+	// Every new chunk can bury the chunks behind it, or open up a way to them
+	if (Key.Lod == 0)
+	{
+		if (MeshData.bHasVisibility)
+			Chunk.Visibility = MeshData.Visibility;
+
+		bChunkVisibilityChanged = true;
+	}
+
+	if (LodStats.Num() <= Key.Lod)
+		LodStats.SetNum(Key.Lod + 1);
+
+	FVoxelLodStats& Stats = LodStats[Key.Lod];
+	Stats.NumChunks++;
+	Stats.NumGenerated++;
+	Stats.TotalGenerationSeconds += MeshData.GenerationSeconds;
+
+	// The collision mesh covers materials that have no render section, so a chunk can have collision without any triangles to draw
+	if (MeshData.bHasCollision)
+		UpdateChunkCollision(MeshData);
+
+	if (MeshData.IsEmpty())
+	{
+		WriteChunkCsvRow(MeshData, false, 0);
+		return false;
+	}
+
+	const double CreateStartTime = FPlatformTime::Seconds();
+
+	// Reuse a mesh component from an unloaded chunk if there is one
+	UProceduralMeshComponent* Mesh = AcquireMeshComponent();
+	Chunk.Mesh = Mesh;
+
+	if (Key.Lod == 0 && IsChunkBuried(Key.Coord))
+		Mesh->SetVisibility(false);
+	Chunk.MeshBytes = MeshData.GetMeshBytes();
+	Chunk.NumTriangles = MeshData.GetNumTriangles();
+	Chunk.NumVertices = MeshData.GetNumVertices();
+	Chunk.NumSections = MeshData.GetNumSections();
+	MeshMemoryBytes += Chunk.MeshBytes;
+	Stats.NumTriangles += Chunk.NumTriangles;
+	Stats.NumSections += Chunk.NumSections;
+	Stats.MeshBytes += Chunk.MeshBytes;
+	AddLoadedChunkStats(Chunk);
+
+	{
+		VOXEL_TERRAIN_SCOPE(STAT_VoxelTerrain_CreateMeshSections);
+
+		for (int32 SectionIndex = 0; SectionIndex < MeshData.Sections.Num() && SectionIndex < TerrainMaterials.Num(); SectionIndex++)
+		{
+			const FVoxelChunkMeshSection& Section = MeshData.Sections[SectionIndex];
+
+			// Finally create the mesh. The collision lives on its own component, so none is cooked for the render triangles.
+			Mesh->CreateMeshSection(SectionIndex, Section.Vertices, Section.Indices, Section.Normals, Section.UV0, Section.Colors, Section.Tangents, false);
+			Mesh->SetMaterial(SectionIndex, GetSectionMaterial(SectionIndex));
+		}
+	}
+
+	WriteChunkCsvRow(MeshData, false, FPlatformTime::Seconds() - CreateStartTime);
+	return true;
+}
+
+// Returns true if a section built after an edit has the same triangles as the one the mesh component already has.
+// The vertices can still have moved.
+static bool HasSameTriangles(const FProcMeshSection& OldSection, const FVoxelChunkMeshSection& Section)
+{
+	static_assert(sizeof(uint32) == sizeof(int32), "The index buffers are compared as raw memory");
+
+	return OldSection.ProcVertexBuffer.Num() == Section.Vertices.Num()
+		&& OldSection.ProcIndexBuffer.Num() == Section.Indices.Num()
+		&& FMemory::Memcmp(OldSection.ProcIndexBuffer.GetData(), Section.Indices.GetData(), Section.Indices.Num() * sizeof(int32)) == 0;
+}
+
+// Returns true if every vertex of a section is the same as in the mesh component. The tangents follow from the normals, so they aren't compared.
+// Single section meshes can change material without moving anything, so their colors are.
+static bool HasSameVertices(const FProcMeshSection& OldSection, const FVoxelChunkMeshSection& Section)
+{
+	const bool bHasColors = Section.Colors.Num() == Section.Vertices.Num();
+
+	for (int32 i = 0; i < Section.Vertices.Num(); i++)
+	{
+		const FProcMeshVertex& OldVertex = OldSection.ProcVertexBuffer[i];
+
+		if (OldVertex.Position != Section.Vertices[i] || OldVertex.Normal != Section.Normals[i] || OldVertex.UV0 != Section.UV0[i])
+			return false;
+
+		if (bHasColors && OldVertex.Color != Section.Colors[i])
+			return false;
+	}
+
+	return true;
+}
+
+void AVoxelTerrainActor::UpdateChunkComponent(const FVoxelChunkMeshData& MeshData)
+{
+	FVoxelLoadedChunk* Chunk = MeshData.Lod == 0 ? Chunks.Find(MeshData.ChunkCoord) : LodNodes.Find(FVoxelChunkKey(MeshData.ChunkCoord, MeshData.Lod));
+	if (!Chunk)
+		return;
+
+	FVoxelLodStats& Stats = LodStats[MeshData.Lod];
+	MeshMemoryBytes -= Chunk->MeshBytes;
+	Stats.MeshBytes -= Chunk->MeshBytes;
+	Stats.NumTriangles -= Chunk->NumTriangles;
+	Stats.NumSections -= Chunk->NumSections;
+	RemoveLoadedChunkStats(*Chunk);
+
+	Chunk->MeshBytes = MeshData.GetMeshBytes();
+	Chunk->NumTriangles = MeshData.GetNumTriangles();
+	Chunk->NumVertices = MeshData.GetNumVertices();
+	Chunk->NumSections = MeshData.GetNumSections();
+	MeshMemoryBytes += Chunk->MeshBytes;
+	Stats.MeshBytes += Chunk->MeshBytes;
+	Stats.NumTriangles += Chunk->NumTriangles;
+	Stats.NumSections += Chunk->NumSections;
+	AddLoadedChunkStats(*Chunk);
+
+	// The edit might have dug out everything there was
+	if (MeshData.IsEmpty())
+	{
+		if (Chunk->Mesh)
+			ReleaseMeshComponent(Chunk->Mesh);
+
+		Chunk->Mesh = nullptr;
+		WriteChunkCsvRow(MeshData, true, 0);
+		return;
+	}
+
+	VOXEL_TERRAIN_SCOPE(STAT_VoxelTerrain_CreateMeshSections);
+	const double CreateStartTime = FPlatformTime::Seconds();
+
+	if (!Chunk->Mesh)
+	{
+		Chunk->Mesh = AcquireMeshComponent();
+
+		if (MeshData.Lod == 0 && IsChunkBuried(MeshData.ChunkCoord))
+			Chunk->Mesh->SetVisibility(false);
+	}
+
+	UProceduralMeshComponent* Mesh = Chunk->Mesh;
+
+	for (int32 SectionIndex = 0; SectionIndex < MeshData.Sections.Num() && SectionIndex < TerrainMaterials.Num(); SectionIndex++)
+	{
+		const FVoxelChunkMeshSection& Section = MeshData.Sections[SectionIndex];
+		const FProcMeshSection* OldSection = Mesh->GetProcMeshSection(SectionIndex);
+
+		if (Section.Indices.Num() == 0)
+		{
+			if (OldSection && OldSection->ProcIndexBuffer.Num() > 0)
+				Mesh->ClearMeshSection(SectionIndex);
+
+			continue;
+		}
+
+		// Most edits only touch one material, so the other sections usually come out exactly the same
+		if (OldSection && HasSameTriangles(*OldSection, Section))
+		{
+			if (!HasSameVertices(*OldSection, Section))
+				Mesh->UpdateMeshSection(SectionIndex, Section.Vertices, Section.Normals, Section.UV0, Section.Colors, Section.Tangents);
+
+			continue;
+		}
+
+		// UpdateMeshSection can't change the triangles, so the section has to be created again
+		Mesh->CreateMeshSection(SectionIndex, Section.Vertices, Section.Indices, Section.Normals, Section.UV0, Section.Colors, Section.Tangents, false);
+		Mesh->SetMaterial(SectionIndex, GetSectionMaterial(SectionIndex));
+	}
+
+	WriteChunkCsvRow(MeshData, true, FPlatformTime::Seconds() - CreateStartTime);
+}
+
+void AVoxelTerrainActor::UpdateChunkVisibility(const FVoxelChunkMeshData& MeshData)
+{
+	FVoxelLoadedChunk* Chunk = Chunks.Find(MeshData.ChunkCoord);
+	if (!Chunk || Chunk->Visibility == MeshData.Visibility)
+		return;
+
+	Chunk->Visibility = MeshData.Visibility;
+	bChunkVisibilityChanged = true;
+}
+
+void AVoxelTerrainActor::HideBuriedChunks(const TArray<FIntVector>& ViewerChunks)
+{
+	// Nothing changes until a viewer moves into another chunk, or a chunk comes, goes or is opened up
+	if (!bChunkVisibilityChanged && ViewerChunks == LastVisibilityViewerChunks)
+		return;
+
+	VOXEL_TERRAIN_SCOPE(STAT_VoxelTerrain_CullChunks);
+
+	bChunkVisibilityChanged = false;
+	LastVisibilityViewerChunks = ViewerChunks;
+
+	// The walk covers every loaded chunk, and one more layer around them. The chunks in there that haven't loaded yet are open,
+	// so the walk can go around the edge of what is loaded, but it can't wander off forever.
+	FIntVector Lower = ViewerChunks[0];
+	FIntVector Upper = ViewerChunks[0];
+
+	auto AddToBounds = [&Lower, &Upper](const FIntVector& ChunkCoord)
+	{
+		Lower = FIntVector(FMath::Min(Lower.X, ChunkCoord.X), FMath::Min(Lower.Y, ChunkCoord.Y), FMath::Min(Lower.Z, ChunkCoord.Z));
+		Upper = FIntVector(FMath::Max(Upper.X, ChunkCoord.X), FMath::Max(Upper.Y, ChunkCoord.Y), FMath::Max(Upper.Z, ChunkCoord.Z));
+	};
+
+	for (const FIntVector& ViewerChunk : ViewerChunks)
+		AddToBounds(ViewerChunk);
+
+	for (const TPair<FIntVector, FVoxelLoadedChunk>& Pair : Chunks)
+		AddToBounds(Pair.Key);
+
+	VisibleLowerBound = Lower - FIntVector(1);
+	VisibleUpperBound = Upper + FIntVector(1);
+
+	FVoxelChunkVisibility::FindVisibleChunks(ViewerChunks, VisibleLowerBound, VisibleUpperBound, [this](const FIntVector& ChunkCoord)
+	{
+		const FVoxelLoadedChunk* Chunk = Chunks.Find(ChunkCoord);
+		return Chunk ? Chunk->Visibility : FVoxelChunkVisibility();
+	}, VisibleChunks);
+
+	NumHiddenChunks = 0;
+
+	for (TPair<FIntVector, FVoxelLoadedChunk>& Pair : Chunks)
+	{
+		const bool bVisible = VisibleChunks.Contains(Pair.Key);
+		if (!bVisible)
+			NumHiddenChunks++;
+
+		UProceduralMeshComponent* Mesh = Pair.Value.Mesh;
+		if (Mesh && Mesh->IsVisible() != bVisible)
+			Mesh->SetVisibility(bVisible);
+
+		// A chunk that was buried when it was generated is meshed now that it can be seen
+		if (bVisible && UnmeshedChunks.Remove(Pair.Key) > 0)
+			DirtyChunks.Add(Pair.Key);
+	}
+}
+
+bool AVoxelTerrainActor::IsChunkBuried(const FIntVector& ChunkCoord) const
+{
+	if (!bHideBuriedChunks || VisibleChunks.Num() == 0)
+		return false;
+
+	const bool bCovered = ChunkCoord.X >= VisibleLowerBound.X && ChunkCoord.Y >= VisibleLowerBound.Y && ChunkCoord.Z >= VisibleLowerBound.Z
+		&& ChunkCoord.X <= VisibleUpperBound.X && ChunkCoord.Y <= VisibleUpperBound.Y && ChunkCoord.Z <= VisibleUpperBound.Z;
+
+	return bCovered && !VisibleChunks.Contains(ChunkCoord);
+}
+
+void AVoxelTerrainActor::WriteChunkCsvRow(const FVoxelChunkMeshData& MeshData, bool bRemesh, double CreateSeconds)
+{
+	if (!ChunkCsv.IsValid())
+		return;
+
+	const FString Row = FString::Printf(TEXT("%d,%d,%d,%d,%d,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%d,%d,%d,%lld,%d\n"),
+		MeshData.ChunkCoord.X, MeshData.ChunkCoord.Y, MeshData.ChunkCoord.Z, MeshData.Lod, bRemesh ? 1 : 0, MeshData.bSkipped ? 1 : 0, MeshData.bCached ? 1 : 0,
+		MeshData.GenerationSeconds * 1000.0, MeshData.NoiseSeconds * 1000.0, MeshData.ExtractSeconds * 1000.0, MeshData.MeshBuildSeconds * 1000.0, MeshData.CollisionSeconds * 1000.0, CreateSeconds * 1000.0,
+		MeshData.GetNumTriangles(), MeshData.GetNumVertices(), MeshData.GetNumSections(), MeshData.GetMeshBytes(), MeshData.CollisionIndices.Num() / 3);
+
+	FTCHARToUTF8 Utf8Row(*Row);
+	ChunkCsv->Serialize((void*)Utf8Row.Get(), Utf8Row.Length());
+}
+
+UProceduralMeshComponent* AVoxelTerrainActor::AcquireMeshComponent()
+{
+	if (MeshPool.Num() > 0)
+	{
+		UProceduralMeshComponent* Mesh = MeshPool.Pop(false);
+		Mesh->SetVisibility(true);
+		return Mesh;
+	}
+
+	// Create a new mesh component to render and add it to the list of meshes.
+	UProceduralMeshComponent* Mesh = NewObject<UProceduralMeshComponent>(this, FName(*FString::Printf(TEXT("VoxelMesh_%d"), NumMeshComponentsCreated++)));
+	Mesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Mesh->RegisterComponent();
+	Mesh->AttachToComponent(GetRootComponent(), FAttachmentTransformRules(EAttachmentRule::KeepRelative, false));
+
+	return Mesh;
+}
+
+void AVoxelTerrainActor::ReleaseMeshComponent(UProceduralMeshComponent* Mesh)
+{
+	// Don't keep more spare components around than a reasonable burst of unloads needs
+	static const int32 MaxPooledMeshComponents = 128;
+
+	if (MeshPool.Num() >= MaxPooledMeshComponents)
+	{
+		Mesh->DestroyComponent();
+		return;
+	}
+
+	// Clearing the sections frees the buffers and the render state, but keeps the component registered
+	Mesh->ClearAllMeshSections();
+	Mesh->SetVisibility(false);
+	MeshPool.Add(Mesh);
+}
+
+UProceduralMeshComponent* AVoxelTerrainActor::AcquireCollisionComponent()
+{
+	if (CollisionMeshPool.Num() > 0)
+		return CollisionMeshPool.Pop(false);
+
+	UProceduralMeshComponent* Mesh = NewObject<UProceduralMeshComponent>(this, FName(*FString::Printf(TEXT("VoxelCollision_%d"), NumMeshComponentsCreated++)));
+
+	// Collision components are never drawn, so they don't get a scene proxy and their sections cost nothing to render
+	Mesh->SetVisibility(false);
+
+	// The collision is cooked on a background thread, and the old collision stays in place until the new one is ready.
+	// So a chunk can become collidable, or have its collision changed by an edit, without stalling the game thread.
+	Mesh->bUseAsyncCooking = true;
+
+	Mesh->RegisterComponent();
+	Mesh->AttachToComponent(GetRootComponent(), FAttachmentTransformRules(EAttachmentRule::KeepRelative, false));
+
+	return Mesh;
+}
+
+void AVoxelTerrainActor::ReleaseCollisionComponent(UProceduralMeshComponent* Mesh)
+{
+	// Only the chunks around the collision actors have these, so not many are needed
+	static const int32 MaxPooledCollisionComponents = 32;
+
+	if (CollisionMeshPool.Num() >= MaxPooledCollisionComponents)
+	{
+		Mesh->DestroyComponent();
+		return;
+	}
+
+	// Clearing the sections removes the collision from the physics scene
+	Mesh->ClearAllMeshSections();
+	CollisionMeshPool.Add(Mesh);
+}
+
+void AVoxelTerrainActor::UpdateChunkCollision(const FVoxelChunkMeshData& MeshData)
+{
+	// The collision actors might have moved away while this was being built
+	FVoxelLoadedChunk* Chunk = Chunks.Find(MeshData.ChunkCoord);
+	if (!Chunk || !IsCollisionWanted(MeshData.ChunkCoord))
+		return;
+
+	VOXEL_TERRAIN_SCOPE(STAT_VoxelTerrain_CreateCollisionSections);
+
+	if (!CollisionChunks.Contains(MeshData.ChunkCoord))
+	{
+		CollisionChunks.Add(MeshData.ChunkCoord);
+		INC_DWORD_STAT(STAT_VoxelTerrain_CollisionChunks);
+	}
+
+	DEC_DWORD_STAT_BY(STAT_VoxelTerrain_CollisionTriangles, Chunk->NumCollisionTriangles);
+	Chunk->NumCollisionTriangles = MeshData.CollisionIndices.Num() / 3;
+	INC_DWORD_STAT_BY(STAT_VoxelTerrain_CollisionTriangles, Chunk->NumCollisionTriangles);
+
+	if (MeshData.CollisionIndices.Num() == 0)
+	{
+		if (Chunk->CollisionMesh)
+			ReleaseCollisionComponent(Chunk->CollisionMesh);
+
+		Chunk->CollisionMesh = nullptr;
+		return;
+	}
+
+	if (!Chunk->CollisionMesh)
+		Chunk->CollisionMesh = AcquireCollisionComponent();
+
+	// The render sections are on another component, so they don't have to be sent to the render thread again
+	Chunk->CollisionMesh->CreateMeshSection(0, MeshData.CollisionVertices, MeshData.CollisionIndices, TArray<FVector>(), TArray<FVector2D>(), TArray<FColor>(), TArray<FProcMeshTangent>(), true);
+}
+
+void AVoxelTerrainActor::ClearChunkCollision(const FIntVector& ChunkCoord)
+{
+	if (CollisionChunks.Remove(ChunkCoord) == 0)
+		return;
+
+	DEC_DWORD_STAT(STAT_VoxelTerrain_CollisionChunks);
+
+	if (FVoxelLoadedChunk* Chunk = Chunks.Find(ChunkCoord))
+	{
+		DEC_DWORD_STAT_BY(STAT_VoxelTerrain_CollisionTriangles, Chunk->NumCollisionTriangles);
+		Chunk->NumCollisionTriangles = 0;
+
+		if (Chunk->CollisionMesh)
+			ReleaseCollisionComponent(Chunk->CollisionMesh);
+
+		Chunk->CollisionMesh = nullptr;
+	}
+}
+
+void AVoxelTerrainActor::UpdateCollisionStreaming()
+{
+	if (!GenerationContext.IsValid())
+		return;
+
+	// Turning collision off drops whatever has been built
+	if (!bGenerateCollision)
+	{
+		for (const FIntVector& ChunkCoord : CollisionChunks.Array())
+			ClearChunkCollision(ChunkCoord);
+
+		DesiredCollisionChunks.Reset();
+		LastCollisionActorChunks.Empty();
+		return;
+	}
+
+	TArray<FIntVector> ActorChunks;
+	GetCollisionActorChunks(ActorChunks);
+
+	// The chunks only change once an actor moves into another chunk
+	if (ActorChunks != LastCollisionActorChunks)
+	{
+		LastCollisionActorChunks = ActorChunks;
+
+		const int32 RadiusSquared = FMath::FloorToInt(CollisionRadius * CollisionRadius);
+		const int32 Extent = FMath::CeilToInt(CollisionRadius);
+
+		DesiredCollisionChunks.Reset();
+		for (const FIntVector& ActorChunk : ActorChunks)
+		{
+			for (int32 Z = -Extent; Z <= Extent; Z++)
+			{
+				for (int32 Y = -Extent; Y <= Extent; Y++)
+				{
+					for (int32 X = -Extent; X <= Extent; X++)
+					{
+						if (X * X + Y * Y + Z * Z <= RadiusSquared)
+							DesiredCollisionChunks.Add(ActorChunk + FIntVector(X, Y, Z));
+					}
+				}
+			}
+		}
+
+		// Collision is kept until a chunk is a chunk further out than it was built at,
+		// so the chunks on the edge aren't cooked over and over as an actor moves back and forth
+		const float DropRadius = CollisionRadius + 1.f;
+		const int32 DropRadiusSquared = FMath::FloorToInt(DropRadius * DropRadius);
+
+		TArray<FIntVector> ChunksToClear;
+		for (const FIntVector& ChunkCoord : CollisionChunks)
+		{
+			if (GetDistanceSquaredToViewers(ChunkCoord, ActorChunks) > DropRadiusSquared)
+				ChunksToClear.Add(ChunkCoord);
+		}
+
+		for (const FIntVector& ChunkCoord : ChunksToClear)
+			ClearChunkCollision(ChunkCoord);
+	}
+
+	// Chunks that are generated from now on get their collision with their mesh. The ones that loaded before an actor came near them
+	// only need the collision, and chunks that are on their way already are picked up when they come back.
+	for (const FIntVector& ChunkCoord : DesiredCollisionChunks)
+	{
+		if (Chunks.Contains(ChunkCoord) && !CollisionChunks.Contains(ChunkCoord) && !QueuedChunks.Contains(FVoxelChunkKey(ChunkCoord, 0)))
+			QueueChunkCollision(ChunkCoord);
+	}
+}
+
+void AVoxelTerrainActor::QueueChunkCollision(const FIntVector& ChunkCoord)
+{
+	FVoxelChunkRequest Request = MakeChunkRequest(ChunkCoord.X, ChunkCoord.Y, ChunkCoord.Z);
+	Request.bBuildMesh = false;
+	Request.bBuildCollision = true;
+	Request.bBuildVisibility = false;
+
+	// Without a worker pool there is nothing to queue on, so just do it now
+	if (!WorkerPool)
+	{
+		FVoxelChunkMeshData MeshData;
+		GenerationContext->BuildChunkMesh(Request, MeshData);
+		UpdateChunkCollision(MeshData);
+		return;
+	}
+
+	// Like remeshes, these skip the pending chunks
+	QueuedChunks.Add(FVoxelChunkKey(ChunkCoord, 0));
+	ChunksInFlight++;
+	(new FAutoDeleteAsyncTask<FVoxelChunkGenerationTask>(GenerationContext.ToSharedRef(), Request))->StartBackgroundTask(WorkerPool);
+}
+
+bool AVoxelTerrainActor::IsCollisionWanted(const FIntVector& ChunkCoord) const
+{
+	// A chunk that already has collision keeps it up to date until it is dropped
+	return bGenerateCollision && (DesiredCollisionChunks.Contains(ChunkCoord) || CollisionChunks.Contains(ChunkCoord));
+}
+
+void AVoxelTerrainActor::GetCollisionActorChunks(TArray<FIntVector>& OutActorChunks) const
+{
+	OutActorChunks.Reset();
+
+	for (const TWeakObjectPtr<AActor>& Actor : CollisionActors)
+	{
+		if (Actor.IsValid())
+			OutActorChunks.AddUnique(WorldToChunk(Actor->GetActorLocation()));
+	}
+
+	// Without any collision actors, whatever the chunks are streamed in around is what needs to collide with them
+	if (OutActorChunks.Num() == 0)
+		GetViewerChunks(OutActorChunks);
+}
+
+void AVoxelTerrainActor::DispatchPendingChunks()
+{
+	if (!WorkerPool || PendingChunks.Num() == 0)
+		return;
+
+	// Sort so the closest chunk is at the end of the array, where it is cheapest to pop from
+	if (bPendingChunksNeedSort)
+	{
+		TArray<FIntVector> ViewerChunks;
+		GetViewerChunks(ViewerChunks);
+
+		PendingChunks.Sort([&ViewerChunks](const FVoxelChunkKey& A, const FVoxelChunkKey& B)
+		{
+			return GetDistanceSquaredToViewers(A, ViewerChunks) > GetDistanceSquaredToViewers(B, ViewerChunks);
+		});
+
+		bPendingChunksNeedSort = false;
+	}
+
+	// Only hand out a couple of chunks per worker at a time, so the order can still change if the viewer moves
+	const int32 MaxChunksInFlight = WorkerPool->GetNumThreads() * 2;
+	TSharedRef<FVoxelGenerationContext, ESPMode::ThreadSafe> Context = GenerationContext.ToSharedRef();
+
+	while (PendingChunks.Num() > 0 && ChunksInFlight < MaxChunksInFlight)
+	{
+		const FVoxelChunkKey Key = PendingChunks.Pop(false);
+
+		// A chunk that is already buried only needs its visibility for now
+		FVoxelChunkRequest Request = MakeChunkRequest(Key);
+		if (Key.Lod == 0 && bDeferBuriedChunkMeshes && IsChunkBuried(Key.Coord))
+			Request.bBuildMesh = false;
+
+		ChunksInFlight++;
+		(new FAutoDeleteAsyncTask<FVoxelChunkGenerationTask>(Context, Request))->StartBackgroundTask(WorkerPool);
+	}
+}
+
+void AVoxelTerrainActor::UpdateStreaming()
+{
+	TArray<FIntVector> ViewerChunks;
+	GetViewerChunks(ViewerChunks);
+
+	// Nothing changes until a viewer moves into another chunk
+	if (ViewerChunks == LastViewerChunks)
+		return;
+
+	LastViewerChunks = ViewerChunks;
+
+	// Give the budget another chance every time the viewers move, in case they've moved somewhere with less to render
+	if (MeshMemoryBytes < int64(MeshMemoryBudgetMB) * 1024 * 1024 * 3 / 4)
+		BudgetLoadRadius = FMath::Min(BudgetLoadRadius + 1.f, StreamingLoadRadius);
+
+	const float LoadRadius = FMath::Min(StreamingLoadRadius, BudgetLoadRadius);
+
+	if (NumLodLevels > 0)
+	{
+		UpdateLodStreaming(ViewerChunks, LoadRadius);
+		return;
+	}
+
+	// Level of detail nodes are only kept while there are levels of detail
+	TArray<FVoxelChunkKey> NodesToUnload;
+	LodNodes.GenerateKeyArray(NodesToUnload);
+
+	for (const FVoxelChunkKey& Key : NodesToUnload)
+		UnloadChunkNode(Key);
+
+	const int32 LoadRadiusSquared = FMath::FloorToInt(LoadRadius * LoadRadius);
+	const int32 Extent = FMath::CeilToInt(LoadRadius);
+
+	// Queue everything inside the load radius of any viewer
+	for (const FIntVector& ViewerChunk : ViewerChunks)
+	{
+		for (int32 Z = -Extent; Z <= Extent; Z++)
+		{
+			for (int32 Y = -Extent; Y <= Extent; Y++)
+			{
+				for (int32 X = -Extent; X <= Extent; X++)
+				{
+					if (X * X + Y * Y + Z * Z <= LoadRadiusSquared)
+						QueueChunk(ViewerChunk.X + X, ViewerChunk.Y + Y, ViewerChunk.Z + Z);
+				}
+			}
+		}
+	}
+
+	// Unload everything outside the unload radius of every viewer
+	TArray<FIntVector> ChunksToUnload;
+	for (const auto& Chunk : Chunks)
+	{
+		if (!IsChunkInRange(Chunk.Key, ViewerChunks))
+			ChunksToUnload.Add(Chunk.Key);
+	}
+
+	for (const FIntVector& ChunkCoord : ChunksToUnload)
+		UnloadChunk(ChunkCoord.X, ChunkCoord.Y, ChunkCoord.Z);
+
+	// Chunks that are still waiting for a worker don't need to be generated any more either
+	for (int32 i = PendingChunks.Num() - 1; i >= 0; i--)
+	{
+		if (PendingChunks[i].Lod > 0 || !IsChunkInRange(PendingChunks[i].Coord, ViewerChunks))
+		{
+			QueuedChunks.Remove(PendingChunks[i]);
+			PendingChunks.RemoveAtSwap(i, 1, false);
+			ChunksQueuedTotal = FMath::Max(0, ChunksQueuedTotal - 1);
+		}
+	}
+
+	bPendingChunksNeedSort = true;
+
+	EnforceMeshMemoryBudget(ViewerChunks);
+}
+
+void AVoxelTerrainActor::UpdateLodStreaming(const TArray<FIntVector>& ViewerChunks, float LoadRadius)
+{
+	// The top level reaches twice as far as the level below it, like every other level
+	const int32 TopNodeSize = 1 << NumLodLevels;
+	const float DrawDistance = LoadRadius * TopNodeSize;
+	const int32 DrawDistanceSquared = FMath::FloorToInt(DrawDistance * DrawDistance);
+	const int32 Extent = FMath::CeilToInt(DrawDistance);
+
+	// Find every top level node within the draw distance of a viewer
+	TSet<FIntVector> TopNodes;
+	for (const FIntVector& ViewerChunk : ViewerChunks)
+	{
+		const FIntVector Lower = DivideAndRoundDown(ViewerChunk - FIntVector(Extent), TopNodeSize);
+		const FIntVector Upper = DivideAndRoundDown(ViewerChunk + FIntVector(Extent), TopNodeSize);
+
+		for (int32 Z = Lower.Z; Z <= Upper.Z; Z++)
+		{
+			for (int32 Y = Lower.Y; Y <= Upper.Y; Y++)
+			{
+				for (int32 X = Lower.X; X <= Upper.X; X++)
+				{
+					if (GetDistanceSquaredToViewers(FVoxelChunkKey(FIntVector(X, Y, Z), NumLodLevels), ViewerChunks) <= DrawDistanceSquared)
+						TopNodes.Add(FIntVector(X, Y, Z));
+				}
+			}
+		}
+	}
+
+	// Split them down to the level of detail each part of them needs
+	DesiredChunks.Reset();
+	SplitNodes.Reset();
+	for (const FIntVector& TopNode : TopNodes)
+		SelectLodNodes(FVoxelChunkKey(TopNode, NumLodLevels), ViewerChunks, LoadRadius);
+
+	for (const FVoxelChunkKey& Key : DesiredChunks)
+		QueueChunkNode(Key);
+
+	// Chunks that are still waiting for a worker don't need to be generated any more if the selection has moved on
+	for (int32 i = PendingChunks.Num() - 1; i >= 0; i--)
+	{
+		if (!DesiredChunks.Contains(PendingChunks[i]))
+		{
+			QueuedChunks.Remove(PendingChunks[i]);
+			PendingChunks.RemoveAtSwap(i, 1, false);
+			ChunksQueuedTotal = FMath::Max(0, ChunksQueuedTotal - 1);
+		}
+	}
+
+	bPendingChunksNeedSort = true;
+
+	// Whatever the selection no longer wants stays visible until its replacement has loaded, so Tick unloads it later
+	bUnloadStaleChunks = true;
+}
+
+void AVoxelTerrainActor::SelectLodNodes(const FVoxelChunkKey& Key, const TArray<FIntVector>& ViewerChunks, float LoadRadius)
+{
+	// A node is split into its eight children once a viewer is within the distance its children are used out to.
+	// Full resolution chunks are used out to the load radius, and every level above that is used twice as far out as the one below it.
+	if (Key.Lod > 0)
+	{
+		const float SplitDistance = LoadRadius * (1 << (Key.Lod - 1));
+
+		if (GetDistanceSquaredToViewers(Key, ViewerChunks) <= FMath::FloorToInt(SplitDistance * SplitDistance))
+		{
+			SplitNodes.Add(Key);
+
+			for (int32 Child = 0; Child < 8; Child++)
+			{
+				const FIntVector ChildCoord = Key.Coord * 2 + FIntVector(Child & 1, (Child >> 1) & 1, (Child >> 2) & 1);
+				SelectLodNodes(FVoxelChunkKey(ChildCoord, Key.Lod - 1), ViewerChunks, LoadRadius);
+			}
+
+			return;
+		}
+	}
+
+	DesiredChunks.Add(Key);
+}
+
+bool AVoxelTerrainActor::UnloadStaleChunks()
+{
+	TArray<FVoxelChunkKey> StaleChunks;
+
+	for (const auto& Chunk : Chunks)
+	{
+		const FVoxelChunkKey Key(Chunk.Key, 0);
+		if (!DesiredChunks.Contains(Key))
+			StaleChunks.Add(Key);
+	}
+
+	for (const auto& Node : LodNodes)
+	{
+		if (!DesiredChunks.Contains(Node.Key))
+			StaleChunks.Add(Node.Key);
+	}
+
+	bool bAllUnloaded = true;
+	for (const FVoxelChunkKey& Key : StaleChunks)
+	{
+		if (IsReplacementLoaded(Key))
+			UnloadChunkNode(Key);
+		else
+			bAllUnloaded = false;
+	}
+
+	return bAllUnloaded;
+}
+
+bool AVoxelTerrainActor::IsReplacementLoaded(const FVoxelChunkKey& Key) const
+{
+	// Replaced by a coarser node
+	for (int32 Lod = Key.Lod + 1; Lod <= NumLodLevels; Lod++)
+	{
+		const FVoxelChunkKey Ancestor(DivideAndRoundDown(Key.Coord, 1 << (Lod - Key.Lod)), Lod);
+
+		if (DesiredChunks.Contains(Ancestor))
+			return IsChunkNodeLoaded(Ancestor);
+	}
+
+	// Replaced by finer nodes, or by nothing at all if it's gone out of range
+	return AreDescendantsLoaded(Key);
+}
+
+bool AVoxelTerrainActor::AreDescendantsLoaded(const FVoxelChunkKey& Key) const
+{
+	// Nothing replaces a node that wasn't split, since it's out of range
+	if (!SplitNodes.Contains(Key))
+		return true;
+
+	for (int32 Child = 0; Child < 8; Child++)
+	{
+		const FVoxelChunkKey ChildKey(Key.Coord * 2 + FIntVector(Child & 1, (Child >> 1) & 1, (Child >> 2) & 1), Key.Lod - 1);
+
+		if (DesiredChunks.Contains(ChildKey))
+		{
+			if (!IsChunkNodeLoaded(ChildKey))
+				return false;
+		}
+		else if (!AreDescendantsLoaded(ChildKey))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void AVoxelTerrainActor::EnforceMeshMemoryBudget(const TArray<FIntVector>& ViewerChunks)
+{
+	const int64 BudgetBytes = int64(MeshMemoryBudgetMB) * 1024 * 1024;
+	if (MeshMemoryBytes <= BudgetBytes)
+		return;
+
+	// Every level of detail reaches out in proportion to the load radius, so shrinking it pulls all of them in.
+	// Unloading the furthest nodes directly would leave holes in the terrain.
+	if (NumLodLevels > 0)
+	{
+		BudgetLoadRadius = FMath::Max(1.f, FMath::Min(BudgetLoadRadius, StreamingLoadRadius) - 1.f);
+		LastViewerChunks.Empty();
+
+		UE_LOG(LogVoxelTerrain, Log, TEXT("%s: chunk meshes went over the %d MB budget, load radius reduced to %.1f chunks"), *GetName(), MeshMemoryBudgetMB, BudgetLoadRadius);
+		return;
+	}
+
+	// Unload the furthest chunks with meshes first
+	TArray<TPair<int32, FIntVector>> ChunksByDistance;
+	for (const auto& Chunk : Chunks)
+	{
+		if (Chunk.Value.Mesh)
+			ChunksByDistance.Add(TPair<int32, FIntVector>(GetDistanceSquaredToViewers(Chunk.Key, ViewerChunks), Chunk.Key));
+	}
+
+	ChunksByDistance.Sort([](const TPair<int32, FIntVector>& A, const TPair<int32, FIntVector>& B) { return A.Key > B.Key; });
+
+	for (const TPair<int32, FIntVector>& Chunk : ChunksByDistance)
+	{
+		if (MeshMemoryBytes <= BudgetBytes)
+			break;
+
+		UnloadChunk(Chunk.Value.X, Chunk.Value.Y, Chunk.Value.Z);
+
+		// Don't load anything this far out again until the budget allows it, otherwise the chunk would just come straight back
+		BudgetLoadRadius = FMath::Max(1.f, FMath::Min(BudgetLoadRadius, FMath::Sqrt(float(Chunk.Key)) - 1.f));
+	}
+
+	UE_LOG(LogVoxelTerrain, Log, TEXT("%s: chunk meshes went over the %d MB budget, load radius reduced to %.1f chunks"), *GetName(), MeshMemoryBudgetMB, BudgetLoadRadius);
+}
+
+bool AVoxelTerrainActor::IsChunkInRange(const FIntVector& ChunkCoord, const TArray<FIntVector>& ViewerChunks) const
+{
+	const float UnloadRadius = FMath::Max(StreamingUnloadRadius, StreamingLoadRadius + 1.f);
+	return GetDistanceSquaredToViewers(ChunkCoord, ViewerChunks) <= FMath::FloorToInt(UnloadRadius * UnloadRadius);
+}
+
+bool AVoxelTerrainActor::IsChunkWanted(const FVoxelChunkKey& Key, const TArray<FIntVector>& ViewerChunks) const
+{
+	if (NumLodLevels > 0)
+		return DesiredChunks.Contains(Key);
+
+	return Key.Lod == 0 && IsChunkInRange(Key.Coord, ViewerChunks);
+}
+
+void AVoxelTerrainActor::GetViewerChunks(TArray<FIntVector>& OutViewerChunks) const
+{
+	TArray<FVector> ViewLocations;
+
+	for (const TWeakObjectPtr<AActor>& Viewer : StreamingViewers)
+	{
+		if (Viewer.IsValid())
+			ViewLocations.Add(Viewer->GetActorLocation());
+	}
+
+	// Without any viewers, follow every local player's camera
+	if (ViewLocations.Num() == 0)
+	{
+		if (UWorld* World = GetWorld())
+		{
+			for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+			{
+				APlayerController* PlayerController = It->Get();
+				if (PlayerController && PlayerController->IsLocalController())
+				{
+					FVector ViewLocation;
+					FRotator ViewRotation;
+					PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+					ViewLocations.Add(ViewLocation);
+				}
+			}
+		}
+	}
+
+	// Fall back to the terrain itself, so there is always somewhere to generate around
+	if (ViewLocations.Num() == 0)
+		ViewLocations.Add(GetActorLocation());
+
+	OutViewerChunks.Reset();
+	for (const FVector& ViewLocation : ViewLocations)
+		OutViewerChunks.AddUnique(WorldToChunk(ViewLocation));
+}
+
+FIntVector AVoxelTerrainActor::WorldToChunk(const FVector& WorldLocation) const
+{
+	// Each voxel is 100 units
+	const FVector LocalLocation = GetActorTransform().InverseTransformPosition(WorldLocation) / (FVoxelChunkTraits::Size * 100.f);
+	return FIntVector(FMath::FloorToInt(LocalLocation.X), FMath::FloorToInt(LocalLocation.Y), FMath::FloorToInt(LocalLocation.Z));
+}
+
+int32 AVoxelTerrainActor::GetDistanceSquaredToViewers(const FIntVector& ChunkCoord, const TArray<FIntVector>& ViewerChunks)
+{
+	return GetDistanceSquaredToViewers(FVoxelChunkKey(ChunkCoord, 0), ViewerChunks);
+}
+
+int32 AVoxelTerrainActor::GetDistanceSquaredToViewers(const FVoxelChunkKey& Key, const TArray<FIntVector>& ViewerChunks)
+{
+	const int32 NodeSize = 1 << Key.Lod;
+	const FIntVector Lower = Key.Coord * NodeSize;
+	const FIntVector Upper = Lower + FIntVector(NodeSize - 1);
+
+	int32 ClosestDistanceSquared = MAX_int32;
+
+	for (const FIntVector& ViewerChunk : ViewerChunks)
+	{
+		// Zero along any axis the viewer is within the node on
+		int32 DistanceSquared = 0;
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			const int32 Delta = FMath::Max3(Lower[Axis] - ViewerChunk[Axis], 0, ViewerChunk[Axis] - Upper[Axis]);
+			DistanceSquared += Delta * Delta;
+		}
+
+		ClosestDistanceSquared = FMath::Min(ClosestDistanceSquared, DistanceSquared);
+	}
+
+	return ClosestDistanceSquared;
+}
+
+FIntVector AVoxelTerrainActor::DivideAndRoundDown(const FIntVector& Coord, int32 Divisor)
+{
+	return FIntVector(FMath::FloorToInt(float(Coord.X) / Divisor), FMath::FloorToInt(float(Coord.Y) / Divisor), FMath::FloorToInt(float(Coord.Z) / Divisor));
+}
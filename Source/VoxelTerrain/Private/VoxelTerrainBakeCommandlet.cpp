@@ -0,0 +1,96 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#include "VoxelTerrainBakeCommandlet.h"
+#include "VoxelTerrainActor.h"
+#include "VoxelTerrain.h"
+#include "Engine/Level.h"
+#include "Engine/World.h"
+#include "Misc/Parse.h"
+#include "UObject/Package.h"
+
+// Reads a chunk coordinate written as X,Y,Z from the command line. Returns false if it isn't there or isn't three numbers.
+static bool ParseChunkCoord(const FString& Params, const TCHAR* Name, FIntVector& OutCoord)
+{
+	FString Value;
+	if (!FParse::Value(*Params, Name, Value))
+		return false;
+
+	TArray<FString> Parts;
+	if (Value.ParseIntoArray(Parts, TEXT(",")) != 3)
+		return false;
+
+	OutCoord = FIntVector(FCString::Atoi(*Parts[0]), FCString::Atoi(*Parts[1]), FCString::Atoi(*Parts[2]));
+	return true;
+}
+
+UVoxelTerrainBakeCommandlet::UVoxelTerrainBakeCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+}
+
+int32 UVoxelTerrainBakeCommandlet::Main(const FString& Params)
+{
+	FString MapName;
+	if (!FParse::Value(*Params, TEXT("Map="), MapName))
+	{
+		UE_LOG(LogVoxelTerrain, Error, TEXT("Usage: -run=VoxelTerrainBake -Map=/Game/Maps/MyMap [-Terrain=ActorName] [-Min=X,Y,Z -Max=X,Y,Z] [-Rebuild]"));
+		return 1;
+	}
+
+	FString TerrainName;
+	FParse::Value(*Params, TEXT("Terrain="), TerrainName);
+
+	FIntVector LowerChunk, UpperChunk;
+	const bool bHasMin = ParseChunkCoord(Params, TEXT("Min="), LowerChunk);
+	const bool bHasMax = ParseChunkCoord(Params, TEXT("Max="), UpperChunk);
+
+	if (bHasMin != bHasMax)
+	{
+		UE_LOG(LogVoxelTerrain, Error, TEXT("-Min and -Max have to be given together, as X,Y,Z"));
+		return 1;
+	}
+
+	const bool bRebuildAll = FParse::Param(*Params, TEXT("Rebuild"));
+
+	UPackage* Package = LoadPackage(nullptr, *MapName, LOAD_None);
+	UWorld* World = Package ? UWorld::FindWorldInPackage(Package) : nullptr;
+
+	if (!World || !World->PersistentLevel)
+	{
+		UE_LOG(LogVoxelTerrain, Error, TEXT("Couldn't load the map %s"), *MapName);
+		return 1;
+	}
+
+	// Only the persistent level is searched, so terrains in streamed levels have to be baked from their own map
+	int32 NumTerrains = 0;
+	int32 NumChunks = 0;
+
+	for (AActor* Actor : World->PersistentLevel->Actors)
+	{
+		AVoxelTerrainActor* Terrain = Cast<AVoxelTerrainActor>(Actor);
+		if (!Terrain || (!TerrainName.IsEmpty() && Terrain->GetName() != TerrainName))
+			continue;
+
+		// The same area BeginPlay generates when the terrain doesn't stream
+		if (!bHasMin)
+		{
+			LowerChunk = FIntVector(-(Terrain->ChunksToGenerateX - 1), -(Terrain->ChunksToGenerateY - 1), -(Terrain->ChunksToGenerateZ - 1));
+			UpperChunk = FIntVector(Terrain->ChunksToGenerateX - 1, Terrain->ChunksToGenerateY - 1, Terrain->ChunksToGenerateZ - 1);
+		}
+
+		NumChunks += Terrain->BakeMeshCache(LowerChunk, UpperChunk, bRebuildAll);
+		NumTerrains++;
+	}
+
+	if (NumTerrains == 0)
+	{
+		UE_LOG(LogVoxelTerrain, Error, TEXT("%s doesn't have any voxel terrains to bake"), *MapName);
+		return 1;
+	}
+
+	UE_LOG(LogVoxelTerrain, Display, TEXT("Baked %d chunks over %d terrains"), NumChunks, NumTerrains);
+	return 0;
+}
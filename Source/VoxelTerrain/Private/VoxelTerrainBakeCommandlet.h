@@ -0,0 +1,27 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "VoxelTerrainBakeCommandlet.generated.h"
+
+// Bakes the chunk meshes of the voxel terrains in a map into their mesh caches, so the game can load them instead of generating them.
+// Only the chunks that aren't baked yet are built, so running it again after some chunks were edited only rebuilds those.
+//
+// Usage: UE4Editor-Cmd <Project> -run=VoxelTerrainBake -Map=/Game/Maps/MyMap [-Terrain=ActorName] [-Min=X,Y,Z -Max=X,Y,Z] [-Rebuild]
+//   -Map      The map the terrains are in
+//   -Terrain  Only bake the terrain actor with this name
+//   -Min/-Max The corners of the range of chunks to bake, inclusive. Each terrain's ChunksToGenerate area is baked if these are left out.
+//   -Rebuild  Bake every chunk in the range, even the ones that are already baked
+UCLASS()
+class UVoxelTerrainBakeCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UVoxelTerrainBakeCommandlet();
+
+	// UCommandlet functions
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,603 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#include "VoxelTerrainActor.h"
+#include "VoxelTerrain.h"
+#include "VoxelTerrainGeneration.h"
+#include "VoxelBatchedNoise.h"
+#include "VoxelChunkStore.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/Paths.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+
+using namespace PolyVox;
+
+// Extracts and builds the same chunks with every surface extractor, and logs how many triangles each one made, how long it took
+// and how much memory the meshes take up. Spherical terrains go through exactly the same path, so this covers them too.
+// Usage: VoxelTerrain.BenchmarkExtractors [NumChunksPerAxis]
+static void BenchmarkExtractors(const TArray<FString>& Args, UWorld* World)
+{
+	const int32 ChunksPerAxis = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 3;
+
+	for (TActorIterator<AVoxelTerrainActor> It(World); It; ++It)
+	{
+		AVoxelTerrainActor* Terrain = *It;
+		TSharedPtr<FVoxelGenerationContext, ESPMode::ThreadSafe> Context = Terrain->GetGenerationContext();
+
+		if (!Context.IsValid())
+			continue;
+
+		FVoxelChunkWorkspace Workspace;
+		FVoxelChunkMeshData MeshData;
+
+		const EVoxelSurfaceExtractor Extractors[] = { EVoxelSurfaceExtractor::Cubic, EVoxelSurfaceExtractor::Greedy, EVoxelSurfaceExtractor::MarchingCubes };
+		const TCHAR* ExtractorNames[] = { TEXT("Cubic:         "), TEXT("Greedy:        "), TEXT("MarchingCubes: ") };
+		uint64 Triangles[ARRAY_COUNT(Extractors)] = { 0 };
+		uint64 Vertices[ARRAY_COUNT(Extractors)] = { 0 };
+		int64 MeshBytes[ARRAY_COUNT(Extractors)] = { 0 };
+		double ExtractSeconds[ARRAY_COUNT(Extractors)] = { 0 };
+		double BuildSeconds[ARRAY_COUNT(Extractors)] = { 0 };
+
+		// Chunks are centred around the terrain, like BeginPlay does it
+		for (int32 X = -(ChunksPerAxis / 2); X < ChunksPerAxis - ChunksPerAxis / 2; X++)
+		{
+			for (int32 Y = -(ChunksPerAxis / 2); Y < ChunksPerAxis - ChunksPerAxis / 2; Y++)
+			{
+				for (int32 Z = -(ChunksPerAxis / 2); Z < ChunksPerAxis - ChunksPerAxis / 2; Z++)
+				{
+					const FVoxelChunkRequest Request = Terrain->MakeChunkRequest(X, Y, Z);
+
+					// Make sure the noise is generated and paged in, so only the extraction itself is timed.
+					// Marching cubes reads the furthest, so staging for it covers the others too.
+					const PolyVox::Region SourceRegion = FVoxelGenerationContext::GetSourceRegion(Request.Region, EVoxelSurfaceExtractor::MarchingCubes);
+					Context->Pager->StageRegion(SourceRegion);
+					Context->Volume->prefetch(SourceRegion);
+
+					for (int32 i = 0; i < ARRAY_COUNT(Extractors); i++)
+					{
+						MeshData.Reset(Context->NumMaterials, Context->bSingleMeshSection);
+
+						if (Extractors[i] == EVoxelSurfaceExtractor::MarchingCubes)
+						{
+							FVoxelDensityField DensityField(nullptr, FIntVector::ZeroValue, FIntVector::ZeroValue);
+
+							double StartTime = FPlatformTime::Seconds();
+							auto ExtractedMesh = Context->ExtractMarchingCubesSurface(Request.Region, Workspace, DensityField);
+							ExtractSeconds[i] += FPlatformTime::Seconds() - StartTime;
+
+							StartTime = FPlatformTime::Seconds();
+							Workspace.MeshBuilder.BuildMarchingCubesMesh(ExtractedMesh, Request.OffsetLocation, MeshData, 1.f, &DensityField);
+							BuildSeconds[i] += FPlatformTime::Seconds() - StartTime;
+						}
+						else
+						{
+							double StartTime = FPlatformTime::Seconds();
+							auto ExtractedMesh = Context->ExtractSurface(Request.Region, Extractors[i], Workspace);
+							ExtractSeconds[i] += FPlatformTime::Seconds() - StartTime;
+
+							StartTime = FPlatformTime::Seconds();
+							Workspace.MeshBuilder.BuildCubicMesh(ExtractedMesh, Request.OffsetLocation, MeshData);
+							BuildSeconds[i] += FPlatformTime::Seconds() - StartTime;
+						}
+
+						Triangles[i] += MeshData.GetNumTriangles();
+						Vertices[i] += MeshData.GetNumVertices();
+						MeshBytes[i] += MeshData.GetMeshBytes();
+					}
+				}
+			}
+		}
+
+		const int32 NumChunks = ChunksPerAxis * ChunksPerAxis * ChunksPerAxis;
+		UE_LOG(LogVoxelTerrain, Display, TEXT("%s: extractor benchmark over %d %s chunks"), *Terrain->GetName(), NumChunks, Terrain->bIsSpherical ? TEXT("spherical") : TEXT("flat"));
+
+		for (int32 i = 0; i < ARRAY_COUNT(Extractors); i++)
+		{
+			UE_LOG(LogVoxelTerrain, Display, TEXT("  %s%llu triangles, %llu vertices, %.1f KB of mesh, %.2f ms extracting (%.3f ms per chunk), %.2f ms building"),
+				ExtractorNames[i], Triangles[i], Vertices[i], MeshBytes[i] / 1024.0, ExtractSeconds[i] * 1000.0, ExtractSeconds[i] * 1000.0 / NumChunks, BuildSeconds[i] * 1000.0);
+		}
+
+		if (Triangles[0] > 0)
+		{
+			UE_LOG(LogVoxelTerrain, Display, TEXT("  Greedy meshing removed %.1f%% of the triangles"), 100.0 * (1.0 - double(Triangles[1]) / double(Triangles[0])));
+		}
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs BenchmarkExtractorsCommand(
+	TEXT("VoxelTerrain.BenchmarkExtractors"),
+	TEXT("Compares the triangle count, extraction time and mesh memory of every surface extractor. Usage: VoxelTerrain.BenchmarkExtractors [NumChunksPerAxis]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchmarkExtractors));
+
+// Checks the batched noise against ANL on the terrain's real noise program, for a few seeds and every instruction set the CPU supports,
+// and logs how much faster it is. It fails if any of them is further from ANL than FVoxelBatchedNoise::AnlTolerance.
+// Usage: VoxelTerrain.ValidateBatchedNoise [NumPoints]
+static void ValidateBatchedNoise(const TArray<FString>& Args)
+{
+	const int32 NumPoints = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 16 * 1024;
+	const uint32 Seeds[] = { 123, 0, 42, 987654321 };
+
+	const EVoxelNoiseInstructionSet SupportedInstructionSet = FVoxelBatchedNoise::GetSupportedInstructionSet();
+	const EVoxelNoiseInstructionSet InstructionSets[] = { EVoxelNoiseInstructionSet::Scalar, EVoxelNoiseInstructionSet::SSE2, EVoxelNoiseInstructionSet::AVX2 };
+
+	UE_LOG(LogVoxelTerrain, Display, TEXT("Batched noise against ANL over %d voxels within %d of the origin, best instruction set is %s, tolerance is %g"),
+		NumPoints, FVoxelBatchedNoise::AnlToleranceExtent, FVoxelBatchedNoise::GetInstructionSetName(SupportedInstructionSet), FVoxelBatchedNoise::AnlTolerance);
+
+	bool bPassed = true;
+
+	for (uint32 Seed : Seeds)
+	{
+		// The actor's default settings. Flat terrain uses both the terrain and the ore fractal, so it covers everything the batched noise stands in for.
+		const VoxelTerrainPager Pager(false, Seed, 3, 0.01f, 32.f, 0.f, 64.f, true);
+
+		for (EVoxelNoiseInstructionSet InstructionSet : InstructionSets)
+		{
+			if (InstructionSet > SupportedInstructionSet)
+				continue;
+
+			const FVoxelNoiseComparison Comparison = Pager.CompareBatchedNoise(NumPoints, InstructionSet);
+			const bool bWithinTolerance = Comparison.MaxError >= 0.f && Comparison.MaxError <= FVoxelBatchedNoise::AnlTolerance;
+			bPassed &= bWithinTolerance;
+
+			UE_LOG(LogVoxelTerrain, Display, TEXT("  Seed %u, %s: max error %g, %.1fx faster than ANL%s"),
+				Seed,
+				FVoxelBatchedNoise::GetInstructionSetName(InstructionSet),
+				Comparison.MaxError,
+				Comparison.AnlSeconds / FMath::Max(Comparison.BatchedSeconds, 1e-9),
+				bWithinTolerance ? TEXT("") : TEXT(" - OUTSIDE TOLERANCE"));
+		}
+	}
+
+	if (bPassed)
+	{
+		UE_LOG(LogVoxelTerrain, Display, TEXT("The batched noise matches ANL"));
+	}
+	else
+	{
+		UE_LOG(LogVoxelTerrain, Error, TEXT("The batched noise does not match ANL, so terrains that ask for it are generated with ANL instead"));
+	}
+}
+
+static FAutoConsoleCommandWithArgs ValidateBatchedNoiseCommand(
+	TEXT("VoxelTerrain.ValidateBatchedNoise"),
+	TEXT("Compares the batched noise against ANL for a few seeds and every supported instruction set. Usage: VoxelTerrain.ValidateBatchedNoise [NumPoints]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&ValidateBatchedNoise));
+
+// Pre-generates a block of chunks into a scratch chunk store, then logs how well they compressed and how long it takes to page a chunk in
+// from the store compared to regenerating it from noise.
+// Usage: VoxelTerrain.BenchmarkChunkStore [NumChunksPerAxis]
+static void BenchmarkChunkStore(const TArray<FString>& Args, UWorld* World)
+{
+	const int32 ChunksPerAxis = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 4;
+	const int32 ChunkSideLength = VoxelTerrainPager::VolumeChunkSideLength;
+	const int32 NumVoxels = ChunkSideLength * ChunkSideLength * ChunkSideLength;
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+	for (TActorIterator<AVoxelTerrainActor> It(World); It; ++It)
+	{
+		AVoxelTerrainActor* Terrain = *It;
+		TSharedPtr<FVoxelGenerationContext, ESPMode::ThreadSafe> Context = Terrain->GetGenerationContext();
+
+		if (!Context.IsValid())
+			continue;
+
+		// Use a scratch directory so the actor's own saved chunks are left alone
+		const FString Directory = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("VoxelTerrain"), TEXT("Benchmark"), Terrain->GetName());
+		PlatformFile.DeleteDirectoryRecursively(*Directory);
+
+		TArray<FIntVector> ChunkKeys;
+		for (int32 Z = -(ChunksPerAxis / 2); Z < ChunksPerAxis - ChunksPerAxis / 2; Z++)
+			for (int32 Y = -(ChunksPerAxis / 2); Y < ChunksPerAxis - ChunksPerAxis / 2; Y++)
+				for (int32 X = -(ChunksPerAxis / 2); X < ChunksPerAxis - ChunksPerAxis / 2; X++)
+					ChunkKeys.Add(FIntVector(X, Y, Z));
+
+		TArray<MaterialDensityPair88> Voxels, LoadedVoxels;
+		Voxels.SetNumUninitialized(NumVoxels);
+		LoadedVoxels.SetNumUninitialized(NumVoxels);
+
+		int64 CompressedBytes = 0;
+		double GenerateSeconds = 0;
+		double ReadSeconds = 0;
+		int32 NumMismatched = 0;
+
+		// Generate every chunk from noise and save it
+		{
+			FVoxelChunkStore Store(Directory, ChunkSideLength, Context->Pager->GetSettingsHash());
+			TArray<uint8> Compressed;
+
+			for (const FIntVector& ChunkKey : ChunkKeys)
+			{
+				const Vector3DInt32 ChunkLower(ChunkKey.X * ChunkSideLength, ChunkKey.Y * ChunkSideLength, ChunkKey.Z * ChunkSideLength);
+				const PolyVox::Region ChunkRegion(ChunkLower, ChunkLower + Vector3DInt32(ChunkSideLength - 1, ChunkSideLength - 1, ChunkSideLength - 1));
+
+				const double StartTime = FPlatformTime::Seconds();
+				Context->Pager->GenerateRegion(ChunkRegion, Voxels.GetData());
+				GenerateSeconds += FPlatformTime::Seconds() - StartTime;
+
+				FVoxelChunkStore::CompressChunk(Voxels.GetData(), NumVoxels, Compressed);
+				CompressedBytes += Compressed.Num();
+
+				Store.WriteChunk(ChunkKey, Voxels.GetData());
+			}
+
+			Store.Flush();
+		}
+
+		// Read them back through a fresh store, so the region files have to be opened and mapped again
+		{
+			FVoxelChunkStore Store(Directory, ChunkSideLength, Context->Pager->GetSettingsHash());
+
+			for (const FIntVector& ChunkKey : ChunkKeys)
+			{
+				const double StartTime = FPlatformTime::Seconds();
+				const bool bFound = Store.ReadChunk(ChunkKey, LoadedVoxels.GetData());
+				ReadSeconds += FPlatformTime::Seconds() - StartTime;
+
+				// Make sure the round trip didn't change anything
+				const Vector3DInt32 ChunkLower(ChunkKey.X * ChunkSideLength, ChunkKey.Y * ChunkSideLength, ChunkKey.Z * ChunkSideLength);
+				const PolyVox::Region ChunkRegion(ChunkLower, ChunkLower + Vector3DInt32(ChunkSideLength - 1, ChunkSideLength - 1, ChunkSideLength - 1));
+				Context->Pager->GenerateRegion(ChunkRegion, Voxels.GetData());
+
+				if (!bFound || FMemory::Memcmp(Voxels.GetData(), LoadedVoxels.GetData(), NumVoxels * sizeof(MaterialDensityPair88)) != 0)
+					NumMismatched++;
+			}
+		}
+
+		PlatformFile.DeleteDirectoryRecursively(*Directory);
+
+		const int32 NumChunks = ChunkKeys.Num();
+		const int64 RawBytes = int64(NumChunks) * NumVoxels * sizeof(MaterialDensityPair88);
+
+		UE_LOG(LogVoxelTerrain, Display, TEXT("%s: chunk store benchmark over %d chunks"), *Terrain->GetName(), NumChunks);
+		UE_LOG(LogVoxelTerrain, Display, TEXT("  Compression: %lld KB raw, %lld KB stored, %.1f:1"), RawBytes / 1024, CompressedBytes / 1024, double(RawBytes) / FMath::Max<int64>(CompressedBytes, 1));
+		UE_LOG(LogVoxelTerrain, Display, TEXT("  Regenerate:  %.3f ms per chunk"), GenerateSeconds * 1000.0 / NumChunks);
+		UE_LOG(LogVoxelTerrain, Display, TEXT("  Store hit:   %.3f ms per chunk"), ReadSeconds * 1000.0 / NumChunks);
+
+		if (NumMismatched > 0)
+		{
+			UE_LOG(LogVoxelTerrain, Warning, TEXT("  %d chunks didn't come back the same as they were saved"), NumMismatched);
+		}
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs BenchmarkChunkStoreCommand(
+	TEXT("VoxelTerrain.BenchmarkChunkStore"),
+	TEXT("Logs the compression ratio of the chunk store and compares loading chunks from it to regenerating them. Usage: VoxelTerrain.BenchmarkChunkStore [NumChunksPerAxis]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchmarkChunkStore));
+
+// Logs how many chunks, triangles and how much mesh memory every level of detail is using, and how long its chunks took to generate.
+// Usage: VoxelTerrain.LodStats
+static void LogLodStats(const TArray<FString>& Args, UWorld* World)
+{
+	for (TActorIterator<AVoxelTerrainActor> It(World); It; ++It)
+	{
+		AVoxelTerrainActor* Terrain = *It;
+		UE_LOG(LogVoxelTerrain, Display, TEXT("%s: %d levels of detail"), *Terrain->GetName(), Terrain->NumLodLevels);
+
+		for (int32 Lod = 0; Lod <= Terrain->NumLodLevels; Lod++)
+		{
+			const FVoxelLodStats Stats = Terrain->GetLodStats(Lod);
+			UE_LOG(LogVoxelTerrain, Display, TEXT("  LOD %d: %d chunks, %d triangles, %.2f MB, %d generated at %.3f ms each"),
+				Lod, Stats.NumChunks, Stats.NumTriangles, Stats.MeshMemoryMB, Stats.NumGenerated, Stats.AverageGenerationMs);
+		}
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs LodStatsCommand(
+	TEXT("VoxelTerrain.LodStats"),
+	TEXT("Logs the chunk count, triangle count, mesh memory and generation time of every level of detail. Usage: VoxelTerrain.LodStats"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&LogLodStats));
+
+// Logs how much memory the paged in voxels take up with the palette compression, next to what they would take up at two bytes a voxel.
+// Usage: VoxelTerrain.VolumeMemory
+static void LogVolumeMemory(const TArray<FString>& Args, UWorld* World)
+{
+	for (TActorIterator<AVoxelTerrainActor> It(World); It; ++It)
+	{
+		AVoxelTerrainActor* Terrain = *It;
+		TSharedPtr<FVoxelGenerationContext, ESPMode::ThreadSafe> Context = Terrain->GetGenerationContext();
+
+		if (!Context.IsValid())
+			continue;
+
+		const int64 Bytes = Context->Volume->calculateSizeInBytes();
+		const int64 UncompressedBytes = Context->Volume->GetUncompressedSizeInBytes();
+
+		UE_LOG(LogVoxelTerrain, Display, TEXT("%s: %d volume chunks paged in, %d of them uniform"), *Terrain->GetName(), Context->Volume->GetNumChunks(), Context->Volume->GetNumUniformChunks());
+		UE_LOG(LogVoxelTerrain, Display, TEXT("  %.2f MB compressed, %.2f MB uncompressed, %.1f:1"), Bytes / (1024.0 * 1024.0), UncompressedBytes / (1024.0 * 1024.0), double(UncompressedBytes) / FMath::Max<int64>(Bytes, 1));
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs VolumeMemoryCommand(
+	TEXT("VoxelTerrain.VolumeMemory"),
+	TEXT("Logs how much memory the paged in voxels take up, compressed and uncompressed. Usage: VoxelTerrain.VolumeMemory"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&LogVolumeMemory));
+
+// Builds the same nodes at every level of detail, both blocky and smooth, and logs how many triangles they made and how long they took.
+// Usage: VoxelTerrain.BenchmarkLod [NumNodesPerAxis]
+static void BenchmarkLod(const TArray<FString>& Args, UWorld* World)
+{
+	const int32 NodesPerAxis = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 2;
+
+	for (TActorIterator<AVoxelTerrainActor> It(World); It; ++It)
+	{
+		AVoxelTerrainActor* Terrain = *It;
+		TSharedPtr<FVoxelGenerationContext, ESPMode::ThreadSafe> Context = Terrain->GetGenerationContext();
+
+		if (!Context.IsValid())
+			continue;
+
+		const int32 NumNodes = NodesPerAxis * NodesPerAxis * NodesPerAxis;
+		UE_LOG(LogVoxelTerrain, Display, TEXT("%s: level of detail benchmark over %d nodes per level"), *Terrain->GetName(), NumNodes);
+
+		FVoxelChunkMeshData MeshData;
+
+		for (int32 Lod = 1; Lod <= FMath::Max(1, Terrain->NumLodLevels); Lod++)
+		{
+			uint64 Triangles[2] = { 0 };
+			double Seconds[2] = { 0 };
+
+			// Nodes are centred around the terrain, like the chunks in the other benchmarks
+			for (int32 X = -(NodesPerAxis / 2); X < NodesPerAxis - NodesPerAxis / 2; X++)
+			{
+				for (int32 Y = -(NodesPerAxis / 2); Y < NodesPerAxis - NodesPerAxis / 2; Y++)
+				{
+					for (int32 Z = -(NodesPerAxis / 2); Z < NodesPerAxis - NodesPerAxis / 2; Z++)
+					{
+						const FVoxelChunkRequest Request = Terrain->MakeChunkRequest(FVoxelChunkKey(FIntVector(X, Y, Z), Lod));
+
+						for (int32 i = 0; i < 2; i++)
+						{
+							MeshData.Reset(Context->NumMaterials, Context->bSingleMeshSection);
+
+							const double StartTime = FPlatformTime::Seconds();
+							Context->BuildLodChunkMesh(Request, i == 1, MeshData);
+							Seconds[i] += FPlatformTime::Seconds() - StartTime;
+							Triangles[i] += MeshData.GetNumTriangles();
+						}
+					}
+				}
+			}
+
+			// Each node covers 2^Lod chunks along every axis
+			const int32 ChunksPerNode = 1 << (3 * Lod);
+			UE_LOG(LogVoxelTerrain, Display, TEXT("  LOD %d blocky: %llu triangles, %.3f ms per node, %.4f ms per chunk covered"), Lod, Triangles[0], Seconds[0] * 1000.0 / NumNodes, Seconds[0] * 1000.0 / (double(NumNodes) * ChunksPerNode));
+			UE_LOG(LogVoxelTerrain, Display, TEXT("  LOD %d smooth: %llu triangles, %.3f ms per node, %.4f ms per chunk covered"), Lod, Triangles[1], Seconds[1] * 1000.0 / NumNodes, Seconds[1] * 1000.0 / (double(NumNodes) * ChunksPerNode));
+		}
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs BenchmarkLodCommand(
+	TEXT("VoxelTerrain.BenchmarkLod"),
+	TEXT("Compares the triangle count and generation time of blocky and smooth nodes at every level of detail. Usage: VoxelTerrain.BenchmarkLod [NumNodesPerAxis]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchmarkLod));
+
+// Carves spheres out of the terrain around its origin and logs how long the game thread spent on each edit.
+// The remeshing happens on the workers over the next few frames, so it isn't part of the time.
+// Usage: VoxelTerrain.BenchmarkEdits [NumEdits] [RadiusInVoxels]
+static void BenchmarkEdits(const TArray<FString>& Args, UWorld* World)
+{
+	const int32 NumEdits = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 100;
+	const float Radius = Args.Num() > 1 ? FMath::Max(0.5f, FCString::Atof(*Args[1])) : 3.f;
+
+	for (TActorIterator<AVoxelTerrainActor> It(World); It; ++It)
+	{
+		AVoxelTerrainActor* Terrain = *It;
+		FRandomStream Random(Terrain->Seed);
+
+		// Stay within the chunks that are generated around the origin
+		const int32 HalfWidthX = FMath::Max(1, Terrain->ChunksToGenerateX * FVoxelChunkTraits::Size);
+		const int32 HalfWidthY = FMath::Max(1, Terrain->ChunksToGenerateY * FVoxelChunkTraits::Size);
+		const int32 HalfHeight = FMath::Max(1, FMath::CeilToInt(Terrain->TerrainHeight));
+
+		int32 NumChanged = 0;
+		double WorstSeconds = 0;
+		const double StartTime = FPlatformTime::Seconds();
+
+		for (int32 i = 0; i < NumEdits; i++)
+		{
+			const FIntVector Voxel(Random.RandRange(-HalfWidthX, HalfWidthX), Random.RandRange(-HalfWidthY, HalfWidthY), Random.RandRange(-HalfHeight, HalfHeight));
+
+			const double EditStartTime = FPlatformTime::Seconds();
+			NumChanged += Terrain->EditSphere(Terrain->VoxelToWorld(Voxel), Radius * 100.f * Terrain->GetActorScale().GetMax(), EVoxelEditMode::Carve) ? 1 : 0;
+			WorstSeconds = FMath::Max(WorstSeconds, FPlatformTime::Seconds() - EditStartTime);
+		}
+
+		const double Seconds = FPlatformTime::Seconds() - StartTime;
+		UE_LOG(LogVoxelTerrain, Display, TEXT("%s: %d edits with a radius of %.1f voxels, %d changed the terrain"), *Terrain->GetName(), NumEdits, Radius, NumChanged);
+		UE_LOG(LogVoxelTerrain, Display, TEXT("  %.3f ms per edit, %.3f ms for the slowest, %d chunks waiting to be remeshed"), Seconds * 1000.0 / NumEdits, WorstSeconds * 1000.0, Terrain->GetNumDirtyChunks());
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs BenchmarkEditsCommand(
+	TEXT("VoxelTerrain.BenchmarkEdits"),
+	TEXT("Carves spheres out of the terrain and logs how long each edit takes on the game thread. Usage: VoxelTerrain.BenchmarkEdits [NumEdits] [RadiusInVoxels]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchmarkEdits));
+
+// What meshing a block of voxels in chunks of one size cost
+struct FChunkSizeResult
+{
+	int32 NumChunks = 0;
+	uint64 NumTriangles = 0;
+	int64 MeshBytes = 0;
+	int64 VoxelsRead = 0;
+	double Seconds = 0;
+};
+
+// Extracts and builds every chunk of ChunkTraits size in a block of voxels. The noise is generated and paged in first, so only the meshing is timed.
+// Overlapping chunks extract 63 voxels around every 32 voxel step, which is how the terrain used to be split up.
+template<typename ChunkTraits>
+static FChunkSizeResult MeshBlockInChunks(AVoxelTerrainActor* Terrain, FVoxelGenerationContext& Context, const FIntVector& FirstVoxel, int32 BlockSize, bool bOverlapping = false)
+{
+	FChunkSizeResult Result;
+	FVoxelChunkWorkspace Workspace;
+	FVoxelChunkMeshData MeshData;
+
+	const int32 ChunksPerAxis = FMath::Max(1, BlockSize / ChunkTraits::Size);
+	const bool bSmooth = Terrain->SurfaceExtractor == EVoxelSurfaceExtractor::MarchingCubes;
+
+	for (int32 Z = 0; Z < ChunksPerAxis; Z++)
+	{
+		for (int32 Y = 0; Y < ChunksPerAxis; Y++)
+		{
+			for (int32 X = 0; X < ChunksPerAxis; X++)
+			{
+				const FIntVector Lower = Terrain->VoxelToVolume(FirstVoxel + ChunkTraits::ChunkToVoxel(FIntVector(X, Y, Z)));
+				const FIntVector Upper = bOverlapping ? Lower + FIntVector(62) : Lower + FIntVector(ChunkTraits::Size - 1);
+				const PolyVox::Region Region(Vector3DInt32(Lower.X, Lower.Y, Lower.Z), Vector3DInt32(Upper.X, Upper.Y, Upper.Z));
+
+				const PolyVox::Region SourceRegion = FVoxelGenerationContext::GetSourceRegion(Region, Terrain->SurfaceExtractor);
+				Context.Pager->StageRegion(SourceRegion);
+				Context.Volume->prefetch(SourceRegion);
+
+				MeshData.Reset(Context.NumMaterials, Context.bSingleMeshSection);
+
+				const FVector OffsetLocation(ChunkTraits::ChunkToVoxel(FIntVector(X, Y, Z)));
+				const double StartTime = FPlatformTime::Seconds();
+				if (bSmooth)
+				{
+					FVoxelDensityField DensityField(nullptr, FIntVector::ZeroValue, FIntVector::ZeroValue);
+					auto ExtractedMesh = Context.ExtractMarchingCubesSurface(Region, Workspace, DensityField);
+					Workspace.MeshBuilder.BuildMarchingCubesMesh(ExtractedMesh, OffsetLocation, MeshData, 1.f, &DensityField);
+				}
+				else
+				{
+					auto ExtractedMesh = Context.ExtractSurface(Region, Terrain->SurfaceExtractor, Workspace);
+					Workspace.MeshBuilder.BuildCubicMesh(ExtractedMesh, OffsetLocation, MeshData);
+				}
+				Result.Seconds += FPlatformTime::Seconds() - StartTime;
+
+				const int32 ReadSize = Region.getWidthInVoxels() + (bSmooth ? ChunkTraits::SmoothApronBelow + ChunkTraits::SmoothApronAbove : ChunkTraits::Apron);
+				Result.NumChunks++;
+				Result.NumTriangles += MeshData.GetNumTriangles();
+				Result.MeshBytes += MeshData.GetMeshBytes();
+				Result.VoxelsRead += int64(ReadSize) * ReadSize * ReadSize;
+			}
+		}
+	}
+
+	return Result;
+}
+
+static void LogChunkSizeResult(const TCHAR* Name, const FChunkSizeResult& Result, int32 BlockSize)
+{
+	const int64 BlockVoxels = int64(BlockSize) * BlockSize * BlockSize;
+
+	UE_LOG(LogVoxelTerrain, Display, TEXT("  %s %4d chunks, %8llu triangles, %7.1f KB of mesh, %.2f voxels read per voxel, %8.2f ms (%.1f voxels per us)"),
+		Name, Result.NumChunks, Result.NumTriangles, Result.MeshBytes / 1024.0, double(Result.VoxelsRead) / BlockVoxels, Result.Seconds * 1000.0, BlockVoxels / FMath::Max(Result.Seconds * 1000000.0, 1.0));
+}
+
+// Meshes the same block of voxels in 16, 32 and 64 voxel chunks, and in the overlapping chunks the terrain used to use,
+// and logs how long each took, how many voxels they read and how much mesh they made.
+// Usage: VoxelTerrain.BenchmarkChunkSizes [BlockSizeInVoxels]
+static void BenchmarkChunkSizes(const TArray<FString>& Args, UWorld* World)
+{
+	// Round up to whole 64 voxel chunks, so every size covers the same voxels
+	const int32 BlockSize = Args.Num() > 0 ? FMath::Max(1, FMath::DivideAndRoundUp(FCString::Atoi(*Args[0]), 64)) * 64 : 128;
+
+	for (TActorIterator<AVoxelTerrainActor> It(World); It; ++It)
+	{
+		AVoxelTerrainActor* Terrain = *It;
+		TSharedPtr<FVoxelGenerationContext, ESPMode::ThreadSafe> Context = Terrain->GetGenerationContext();
+
+		if (!Context.IsValid())
+			continue;
+
+		// Centre the block on the terrain's origin, where there is most likely to be a surface
+		const FIntVector FirstVoxel(-BlockSize / 2);
+
+		UE_LOG(LogVoxelTerrain, Display, TEXT("%s: meshing a %d voxel block in chunks of each size (the terrain uses %d)"), *Terrain->GetName(), BlockSize, FVoxelChunkTraits::Size);
+		LogChunkSizeResult(TEXT("16:         "), MeshBlockInChunks<FVoxelChunkTraits16>(Terrain, *Context, FirstVoxel, BlockSize), BlockSize);
+		LogChunkSizeResult(TEXT("32:         "), MeshBlockInChunks<FVoxelChunkTraits32>(Terrain, *Context, FirstVoxel, BlockSize), BlockSize);
+		LogChunkSizeResult(TEXT("64:         "), MeshBlockInChunks<FVoxelChunkTraits64>(Terrain, *Context, FirstVoxel, BlockSize), BlockSize);
+		LogChunkSizeResult(TEXT("Overlapping:"), MeshBlockInChunks<FVoxelChunkTraits32>(Terrain, *Context, FirstVoxel, BlockSize, true), BlockSize);
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs BenchmarkChunkSizesCommand(
+	TEXT("VoxelTerrain.BenchmarkChunkSizes"),
+	TEXT("Compares meshing throughput and mesh memory for 16, 32 and 64 voxel chunks. Usage: VoxelTerrain.BenchmarkChunkSizes [BlockSizeInVoxels]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchmarkChunkSizes));
+
+// Fires the same rays down through the terrain as physics line traces against the chunk collision, as voxel raycasts one at a time,
+// and as one batch spread over every core, and logs how many of each a second there were and how often they agreed.
+// Physics only hits the chunks that have collision, so the agreement is counted over the rays it hit.
+// Usage: VoxelTerrain.BenchmarkQueries [NumRays]
+static void BenchmarkQueries(const TArray<FString>& Args, UWorld* World)
+{
+	const int32 NumRays = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 10000;
+
+	for (TActorIterator<AVoxelTerrainActor> It(World); It; ++It)
+	{
+		AVoxelTerrainActor* Terrain = *It;
+		FRandomStream Random(Terrain->Seed);
+
+		// Rays start above the highest ground and end below the lowest, within the chunks that are generated around the origin
+		const int32 HalfWidthX = FMath::Max(1, Terrain->ChunksToGenerateX * FVoxelChunkTraits::Size / 2);
+		const int32 HalfWidthY = FMath::Max(1, Terrain->ChunksToGenerateY * FVoxelChunkTraits::Size / 2);
+		const int32 HalfHeight = FMath::Max(1, FMath::CeilToInt(Terrain->TerrainHeight));
+
+		TArray<FVoxelQuery> Queries;
+		Queries.SetNum(NumRays);
+
+		for (FVoxelQuery& Query : Queries)
+		{
+			const FVector Start(Random.FRandRange(-HalfWidthX, HalfWidthX), Random.FRandRange(-HalfWidthY, HalfWidthY), HalfHeight);
+			const FVector End = Start + FVector(Random.FRandRange(-16.f, 16.f), Random.FRandRange(-16.f, 16.f), -2.f * HalfHeight);
+
+			Query.Type = EVoxelQueryType::Raycast;
+			Query.Start = Terrain->GetActorTransform().TransformPosition(Start * 100.f);
+			Query.End = Terrain->GetActorTransform().TransformPosition(End * 100.f);
+		}
+
+		TArray<FHitResult> PhysicsHits;
+		PhysicsHits.SetNum(NumRays);
+		int32 NumPhysicsHits = 0;
+
+		const double PhysicsStartTime = FPlatformTime::Seconds();
+		for (int32 i = 0; i < NumRays; i++)
+			NumPhysicsHits += World->LineTraceSingleByChannel(PhysicsHits[i], Queries[i].Start, Queries[i].End, ECC_Visibility) ? 1 : 0;
+		const double PhysicsSeconds = FPlatformTime::Seconds() - PhysicsStartTime;
+
+		// Run the rays once first, so paging in chunks the streaming hadn't touched yet isn't counted against the voxel raycasts
+		TArray<FVoxelQueryHit> VoxelHits;
+		Terrain->RunQueries(Queries, VoxelHits);
+		int32 NumVoxelHits = 0;
+
+		const double VoxelStartTime = FPlatformTime::Seconds();
+		for (int32 i = 0; i < NumRays; i++)
+			NumVoxelHits += Terrain->RaycastVoxels(Queries[i].Start, Queries[i].End, VoxelHits[i]) ? 1 : 0;
+		const double VoxelSeconds = FPlatformTime::Seconds() - VoxelStartTime;
+
+		TArray<FVoxelQueryHit> BatchHits;
+		const double BatchStartTime = FPlatformTime::Seconds();
+		Terrain->RunQueries(Queries, BatchHits);
+		const double BatchSeconds = FPlatformTime::Seconds() - BatchStartTime;
+
+		// A trace that hit the terrain's collision should have hit the same surface, give or take a voxel for how the collision was merged
+		const float Tolerance = 100.f * Terrain->GetActorScale().GetMax();
+		int32 NumCompared = 0;
+		int32 NumAgreed = 0;
+
+		for (int32 i = 0; i < NumRays; i++)
+		{
+			if (!PhysicsHits[i].bBlockingHit || PhysicsHits[i].GetActor() != Terrain)
+				continue;
+
+			NumCompared++;
+			if (VoxelHits[i].bHit && FMath::Abs(VoxelHits[i].Distance - PhysicsHits[i].Distance) <= Tolerance)
+				NumAgreed++;
+		}
+
+		UE_LOG(LogVoxelTerrain, Display, TEXT("%s: %d rays down through the terrain, %d chunks with collision"), *Terrain->GetName(), NumRays, Terrain->GetNumCollidableChunks());
+		UE_LOG(LogVoxelTerrain, Display, TEXT("  Physics traces: %d hits, %.3f ms (%.0f rays per ms)"), NumPhysicsHits, PhysicsSeconds * 1000.0, NumRays / FMath::Max(PhysicsSeconds * 1000.0, 1e-6));
+		UE_LOG(LogVoxelTerrain, Display, TEXT("  Voxel raycasts: %d hits, %.3f ms (%.0f rays per ms)"), NumVoxelHits, VoxelSeconds * 1000.0, NumRays / FMath::Max(VoxelSeconds * 1000.0, 1e-6));
+		UE_LOG(LogVoxelTerrain, Display, TEXT("  Voxel batch:    %.3f ms (%.0f rays per ms) over %d cores"), BatchSeconds * 1000.0, NumRays / FMath::Max(BatchSeconds * 1000.0, 1e-6), FPlatformMisc::NumberOfCoresIncludingHyperthreads());
+		UE_LOG(LogVoxelTerrain, Display, TEXT("  %d of the %d rays that hit the terrain's collision hit the voxels within a voxel of it"), NumAgreed, NumCompared);
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs BenchmarkQueriesCommand(
+	TEXT("VoxelTerrain.BenchmarkQueries"),
+	TEXT("Compares voxel raycasts, one at a time and batched, with physics line traces against the chunk collision. Usage: VoxelTerrain.BenchmarkQueries [NumRays]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchmarkQueries));
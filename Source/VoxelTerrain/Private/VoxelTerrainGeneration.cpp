@@ -0,0 +1,551 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#include "VoxelTerrainGeneration.h"
+#include "VoxelTerrain.h"
+#include "VoxelTerrainStats.h"
+
+// PolyVox
+#include "PolyVox/RawVolume.h"
+
+using namespace PolyVox;
+
+// Copies a region of the volume into the workspace, and from there into a volume the PolyVox extractors can walk a voxel at a time
+static void ReadSnapshot(const FVoxelPaletteVolume& Volume, const PolyVox::Region& SnapshotRegion, FVoxelChunkWorkspace& Workspace, RawVolume<MaterialDensityPair88>& OutSnapshotVolume)
+{
+	TArray<MaterialDensityPair88>& Voxels = Workspace.RegionVoxels;
+	Voxels.SetNumUninitialized(SnapshotRegion.getWidthInVoxels() * SnapshotRegion.getHeightInVoxels() * SnapshotRegion.getDepthInVoxels());
+	Volume.ReadRegion(SnapshotRegion, Voxels.GetData());
+
+	int32 VoxelIndex = 0;
+	for (int32 z = SnapshotRegion.getLowerZ(); z <= SnapshotRegion.getUpperZ(); z++)
+		for (int32 y = SnapshotRegion.getLowerY(); y <= SnapshotRegion.getUpperY(); y++)
+			for (int32 x = SnapshotRegion.getLowerX(); x <= SnapshotRegion.getUpperX(); x++)
+				OutSnapshotVolume.setVoxel(x, y, z, Voxels[VoxelIndex++]);
+}
+
+FVoxelGenerationContext::FVoxelGenerationContext(const TSharedPtr<VoxelTerrainPager, ESPMode::ThreadSafe>& InPager, const TSharedPtr<FVoxelPaletteVolume, ESPMode::ThreadSafe>& InVolume, int32 InNumMaterials)
+	: Pager(InPager)
+	, Volume(InVolume)
+	, NumMaterials(InNumMaterials)
+{
+}
+
+void FVoxelGenerationContext::BuildChunkMesh(const FVoxelChunkRequest& Request, FVoxelChunkMeshData& OutMeshData)
+{
+	VOXEL_TERRAIN_SCOPE(STAT_VoxelTerrain_GenerateChunk);
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	OutMeshData.Reset(NumMaterials, bSingleMeshSection);
+	OutMeshData.ChunkCoord = Request.ChunkCoord;
+	OutMeshData.Lod = Request.Lod;
+	OutMeshData.Epoch = Request.Epoch;
+	OutMeshData.bHasMesh = Request.bBuildMesh;
+	OutMeshData.bHasCollision = Request.bBuildCollision && Request.Lod == 0;
+
+	if (Request.Lod > 0)
+		BuildLodChunkMesh(Request, Request.SurfaceExtractor == EVoxelSurfaceExtractor::MarchingCubes, OutMeshData);
+	else
+		BuildVolumeChunkMesh(Request, OutMeshData);
+
+	OutMeshData.GenerationSeconds = FPlatformTime::Seconds() - StartTime;
+
+	if (OutMeshData.bCached)
+		INC_DWORD_STAT(STAT_VoxelTerrain_ChunksCached);
+	else if (OutMeshData.bSkipped)
+		INC_DWORD_STAT(STAT_VoxelTerrain_ChunksSkipped);
+	else if (!OutMeshData.bCancelled && OutMeshData.bHasMesh)
+		INC_DWORD_STAT(STAT_VoxelTerrain_ChunksGenerated);
+}
+
+void FVoxelGenerationContext::BuildVolumeChunkMesh(const FVoxelChunkRequest& Request, FVoxelChunkMeshData& OutMeshData)
+{
+	// Smooth chunks reach further into the chunks after them than the blocky ones do
+	const bool bSmooth = Request.SurfaceExtractor == EVoxelSurfaceExtractor::MarchingCubes;
+	const PolyVox::Region SourceRegion = GetSourceRegion(Request.Region, Request.SurfaceExtractor);
+
+	// A baked chunk doesn't need anything generated at all. The meshes are only ever baked from the noise, so a chunk reading saved or edited voxels
+	// has to be built from those instead, even if a later bake put it back in the cache.
+	if (Request.bUseMeshCache && MeshCache.IsValid() && !Pager->IsRegionModified(SourceRegion))
+	{
+		VOXEL_TERRAIN_SCOPE(STAT_VoxelTerrain_ReadMeshCache);
+
+		if (MeshCache->ReadChunk(Request.ChunkCoord, Request.bBuildMesh, OutMeshData.bHasCollision, OutMeshData))
+		{
+			OutMeshData.bCached = true;
+			OutMeshData.bCancelled = IsCancelled(Request.Epoch);
+			return;
+		}
+	}
+
+	// A region with no surface in it would only give an empty mesh, so don't generate or extract anything for it.
+	// This is decided from the bounds of the noise, so it never touches the volume.
+	if (Pager->IsRegionFeatureless(SourceRegion))
+	{
+		// The chunk is either all air, which sees straight through, or all solid, which sees nothing
+		const FIntVector Lower(Request.Region.getLowerX(), Request.Region.getLowerY(), Request.Region.getLowerZ());
+		const FIntVector Upper(Request.Region.getUpperX(), Request.Region.getUpperY(), Request.Region.getUpperZ());
+
+		MaterialDensityPair88 Voxel;
+		if (Request.bBuildVisibility && Pager->ClassifyBox(Lower, Upper, Voxel))
+		{
+			OutMeshData.bHasVisibility = true;
+			OutMeshData.Visibility = Voxel.getMaterial() == 0 ? FVoxelChunkVisibility() : FVoxelChunkVisibility(0);
+		}
+
+		OutMeshData.bSkipped = true;
+		OutMeshData.bCancelled = IsCancelled(Request.Epoch);
+		return;
+	}
+
+	// Stage 1: Generate the noise for every volume chunk the mesh touches.
+	// This doesn't touch the volume, so it runs on all of the workers at once.
+	double StageStartTime = FPlatformTime::Seconds();
+	Pager->StageRegion(SourceRegion);
+	OutMeshData.NoiseSeconds = FPlatformTime::Seconds() - StageStartTime;
+
+	if (IsCancelled(Request.Epoch))
+	{
+		OutMeshData.bCancelled = true;
+		return;
+	}
+
+	TUniquePtr<FVoxelChunkWorkspace> Workspace = AcquireWorkspace();
+
+	if (Request.bBuildVisibility)
+		BuildChunkVisibility(Request, *Workspace, OutMeshData);
+
+	if (bSmooth)
+	{
+		BuildSmoothChunkMesh(Request, *Workspace, OutMeshData);
+	}
+	else if (Request.bBuildMesh)
+	{
+		// Stage 2: Extract the voxel mesh.
+		// The volume pages in the chunks we just staged, which only has to copy them.
+		StageStartTime = FPlatformTime::Seconds();
+		auto ExtractedMesh = ExtractSurface(Request.Region, Request.SurfaceExtractor, *Workspace);
+		OutMeshData.ExtractSeconds = FPlatformTime::Seconds() - StageStartTime;
+
+		// Stage 3: Convert the mesh into the buffers the procedural mesh component wants.
+		StageStartTime = FPlatformTime::Seconds();
+		if (ExtractedMesh.getNoOfIndices() > 0 && !IsCancelled(Request.Epoch))
+			Workspace->MeshBuilder.BuildCubicMesh(ExtractedMesh, Request.OffsetLocation, OutMeshData);
+		OutMeshData.MeshBuildSeconds = FPlatformTime::Seconds() - StageStartTime;
+	}
+
+	// Stage 4: Merge the voxels into a collision mesh, if the chunk is close enough to something that can collide with it
+	if (!bSmooth && OutMeshData.bHasCollision && !IsCancelled(Request.Epoch))
+	{
+		StageStartTime = FPlatformTime::Seconds();
+		BuildCollisionMesh(Request, *Workspace, OutMeshData);
+		OutMeshData.CollisionSeconds = FPlatformTime::Seconds() - StageStartTime;
+	}
+
+	OutMeshData.bCancelled = IsCancelled(Request.Epoch);
+	ReleaseWorkspace(MoveTemp(Workspace));
+}
+
+void FVoxelGenerationContext::BuildCollisionMesh(const FVoxelChunkRequest& Request, FVoxelChunkWorkspace& Workspace, FVoxelChunkMeshData& OutMeshData)
+{
+	VOXEL_TERRAIN_SCOPE(STAT_VoxelTerrain_BuildCollision);
+
+	if (!Request.bBuildMesh || Request.SurfaceExtractor != EVoxelSurfaceExtractor::Greedy)
+		Workspace.GreedyMesher.GatherVoxels(Volume.Get(), Request.Region);
+
+	// Merging across materials leaves a flat floor as a single quad however it is painted
+	auto CollisionMesh = Workspace.GreedyMesher.ExtractMesh(true);
+
+	if (CollisionMesh.getNoOfIndices() > 0)
+		Workspace.MeshBuilder.BuildCollisionMesh(CollisionMesh, Request.OffsetLocation, OutMeshData);
+}
+
+void FVoxelGenerationContext::BuildSmoothChunkMesh(const FVoxelChunkRequest& Request, FVoxelChunkWorkspace& Workspace, FVoxelChunkMeshData& OutMeshData)
+{
+	if (!Request.bBuildMesh && !OutMeshData.bHasCollision)
+		return;
+
+	// Stage 2: Extract the smooth mesh. This is the same for the render mesh and the collision, so it is only done once.
+	double StageStartTime = FPlatformTime::Seconds();
+	FVoxelDensityField DensityField(nullptr, FIntVector::ZeroValue, FIntVector::ZeroValue);
+	auto ExtractedMesh = ExtractMarchingCubesSurface(Request.Region, Workspace, DensityField);
+	OutMeshData.ExtractSeconds = FPlatformTime::Seconds() - StageStartTime;
+
+	if (ExtractedMesh.getNoOfIndices() == 0 || IsCancelled(Request.Epoch))
+		return;
+
+	// Stage 3: Convert the mesh, with the normals from the gradient of the snapshot it was extracted from
+	if (Request.bBuildMesh)
+	{
+		StageStartTime = FPlatformTime::Seconds();
+		Workspace.MeshBuilder.BuildMarchingCubesMesh(ExtractedMesh, Request.OffsetLocation, OutMeshData, 1.f, &DensityField);
+		OutMeshData.MeshBuildSeconds = FPlatformTime::Seconds() - StageStartTime;
+	}
+
+	// Stage 4: Collide with the triangles that are drawn. Greedy merging the voxels would leave steps under a smooth slope.
+	if (OutMeshData.bHasCollision)
+	{
+		VOXEL_TERRAIN_SCOPE(STAT_VoxelTerrain_BuildCollision);
+
+		StageStartTime = FPlatformTime::Seconds();
+		Workspace.MeshBuilder.BuildCollisionMesh(ExtractedMesh, Request.OffsetLocation, OutMeshData);
+		OutMeshData.CollisionSeconds = FPlatformTime::Seconds() - StageStartTime;
+	}
+}
+
+void FVoxelGenerationContext::BuildChunkVisibility(const FVoxelChunkRequest& Request, FVoxelChunkWorkspace& Workspace, FVoxelChunkMeshData& OutMeshData)
+{
+	VOXEL_TERRAIN_SCOPE(STAT_VoxelTerrain_BuildVisibility);
+
+	// Just the chunk's own voxels. The apron belongs to the chunk before, which works out its own faces.
+	const PolyVox::Region& Region = Request.Region;
+	check(Region.getWidthInVoxels() == FVoxelChunkTraits::Size && Region.getHeightInVoxels() == FVoxelChunkTraits::Size && Region.getDepthInVoxels() == FVoxelChunkTraits::Size);
+
+	Workspace.RegionVoxels.SetNumUninitialized(FVoxelChunkTraits::NumVoxels, false);
+	Volume->ReadRegion(Region, Workspace.RegionVoxels.GetData());
+
+	OutMeshData.Visibility = FVoxelChunkVisibility::Compute(Workspace.RegionVoxels.GetData(), FVoxelChunkTraits::Size, Workspace.VisibilityVisited, Workspace.VisibilityStack);
+	OutMeshData.bHasVisibility = true;
+}
+
+void FVoxelGenerationContext::BuildLodChunkMesh(const FVoxelChunkRequest& Request, bool bSmooth, FVoxelChunkMeshData& OutMeshData)
+{
+	const int32 Step = 1 << Request.Lod;
+	const int32 NodeSamples = Request.Region.getWidthInVoxels() / Step;
+
+	// Blocky nodes own the voxels of samples 0 to NodeSamples - 1. Smooth nodes own the cells between samples 0 and NodeSamples,
+	// so they need one more sample. Either way there is one more sample of apron on every side, and marching cubes reads one past that for its normals.
+	const int32 InnerSamples = bSmooth ? NodeSamples + 1 : NodeSamples;
+	const int32 SamplesPerAxis = NodeSamples + 3;
+	const FIntVector Origin = FIntVector(Request.Region.getLowerX(), Request.Region.getLowerY(), Request.Region.getLowerZ()) - FIntVector(Step);
+
+	// Skip the node if the noise can't have a surface anywhere near it
+	MaterialDensityPair88 UniformVoxel;
+	if (Pager->ClassifyBox(Origin, Origin + FIntVector((SamplesPerAxis - 1) * Step), UniformVoxel))
+	{
+		OutMeshData.bSkipped = true;
+		OutMeshData.bCancelled = IsCancelled(Request.Epoch);
+		return;
+	}
+
+	TUniquePtr<FVoxelChunkWorkspace> Workspace = AcquireWorkspace();
+
+	TArray<MaterialDensityPair88>& Samples = Workspace->LodSamples;
+	Samples.SetNumUninitialized(SamplesPerAxis * SamplesPerAxis * SamplesPerAxis);
+
+	double StageStartTime = FPlatformTime::Seconds();
+	Pager->GenerateSampledRegion(Origin, FIntVector(SamplesPerAxis), Step, Samples.GetData());
+	OutMeshData.NoiseSeconds = FPlatformTime::Seconds() - StageStartTime;
+
+	if (IsCancelled(Request.Epoch))
+	{
+		OutMeshData.bCancelled = true;
+		ReleaseWorkspace(MoveTemp(Workspace));
+		return;
+	}
+
+	// Sample coordinates start at -1, for the apron
+	auto GetSample = [&Samples, SamplesPerAxis](int32 X, int32 Y, int32 Z) -> const MaterialDensityPair88&
+	{
+		return Samples[(X + 1) + (Y + 1) * SamplesPerAxis + (Z + 1) * SamplesPerAxis * SamplesPerAxis];
+	};
+
+	// A sample is buried if it and every sample around it is solid
+	auto IsBuried = [&GetSample](int32 X, int32 Y, int32 Z)
+	{
+		for (int32 z = Z - 1; z <= Z + 1; z++)
+			for (int32 y = Y - 1; y <= Y + 1; y++)
+				for (int32 x = X - 1; x <= X + 1; x++)
+					if (GetSample(x, y, z).getMaterial() == 0)
+						return false;
+
+		return true;
+	};
+
+	// Copy the samples into a volume the extractors can read, turning the apron into skirts.
+	// An apron sample only keeps its value when the sample just inside the node is buried, so nothing is generated between them.
+	// Everywhere else the apron is air, which closes the surface off along the sides of the node. That hides the cracks next to nodes of a
+	// different level of detail, and it means a face on the boundary between two nodes only comes from the node its solid voxel is in.
+	// Smooth nodes take their normals from the skirted samples as well, so they are kept in the workspace too.
+	const PolyVox::Region SampleRegion(Vector3DInt32(-1, -1, -1), Vector3DInt32(SamplesPerAxis - 2, SamplesPerAxis - 2, SamplesPerAxis - 2));
+	RawVolume<MaterialDensityPair88> SampleVolume(SampleRegion);
+
+	TArray<MaterialDensityPair88>& SkirtedSamples = Workspace->RegionVoxels;
+	SkirtedSamples.SetNumUninitialized(Samples.Num(), false);
+
+	for (int32 z = -1; z < SamplesPerAxis - 1; z++)
+	{
+		for (int32 y = -1; y < SamplesPerAxis - 1; y++)
+		{
+			for (int32 x = -1; x < SamplesPerAxis - 1; x++)
+			{
+				MaterialDensityPair88 Voxel = GetSample(x, y, z);
+
+				const bool bApron = x < 0 || y < 0 || z < 0 || x >= InnerSamples || y >= InnerSamples || z >= InnerSamples;
+				if (bApron && !IsBuried(FMath::Clamp(x, 0, InnerSamples - 1), FMath::Clamp(y, 0, InnerSamples - 1), FMath::Clamp(z, 0, InnerSamples - 1)))
+					Voxel = MaterialDensityPair88();
+
+				SampleVolume.setVoxel(x, y, z, Voxel);
+				SkirtedSamples[(x + 1) + (y + 1) * SamplesPerAxis + (z + 1) * SamplesPerAxis * SamplesPerAxis] = Voxel;
+			}
+		}
+	}
+
+	// The samples are Step voxels apart and the node starts at OffsetLocation
+	if (bSmooth)
+	{
+		// The cells in the apron are extracted too, since that is where the skirts are. The mesh starts at sample -1.
+		Mesh<MarchingCubesVertex<MaterialDensityPair88>> ExtractedMesh;
+		{
+			VOXEL_TERRAIN_SCOPE(STAT_VoxelTerrain_Extract);
+			StageStartTime = FPlatformTime::Seconds();
+			ExtractedMesh = extractMarchingCubesMesh(&SampleVolume, PolyVox::Region(Vector3DInt32(-1, -1, -1), Vector3DInt32(InnerSamples, InnerSamples, InnerSamples)));
+			OutMeshData.ExtractSeconds = FPlatformTime::Seconds() - StageStartTime;
+		}
+
+		StageStartTime = FPlatformTime::Seconds();
+		if (ExtractedMesh.getNoOfIndices() > 0 && !IsCancelled(Request.Epoch))
+		{
+			// The mesh and the samples both start at sample -1
+			const FVoxelDensityField DensityField(SkirtedSamples.GetData(), FIntVector::ZeroValue, FIntVector(SamplesPerAxis));
+			Workspace->MeshBuilder.BuildMarchingCubesMesh(ExtractedMesh, Request.OffsetLocation - FVector(Step), OutMeshData, Step, &DensityField);
+		}
+		OutMeshData.MeshBuildSeconds = FPlatformTime::Seconds() - StageStartTime;
+	}
+	else
+	{
+		Mesh<CubicVertex<MaterialDensityPair88>> ExtractedMesh;
+		{
+			VOXEL_TERRAIN_SCOPE(STAT_VoxelTerrain_Extract);
+			StageStartTime = FPlatformTime::Seconds();
+			Workspace->GreedyMesher.GatherVoxels(&SampleVolume, PolyVox::Region(Vector3DInt32(0, 0, 0), Vector3DInt32(NodeSamples - 1, NodeSamples - 1, NodeSamples - 1)), true);
+			ExtractedMesh = Workspace->GreedyMesher.ExtractMesh();
+			OutMeshData.ExtractSeconds = FPlatformTime::Seconds() - StageStartTime;
+		}
+
+		// Blocky faces sit half a voxel from the voxel's position. A sample stands for the Step voxels starting at it,
+		// so its faces have to move out by the rest of those voxels to line up with the full resolution chunks.
+		StageStartTime = FPlatformTime::Seconds();
+		if (ExtractedMesh.getNoOfIndices() > 0 && !IsCancelled(Request.Epoch))
+			Workspace->MeshBuilder.BuildCubicMesh(ExtractedMesh, Request.OffsetLocation + FVector(0.5f * (Step - 1)), OutMeshData, Step);
+		OutMeshData.MeshBuildSeconds = FPlatformTime::Seconds() - StageStartTime;
+	}
+
+	OutMeshData.bCancelled = IsCancelled(Request.Epoch);
+	ReleaseWorkspace(MoveTemp(Workspace));
+}
+
+Mesh<CubicVertex<MaterialDensityPair88>> FVoxelGenerationContext::ExtractSurface(const PolyVox::Region& Region, EVoxelSurfaceExtractor Extractor, FVoxelChunkWorkspace& Workspace)
+{
+	// This includes waiting for an edit to the chunks the region touches, which is part of what extraction costs while the terrain is being edited
+	VOXEL_TERRAIN_SCOPE(STAT_VoxelTerrain_Extract);
+
+	switch (Extractor)
+	{
+	case EVoxelSurfaceExtractor::Greedy:
+	{
+		// Gathering takes a snapshot of the voxels, so the merging works on a consistent copy even if the region is edited in the meantime
+		Workspace.GreedyMesher.GatherVoxels(Volume.Get(), Region);
+		return Workspace.GreedyMesher.ExtractMesh();
+	}
+
+	case EVoxelSurfaceExtractor::Cubic:
+	default:
+	{
+		// Generate a blocky mesh from the voxels.
+		// The extractor walks the volume a voxel at a time without locking it, so it reads a snapshot of the region and its neighbours instead.
+		const PolyVox::Region SnapshotRegion(Region.getLowerCorner() - Vector3DInt32(1, 1, 1), Region.getUpperCorner() + Vector3DInt32(1, 1, 1));
+		RawVolume<MaterialDensityPair88> SnapshotVolume(SnapshotRegion);
+		ReadSnapshot(*Volume, SnapshotRegion, Workspace, SnapshotVolume);
+
+		return extractCubicMesh(&SnapshotVolume, Region);
+	}
+	}
+}
+
+Mesh<MarchingCubesVertex<MaterialDensityPair88>> FVoxelGenerationContext::ExtractMarchingCubesSurface(const PolyVox::Region& Region, FVoxelChunkWorkspace& Workspace, FVoxelDensityField& OutDensityField)
+{
+	VOXEL_TERRAIN_SCOPE(STAT_VoxelTerrain_Extract);
+
+	// The cells run up to the first voxel of the next chunk, so the vertices on a shared side come from the same voxels in both chunks.
+	// The snapshot has one more voxel on every side of those for the normals.
+	const PolyVox::Region CellRegion(Region.getLowerCorner(), Region.getUpperCorner() + Vector3DInt32(1, 1, 1));
+	const int32 Below = FVoxelChunkTraits::SmoothApronBelow;
+	const int32 Above = FVoxelChunkTraits::SmoothApronAbove;
+	const PolyVox::Region SnapshotRegion(Region.getLowerCorner() - Vector3DInt32(Below, Below, Below), Region.getUpperCorner() + Vector3DInt32(Above, Above, Above));
+
+	RawVolume<MaterialDensityPair88> SnapshotVolume(SnapshotRegion);
+	ReadSnapshot(*Volume, SnapshotRegion, Workspace, SnapshotVolume);
+
+	// The mesh's positions start at the first voxel of the chunk
+	OutDensityField = FVoxelDensityField(Workspace.RegionVoxels.GetData(), FIntVector(-Below),
+		FIntVector(SnapshotRegion.getWidthInVoxels(), SnapshotRegion.getHeightInVoxels(), SnapshotRegion.getDepthInVoxels()));
+
+	return extractMarchingCubesMesh(&SnapshotVolume, CellRegion);
+}
+
+PolyVox::Region FVoxelGenerationContext::GetSourceRegion(const PolyVox::Region& Region, EVoxelSurfaceExtractor Extractor)
+{
+	if (Extractor != EVoxelSurfaceExtractor::MarchingCubes)
+		return Region;
+
+	// The pager already adds the voxel below, which is all marching cubes needs on that side
+	const int32 Above = FVoxelChunkTraits::SmoothApronAbove;
+	return PolyVox::Region(Region.getLowerCorner(), Region.getUpperCorner() + Vector3DInt32(Above, Above, Above));
+}
+
+TUniquePtr<FVoxelChunkWorkspace> FVoxelGenerationContext::AcquireWorkspace()
+{
+	{
+		FScopeLock PoolScopeLock(&PoolLock);
+
+		if (WorkspacePool.Num() > 0)
+			return WorkspacePool.Pop(false);
+	}
+
+	return MakeUnique<FVoxelChunkWorkspace>();
+}
+
+void FVoxelGenerationContext::ReleaseWorkspace(TUniquePtr<FVoxelChunkWorkspace>&& Workspace)
+{
+	FScopeLock PoolScopeLock(&PoolLock);
+	WorkspacePool.Add(MoveTemp(Workspace));
+}
+
+TSharedPtr<FVoxelChunkMeshData, ESPMode::ThreadSafe> FVoxelGenerationContext::AcquireMeshData()
+{
+	TSharedPtr<FVoxelChunkMeshData, ESPMode::ThreadSafe> MeshData;
+
+	{
+		FScopeLock PoolScopeLock(&PoolLock);
+
+		if (MeshDataPool.Num() > 0)
+			MeshData = MeshDataPool.Pop(false);
+	}
+
+	if (!MeshData.IsValid())
+		MeshData = MakeShareable(new FVoxelChunkMeshData());
+
+	// Pooled objects still hold whatever their last chunk left in them, so every path hands out a clean one
+	MeshData->Reset(NumMaterials, bSingleMeshSection);
+	return MeshData;
+}
+
+void FVoxelGenerationContext::ReleaseMeshData(const TSharedPtr<FVoxelChunkMeshData, ESPMode::ThreadSafe>& MeshData)
+{
+	FScopeLock PoolScopeLock(&PoolLock);
+	MeshDataPool.Add(MeshData);
+}
+
+void FVoxelChunkGenerationTask::DoWork()
+{
+	TSharedPtr<FVoxelChunkMeshData, ESPMode::ThreadSafe> MeshData = Context->AcquireMeshData();
+
+	// Chunks that were cancelled while they sat in the queue still report back, so the actor can keep count of what's in flight.
+	if (Context->IsCancelled(Request.Epoch))
+	{
+		MeshData->ChunkCoord = Request.ChunkCoord;
+		MeshData->Lod = Request.Lod;
+		MeshData->Epoch = Request.Epoch;
+		MeshData->bHasMesh = Request.bBuildMesh;
+		MeshData->bHasCollision = Request.bBuildCollision && Request.Lod == 0;
+		MeshData->bHasVisibility = Request.bBuildVisibility && Request.Lod == 0;
+		MeshData->bCancelled = true;
+	}
+	else
+	{
+		Context->BuildChunkMesh(Request, *MeshData);
+	}
+
+	Context->CompletedChunks.Enqueue(MeshData);
+}
+
+void FVoxelQueryBatch::RunQuery(const FVoxelTerrainQuery& VoxelQuery, const FTransform& TerrainTransform, const FVoxelQuery& Query, FVoxelQueryHit& OutHit)
+{
+	OutHit = FVoxelQueryHit();
+
+	// Work in voxels, relative to the terrain, like the editing functions
+	const FVector LocalStart = TerrainTransform.InverseTransformPosition(Query.Start) / 100.f;
+	FVoxelQueryResult Result;
+
+	switch (Query.Type)
+	{
+	case EVoxelQueryType::Raycast:
+		if (VoxelQuery.Raycast(LocalStart, TerrainTransform.InverseTransformPosition(Query.End) / 100.f, Result))
+		{
+			// The terrain's transform is affine, so the hit is the same fraction of the way along the ray in world space
+			OutHit.Location = FMath::Lerp(Query.Start, Query.End, Result.Time);
+			OutHit.Normal = TerrainTransform.TransformVectorNoScale(FVector(Result.Normal));
+			OutHit.bHit = true;
+		}
+		break;
+
+	case EVoxelQueryType::SurfaceHeight:
+		{
+			const FIntVector Column(FMath::RoundToInt(LocalStart.X), FMath::RoundToInt(LocalStart.Y), FMath::RoundToInt(LocalStart.Z));
+
+			// The lowest voxel whose top is still within the distance
+			const float LocalDistance = Query.Distance / (100.f * FMath::Abs(TerrainTransform.GetScale3D().Z));
+			const int32 LowestZ = FMath::CeilToInt(LocalStart.Z - LocalDistance - 0.5f);
+
+			if (VoxelQuery.FindSurfaceBelow(Column, Column.Z - LowestZ, Result))
+			{
+				OutHit.Location = TerrainTransform.TransformPosition(FVector(LocalStart.X, LocalStart.Y, Result.Voxel.Z + 0.5f) * 100.f);
+				OutHit.Normal = TerrainTransform.TransformVectorNoScale(FVector::UpVector);
+				OutHit.bHit = true;
+			}
+		}
+		break;
+
+	case EVoxelQueryType::OverlapSphere:
+		if (VoxelQuery.OverlapSphere(LocalStart, Query.Distance / (100.f * TerrainTransform.GetMaximumAxisScale()), Result))
+		{
+			OutHit.Location = TerrainTransform.TransformPosition(FVector(Result.Voxel) * 100.f);
+			OutHit.bHit = true;
+		}
+		break;
+
+	case EVoxelQueryType::OverlapBox:
+		{
+			// The terrain might be rotated, so the corners can come out the other way around
+			const FVector LocalEnd = TerrainTransform.InverseTransformPosition(Query.End) / 100.f;
+			const FVector BoxMin = LocalStart.ComponentMin(LocalEnd);
+			const FVector BoxMax = LocalStart.ComponentMax(LocalEnd);
+
+			const FIntVector Lower(FMath::CeilToInt(BoxMin.X), FMath::CeilToInt(BoxMin.Y), FMath::CeilToInt(BoxMin.Z));
+			const FIntVector Upper(FMath::FloorToInt(BoxMax.X), FMath::FloorToInt(BoxMax.Y), FMath::FloorToInt(BoxMax.Z));
+
+			if (VoxelQuery.OverlapBox(Lower, Upper, Result))
+			{
+				OutHit.Location = TerrainTransform.TransformPosition(FVector(Result.Voxel) * 100.f);
+				OutHit.bHit = true;
+			}
+		}
+		break;
+	}
+
+	if (OutHit.bHit)
+	{
+		OutHit.Voxel = Result.Voxel;
+		OutHit.Distance = FVector::Dist(Query.Start, OutHit.Location);
+		OutHit.Material = Result.Value.getMaterial();
+	}
+}
+
+void FVoxelQueryBatch::RunQueries(int32 First, int32 Last)
+{
+	VOXEL_TERRAIN_SCOPE(STAT_VoxelTerrain_Queries);
+
+	for (int32 Index = First; Index < Last; Index++)
+		RunQuery(VoxelQuery, TerrainTransform, Queries[Index], Results[Index]);
+
+	INC_DWORD_STAT_BY(STAT_VoxelTerrain_QueriesAnswered, Last - First);
+}
+
+void FVoxelQueryTask::DoWork()
+{
+	Batch->RunQueries(First, Last);
+
+	if (Batch->NumTasksRemaining.Decrement() == 0)
+		Context->CompletedQueryBatches.Enqueue(Batch);
+}
@@ -0,0 +1,239 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#pragma once
+
+#include "VoxelTerrainActor.h"
+#include "VoxelChunkMeshBuilder.h"
+#include "VoxelGreedyMesher.h"
+#include "VoxelMeshCache.h"
+#include "VoxelTerrainQuery.h"
+#include "Async/AsyncWork.h"
+#include "Containers/Queue.h"
+#include "HAL/ThreadSafeCounter.h"
+
+// Describes a single chunk that should be generated
+struct FVoxelChunkRequest
+{
+	// The chunk coordinates of the chunk. For coarser levels of detail these are the coordinates of the node at that level.
+	FIntVector ChunkCoord;
+
+	// The level of detail to build the chunk at. Zero is full resolution, and each level above that samples every other voxel of the one below.
+	int32 Lod = 0;
+
+	// The region of the volume to extract the mesh from. For coarser levels of detail this is the box of voxels the node covers.
+	PolyVox::Region Region;
+
+	// The offset (in voxels) that is applied to every vertex of the mesh
+	FVector OffsetLocation;
+
+	// The surface extractor to build the mesh with. This is part of the request so the extractor can change while chunks are being built.
+	// Coarser levels of detail are smooth with marching cubes and greedy meshed with anything else.
+	EVoxelSurfaceExtractor SurfaceExtractor = EVoxelSurfaceExtractor::Cubic;
+
+	// The generation epoch this chunk was requested in
+	int32 Epoch = 0;
+
+	// Build the render sections. This is only turned off for chunks that are already loaded and just need collision.
+	bool bBuildMesh = true;
+
+	// Build a collision mesh as well. Only full resolution chunks ever have collision.
+	bool bBuildCollision = false;
+
+	// Read the chunk from the mesh cache if it is in there. This is turned off when the cache itself is being baked.
+	bool bUseMeshCache = true;
+
+	// Work out which faces of the chunk its air connects, so the terrain can hide the chunks that are buried behind it.
+	// A chunk can be built with only this, and no mesh, while it is hidden.
+	bool bBuildVisibility = false;
+};
+
+// Scratch memory a worker needs to build a chunk. These are pooled so their buffers can be reused between chunks.
+struct FVoxelChunkWorkspace
+{
+	FVoxelChunkMeshBuilder MeshBuilder;
+	FVoxelGreedyMesher GreedyMesher;
+
+	// The noise samples of a level of detail node
+	TArray<PolyVox::MaterialDensityPair88> LodSamples;
+
+	// A snapshot of the voxels around a chunk, for the extractors that can't read the volume while it is being edited
+	TArray<PolyVox::MaterialDensityPair88> RegionVoxels;
+
+	// The flood fill that works out a chunk's visibility
+	TArray<uint8> VisibilityVisited;
+	TArray<int32> VisibilityStack;
+};
+
+// A batch of queries queued with QueueQueries, shared between the tasks answering it
+struct FVoxelQueryBatch
+{
+	// The most queries one task answers. Queries are quick, so each task gets enough of them to be worth starting.
+	static const int32 QueriesPerTask = 64;
+
+	FVoxelQueryBatch(const FVoxelPaletteVolume& Volume, const FIntVector& VolumeOffset)
+		: VoxelQuery(Volume, VolumeOffset)
+	{}
+
+	// Answers a query in world space, by converting it to voxels relative to the terrain. This is safe to call from any thread.
+	static void RunQuery(const FVoxelTerrainQuery& VoxelQuery, const FTransform& TerrainTransform, const FVoxelQuery& Query, FVoxelQueryHit& OutHit);
+
+	// Answers the queries from First up to but not including Last
+	void RunQueries(int32 First, int32 Last);
+
+	int32 BatchId = 0;
+
+	// Reads the voxels for every query in the batch
+	FVoxelTerrainQuery VoxelQuery;
+
+	// Where the terrain was when the batch was queued. The queries are answered relative to that.
+	FTransform TerrainTransform;
+
+	TArray<FVoxelQuery> Queries;
+	TArray<FVoxelQueryHit> Results;
+
+	// The number of tasks still answering the batch. The last one to finish hands the batch back to the game thread.
+	FThreadSafeCounter NumTasksRemaining;
+
+	// Called on the game thread with the results
+	TFunction<void(int32 BatchId, const TArray<FVoxelQueryHit>& Results)> OnComplete;
+};
+
+// State shared between the terrain actor and all of the worker threads generating chunks for it.
+// This is reference counted so that in-flight tasks can safely finish after the actor has gone away.
+class FVoxelGenerationContext
+{
+public:
+	FVoxelGenerationContext(const TSharedPtr<VoxelTerrainPager, ESPMode::ThreadSafe>& InPager, const TSharedPtr<FVoxelPaletteVolume, ESPMode::ThreadSafe>& InVolume, int32 InNumMaterials);
+
+	// Runs all of the worker stages for a single chunk: noise generation, surface extraction and mesh conversion.
+	// This is safe to call from any thread.
+	void BuildChunkMesh(const FVoxelChunkRequest& Request, FVoxelChunkMeshData& OutMeshData);
+
+	// Builds a full resolution chunk from the volume, or reads it from the mesh cache
+	void BuildVolumeChunkMesh(const FVoxelChunkRequest& Request, FVoxelChunkMeshData& OutMeshData);
+
+	// Builds the collision mesh of a full resolution blocky chunk by greedy merging its voxels, whatever extractor the render mesh uses.
+	// When the render mesh came from the greedy mesher the workspace already has the voxels, so the volume isn't read again.
+	void BuildCollisionMesh(const FVoxelChunkRequest& Request, FVoxelChunkWorkspace& Workspace, FVoxelChunkMeshData& OutMeshData);
+
+	// Builds the render and collision meshes of a full resolution chunk with marching cubes, from a single extraction
+	void BuildSmoothChunkMesh(const FVoxelChunkRequest& Request, FVoxelChunkWorkspace& Workspace, FVoxelChunkMeshData& OutMeshData);
+
+	// Works out which faces of a full resolution chunk its air connects, from a snapshot of its voxels. This is safe to call from any thread.
+	void BuildChunkVisibility(const FVoxelChunkRequest& Request, FVoxelChunkWorkspace& Workspace, FVoxelChunkMeshData& OutMeshData);
+
+	// Builds the mesh of a coarser level of detail node straight from the noise, sampling every 2^Lod voxels.
+	// These never touch the volume, so edits to the voxels only show up at full resolution.
+	// The sides of the node are closed off with skirts, so it doesn't leave cracks next to a node of a different level of detail.
+	// Blocky nodes always use the greedy mesher, since the point of them is to have as few triangles as possible.
+	// This is safe to call from any thread.
+	void BuildLodChunkMesh(const FVoxelChunkRequest& Request, bool bSmooth, FVoxelChunkMeshData& OutMeshData);
+
+	// Extracts the blocky surface of a region with the given extractor. This is safe to call from any thread.
+	// Marching cubes meshes have a different vertex type, so they come from ExtractMarchingCubesSurface instead.
+	PolyVox::Mesh<PolyVox::CubicVertex<PolyVox::MaterialDensityPair88>> ExtractSurface(const PolyVox::Region& Region, EVoxelSurfaceExtractor Extractor, FVoxelChunkWorkspace& Workspace);
+
+	// Extracts the smooth surface of a chunk's region, including the cells up to the first voxel of the chunks after it, from a snapshot of the voxels.
+	// The snapshot stays in the workspace's RegionVoxels, and OutDensityField is set up to take the normals from it.
+	// This is safe to call from any thread.
+	PolyVox::Mesh<PolyVox::MarchingCubesVertex<PolyVox::MaterialDensityPair88>> ExtractMarchingCubesSurface(const PolyVox::Region& Region, FVoxelChunkWorkspace& Workspace, FVoxelDensityField& OutDensityField);
+
+	// Returns the region a chunk has to stage and check for a surface with the given extractor. The pager adds the voxel below the region itself.
+	static PolyVox::Region GetSourceRegion(const PolyVox::Region& Region, EVoxelSurfaceExtractor Extractor);
+
+	// Takes a workspace from the pool, or creates one if the pool is empty
+	TUniquePtr<FVoxelChunkWorkspace> AcquireWorkspace();
+
+	// Returns a workspace to the pool
+	void ReleaseWorkspace(TUniquePtr<FVoxelChunkWorkspace>&& Workspace);
+
+	// Takes a mesh data object from the pool, or creates one if the pool is empty. Either way it comes back reset.
+	TSharedPtr<FVoxelChunkMeshData, ESPMode::ThreadSafe> AcquireMeshData();
+
+	// Returns a mesh data object to the pool once its component has been created, so its buffers can be reused
+	void ReleaseMeshData(const TSharedPtr<FVoxelChunkMeshData, ESPMode::ThreadSafe>& MeshData);
+
+	// Returns true if the given epoch has been cancelled
+	bool IsCancelled(int32 InEpoch) const { return InEpoch != Epoch.GetValue(); }
+
+	// The pager is declared before the volume so it is destroyed after it; the volume pages chunks out when it is destroyed.
+	TSharedPtr<VoxelTerrainPager, ESPMode::ThreadSafe> Pager;
+	TSharedPtr<FVoxelPaletteVolume, ESPMode::ThreadSafe> Volume;
+
+	// The number of material sections each chunk is split into
+	int32 NumMaterials;
+
+	// Put every material into a single section per chunk instead, with the material in the vertex colors.
+	// It has to be set before any chunks are requested.
+	bool bSingleMeshSection = false;
+
+	// Baked full resolution chunk meshes. This is null if the terrain doesn't use the mesh cache.
+	// It has to be set before any chunks are requested.
+	TSharedPtr<FVoxelMeshCache, ESPMode::ThreadSafe> MeshCache;
+
+	// Incremented whenever generation is cancelled. Any chunk requested in an older epoch is discarded.
+	FThreadSafeCounter Epoch;
+
+	// Workspaces and mesh data that aren't in use. Reusing them means their buffers don't have to be reallocated for every chunk.
+	TArray<TUniquePtr<FVoxelChunkWorkspace>> WorkspacePool;
+	TArray<TSharedPtr<FVoxelChunkMeshData, ESPMode::ThreadSafe>> MeshDataPool;
+	FCriticalSection PoolLock;
+
+	// Finished chunks waiting for the game thread to create their components
+	TQueue<TSharedPtr<FVoxelChunkMeshData, ESPMode::ThreadSafe>, EQueueMode::Mpsc> CompletedChunks;
+
+	// Answered query batches waiting for the game thread to hand out their results
+	TQueue<TSharedPtr<FVoxelQueryBatch, ESPMode::ThreadSafe>, EQueueMode::Mpsc> CompletedQueryBatches;
+};
+
+// Background task that builds the mesh data for a single chunk and hands it back to the game thread
+class FVoxelChunkGenerationTask : public FNonAbandonableTask
+{
+	friend class FAutoDeleteAsyncTask<FVoxelChunkGenerationTask>;
+
+public:
+	FVoxelChunkGenerationTask(const TSharedRef<FVoxelGenerationContext, ESPMode::ThreadSafe>& InContext, const FVoxelChunkRequest& InRequest)
+		: Context(InContext)
+		, Request(InRequest)
+	{}
+
+	void DoWork();
+
+	FORCEINLINE TStatId GetStatId() const
+	{
+		RETURN_QUICK_DECLARE_CYCLE_STAT(FVoxelChunkGenerationTask, STATGROUP_ThreadPoolAsyncTasks);
+	}
+
+private:
+	TSharedRef<FVoxelGenerationContext, ESPMode::ThreadSafe> Context;
+	FVoxelChunkRequest Request;
+};
+
+// Background task that answers part of a batch of queries, and hands the batch back to the game thread if it was the last part
+class FVoxelQueryTask : public FNonAbandonableTask
+{
+	friend class FAutoDeleteAsyncTask<FVoxelQueryTask>;
+
+public:
+	FVoxelQueryTask(const TSharedRef<FVoxelGenerationContext, ESPMode::ThreadSafe>& InContext, const TSharedRef<FVoxelQueryBatch, ESPMode::ThreadSafe>& InBatch, int32 InFirst, int32 InLast)
+		: Context(InContext)
+		, Batch(InBatch)
+		, First(InFirst)
+		, Last(InLast)
+	{}
+
+	void DoWork();
+
+	FORCEINLINE TStatId GetStatId() const
+	{
+		RETURN_QUICK_DECLARE_CYCLE_STAT(FVoxelQueryTask, STATGROUP_ThreadPoolAsyncTasks);
+	}
+
+private:
+	// Holds on to the volume the batch reads
+	TSharedRef<FVoxelGenerationContext, ESPMode::ThreadSafe> Context;
+
+	TSharedRef<FVoxelQueryBatch, ESPMode::ThreadSafe> Batch;
+	int32 First;
+	int32 Last;
+};
@@ -0,0 +1,613 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#include "VoxelTerrainNet.h"
+#include "VoxelTerrain.h"
+#include "VoxelTerrainPager.h"
+#include "VoxelChunkStore.h"
+
+using namespace PolyVox;
+
+// The values of EVoxelEditMode. The actor checks these match.
+static const uint8 EditModeCarve = 0;
+static const uint8 EditModeFill = 1;
+static const uint8 EditModePaint = 2;
+
+// The flags in the first byte of an edit. The shape and mode are packed into the bits below them.
+static const uint8 EditFlagSphere = 1 << 0;
+static const int32 EditModeShift = 1;
+static const uint8 EditModeMask = 3 << EditModeShift;
+static const uint8 EditFlagMaterial = 1 << 3;
+static const uint8 EditFlagSequence = 1 << 4;
+
+// Rounds towards negative infinity, for a positive divisor
+static FORCEINLINE int32 DivideAndRoundDown(int32 Dividend, int32 Divisor)
+{
+	return (Dividend >= 0 ? Dividend : Dividend - (Divisor - 1)) / Divisor;
+}
+
+// Appends an unsigned number seven bits at a time, so small numbers take a single byte
+static void WriteVarUint(TArray<uint8>& OutData, uint32 Value)
+{
+	while (Value >= 0x80)
+	{
+		OutData.Add(uint8(Value | 0x80));
+		Value >>= 7;
+	}
+
+	OutData.Add(uint8(Value));
+}
+
+// Appends a signed number, with small negative numbers folded in between the small positive ones
+static void WriteVarInt(TArray<uint8>& OutData, int32 Value)
+{
+	WriteVarUint(OutData, (uint32(Value) << 1) ^ uint32(Value >> 31));
+}
+
+static void WriteVarIntVector(TArray<uint8>& OutData, const FIntVector& Value)
+{
+	WriteVarInt(OutData, Value.X);
+	WriteVarInt(OutData, Value.Y);
+	WriteVarInt(OutData, Value.Z);
+}
+
+// Reads the numbers written above. Reading past the end sets bOverflow and returns zeros, so the callers only have to check once at the end.
+struct FVoxelNetReader
+{
+	const uint8* Data;
+	int32 DataSize;
+	int32 Offset = 0;
+	bool bOverflow = false;
+	bool bCorrupt = false;
+
+	FVoxelNetReader(const uint8* InData, int32 InDataSize)
+		: Data(InData)
+		, DataSize(InDataSize)
+	{}
+
+	bool IsAtEnd() const { return Offset >= DataSize; }
+
+	uint8 ReadByte()
+	{
+		if (Offset >= DataSize)
+		{
+			bOverflow = true;
+			return 0;
+		}
+
+		return Data[Offset++];
+	}
+
+	uint32 ReadVarUint()
+	{
+		uint32 Value = 0;
+
+		for (int32 Shift = 0; Shift < 35; Shift += 7)
+		{
+			const uint8 Byte = ReadByte();
+			Value |= uint32(Byte & 0x7F) << Shift;
+
+			if (!(Byte & 0x80))
+				return Value;
+		}
+
+		// Nothing ever writes more than five bytes
+		bCorrupt = true;
+		return 0;
+	}
+
+	int32 ReadVarInt()
+	{
+		const uint32 Value = ReadVarUint();
+		return int32(Value >> 1) ^ -int32(Value & 1);
+	}
+
+	FIntVector ReadVarIntVector()
+	{
+		const int32 X = ReadVarInt();
+		const int32 Y = ReadVarInt();
+		const int32 Z = ReadVarInt();
+		return FIntVector(X, Y, Z);
+	}
+};
+
+FVoxelNetEdit FVoxelNetEdit::MakeBox(const FIntVector& InLower, const FIntVector& InUpper, uint8 InMode, uint8 InMaterial)
+{
+	FVoxelNetEdit Edit;
+	Edit.Shape = EShape::Box;
+	Edit.Mode = InMode;
+	Edit.Material = InMaterial;
+	Edit.Lower = InLower;
+	Edit.Upper = InUpper;
+	return Edit;
+}
+
+FVoxelNetEdit FVoxelNetEdit::MakeSphere(const FVector& InCenter, float InRadius, uint8 InMode, uint8 InMaterial)
+{
+	FVoxelNetEdit Edit;
+	Edit.Shape = EShape::Sphere;
+	Edit.Mode = InMode;
+	Edit.Material = InMaterial;
+	Edit.Center = FIntVector(FMath::RoundToInt(InCenter.X * SubVoxelSteps), FMath::RoundToInt(InCenter.Y * SubVoxelSteps), FMath::RoundToInt(InCenter.Z * SubVoxelSteps));
+	Edit.Radius = FMath::RoundToInt(InRadius * SubVoxelSteps);
+	return Edit;
+}
+
+void FVoxelNetEdit::GetBounds(FIntVector& OutLower, FIntVector& OutUpper) const
+{
+	if (Shape == EShape::Box)
+	{
+		OutLower = Lower;
+		OutUpper = Upper;
+		return;
+	}
+
+	// The voxels whose centres are inside the sphere's bounding box
+	const FIntVector SphereLower = Center - FIntVector(Radius);
+	const FIntVector SphereUpper = Center + FIntVector(Radius);
+	OutLower = FIntVector(-DivideAndRoundDown(-SphereLower.X, SubVoxelSteps), -DivideAndRoundDown(-SphereLower.Y, SubVoxelSteps), -DivideAndRoundDown(-SphereLower.Z, SubVoxelSteps));
+	OutUpper = FIntVector(DivideAndRoundDown(SphereUpper.X, SubVoxelSteps), DivideAndRoundDown(SphereUpper.Y, SubVoxelSteps), DivideAndRoundDown(SphereUpper.Z, SubVoxelSteps));
+}
+
+bool FVoxelNetEdit::Contains(const FIntVector& Voxel) const
+{
+	if (Shape == EShape::Box)
+	{
+		return Voxel.X >= Lower.X && Voxel.Y >= Lower.Y && Voxel.Z >= Lower.Z
+			&& Voxel.X <= Upper.X && Voxel.Y <= Upper.Y && Voxel.Z <= Upper.Z;
+	}
+
+	// Integers all the way, so every machine agrees on which voxels are inside
+	const int64 DeltaX = int64(Voxel.X) * SubVoxelSteps - Center.X;
+	const int64 DeltaY = int64(Voxel.Y) * SubVoxelSteps - Center.Y;
+	const int64 DeltaZ = int64(Voxel.Z) * SubVoxelSteps - Center.Z;
+	return DeltaX * DeltaX + DeltaY * DeltaY + DeltaZ * DeltaZ <= int64(Radius) * Radius;
+}
+
+void FVoxelNetEdit::ApplyMode(uint8 Mode, uint8 Material, MaterialDensityPair88& InOutVoxel)
+{
+	switch (Mode)
+	{
+	case EditModeCarve:
+		InOutVoxel = MaterialDensityPair88();
+		break;
+
+	case EditModeFill:
+		InOutVoxel = Material != 0 ? MaterialDensityPair88(Material, MaterialDensityPair88::getMaxDensity()) : MaterialDensityPair88();
+		break;
+
+	case EditModePaint:
+		if (InOutVoxel.getMaterial() != 0 && Material != 0)
+			InOutVoxel.setMaterial(Material);
+		break;
+	}
+}
+
+void FVoxelNetEditWriter::Write(const FVoxelNetEdit& Edit)
+{
+	const bool bSphere = Edit.Shape == FVoxelNetEdit::EShape::Sphere;
+	const bool bNewMaterial = Edit.Material != Previous.Material;
+	const bool bSkipsSequence = Edit.Sequence != Previous.Sequence + 1;
+
+	Data.Add((bSphere ? EditFlagSphere : 0) | ((Edit.Mode << EditModeShift) & EditModeMask) | (bNewMaterial ? EditFlagMaterial : 0) | (bSkipsSequence ? EditFlagSequence : 0));
+
+	if (bSkipsSequence)
+		WriteVarInt(Data, int32(Edit.Sequence - Previous.Sequence));
+
+	if (bNewMaterial)
+		Data.Add(Edit.Material);
+
+	// Each shape is written relative to the last edit with the same shape
+	if (bSphere)
+	{
+		WriteVarIntVector(Data, Edit.Center - Previous.Center);
+		WriteVarInt(Data, Edit.Radius - Previous.Radius);
+		Previous.Center = Edit.Center;
+		Previous.Radius = Edit.Radius;
+	}
+	else
+	{
+		WriteVarIntVector(Data, Edit.Lower - Previous.Lower);
+		WriteVarIntVector(Data, Edit.Upper - Edit.Lower);
+		Previous.Lower = Edit.Lower;
+		Previous.Upper = Edit.Upper;
+	}
+
+	Previous.Sequence = Edit.Sequence;
+	Previous.Material = Edit.Material;
+	NumEdits++;
+}
+
+void FVoxelNetEditWriter::Reset()
+{
+	Data.Reset();
+	NumEdits = 0;
+	Previous = FVoxelNetEdit();
+}
+
+bool FVoxelNetCodec::ReadEdits(const uint8* Data, int32 DataSize, TArray<FVoxelNetEdit>& OutEdits)
+{
+	FVoxelNetReader Reader(Data, DataSize);
+	FVoxelNetEdit Previous;
+
+	while (!Reader.IsAtEnd())
+	{
+		const uint8 Flags = Reader.ReadByte();
+
+		FVoxelNetEdit Edit = Previous;
+		Edit.Shape = (Flags & EditFlagSphere) ? FVoxelNetEdit::EShape::Sphere : FVoxelNetEdit::EShape::Box;
+		Edit.Mode = (Flags & EditModeMask) >> EditModeShift;
+		Edit.Sequence = Previous.Sequence + ((Flags & EditFlagSequence) ? uint32(Reader.ReadVarInt()) : 1);
+
+		if (Flags & EditFlagMaterial)
+			Edit.Material = Reader.ReadByte();
+
+		if (Edit.Shape == FVoxelNetEdit::EShape::Sphere)
+		{
+			Edit.Center = Previous.Center + Reader.ReadVarIntVector();
+			Edit.Radius = Previous.Radius + Reader.ReadVarInt();
+		}
+		else
+		{
+			Edit.Lower = Previous.Lower + Reader.ReadVarIntVector();
+			Edit.Upper = Edit.Lower + Reader.ReadVarIntVector();
+		}
+
+		if (Reader.bOverflow || Reader.bCorrupt || Edit.Mode > EditModePaint)
+			return false;
+
+		OutEdits.Add(Edit);
+		Previous = Edit;
+	}
+
+	return true;
+}
+
+void FVoxelNetCodec::WriteChunkDiff(const FIntVector& ChunkCoord, uint32 Version, const MaterialDensityPair88* Voxels, const MaterialDensityPair88* Baseline, int32 NumVoxels, TArray<uint8>& OutData)
+{
+	// Each run is the number of voxels since the last one that are the same as the baseline, then the length and value of the run
+	TArray<uint8> Runs;
+	int32 RunEnd = 0;
+
+	for (int32 VoxelIndex = 0; VoxelIndex < NumVoxels; VoxelIndex++)
+	{
+		const MaterialDensityPair88 Voxel = Voxels[VoxelIndex];
+		if (Voxel == Baseline[VoxelIndex])
+			continue;
+
+		// A run carries on through voxels that happen to match the baseline already, since writing them again doesn't change anything
+		int32 RunLength = 1;
+		while (VoxelIndex + RunLength < NumVoxels && Voxels[VoxelIndex + RunLength] == Voxel)
+			RunLength++;
+
+		WriteVarUint(Runs, VoxelIndex - RunEnd);
+		WriteVarUint(Runs, RunLength - 1);
+		Runs.Add(Voxel.getMaterial());
+		Runs.Add(Voxel.getDensity());
+
+		VoxelIndex += RunLength - 1;
+		RunEnd = VoxelIndex + 1;
+	}
+
+	WriteVarIntVector(OutData, ChunkCoord);
+	WriteVarUint(OutData, Version);
+	WriteVarUint(OutData, Runs.Num());
+	OutData.Append(Runs);
+}
+
+int32 FVoxelNetCodec::ReadChunkDiff(const uint8* Data, int32 DataSize, FIntVector& OutChunkCoord, uint32& OutVersion, const uint8*& OutDiff, int32& OutDiffSize)
+{
+	FVoxelNetReader Reader(Data, DataSize);
+	OutChunkCoord = Reader.ReadVarIntVector();
+	OutVersion = Reader.ReadVarUint();
+	const uint32 DiffSize = Reader.ReadVarUint();
+
+	if (Reader.bCorrupt || DiffSize > uint32(MAX_int32 / 2))
+		return INDEX_NONE;
+
+	// The rest of the chunk is still on its way
+	if (Reader.bOverflow || int64(Reader.Offset) + DiffSize > DataSize)
+		return 0;
+
+	OutDiff = Data + Reader.Offset;
+	OutDiffSize = int32(DiffSize);
+	return Reader.Offset + OutDiffSize;
+}
+
+bool FVoxelNetCodec::ApplyChunkDiff(const uint8* Diff, int32 DiffSize, MaterialDensityPair88* InOutVoxels, int32 NumVoxels)
+{
+	FVoxelNetReader Reader(Diff, DiffSize);
+	int64 VoxelIndex = 0;
+
+	while (!Reader.IsAtEnd())
+	{
+		VoxelIndex += Reader.ReadVarUint();
+		const int64 RunLength = int64(Reader.ReadVarUint()) + 1;
+		const uint8 Material = Reader.ReadByte();
+		const uint8 Density = Reader.ReadByte();
+		const MaterialDensityPair88 Voxel(Material, Density);
+
+		if (Reader.bOverflow || Reader.bCorrupt || VoxelIndex + RunLength > NumVoxels)
+			return false;
+
+		for (int64 i = 0; i < RunLength; i++)
+			InOutVoxels[VoxelIndex + i] = Voxel;
+
+		VoxelIndex += RunLength;
+	}
+
+	return true;
+}
+
+void FVoxelNetReplicator::SetVolume(VoxelTerrainPager* InPager, FVoxelPaletteVolume* InVolume, const FIntVector& InVolumeOffset)
+{
+	Pager = InPager;
+	Volume = InVolume;
+	VolumeOffset = InVolumeOffset;
+}
+
+bool FVoxelNetReplicator::ApplyEdit(const FVoxelNetEdit& Edit)
+{
+	FIntVector Lower, Upper;
+	Edit.GetBounds(Lower, Upper);
+
+	if (Lower.X > Upper.X || Lower.Y > Upper.Y || Lower.Z > Upper.Z)
+		return false;
+
+	// Edits that aren't replicated don't touch the versions
+	if (Edit.Sequence == 0)
+		return EditVoxels(Lower, Upper, [&Edit](const FIntVector& Voxel, MaterialDensityPair88& InOutVoxel) { Edit.Apply(Voxel, InOutVoxel); }, nullptr);
+
+	// A client that has had a chunk in its snapshot already has every edit up to the chunk's version,
+	// so those are skipped in that chunk however late they arrive
+	const FIntVector LowerChunk = FVoxelChunkTraits::VoxelToChunk(Lower);
+	const FIntVector UpperChunk = FVoxelChunkTraits::VoxelToChunk(Upper);
+	TSet<FIntVector> StaleChunks;
+
+	for (int32 Z = LowerChunk.Z; Z <= UpperChunk.Z; Z++)
+	{
+		for (int32 Y = LowerChunk.Y; Y <= UpperChunk.Y; Y++)
+		{
+			for (int32 X = LowerChunk.X; X <= UpperChunk.X; X++)
+			{
+				const uint32* Version = ChunkVersions.Find(FIntVector(X, Y, Z));
+				if (Version && *Version >= Edit.Sequence)
+					StaleChunks.Add(FIntVector(X, Y, Z));
+			}
+		}
+	}
+
+	// Only the chunks the edit actually changes move up to its sequence. A chunk it missed is the same with or without it,
+	// so it doesn't need to go in a snapshot because of it.
+	TSet<FIntVector> ChangedChunks;
+	const bool bChanged = EditVoxels(Lower, Upper, [&Edit, &StaleChunks](const FIntVector& Voxel, MaterialDensityPair88& InOutVoxel)
+	{
+		if (StaleChunks.Num() == 0 || !StaleChunks.Contains(FVoxelChunkTraits::VoxelToChunk(Voxel)))
+			Edit.Apply(Voxel, InOutVoxel);
+	}, &ChangedChunks);
+
+	for (const FIntVector& ChunkCoord : ChangedChunks)
+		ChunkVersions.Add(ChunkCoord, Edit.Sequence);
+
+	return bChanged;
+}
+
+void FVoxelNetReplicator::GetSnapshotChunks(TArray<FIntVector>& OutChunks) const
+{
+	TSet<FIntVector> Chunks;
+	for (const auto& ChunkVersion : ChunkVersions)
+		Chunks.Add(ChunkVersion.Key);
+
+	// Chunks saved by an earlier game are loaded from the store instead of the noise, so the client needs them too.
+	// The store's chunks are volume chunks, which can be a different size to the ones sent, and are offset from them.
+	if (Pager && Pager->GetChunkStore().IsValid())
+	{
+		TArray<FIntVector> StoredChunks;
+		Pager->GetChunkStore()->GetChunkKeys(StoredChunks);
+
+		const int32 StoredSideLength = VoxelTerrainPager::VolumeChunkSideLength;
+		for (const FIntVector& StoredChunk : StoredChunks)
+		{
+			const FIntVector LowerChunk = FVoxelChunkTraits::VoxelToChunk(StoredChunk * StoredSideLength - VolumeOffset);
+			const FIntVector UpperChunk = FVoxelChunkTraits::VoxelToChunk(StoredChunk * StoredSideLength + FIntVector(StoredSideLength - 1) - VolumeOffset);
+
+			for (int32 Z = LowerChunk.Z; Z <= UpperChunk.Z; Z++)
+			{
+				for (int32 Y = LowerChunk.Y; Y <= UpperChunk.Y; Y++)
+				{
+					for (int32 X = LowerChunk.X; X <= UpperChunk.X; X++)
+						Chunks.Add(FIntVector(X, Y, Z));
+				}
+			}
+		}
+	}
+
+	OutChunks.Reset();
+	for (const FIntVector& ChunkCoord : Chunks)
+		OutChunks.Add(ChunkCoord);
+}
+
+void FVoxelNetReplicator::WriteSnapshotChunk(const FIntVector& ChunkCoord, TArray<uint8>& OutData)
+{
+	if (!Pager || !Volume)
+		return;
+
+	TArray<MaterialDensityPair88> Voxels;
+	TArray<MaterialDensityPair88> Baseline;
+	Voxels.SetNumUninitialized(FVoxelChunkTraits::NumVoxels);
+	Baseline.SetNumUninitialized(FVoxelChunkTraits::NumVoxels);
+
+	// The baseline is what the client will generate for the chunk itself
+	const PolyVox::Region Region = GetChunkRegion(ChunkCoord);
+	Pager->StageRegion(Region);
+	Volume->ReadRegion(Region, Voxels.GetData());
+	Pager->GenerateRegion(Region, Baseline.GetData());
+
+	// A chunk that only came from the store goes at version 0, since it has every edit made since the terrain started
+	const uint32* Version = ChunkVersions.Find(ChunkCoord);
+	FVoxelNetCodec::WriteChunkDiff(ChunkCoord, Version ? *Version : 0, Voxels.GetData(), Baseline.GetData(), FVoxelChunkTraits::NumVoxels, OutData);
+}
+
+bool FVoxelNetReplicator::ReceiveEdits(const uint8* Data, int32 DataSize)
+{
+	TArray<FVoxelNetEdit> Edits;
+	if (!FVoxelNetCodec::ReadEdits(Data, DataSize, Edits))
+		return false;
+
+	if (bWaitingForSnapshot)
+	{
+		HeldBackEdits.Append(Edits);
+		NumHeldBackEdits += Edits.Num();
+		return true;
+	}
+
+	for (const FVoxelNetEdit& Edit : Edits)
+		ApplyEdit(Edit);
+
+	return true;
+}
+
+void FVoxelNetReplicator::ReceiveSnapshot(const uint8* Data, int32 DataSize)
+{
+	SnapshotData.Append(Data, DataSize);
+	NumSnapshotBytes += DataSize;
+}
+
+bool FVoxelNetReplicator::ApplySnapshot()
+{
+	if (!Pager || !Volume)
+		return true;
+
+	TArray<MaterialDensityPair88> Voxels;
+	Voxels.SetNumUninitialized(FVoxelChunkTraits::NumVoxels);
+
+	bool bValid = true;
+	int32 Offset = 0;
+
+	while (Offset < SnapshotData.Num())
+	{
+		FIntVector ChunkCoord;
+		uint32 Version;
+		const uint8* Diff;
+		int32 DiffSize;
+
+		const int32 ChunkSize = FVoxelNetCodec::ReadChunkDiff(SnapshotData.GetData() + Offset, SnapshotData.Num() - Offset, ChunkCoord, Version, Diff, DiffSize);
+
+		// The rest of the chunk is still on its way
+		if (ChunkSize == 0)
+			break;
+
+		// Nothing after this can be read either
+		if (ChunkSize == INDEX_NONE)
+		{
+			Offset = SnapshotData.Num();
+			bValid = false;
+			break;
+		}
+
+		Offset += ChunkSize;
+
+		// The edits the chunk was sent with might have got here first. A chunk that isn't versioned yet always takes the snapshot,
+		// since chunks that came from the server's store are sent at version 0.
+		const uint32* ChunkVersion = ChunkVersions.Find(ChunkCoord);
+		if (ChunkVersion && *ChunkVersion >= Version)
+			continue;
+
+		const PolyVox::Region Region = GetChunkRegion(ChunkCoord);
+		Pager->GenerateRegion(Region, Voxels.GetData());
+
+		if (!FVoxelNetCodec::ApplyChunkDiff(Diff, DiffSize, Voxels.GetData(), FVoxelChunkTraits::NumVoxels))
+		{
+			bValid = false;
+			continue;
+		}
+
+		const FIntVector ChunkLower = FVoxelChunkTraits::ChunkToVoxel(ChunkCoord);
+		EditVoxels(ChunkLower, ChunkLower + FIntVector(FVoxelChunkTraits::Size - 1), [&Voxels, &ChunkLower](const FIntVector& Voxel, MaterialDensityPair88& InOutVoxel)
+		{
+			const FIntVector Local = Voxel - ChunkLower;
+			InOutVoxel = Voxels[FVoxelChunkTraits::LocalIndex(Local.X, Local.Y, Local.Z)];
+		}, nullptr);
+
+		ChunkVersions.Add(ChunkCoord, Version);
+		NumSnapshotChunks++;
+	}
+
+	SnapshotData.RemoveAt(0, Offset, false);
+
+	if (bSnapshotComplete && bWaitingForSnapshot)
+	{
+		bWaitingForSnapshot = false;
+
+		for (const FVoxelNetEdit& Edit : HeldBackEdits)
+			ApplyEdit(Edit);
+
+		HeldBackEdits.Empty();
+		SnapshotData.Empty();
+	}
+
+	return bValid;
+}
+
+bool FVoxelNetReplicator::EditVoxels(const FIntVector& Lower, const FIntVector& Upper, TFunctionRef<void(const FIntVector& Voxel, MaterialDensityPair88& InOutVoxel)> EditVoxel, TSet<FIntVector>* OutChangedChunks)
+{
+	if (!Pager || !Volume)
+		return false;
+
+	const FIntVector VolumeLower = Lower + VolumeOffset;
+	const FIntVector VolumeUpper = Upper + VolumeOffset;
+	const PolyVox::Region Region(Vector3DInt32(VolumeLower.X, VolumeLower.Y, VolumeLower.Z), Vector3DInt32(VolumeUpper.X, VolumeUpper.Y, VolumeUpper.Z));
+
+	// Generate the noise for any chunks that aren't paged in yet before locking the region, so the workers aren't held up by it
+	Pager->StageRegion(Region);
+
+	// The whole region is edited in one go, so a worker extracting a chunk either sees all of the edit or none of it.
+	// Only the voxels that actually change are written, and only the chunks around them are remeshed.
+	FIntVector ChangedLower(MAX_int32);
+	FIntVector ChangedUpper(MIN_int32);
+
+	// Neighbouring voxels are nearly always in the same chunk, so the set is only touched when the chunk changes
+	FIntVector LastChangedChunk(MAX_int32);
+
+	Volume->EditRegion(Region, [&](int32 X, int32 Y, int32 Z, MaterialDensityPair88& InOutVoxel)
+	{
+		const FIntVector Voxel = FIntVector(X, Y, Z) - VolumeOffset;
+
+		const MaterialDensityPair88 OldVoxel = InOutVoxel;
+		EditVoxel(Voxel, InOutVoxel);
+
+		if (InOutVoxel.getMaterial() == OldVoxel.getMaterial() && InOutVoxel.getDensity() == OldVoxel.getDensity())
+			return;
+
+		ChangedLower = FIntVector(FMath::Min(ChangedLower.X, Voxel.X), FMath::Min(ChangedLower.Y, Voxel.Y), FMath::Min(ChangedLower.Z, Voxel.Z));
+		ChangedUpper = FIntVector(FMath::Max(ChangedUpper.X, Voxel.X), FMath::Max(ChangedUpper.Y, Voxel.Y), FMath::Max(ChangedUpper.Z, Voxel.Z));
+
+		if (OutChangedChunks)
+		{
+			const FIntVector ChunkCoord = FVoxelChunkTraits::VoxelToChunk(Voxel);
+			if (ChunkCoord != LastChangedChunk)
+			{
+				OutChangedChunks->Add(ChunkCoord);
+				LastChangedChunk = ChunkCoord;
+			}
+		}
+	});
+
+	if (ChangedLower.X > ChangedUpper.X)
+		return false;
+
+	const FIntVector VolumeChangedLower = ChangedLower + VolumeOffset;
+	const FIntVector VolumeChangedUpper = ChangedUpper + VolumeOffset;
+	Pager->MarkRegionModified(PolyVox::Region(Vector3DInt32(VolumeChangedLower.X, VolumeChangedLower.Y, VolumeChangedLower.Z), Vector3DInt32(VolumeChangedUpper.X, VolumeChangedUpper.Y, VolumeChangedUpper.Z)));
+
+	if (OnVoxelsChanged)
+		OnVoxelsChanged(ChangedLower, ChangedUpper);
+
+	return true;
+}
+
+PolyVox::Region FVoxelNetReplicator::GetChunkRegion(const FIntVector& ChunkCoord) const
+{
+	const FIntVector Lower = FVoxelChunkTraits::ChunkToVoxel(ChunkCoord) + VolumeOffset;
+	const FIntVector Upper = Lower + FIntVector(FVoxelChunkTraits::Size - 1);
+	return PolyVox::Region(Vector3DInt32(Lower.X, Lower.Y, Lower.Z), Vector3DInt32(Upper.X, Upper.Y, Upper.Z));
+}
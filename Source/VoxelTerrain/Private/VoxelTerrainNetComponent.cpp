@@ -0,0 +1,119 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#include "VoxelTerrainNetComponent.h"
+#include "VoxelTerrain.h"
+#include "VoxelTerrainActor.h"
+#include "VoxelTerrainNet.h"
+#include "VoxelTerrainStats.h"
+#include "Net/UnrealNetwork.h"
+
+// Sets default values
+UVoxelTerrainNetComponent::UVoxelTerrainNetComponent()
+{
+	// The server sends the snapshot a little every frame
+	PrimaryComponentTick.bCanEverTick = true;
+	bReplicates = true;
+
+	Terrain = nullptr;
+	bRequestedSnapshot = false;
+	bSendingSnapshot = false;
+	PendingOffset = 0;
+	ByteAllowance = 0.f;
+	NumChunksSent = 0;
+	NumBytesSent = 0;
+	SnapshotStartTime = 0;
+}
+
+void UVoxelTerrainNetComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(UVoxelTerrainNetComponent, Terrain);
+}
+
+void UVoxelTerrainNetComponent::OnRep_Terrain()
+{
+	// The terrain only resolves once the client has it, and every edit multicast from then on reaches the client.
+	// Asking for the snapshot after that means the two between them cover every edit.
+	if (Terrain && !bRequestedSnapshot)
+	{
+		bRequestedSnapshot = true;
+		ServerRequestSnapshot();
+	}
+}
+
+bool UVoxelTerrainNetComponent::ServerRequestSnapshot_Validate()
+{
+	return true;
+}
+
+void UVoxelTerrainNetComponent::ServerRequestSnapshot_Implementation()
+{
+	if (!Terrain || bSendingSnapshot)
+		return;
+
+	// Only the chunks that have been edited or saved are different from what the client generates itself
+	Terrain->GetNetSnapshotChunks(ChunksToSend);
+
+	bSendingSnapshot = true;
+	ByteAllowance = 0.f;
+	SnapshotStartTime = FPlatformTime::Seconds();
+}
+
+void UVoxelTerrainNetComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (!bSendingSnapshot || !Terrain)
+		return;
+
+	// The allowance doesn't build up for more than a second, so a long frame doesn't send a burst
+	const float BytesPerSecond = float(FMath::Max(Terrain->NetSnapshotBytesPerSecond, FVoxelNetCodec::MaxPayloadBytes));
+	ByteAllowance = FMath::Min(ByteAllowance + DeltaTime * BytesPerSecond, BytesPerSecond);
+
+	while (ByteAllowance > 0.f)
+	{
+		if (PendingOffset >= PendingData.Num())
+		{
+			PendingData.Reset();
+			PendingOffset = 0;
+
+			if (ChunksToSend.Num() == 0)
+			{
+				ClientFinishSnapshot();
+				bSendingSnapshot = false;
+
+				UE_LOG(LogVoxelTerrain, Log, TEXT("Sent %s a snapshot of %s: %d chunks in %lld bytes, over %.2fs"),
+					*GetOwner()->GetName(), *Terrain->GetName(), NumChunksSent, NumBytesSent, FPlatformTime::Seconds() - SnapshotStartTime);
+				return;
+			}
+
+			// Chunks are written at their version when they're sent, which includes any edits made since the snapshot started
+			while (ChunksToSend.Num() > 0 && PendingData.Num() < FVoxelNetCodec::MaxPayloadBytes)
+			{
+				Terrain->WriteNetSnapshotChunk(ChunksToSend.Pop(false), PendingData);
+				NumChunksSent++;
+			}
+		}
+
+		const int32 NumBytes = FMath::Min(PendingData.Num() - PendingOffset, FVoxelNetCodec::MaxPayloadBytes);
+		ClientReceiveSnapshot(TArray<uint8>(PendingData.GetData() + PendingOffset, NumBytes));
+
+		PendingOffset += NumBytes;
+		ByteAllowance -= NumBytes;
+		NumBytesSent += NumBytes;
+		INC_DWORD_STAT_BY(STAT_VoxelTerrain_NetSnapshotBytesSent, NumBytes);
+	}
+}
+
+void UVoxelTerrainNetComponent::ClientReceiveSnapshot_Implementation(const TArray<uint8>& Data)
+{
+	if (Terrain)
+		Terrain->ReceiveNetSnapshot(Data);
+}
+
+void UVoxelTerrainNetComponent::ClientFinishSnapshot_Implementation()
+{
+	if (Terrain)
+		Terrain->FinishNetSnapshot();
+}
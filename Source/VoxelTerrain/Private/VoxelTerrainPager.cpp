@@ -0,0 +1,993 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#include "VoxelTerrainPager.h"
+#include "VoxelTerrain.h"
+#include "VoxelBatchedNoise.h"
+#include "VoxelChunkStore.h"
+#include "VoxelTerrainStats.h"
+
+// PolyVox
+using namespace PolyVox;
+
+// ANL
+#include "VM/kernel.h"
+using namespace anl;
+
+// The noise program for a terrain.
+// The kernel is only ever read once it has been built, so one program can be shared by every thread.
+// Each thread evaluates it with its own CNoiseExecutor, since that is where ANL keeps its scratch memory.
+struct FVoxelTerrainProgram
+{
+	// This is our kernel. It is responsible for generating our noise.
+	CKernel NoiseKernel;
+
+	// The fBm the terrain is shaped from, before it is scaled and offset
+	TOptional<CInstructionIndex> TerrainFractal;
+
+	// Spherical terrain: the solidity of a voxel
+	TOptional<CInstructionIndex> PerturbGradient;
+
+	// Flat terrain: the offset of the ground at a column. This is a heightmap, so it doesn't depend on Z.
+	TOptional<CInstructionIndex> TerrainZScale;
+
+	// Flat terrain: the noise used to place caves, ore and pockets of dirt
+	TOptional<CInstructionIndex> OreFractal;
+	TOptional<CInstructionIndex> FractalGradient;
+
+	// The batched noise and the same fractals as TerrainFractal and OreFractal, laid out for it.
+	// These are only set up when the terrain asks for the batched noise, and they are only used if they match ANL.
+	TUniquePtr<FVoxelBatchedNoise> BatchedNoise;
+	FVoxelNoiseFractal BatchedTerrainFractal;
+	FVoxelNoiseFractal BatchedOreFractal;
+};
+
+// The settings of the ore noise, relative to the terrain noise
+static const int32 OreOctaves = 2;
+static const float OreFrequencyScale = 1.2f;
+
+// How strongly the cave gradient is biased towards the surface
+static const double CaveGradientBias = 1.015;
+
+// Every octave of the basis noise stays within about -1 to 1. This leaves some headroom on top of that when working out the bounds of a fractal,
+// since simplex noise can overshoot slightly.
+static const double FractalBoundHeadroom = 1.1;
+
+// Chunks are only classified as uniform if they are at least this many voxels away from the closest possible surface
+static const double ChunkClassificationMargin = 1.0;
+
+// The number of voxels the batched noise is checked against ANL at before it is used
+static const int32 BatchedNoiseCheckPoints = 4096;
+
+// Returns the largest difference between a batched fractal and the same fractal in ANL over the given points
+static float MeasureFractalError(const FVoxelBatchedNoise& Noise, EVoxelNoiseInstructionSet InstructionSet, const FVoxelNoiseFractal& Fractal, CNoiseExecutor& Executor, const CInstructionIndex& AnlFractal,
+	const TArray<float>& X, const TArray<float>& Y, const TArray<float>& Z, double& InOutBatchedSeconds, double& InOutAnlSeconds)
+{
+	const int32 NumPoints = X.Num();
+
+	TArray<float> Values;
+	Values.SetNumUninitialized(NumPoints);
+
+	double StartTime = FPlatformTime::Seconds();
+	Noise.EvaluateFractal(InstructionSet, Fractal, X.GetData(), Y.GetData(), Z.GetData(), Values.GetData(), NumPoints);
+	InOutBatchedSeconds += FPlatformTime::Seconds() - StartTime;
+
+	StartTime = FPlatformTime::Seconds();
+	float MaxError = 0.f;
+	for (int32 i = 0; i < NumPoints; i++)
+		MaxError = FMath::Max(MaxError, float(FMath::Abs(Executor.evaluateScalar(X[i], Y[i], Z[i], AnlFractal) - double(Values[i]))));
+
+	InOutAnlSeconds += FPlatformTime::Seconds() - StartTime;
+
+	return MaxError;
+}
+
+// Picks the material of a solid voxel in flat terrain from the ore noise. Returns 0 if the voxel is carved out.
+// EvaluateFractalGradient is only called when a cave is possible, since it can be expensive.
+//
+// Material IDs:
+// Air = 0
+// Stone = 1
+// Dirt = 2
+// Grass = 3
+// Ore = 4
+template<typename GradientFunctionType>
+static FORCEINLINE uint8 GetFlatTerrainMaterial(int32 z, int32 ActualGrassZ, double EvaluatedOreFractal, GradientFunctionType EvaluateFractalGradient)
+{
+	const int32 DirtZ = ActualGrassZ - 1;
+	const int32 DirtThickness = 10;
+
+	// Place a cave
+	// The gradient is only needed when the ore noise is high enough for a cave to be possible
+	if (EvaluatedOreFractal > 1.88 && EvaluateFractalGradient() > 0.875)
+		return 0;
+
+	// Make the top layer into grass
+	if (z >= ActualGrassZ)
+		return 3;
+
+	// Make a layer of dirt below the grass
+	if (z <= DirtZ && z > (DirtZ - DirtThickness))
+		return 2;
+
+	// Make the stone below the dirt
+	// Place an air pocket
+	if (EvaluatedOreFractal > 1.85)
+		return 0;
+
+	// Place an underground dirt pocket
+	if (EvaluatedOreFractal > 1.6 && EvaluatedOreFractal < 1.8)
+		return 2;
+
+	// Place an ore deposit
+	if (EvaluatedOreFractal < 1.5 || EvaluatedOreFractal > 1.848)
+		return 4;
+
+	// Place stone
+	return 1;
+}
+
+// VoxelTerrainPager Definitions
+// Constructor
+VoxelTerrainPager::VoxelTerrainPager(bool bIsSphericalTerrain, uint32 NoiseSeed, uint32 Octaves, float Frequency, float Scale, float Offset, float Height, bool bBatchedNoise) : FVoxelPaletteVolume::Pager(), bIsSpherical(bIsSphericalTerrain), Seed(NoiseSeed), NoiseOctaves(Octaves), NoiseFrequency(Frequency), NoiseScale(Scale), NoiseOffset(Offset), TerrainHeight(Height)
+{
+	Program = MakeUnique<FVoxelTerrainProgram>();
+	CKernel& NoiseKernel = Program->NoiseKernel;
+
+	// Commonly used constants
+	auto Zero = NoiseKernel.constant(0);
+	auto One = NoiseKernel.constant(1);
+	auto VerticalHeight = NoiseKernel.constant(TerrainHeight);
+	auto HalfVerticalHeight = NoiseKernel.constant(TerrainHeight / 2.f);
+
+	if (bIsSpherical)
+	{
+		// Select an area around 0, 0, 0 to become our sphere
+		//	- This is done by comparing the result of NoiseKernel.radial() with the radius of our sphere
+		//	- NoiseKernel.radial() returns the distance from 0, 0, 0 in case you don't know!
+		auto SphereSelect = NoiseKernel.select(One, Zero, NoiseKernel.radial(), HalfVerticalHeight, Zero);
+
+		// This is the actual noise generator we'll be using.
+		// In this case I've gone with a simple fBm generator, which will create terrain that looks like smooth, rolling hills.
+		auto TerrainFractal = NoiseKernel.simplefBm(BasisTypes::BASIS_SIMPLEX, InterpolationTypes::INTERP_LINEAR, NoiseOctaves, NoiseFrequency, Seed);
+		Program->TerrainFractal.Emplace(TerrainFractal);
+
+		// Scale and offset the generated noise value. 
+		// Scaling the noise makes the features bigger or smaller, and offsetting it will move the terrain up and down.
+		// 
+		// Generally speaking it is probably better to avoid using NoiseOffset with a spherical terrain, it might not do what you expect!
+		//	- You should probably just change the TerrainHeight from the editor instead.
+		auto TerrainScale = NoiseKernel.scaleOffset(TerrainFractal, NoiseScale, NoiseOffset);
+
+		// Finally, apply the offset we just calculated from the fractal to our sphere.
+		Program->PerturbGradient.Emplace(NoiseKernel.translateDomain(SphereSelect, TerrainScale));
+	}
+	else
+	{
+		// Create a gradient on the vertical axis to form our ground plane.
+		auto VerticalGradient = NoiseKernel.divide(NoiseKernel.clamp(NoiseKernel.subtract(VerticalHeight, NoiseKernel.z()), Zero, VerticalHeight), VerticalHeight);
+
+		// This is the actual noise generator we'll be using.
+		// In this case I've gone with a simple fBm generator, which will create terrain that looks like smooth, rolling hills.
+		auto TerrainFractal = NoiseKernel.simplefBm(BasisTypes::BASIS_SIMPLEX, InterpolationTypes::INTERP_LINEAR, NoiseOctaves, NoiseFrequency, Seed);
+		Program->TerrainFractal.Emplace(TerrainFractal);
+
+		// Scale and offset the generated noise value. 
+		// Scaling the noise makes the features bigger or smaller, and offsetting it will move the terrain up and down.
+		auto TerrainScale = NoiseKernel.scaleOffset(TerrainFractal, NoiseScale, NoiseOffset);
+
+		// Setting the Z scale of the fractal to 0 will effectively turn the fractal into a heightmap.
+		// The ground plane and the grass height are both worked out from this in GenerateFlatRegion, once per column.
+		Program->TerrainZScale.Emplace(NoiseKernel.scaleZ(TerrainScale, Zero));
+
+		// To generate pockets of ore we're going to need another noise generator.
+		auto OreFractal = NoiseKernel.simpleRidgedMultifractal(BasisTypes::BASIS_SIMPLEX, InterpolationTypes::INTERP_LINEAR, OreOctaves, OreFrequencyScale * NoiseFrequency, Seed);
+		Program->OreFractal.Emplace(OreFractal);
+		Program->FractalGradient.Emplace(NoiseKernel.multiply(OreFractal, NoiseKernel.bias(VerticalGradient, NoiseKernel.constant(CaveGradientBias))));
+	}
+
+	// The fractal can never go further from zero than the sum of the amplitudes of its layers.
+	// ANL's first two layers are both at full strength and only the ones after that halve, and the batched noise lays the layers out the same way, so the bound comes from there.
+	const FVoxelNoiseFractal TerrainLayers = FVoxelBatchedNoise::MakeFractal(EVoxelFractalType::Fbm, int32(NoiseOctaves), NoiseFrequency, Seed);
+	const double FractalBound = TerrainLayers.GetAmplitudeSum() * FractalBoundHeadroom;
+	MinTerrainScale = NoiseOffset - FMath::Abs(NoiseScale) * FractalBound;
+	MaxTerrainScale = NoiseOffset + FMath::Abs(NoiseScale) * FractalBound;
+
+	if (bBatchedNoise)
+		SetUpBatchedNoise();
+}
+
+void VoxelTerrainPager::SetUpBatchedNoise()
+{
+	Program->BatchedNoise = MakeUnique<FVoxelBatchedNoise>();
+	Program->BatchedTerrainFractal = FVoxelBatchedNoise::MakeFractal(EVoxelFractalType::Fbm, int32(NoiseOctaves), NoiseFrequency, Seed);
+	Program->BatchedOreFractal = FVoxelBatchedNoise::MakeFractal(EVoxelFractalType::Ridged, OreOctaves, OreFrequencyScale * NoiseFrequency, Seed);
+
+	// The batched noise only replaces ANL if it makes the same world.
+	// This catches an ANL built with a compiler that draws the layers in a different order, or one with a different table of gradients.
+	const float Error = CompareBatchedNoise(BatchedNoiseCheckPoints, FVoxelBatchedNoise::GetSupportedInstructionSet()).MaxError;
+	if (Error > FVoxelBatchedNoise::AnlTolerance)
+	{
+		UE_LOG(LogVoxelTerrain, Warning, TEXT("The batched noise is up to %g away from ANL, more than the %g it is allowed, so the terrain is generated with ANL instead"), Error, FVoxelBatchedNoise::AnlTolerance);
+		return;
+	}
+
+	bUseBatchedNoise = true;
+
+	UE_LOG(LogVoxelTerrain, Log, TEXT("Generating terrain with batched noise using %s, within %g of ANL"), FVoxelBatchedNoise::GetInstructionSetName(FVoxelBatchedNoise::GetSupportedInstructionSet()), Error);
+}
+
+bool VoxelTerrainPager::CanUseBatchedNoise(const FIntVector& Lower, const FIntVector& Upper) const
+{
+	if (!bUseBatchedNoise)
+		return false;
+
+	// The batched noise has only been checked against ANL out to AnlToleranceExtent, so it is used for whole volume chunks within that and ANL does the rest.
+	// Going by whole chunks means a column tile always comes from the same noise, whichever region asked for it first.
+	const int32 ChunkExtent = FVoxelBatchedNoise::AnlToleranceExtent / VolumeChunkSideLength;
+	const FIntVector LowerKey = GetVolumeChunkKey(Lower.X, Lower.Y, Lower.Z);
+	const FIntVector UpperKey = GetVolumeChunkKey(Upper.X, Upper.Y, Upper.Z);
+
+	return LowerKey.GetMin() >= -ChunkExtent && UpperKey.GetMax() < ChunkExtent;
+}
+
+FVoxelNoiseComparison VoxelTerrainPager::CompareBatchedNoise(int32 NumPoints, EVoxelNoiseInstructionSet InstructionSet) const
+{
+	FVoxelNoiseComparison Comparison;
+
+	if (!Program->BatchedNoise.IsValid())
+		return Comparison;
+
+	// The pager only ever evaluates the noise at whole voxels, so the points are spread over whole voxels as far out as the tolerance holds
+	TArray<float> X, Y, Z;
+	X.SetNumUninitialized(NumPoints);
+	Y.SetNumUninitialized(NumPoints);
+	Z.SetNumUninitialized(NumPoints);
+
+	FRandomStream Random((int32)Seed);
+	const int32 Extent = FVoxelBatchedNoise::AnlToleranceExtent;
+	for (int32 i = 0; i < NumPoints; i++)
+	{
+		X[i] = float(Random.RandRange(-Extent, Extent));
+		Y[i] = float(Random.RandRange(-Extent, Extent));
+		Z[i] = float(Random.RandRange(-Extent, Extent));
+	}
+
+	CNoiseExecutor Executor(Program->NoiseKernel);
+	const FVoxelBatchedNoise& Noise = *Program->BatchedNoise;
+
+	Comparison.MaxError = MeasureFractalError(Noise, InstructionSet, Program->BatchedTerrainFractal, Executor, Program->TerrainFractal.GetValue(), X, Y, Z, Comparison.BatchedSeconds, Comparison.AnlSeconds);
+
+	if (Program->OreFractal.IsSet())
+	{
+		const float OreError = MeasureFractalError(Noise, InstructionSet, Program->BatchedOreFractal, Executor, Program->OreFractal.GetValue(), X, Y, Z, Comparison.BatchedSeconds, Comparison.AnlSeconds);
+		Comparison.MaxError = FMath::Max(Comparison.MaxError, OreError);
+	}
+
+	return Comparison;
+}
+
+// Destructor
+// This lives here because FVoxelTerrainProgram is only defined in this file
+VoxelTerrainPager::~VoxelTerrainPager()
+{
+}
+
+// Called when a new chunk is paged in
+void VoxelTerrainPager::pageIn(const PolyVox::Region& region, FVoxelPaletteVolume::Chunk* Chunk)
+{
+	VOXEL_TERRAIN_SCOPE(STAT_VoxelTerrain_PageIn);
+
+	const FIntVector ChunkKey = GetVolumeChunkKey(region.getLowerX(), region.getLowerY(), region.getLowerZ());
+	const int32 NumVoxels = region.getWidthInVoxels() * region.getHeightInVoxels() * region.getDepthInVoxels();
+
+	TArray<MaterialDensityPair88> Voxels;
+
+	// Saved chunks come first, since they might have been modified
+	if (ChunkStore.IsValid())
+	{
+		Voxels.SetNumUninitialized(NumVoxels);
+
+		bool bReadChunk;
+		{
+			VOXEL_TERRAIN_SCOPE(STAT_VoxelTerrain_DecodeChunk);
+			bReadChunk = ChunkStore->ReadChunk(ChunkKey, Voxels.GetData());
+		}
+
+		if (bReadChunk)
+		{
+			{
+				FScopeLock StagingScopeLock(&StagingLock);
+
+				MarkChunkKnown(ChunkKey);
+				StagedChunks.Remove(ChunkKey);
+			}
+
+			Chunk->SetVoxels(Voxels.GetData());
+			return;
+		}
+
+		Voxels.Reset();
+	}
+
+	// Uniform chunks are never staged, there is only the one voxel to copy
+	MaterialDensityPair88 UniformVoxel;
+	if (ClassifyChunk(ChunkKey, UniformVoxel))
+	{
+		{
+			FScopeLock StagingScopeLock(&StagingLock);
+			MarkChunkKnown(ChunkKey);
+		}
+
+		Chunk->Fill(UniformVoxel);
+		return;
+	}
+
+	// Use the staged voxels if a worker has already generated this chunk
+	{
+		FScopeLock StagingScopeLock(&StagingLock);
+
+		MarkChunkKnown(ChunkKey);
+		StagedChunks.RemoveAndCopyValue(ChunkKey, Voxels);
+	}
+
+	// Otherwise generate it right now
+	if (Voxels.Num() != NumVoxels)
+	{
+		Voxels.SetNumUninitialized(NumVoxels);
+		GenerateRegion(region, Voxels.GetData());
+	}
+
+	// The chunk builds its palette from the whole block at once
+	Chunk->SetVoxels(Voxels.GetData());
+}
+
+void VoxelTerrainPager::StageRegion(const PolyVox::Region& Region)
+{
+	FIntVector LowerKey, UpperKey;
+	GetRegionChunkKeys(Region, LowerKey, UpperKey);
+
+	for (int32 KeyZ = LowerKey.Z; KeyZ <= UpperKey.Z; KeyZ++)
+	{
+		for (int32 KeyY = LowerKey.Y; KeyY <= UpperKey.Y; KeyY++)
+		{
+			for (int32 KeyX = LowerKey.X; KeyX <= UpperKey.X; KeyX++)
+			{
+				const FIntVector ChunkKey(KeyX, KeyY, KeyZ);
+
+				// Uniform chunks don't need any noise, pageIn fills them in directly.
+				// Neither do saved chunks, pageIn loads them instead.
+				MaterialDensityPair88 UniformVoxel;
+				if (ClassifyChunk(ChunkKey, UniformVoxel) || (ChunkStore.IsValid() && ChunkStore->HasChunk(ChunkKey)))
+					continue;
+
+				// Claim the chunk so no other worker generates it as well
+				{
+					FScopeLock StagingScopeLock(&StagingLock);
+
+					if (uint64* LastUsed = KnownChunks.Find(ChunkKey))
+					{
+						*LastUsed = ++KnownChunksClock;
+						continue;
+					}
+
+					MarkChunkKnown(ChunkKey);
+				}
+
+				const Vector3DInt32 ChunkLower(FVolumeChunkTraits::ChunkToVoxel(KeyX), FVolumeChunkTraits::ChunkToVoxel(KeyY), FVolumeChunkTraits::ChunkToVoxel(KeyZ));
+				const PolyVox::Region ChunkRegion(ChunkLower, ChunkLower + Vector3DInt32(VolumeChunkSideLength - 1, VolumeChunkSideLength - 1, VolumeChunkSideLength - 1));
+
+				TArray<MaterialDensityPair88> Voxels;
+				Voxels.SetNumUninitialized(FVolumeChunkTraits::NumVoxels);
+				GenerateRegion(ChunkRegion, Voxels.GetData());
+
+				FScopeLock StagingScopeLock(&StagingLock);
+
+				// Chunks that were staged but never paged in would otherwise pile up forever
+				if (StagedChunks.Num() >= StagedChunkCapacity)
+					EvictOldestStagedChunk();
+
+				StagedChunks.Add(ChunkKey, MoveTemp(Voxels));
+			}
+		}
+	}
+}
+
+bool VoxelTerrainPager::ClassifyChunk(const FIntVector& ChunkKey, MaterialDensityPair88& OutVoxel) const
+{
+	const FIntVector Lower = FVolumeChunkTraits::ChunkToVoxel(ChunkKey);
+	return ClassifyBox(Lower, Lower + FIntVector(VolumeChunkSideLength - 1), OutVoxel);
+}
+
+bool VoxelTerrainPager::ClassifyBox(const FIntVector& Lower, const FIntVector& Upper, MaterialDensityPair88& OutVoxel) const
+{
+	const double HalfVerticalHeight = TerrainHeight / 2.f;
+
+	if (bIsSpherical)
+	{
+		// The fractal moves every voxel along the (1, 1, 1) diagonal, which can bring it at most this much closer to or further from the centre
+		const double MaxShift = FMath::Max(FMath::Abs(MinTerrainScale), FMath::Abs(MaxTerrainScale)) * FMath::Sqrt(3.f);
+
+		// The closest and furthest points of the box from the centre of the sphere
+		double MinDistanceSquared = 0;
+		double MaxDistanceSquared = 0;
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			const double Low = Lower[Axis];
+			const double High = Upper[Axis];
+
+			MinDistanceSquared += Low > 0 ? Low * Low : (High < 0 ? High * High : 0);
+			MaxDistanceSquared += FMath::Max(Low * Low, High * High);
+		}
+
+		// Entirely outside the sphere
+		if (FMath::Sqrt(MinDistanceSquared) - MaxShift >= HalfVerticalHeight + ChunkClassificationMargin)
+		{
+			OutVoxel = MaterialDensityPair88();
+			return true;
+		}
+
+		// Entirely inside the sphere. The spherical terrain is all stone, so there is nothing else to check.
+		if (FMath::Sqrt(MaxDistanceSquared) + MaxShift < HalfVerticalHeight - ChunkClassificationMargin)
+		{
+			OutVoxel = MaterialDensityPair88(1, MaterialDensityPair88::getMaxDensity());
+			return true;
+		}
+
+		return false;
+	}
+
+	// A voxel is only solid if z + TerrainZScale <= HalfVerticalHeight, so a box that is above that for the lowest possible ground is all air.
+	// There is no uniformly solid case for flat terrain. Everything underground can be carved out by caves or turned into ore, so it needs the noise.
+	if (Lower.Z + MinTerrainScale > HalfVerticalHeight + ChunkClassificationMargin)
+	{
+		OutVoxel = MaterialDensityPair88();
+		return true;
+	}
+
+	return false;
+}
+
+bool VoxelTerrainPager::IsRegionFeatureless(const PolyVox::Region& Region) const
+{
+	FIntVector LowerKey, UpperKey;
+	GetRegionChunkKeys(Region, LowerKey, UpperKey);
+
+	bool bAnySolid = false;
+	bool bAnyAir = false;
+
+	for (int32 KeyZ = LowerKey.Z; KeyZ <= UpperKey.Z; KeyZ++)
+	{
+		for (int32 KeyY = LowerKey.Y; KeyY <= UpperKey.Y; KeyY++)
+		{
+			for (int32 KeyX = LowerKey.X; KeyX <= UpperKey.X; KeyX++)
+			{
+				const FIntVector ChunkKey(KeyX, KeyY, KeyZ);
+
+				// Saved and edited chunks might have been modified, so the noise bounds don't say anything about them
+				MaterialDensityPair88 UniformVoxel;
+				if (!ClassifyChunk(ChunkKey, UniformVoxel) || (ChunkStore.IsValid() && ChunkStore->HasChunk(ChunkKey)))
+					return false;
+
+				{
+					FScopeLock ModifiedScopeLock(&ModifiedChunksLock);
+					if (ModifiedChunks.Contains(ChunkKey))
+						return false;
+				}
+
+				// Faces only appear between solid and air voxels
+				bAnySolid |= UniformVoxel.getMaterial() > 0;
+				bAnyAir |= UniformVoxel.getMaterial() == 0;
+
+				if (bAnySolid && bAnyAir)
+					return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool VoxelTerrainPager::IsRegionModified(const PolyVox::Region& Region) const
+{
+	FIntVector LowerKey, UpperKey;
+	GetRegionChunkKeys(Region, LowerKey, UpperKey);
+
+	for (int32 KeyZ = LowerKey.Z; KeyZ <= UpperKey.Z; KeyZ++)
+	{
+		for (int32 KeyY = LowerKey.Y; KeyY <= UpperKey.Y; KeyY++)
+		{
+			for (int32 KeyX = LowerKey.X; KeyX <= UpperKey.X; KeyX++)
+			{
+				const FIntVector ChunkKey(KeyX, KeyY, KeyZ);
+
+				if (ChunkStore.IsValid() && ChunkStore->HasChunk(ChunkKey))
+					return true;
+
+				FScopeLock ModifiedScopeLock(&ModifiedChunksLock);
+				if (ModifiedChunks.Contains(ChunkKey))
+					return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+void VoxelTerrainPager::MarkRegionModified(const PolyVox::Region& Region)
+{
+	const FIntVector LowerKey = GetVolumeChunkKey(Region.getLowerX(), Region.getLowerY(), Region.getLowerZ());
+	const FIntVector UpperKey = GetVolumeChunkKey(Region.getUpperX(), Region.getUpperY(), Region.getUpperZ());
+
+	FScopeLock ModifiedScopeLock(&ModifiedChunksLock);
+
+	for (int32 KeyZ = LowerKey.Z; KeyZ <= UpperKey.Z; KeyZ++)
+	{
+		for (int32 KeyY = LowerKey.Y; KeyY <= UpperKey.Y; KeyY++)
+		{
+			for (int32 KeyX = LowerKey.X; KeyX <= UpperKey.X; KeyX++)
+			{
+				ModifiedChunks.Add(FIntVector(KeyX, KeyY, KeyZ));
+			}
+		}
+	}
+}
+
+void VoxelTerrainPager::MarkChunkKnown(const FIntVector& ChunkKey)
+{
+	KnownChunks.Add(ChunkKey, ++KnownChunksClock);
+
+	// Let the set grow a bit past its limit before trimming it, so the sort only happens every now and then
+	const int32 KnownChunksCapacity = MaxResidentChunks + StagedChunkCapacity;
+	if (KnownChunks.Num() <= KnownChunksCapacity + KnownChunksCapacity / 4)
+		return;
+
+	TArray<TPair<uint64, FIntVector>> ForgettableChunks;
+	for (const auto& KnownChunk : KnownChunks)
+	{
+		// Staged chunks have to stay known, or another worker could stage them a second time
+		if (!StagedChunks.Contains(KnownChunk.Key))
+			ForgettableChunks.Add(TPair<uint64, FIntVector>(KnownChunk.Value, KnownChunk.Key));
+	}
+
+	ForgettableChunks.Sort([](const TPair<uint64, FIntVector>& A, const TPair<uint64, FIntVector>& B) { return A.Key < B.Key; });
+
+	const int32 NumToForget = FMath::Min(KnownChunks.Num() - KnownChunksCapacity, ForgettableChunks.Num());
+	for (int32 i = 0; i < NumToForget; i++)
+		KnownChunks.Remove(ForgettableChunks[i].Value);
+}
+
+void VoxelTerrainPager::EvictOldestStagedChunk()
+{
+	FIntVector OldestKey;
+	uint64 OldestUse = MAX_uint64;
+
+	for (const auto& StagedChunk : StagedChunks)
+	{
+		const uint64* LastUsed = KnownChunks.Find(StagedChunk.Key);
+		const uint64 Use = LastUsed ? *LastUsed : 0;
+
+		if (Use < OldestUse)
+		{
+			OldestUse = Use;
+			OldestKey = StagedChunk.Key;
+		}
+	}
+
+	// The chunk will have to be generated again if it is ever needed, so forget about it as well
+	StagedChunks.Remove(OldestKey);
+	KnownChunks.Remove(OldestKey);
+}
+
+FIntVector VoxelTerrainPager::GetVolumeChunkKey(int32 X, int32 Y, int32 Z)
+{
+	return FVolumeChunkTraits::VoxelToChunk(FIntVector(X, Y, Z));
+}
+
+void VoxelTerrainPager::GetRegionChunkKeys(const PolyVox::Region& Region, FIntVector& OutLowerKey, FIntVector& OutUpperKey)
+{
+	// The surface extractors also peek one voxel outside of the region on the lower side
+	const int32 Apron = FVoxelChunkTraits::Apron;
+	OutLowerKey = GetVolumeChunkKey(Region.getLowerX() - Apron, Region.getLowerY() - Apron, Region.getLowerZ() - Apron);
+	OutUpperKey = GetVolumeChunkKey(Region.getUpperX(), Region.getUpperY(), Region.getUpperZ());
+}
+
+// Generates the voxels for a region
+// This function will automatically generate our voxel-based terrain from simplex noise
+void VoxelTerrainPager::GenerateRegion(const PolyVox::Region& region, MaterialDensityPair88* OutVoxels)
+{
+	const FIntVector Origin(region.getLowerX(), region.getLowerY(), region.getLowerZ());
+	const FIntVector NumSamples(region.getWidthInVoxels(), region.getHeightInVoxels(), region.getDepthInVoxels());
+
+	GenerateSampledRegion(Origin, NumSamples, 1, OutVoxels);
+}
+
+void VoxelTerrainPager::GenerateSampledRegion(const FIntVector& Origin, const FIntVector& NumSamples, int32 Step, MaterialDensityPair88* OutVoxels)
+{
+	check(Step > 0);
+
+	VOXEL_TERRAIN_SCOPE(STAT_VoxelTerrain_Noise);
+
+	if (CanUseBatchedNoise(Origin, Origin + (NumSamples - FIntVector(1, 1, 1)) * Step))
+	{
+		if (bIsSpherical)
+			GenerateBatchedSphericalRegion(Origin, NumSamples, Step, OutVoxels);
+		else
+			GenerateBatchedFlatRegion(Origin, NumSamples, Step, OutVoxels);
+
+		return;
+	}
+
+	// Each call gets its own executor, which is what makes it safe to generate regions on several threads at once
+	CNoiseExecutor TerrainExecutor(Program->NoiseKernel);
+
+	if (bIsSpherical)
+		GenerateSphericalRegion(Origin, NumSamples, Step, OutVoxels, TerrainExecutor);
+	else
+		GenerateFlatRegion(Origin, NumSamples, Step, OutVoxels, TerrainExecutor);
+}
+
+void VoxelTerrainPager::GenerateSphericalRegion(const FIntVector& Origin, const FIntVector& NumSamples, int32 Step, MaterialDensityPair88* OutVoxels, CNoiseExecutor& TerrainExecutor)
+{
+	// Now that we have our noise setup, let's loop over our chunk and apply it.
+	for (int32 i = 0; i < NumSamples.X; i++)
+	{
+		for (int32 j = 0; j < NumSamples.Y; j++)
+		{
+			for (int32 k = 0; k < NumSamples.Z; k++)
+			{
+				// Evaluate the noise
+				auto EvaluatedNoise = TerrainExecutor.evaluateScalar(Origin.X + i * Step, Origin.Y + j * Step, Origin.Z + k * Step, Program->PerturbGradient.GetValue());
+				MaterialDensityPair88 Voxel;
+
+				// For the sake of making this code shorter, I've opted to only use two materials: Air and Stone
+				bool bSolid = EvaluatedNoise > 0.5;
+				Voxel.setDensity(FMath::FloorToInt(FMath::Clamp(EvaluatedNoise, 0.0, 1.0) * Voxel.getMaxDensity()));
+				Voxel.setMaterial(bSolid ? 1 : 0);
+
+				OutVoxels[i + j * NumSamples.X + k * NumSamples.X * NumSamples.Y] = Voxel;
+			}
+		}
+	}
+}
+
+void VoxelTerrainPager::GenerateFlatRegion(const FIntVector& Origin, const FIntVector& NumSamples, int32 Step, MaterialDensityPair88* OutVoxels, CNoiseExecutor& TerrainExecutor)
+{
+	// The same constants the noise program was built from
+	const double VerticalHeight = TerrainHeight;
+	const double HalfVerticalHeight = TerrainHeight / 2.f;
+
+	// The heightmap only depends on the column, so look it up once for every column
+	TArray<double> ColumnHeights;
+	GetColumnHeights(Origin, NumSamples, Step, &TerrainExecutor, ColumnHeights);
+
+	// Now that we have our noise setup, let's loop over our chunk and apply it.
+	for (int32 i = 0; i < NumSamples.X; i++)
+	{
+		for (int32 j = 0; j < NumSamples.Y; j++)
+		{
+			const int32 x = Origin.X + i * Step;
+			const int32 y = Origin.Y + j * Step;
+			const double TerrainZScale = ColumnHeights[i + j * NumSamples.X];
+
+			// For now our grass is always going to appear at the top level, so we don't need to do anything fancy.
+			int ActualGrassZ = FMath::FloorToInt(HalfVerticalHeight - TerrainZScale);
+
+			for (int32 k = 0; k < NumSamples.Z; k++)
+			{
+				const int32 z = Origin.Z + k * Step;
+
+				// This is the vertical gradient shifted up or down by the heightmap, turned into ground and air at 0.5.
+				// It's exactly what the program used to evaluate for every voxel, without going through the executor.
+				auto EvaluatedNoise = FMath::Clamp(VerticalHeight - (z + TerrainZScale), 0.0, VerticalHeight) / VerticalHeight < 0.5 ? 0.0 : 1.0;
+				MaterialDensityPair88 Voxel;
+
+				// Determine the solidity of the voxel
+				bool bSolid = EvaluatedNoise > 0.5;
+
+				// Set all the solid blocks to something
+				// Air never needs the ore noise, so it is only evaluated here
+				if (bSolid)
+				{
+					auto EvaluatedOreFractal = TerrainExecutor.evaluateScalar(x, y, z, Program->OreFractal.GetValue());
+
+					const uint8 Material = GetFlatTerrainMaterial(z, ActualGrassZ, EvaluatedOreFractal, [&]()
+					{
+						return TerrainExecutor.evaluateScalar(x, y, z, Program->FractalGradient.GetValue());
+					});
+
+					bSolid = Material != 0;
+					Voxel.setMaterial(Material);
+				}
+
+				Voxel.setDensity(FMath::FloorToInt(FMath::Clamp(bSolid ? EvaluatedNoise : 0.0, 0.0, 1.0) * Voxel.getMaxDensity()));
+
+				OutVoxels[i + j * NumSamples.X + k * NumSamples.X * NumSamples.Y] = Voxel;
+			}
+		}
+	}
+}
+
+void VoxelTerrainPager::GetColumnHeights(const FIntVector& Origin, const FIntVector& NumSamples, int32 Step, CNoiseExecutor* TerrainExecutor, TArray<double>& OutHeights)
+{
+	OutHeights.SetNumUninitialized(NumSamples.X * NumSamples.Y);
+
+	// Coarse samples are spread over lots of tiles and would only use a few columns of each, so they skip the cache
+	if (Step > 1)
+	{
+		EvaluateColumnHeights(FIntPoint(Origin.X, Origin.Y), FIntPoint(NumSamples.X, NumSamples.Y), Step, TerrainExecutor, OutHeights.GetData());
+		return;
+	}
+
+	TSharedPtr<FVoxelColumnTile, ESPMode::ThreadSafe> Tile;
+	FIntPoint TileCoord(MAX_int32, MAX_int32);
+
+	for (int32 i = 0; i < NumSamples.X; i++)
+	{
+		for (int32 j = 0; j < NumSamples.Y; j++)
+		{
+			const int32 x = Origin.X + i;
+			const int32 y = Origin.Y + j;
+
+			// The heights are shared by every chunk stacked on top of each other, so they come from the tile cache
+			const FIntPoint ColumnTileCoord(FVolumeChunkTraits::VoxelToChunk(x), FVolumeChunkTraits::VoxelToChunk(y));
+			if (ColumnTileCoord != TileCoord)
+			{
+				TileCoord = ColumnTileCoord;
+				Tile = GetColumnTile(TileCoord.X, TileCoord.Y, TerrainExecutor);
+			}
+
+			OutHeights[i + j * NumSamples.X] = Tile->Heights[FVolumeChunkTraits::LocalIndex(FVolumeChunkTraits::VoxelToLocal(x), FVolumeChunkTraits::VoxelToLocal(y), 0)];
+		}
+	}
+}
+
+void VoxelTerrainPager::EvaluateColumnHeights(const FIntPoint& Origin, const FIntPoint& NumColumns, int32 Step, CNoiseExecutor* TerrainExecutor, double* OutHeights)
+{
+	if (TerrainExecutor)
+	{
+		int32 ColumnIndex = 0;
+		for (int32 j = 0; j < NumColumns.Y; j++)
+		{
+			for (int32 i = 0; i < NumColumns.X; i++)
+			{
+				// The Z scale of the heightmap is zero, so any Z gives the same answer
+				OutHeights[ColumnIndex++] = TerrainExecutor->evaluateScalar(Origin.X + i * Step, Origin.Y + j * Step, 0, Program->TerrainZScale.GetValue());
+			}
+		}
+
+		return;
+	}
+
+	// There are usually more columns than fit in a batch, so they are evaluated a batch at a time
+	const int32 TotalColumns = NumColumns.X * NumColumns.Y;
+	float X[FVoxelBatchedNoise::BatchSize];
+	float Y[FVoxelBatchedNoise::BatchSize];
+	float Z[FVoxelBatchedNoise::BatchSize] = { 0 };
+	float Values[FVoxelBatchedNoise::BatchSize];
+
+	for (int32 BatchStart = 0; BatchStart < TotalColumns; BatchStart += FVoxelBatchedNoise::BatchSize)
+	{
+		const int32 Count = FMath::Min(int32(FVoxelBatchedNoise::BatchSize), TotalColumns - BatchStart);
+
+		for (int32 i = 0; i < Count; i++)
+		{
+			X[i] = float(Origin.X + ((BatchStart + i) % NumColumns.X) * Step);
+			Y[i] = float(Origin.Y + ((BatchStart + i) / NumColumns.X) * Step);
+		}
+
+		Program->BatchedNoise->EvaluateFractal(Program->BatchedTerrainFractal, X, Y, Z, Values, Count);
+
+		for (int32 i = 0; i < Count; i++)
+			OutHeights[BatchStart + i] = double(Values[i]) * NoiseScale + NoiseOffset;
+	}
+}
+
+TSharedRef<FVoxelColumnTile, ESPMode::ThreadSafe> VoxelTerrainPager::GetColumnTile(int32 TileX, int32 TileY, CNoiseExecutor* TerrainExecutor)
+{
+	const FIntPoint TileCoord(TileX, TileY);
+
+	{
+		FScopeLock ColumnCacheScopeLock(&ColumnCacheLock);
+
+		if (TSharedRef<FVoxelColumnTile, ESPMode::ThreadSafe>* CachedTile = ColumnCache.Find(TileCoord))
+		{
+			(*CachedTile)->LastUsed = ++ColumnCacheClock;
+			return *CachedTile;
+		}
+	}
+
+	// Whether the tile comes from the batched noise only depends on where it is, so regions that are generated with ANL can still share tiles with regions that aren't.
+	// A region that uses the batched noise is entirely within its extent, so it never needs ANL for its tiles.
+	const FIntVector TileOrigin(TileX * VolumeChunkSideLength, TileY * VolumeChunkSideLength, 0);
+	const bool bBatchedTile = CanUseBatchedNoise(TileOrigin, TileOrigin + FIntVector(VolumeChunkSideLength - 1, VolumeChunkSideLength - 1, 0));
+	check(bBatchedTile || TerrainExecutor);
+
+	// Evaluate the heightmap for every column in the tile.
+	// Two threads might both end up doing this for the same tile, but they will get the same answer.
+	TSharedRef<FVoxelColumnTile, ESPMode::ThreadSafe> Tile = MakeShareable(new FVoxelColumnTile());
+	Tile->Heights.SetNumUninitialized(VolumeChunkSideLength * VolumeChunkSideLength);
+	EvaluateColumnHeights(TileCoord * VolumeChunkSideLength, FIntPoint(VolumeChunkSideLength, VolumeChunkSideLength), 1, bBatchedTile ? nullptr : TerrainExecutor, Tile->Heights.GetData());
+
+	FScopeLock ColumnCacheScopeLock(&ColumnCacheLock);
+
+	// Make room by throwing away the tile that was used least recently
+	if (ColumnCache.Num() >= ColumnCacheCapacity)
+	{
+		FIntPoint OldestCoord = TileCoord;
+		uint64 OldestUse = MAX_uint64;
+
+		for (const auto& CachedTile : ColumnCache)
+		{
+			if (CachedTile.Value->LastUsed < OldestUse)
+			{
+				OldestUse = CachedTile.Value->LastUsed;
+				OldestCoord = CachedTile.Key;
+			}
+		}
+
+		ColumnCache.Remove(OldestCoord);
+	}
+
+	Tile->LastUsed = ++ColumnCacheClock;
+	ColumnCache.Add(TileCoord, Tile);
+
+	return Tile;
+}
+
+void VoxelTerrainPager::GenerateBatchedSphericalRegion(const FIntVector& Origin, const FIntVector& NumSamples, int32 Step, MaterialDensityPair88* OutVoxels)
+{
+	const int32 Width = NumSamples.X;
+	const int32 Height = NumSamples.Y;
+	const int32 NumVoxels = Width * Height * NumSamples.Z;
+	const float Radius = TerrainHeight / 2.f;
+
+	float X[FVoxelBatchedNoise::BatchSize];
+	float Y[FVoxelBatchedNoise::BatchSize];
+	float Z[FVoxelBatchedNoise::BatchSize];
+	float Values[FVoxelBatchedNoise::BatchSize];
+
+	// Walk the output in order, so each batch is a run of voxels along X
+	for (int32 BatchStart = 0; BatchStart < NumVoxels; BatchStart += FVoxelBatchedNoise::BatchSize)
+	{
+		const int32 Count = FMath::Min(int32(FVoxelBatchedNoise::BatchSize), NumVoxels - BatchStart);
+
+		for (int32 i = 0; i < Count; i++)
+		{
+			const int32 VoxelIndex = BatchStart + i;
+			X[i] = float(Origin.X + (VoxelIndex % Width) * Step);
+			Y[i] = float(Origin.Y + ((VoxelIndex / Width) % Height) * Step);
+			Z[i] = float(Origin.Z + (VoxelIndex / (Width * Height)) * Step);
+		}
+
+		Program->BatchedNoise->EvaluateFractal(Program->BatchedTerrainFractal, X, Y, Z, Values, Count);
+
+		for (int32 i = 0; i < Count; i++)
+		{
+			// Move the sphere by the scaled noise, the same way the ANL program translates its domain
+			const float TerrainScale = Values[i] * NoiseScale + NoiseOffset;
+			const float DistanceSquared = FMath::Square(X[i] + TerrainScale) + FMath::Square(Y[i] + TerrainScale) + FMath::Square(Z[i] + TerrainScale);
+
+			MaterialDensityPair88 Voxel;
+			bool bSolid = DistanceSquared < Radius * Radius;
+			Voxel.setDensity(bSolid ? Voxel.getMaxDensity() : 0);
+			Voxel.setMaterial(bSolid ? 1 : 0);
+
+			OutVoxels[BatchStart + i] = Voxel;
+		}
+	}
+}
+
+void VoxelTerrainPager::GenerateBatchedFlatRegion(const FIntVector& Origin, const FIntVector& NumSamples, int32 Step, MaterialDensityPair88* OutVoxels)
+{
+	const int32 Width = NumSamples.X;
+	const int32 Height = NumSamples.Y;
+
+	const double VerticalHeight = TerrainHeight;
+	const double HalfVerticalHeight = TerrainHeight / 2.f;
+
+	// The solid voxels waiting for their ore noise. Air never needs it, so only solid voxels are batched up.
+	float X[FVoxelBatchedNoise::BatchSize];
+	float Y[FVoxelBatchedNoise::BatchSize];
+	float Z[FVoxelBatchedNoise::BatchSize];
+	float Ore[FVoxelBatchedNoise::BatchSize];
+	int32 OutputIndices[FVoxelBatchedNoise::BatchSize];
+	int32 GrassZ[FVoxelBatchedNoise::BatchSize];
+	int32 Count = 0;
+
+	// Evaluates the ore noise for the batch and writes out the finished voxels
+	auto FlushBatch = [&]()
+	{
+		Program->BatchedNoise->EvaluateFractal(Program->BatchedOreFractal, X, Y, Z, Ore, Count);
+
+		for (int32 i = 0; i < Count; i++)
+		{
+			const int32 z = int32(Z[i]);
+			const double EvaluatedOreFractal = Ore[i];
+
+			const uint8 Material = GetFlatTerrainMaterial(z, GrassZ[i], EvaluatedOreFractal, [&]()
+			{
+				// The ore noise biased by the vertical gradient, like the ANL program's FractalGradient
+				const double VerticalGradient = FMath::Clamp(VerticalHeight - z, 0.0, VerticalHeight) / VerticalHeight;
+				return EvaluatedOreFractal * FMath::Pow(VerticalGradient, FMath::Loge(CaveGradientBias) / FMath::Loge(0.5));
+			});
+
+			MaterialDensityPair88& Voxel = OutVoxels[OutputIndices[i]];
+			Voxel.setMaterial(Material);
+			Voxel.setDensity(Material != 0 ? Voxel.getMaxDensity() : 0);
+		}
+
+		Count = 0;
+	};
+
+	TArray<double> ColumnHeights;
+	GetColumnHeights(Origin, NumSamples, Step, nullptr, ColumnHeights);
+
+	for (int32 i = 0; i < Width; i++)
+	{
+		for (int32 j = 0; j < Height; j++)
+		{
+			const double TerrainZScale = ColumnHeights[i + j * Width];
+			const int32 ActualGrassZ = FMath::FloorToInt(HalfVerticalHeight - TerrainZScale);
+
+			for (int32 k = 0; k < NumSamples.Z; k++)
+			{
+				const int32 z = Origin.Z + k * Step;
+				const int32 OutputIndex = i + j * Width + k * Width * Height;
+				const bool bSolid = FMath::Clamp(VerticalHeight - (z + TerrainZScale), 0.0, VerticalHeight) / VerticalHeight >= 0.5;
+
+				// Air is written straight away, solid voxels wait for the batch
+				OutVoxels[OutputIndex] = MaterialDensityPair88();
+				if (!bSolid)
+					continue;
+
+				X[Count] = float(Origin.X + i * Step);
+				Y[Count] = float(Origin.Y + j * Step);
+				Z[Count] = float(z);
+				OutputIndices[Count] = OutputIndex;
+				GrassZ[Count] = ActualGrassZ;
+
+				if (++Count == FVoxelBatchedNoise::BatchSize)
+					FlushBatch();
+			}
+		}
+	}
+
+	if (Count > 0)
+		FlushBatch();
+}
+
+uint32 VoxelTerrainPager::GetSettingsHash() const
+{
+	uint32 Hash = GetTypeHash(uint32(bIsSpherical));
+	Hash = HashCombine(Hash, GetTypeHash(uint32(bUseBatchedNoise)));
+	Hash = HashCombine(Hash, GetTypeHash(Seed));
+	Hash = HashCombine(Hash, GetTypeHash(NoiseOctaves));
+	Hash = HashCombine(Hash, GetTypeHash(NoiseFrequency));
+	Hash = HashCombine(Hash, GetTypeHash(NoiseScale));
+	Hash = HashCombine(Hash, GetTypeHash(NoiseOffset));
+	Hash = HashCombine(Hash, GetTypeHash(TerrainHeight));
+	return Hash;
+}
+
+// Called when a chunk is paged out
+// PolyVox only pages out chunks that have been modified since they were paged in, so everything that gets here needs saving.
+void VoxelTerrainPager::pageOut(const PolyVox::Region& region, FVoxelPaletteVolume::Chunk* Chunk)
+{
+	VOXEL_TERRAIN_SCOPE(STAT_VoxelTerrain_PageOut);
+
+	const FIntVector ChunkKey = GetVolumeChunkKey(region.getLowerX(), region.getLowerY(), region.getLowerZ());
+
+	if (ChunkStore.IsValid())
+	{
+		TArray<MaterialDensityPair88> Voxels;
+		Voxels.SetNumUninitialized(region.getWidthInVoxels() * region.getHeightInVoxels() * region.getDepthInVoxels());
+		Chunk->GetVoxels(Voxels.GetData());
+
+		ChunkStore->WriteChunk(ChunkKey, Voxels.GetData());
+	}
+
+	// The chunk store has the edits now, or they're lost if there isn't one.
+	// This is only forgotten after the write, so IsRegionFeatureless always finds an edited chunk in one or the other.
+	FScopeLock ModifiedScopeLock(&ModifiedChunksLock);
+	ModifiedChunks.Remove(ChunkKey);
+}
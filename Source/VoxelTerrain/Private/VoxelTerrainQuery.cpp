@@ -0,0 +1,302 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#include "VoxelTerrainQuery.h"
+
+using namespace PolyVox;
+
+// Keeps the chunk a query is reading locked, and swaps it for the next one when the query moves on.
+// Only one chunk is ever held, which is what lets queries lock chunks in whatever order they come to them.
+class FVoxelLockedChunkReader
+{
+public:
+	FVoxelLockedChunkReader(const FVoxelPaletteVolume& InVolume)
+		: Volume(InVolume)
+		, SideLengthPower(InVolume.GetChunkSideLengthPower())
+		, Mask(InVolume.GetChunkSideLength() - 1)
+		, LockedChunk(nullptr)
+		, LockedKey(FIntVector::ZeroValue)
+	{}
+
+	~FVoxelLockedChunkReader()
+	{
+		Release();
+	}
+
+	// Returns the chunk a position in the volume is in, locking it in place of the one held before if it isn't the same chunk
+	FORCEINLINE const FVoxelPaletteVolume::Chunk& GetChunk(int32 X, int32 Y, int32 Z)
+	{
+		const FIntVector ChunkKey(X >> SideLengthPower, Y >> SideLengthPower, Z >> SideLengthPower);
+
+		if (!LockedChunk || ChunkKey != LockedKey)
+		{
+			Release();
+			LockedChunk = Volume.LockChunkForReading(ChunkKey);
+			LockedKey = ChunkKey;
+		}
+
+		return *LockedChunk;
+	}
+
+	// Returns the voxel at a position in the volume
+	FORCEINLINE MaterialDensityPair88 GetVoxel(int32 X, int32 Y, int32 Z)
+	{
+		return GetChunk(X, Y, Z).getVoxel(X & Mask, Y & Mask, Z & Mask);
+	}
+
+	// Unlocks the chunk that is held, if there is one
+	void Release()
+	{
+		if (LockedChunk)
+		{
+			Volume.UnlockChunkForReading(LockedChunk);
+			LockedChunk = nullptr;
+		}
+	}
+
+	const FVoxelPaletteVolume& Volume;
+	const int32 SideLengthPower;
+	const int32 Mask;
+
+private:
+	const FVoxelPaletteVolume::Chunk* LockedChunk;
+	FIntVector LockedKey;
+};
+
+bool FVoxelTerrainQuery::Raycast(const FVector& Start, const FVector& End, FVoxelQueryResult& OutResult) const
+{
+	FVoxelLockedChunkReader Reader(*Volume);
+
+	// Moving half a voxel up puts the boundaries between voxels on whole numbers, so the voxel a point is in is just its floor
+	const FVector From = Start + FVector(0.5f);
+	const FVector To = End + FVector(0.5f);
+	const FVector Delta = End - Start;
+
+	FIntVector Voxel(FMath::FloorToInt(From.X), FMath::FloorToInt(From.Y), FMath::FloorToInt(From.Z));
+	const FIntVector LastVoxel(FMath::FloorToInt(To.X), FMath::FloorToInt(To.Y), FMath::FloorToInt(To.Z));
+
+	// For each axis: which way the line goes, the time it takes to cross a whole voxel, and the time it reaches the next boundary.
+	// Time runs from 0 at Start to 1 at End.
+	FIntVector Step(0);
+	FVector CrossTime(MAX_flt);
+	FVector NextTime(MAX_flt);
+
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		if (Delta[Axis] > 0.f)
+		{
+			Step[Axis] = 1;
+			CrossTime[Axis] = 1.f / Delta[Axis];
+			NextTime[Axis] = (Voxel[Axis] + 1 - From[Axis]) * CrossTime[Axis];
+		}
+		else if (Delta[Axis] < 0.f)
+		{
+			Step[Axis] = -1;
+			CrossTime[Axis] = -1.f / Delta[Axis];
+			NextTime[Axis] = (From[Axis] - Voxel[Axis]) * CrossTime[Axis];
+		}
+	}
+
+	// The line crosses exactly this many boundaries. Stopping there means float error near the end can't walk it any further.
+	const int32 NumSteps = FMath::Abs(LastVoxel.X - Voxel.X) + FMath::Abs(LastVoxel.Y - Voxel.Y) + FMath::Abs(LastVoxel.Z - Voxel.Z);
+
+	FIntVector Normal(0);
+	float Time = 0.f;
+
+	for (int32 StepIndex = 0; ; StepIndex++)
+	{
+		const MaterialDensityPair88 Value = Reader.GetVoxel(Voxel.X + VolumeOffset.X, Voxel.Y + VolumeOffset.Y, Voxel.Z + VolumeOffset.Z);
+
+		if (Value.getMaterial() != 0)
+		{
+			OutResult.Voxel = Voxel;
+			OutResult.Normal = Normal;
+			OutResult.Time = Time;
+			OutResult.Value = Value;
+			return true;
+		}
+
+		if (StepIndex == NumSteps)
+			return false;
+
+		// Move into the next voxel along whichever axis the line reaches a boundary on first
+		const int32 Axis = NextTime.X < NextTime.Y ? (NextTime.X < NextTime.Z ? 0 : 2) : (NextTime.Y < NextTime.Z ? 1 : 2);
+
+		Time = FMath::Min(NextTime[Axis], 1.f);
+		Voxel[Axis] += Step[Axis];
+		NextTime[Axis] += CrossTime[Axis];
+
+		Normal = FIntVector(0);
+		Normal[Axis] = -Step[Axis];
+	}
+}
+
+bool FVoxelTerrainQuery::FindSurfaceBelow(const FIntVector& Voxel, int32 MaxDepth, FVoxelQueryResult& OutResult) const
+{
+	FVoxelLockedChunkReader Reader(*Volume);
+
+	const FIntVector VolumeVoxel = Voxel + VolumeOffset;
+	const int32 LowestZ = VolumeVoxel.Z - FMath::Max(MaxDepth, 0);
+	const int32 LocalX = VolumeVoxel.X & Reader.Mask;
+	const int32 LocalY = VolumeVoxel.Y & Reader.Mask;
+
+	int32 Z = VolumeVoxel.Z;
+	while (Z >= LowestZ)
+	{
+		const FVoxelPaletteVolume::Chunk& ColumnChunk = Reader.GetChunk(VolumeVoxel.X, VolumeVoxel.Y, Z);
+		const int32 ChunkBottom = FMath::Max(Z & ~Reader.Mask, LowestZ);
+
+		// A chunk of nothing but air is skipped in one go, and one that is all solid is the surface straight away
+		if (ColumnChunk.IsUniform() && ColumnChunk.getVoxel(0, 0, 0).getMaterial() == 0)
+		{
+			Z = ChunkBottom - 1;
+			continue;
+		}
+
+		for (; Z >= ChunkBottom; Z--)
+		{
+			const MaterialDensityPair88 Value = ColumnChunk.getVoxel(LocalX, LocalY, Z & Reader.Mask);
+
+			if (Value.getMaterial() != 0)
+			{
+				OutResult.Voxel = FIntVector(Voxel.X, Voxel.Y, Z - VolumeOffset.Z);
+				OutResult.Normal = FIntVector(0, 0, 1);
+				OutResult.Time = 0.f;
+				OutResult.Value = Value;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+// The shapes OverlapVoxels looks for solid voxels in. Positions are in voxels relative to the terrain.
+namespace VoxelQueryShapes
+{
+	// Every voxel in the box is in the shape
+	struct FBox
+	{
+		FORCEINLINE bool Contains(const FIntVector& Voxel) const { return true; }
+
+		// Returns the voxel in the box that is most likely to be in the shape
+		FORCEINLINE FIntVector GetClosest(const FIntVector& Lower, const FIntVector& Upper) const { return Lower; }
+	};
+
+	// The voxels whose centre is within a radius of a point
+	struct FSphere
+	{
+		FVector Center;
+		float RadiusSquared;
+
+		FORCEINLINE bool Contains(const FIntVector& Voxel) const { return (FVector(Voxel) - Center).SizeSquared() <= RadiusSquared; }
+
+		// The closest voxel centre to the sphere's centre is the closest along each axis on its own
+		FORCEINLINE FIntVector GetClosest(const FIntVector& Lower, const FIntVector& Upper) const
+		{
+			return FIntVector(
+				FMath::Clamp(FMath::RoundToInt(Center.X), Lower.X, Upper.X),
+				FMath::Clamp(FMath::RoundToInt(Center.Y), Lower.Y, Upper.Y),
+				FMath::Clamp(FMath::RoundToInt(Center.Z), Lower.Z, Upper.Z));
+		}
+	};
+}
+
+template<typename ShapeType>
+bool FVoxelTerrainQuery::OverlapVoxels(const FIntVector& Lower, const FIntVector& Upper, const ShapeType& Shape, FVoxelQueryResult& OutResult) const
+{
+	if (Lower.X > Upper.X || Lower.Y > Upper.Y || Lower.Z > Upper.Z)
+		return false;
+
+	const int32 SideLength = Volume->GetChunkSideLength();
+	const int32 SideLengthPower = Volume->GetChunkSideLengthPower();
+	const int32 Mask = SideLength - 1;
+
+	const FIntVector VolumeLower = Lower + VolumeOffset;
+	const FIntVector VolumeUpper = Upper + VolumeOffset;
+
+	for (int32 ChunkZ = VolumeLower.Z >> SideLengthPower; ChunkZ <= VolumeUpper.Z >> SideLengthPower; ChunkZ++)
+	{
+		for (int32 ChunkY = VolumeLower.Y >> SideLengthPower; ChunkY <= VolumeUpper.Y >> SideLengthPower; ChunkY++)
+		{
+			for (int32 ChunkX = VolumeLower.X >> SideLengthPower; ChunkX <= VolumeUpper.X >> SideLengthPower; ChunkX++)
+			{
+				const FIntVector ChunkKey(ChunkX, ChunkY, ChunkZ);
+				const FIntVector ChunkLower = ChunkKey * SideLength;
+
+				// The part of the box inside this chunk, relative to the terrain
+				const FIntVector BoxLower = FIntVector(FMath::Max(VolumeLower.X, ChunkLower.X), FMath::Max(VolumeLower.Y, ChunkLower.Y), FMath::Max(VolumeLower.Z, ChunkLower.Z)) - VolumeOffset;
+				const FIntVector BoxUpper = FIntVector(FMath::Min(VolumeUpper.X, ChunkLower.X + Mask), FMath::Min(VolumeUpper.Y, ChunkLower.Y + Mask), FMath::Min(VolumeUpper.Z, ChunkLower.Z + Mask)) - VolumeOffset;
+
+				const FVoxelPaletteVolume::Chunk* BoxChunk = Volume->LockChunkForReading(ChunkKey);
+
+				bool bFound = false;
+				if (BoxChunk->IsUniform())
+				{
+					// Every voxel in the chunk is the same, so only the one closest to the shape needs checking
+					const MaterialDensityPair88 Value = BoxChunk->getVoxel(0, 0, 0);
+					const FIntVector Closest = Shape.GetClosest(BoxLower, BoxUpper);
+
+					if (Value.getMaterial() != 0 && Shape.Contains(Closest))
+					{
+						OutResult.Voxel = Closest;
+						OutResult.Value = Value;
+						bFound = true;
+					}
+				}
+				else
+				{
+					for (int32 Z = BoxLower.Z; Z <= BoxUpper.Z && !bFound; Z++)
+					{
+						for (int32 Y = BoxLower.Y; Y <= BoxUpper.Y && !bFound; Y++)
+						{
+							for (int32 X = BoxLower.X; X <= BoxUpper.X; X++)
+							{
+								const MaterialDensityPair88 Value = BoxChunk->getVoxel((X + VolumeOffset.X) & Mask, (Y + VolumeOffset.Y) & Mask, (Z + VolumeOffset.Z) & Mask);
+
+								if (Value.getMaterial() != 0 && Shape.Contains(FIntVector(X, Y, Z)))
+								{
+									OutResult.Voxel = FIntVector(X, Y, Z);
+									OutResult.Value = Value;
+									bFound = true;
+									break;
+								}
+							}
+						}
+					}
+				}
+
+				Volume->UnlockChunkForReading(BoxChunk);
+
+				if (bFound)
+				{
+					OutResult.Normal = FIntVector(0);
+					OutResult.Time = 0.f;
+					return true;
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
+bool FVoxelTerrainQuery::OverlapBox(const FIntVector& Lower, const FIntVector& Upper, FVoxelQueryResult& OutResult) const
+{
+	return OverlapVoxels(Lower, Upper, VoxelQueryShapes::FBox(), OutResult);
+}
+
+bool FVoxelTerrainQuery::OverlapSphere(const FVector& Center, float Radius, FVoxelQueryResult& OutResult) const
+{
+	if (Radius < 0.f)
+		return false;
+
+	VoxelQueryShapes::FSphere Sphere;
+	Sphere.Center = Center;
+	Sphere.RadiusSquared = Radius * Radius;
+
+	// Only the voxels whose centres are inside the sphere's bounds can be in it
+	const FIntVector Lower(FMath::CeilToInt(Center.X - Radius), FMath::CeilToInt(Center.Y - Radius), FMath::CeilToInt(Center.Z - Radius));
+	const FIntVector Upper(FMath::FloorToInt(Center.X + Radius), FMath::FloorToInt(Center.Y + Radius), FMath::FloorToInt(Center.Z + Radius));
+
+	return OverlapVoxels(Lower, Upper, Sphere, OutResult);
+}
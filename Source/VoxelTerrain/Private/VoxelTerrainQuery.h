@@ -0,0 +1,62 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VoxelPaletteVolume.h"
+
+// PolyVox
+#include "PolyVox/MaterialDensityPair.h"
+
+// What a query found, in voxels relative to the terrain
+struct FVoxelQueryResult
+{
+	// The solid voxel that was found
+	FIntVector Voxel = FIntVector::ZeroValue;
+
+	// The face of the voxel a ray came in through, pointing out of the voxel. This is zero if the ray started inside it, and for overlaps.
+	FIntVector Normal = FIntVector::ZeroValue;
+
+	// How far along the ray the voxel was hit, from 0 at the start to 1 at the end
+	float Time = 0.f;
+
+	// The voxel itself
+	PolyVox::MaterialDensityPair88 Value;
+};
+
+// Answers questions about the terrain by reading the voxels straight out of the volume, so they don't need the chunk meshes or their collision
+// to have been built. Everything is in voxels relative to the terrain, where voxel V covers V - 0.5 to V + 0.5 along each axis, like the editing
+// functions, and any voxel with a material is solid.
+//
+// Only one chunk is locked at a time, while the query is reading it. So queries can run on any number of threads while the game thread edits
+// the terrain, and never see half of an edit within a chunk, though a query that crosses several chunks can see an edit in some and not others.
+// Chunks that are all air or all solid are answered from their palette without looking at any voxels.
+class FVoxelTerrainQuery
+{
+public:
+	// The volume has to outlive the query. VolumeOffset is the position of voxel 0 in the volume.
+	FVoxelTerrainQuery(const FVoxelPaletteVolume& InVolume, const FIntVector& InVolumeOffset)
+		: Volume(&InVolume)
+		, VolumeOffset(InVolumeOffset)
+	{}
+
+	// Walks the voxels a line passes through, from Start to End, and returns the first solid one. A solid voxel at Start is a hit at time 0.
+	bool Raycast(const FVector& Start, const FVector& End, FVoxelQueryResult& OutResult) const;
+
+	// Looks straight down the Z axis from a voxel for the first solid one, at most MaxDepth voxels below it. The voxel itself counts.
+	bool FindSurfaceBelow(const FIntVector& Voxel, int32 MaxDepth, FVoxelQueryResult& OutResult) const;
+
+	// Returns true if any voxel in the box is solid. Both corners are inclusive. OutResult is the first solid voxel found, which isn't necessarily the closest.
+	bool OverlapBox(const FIntVector& Lower, const FIntVector& Upper, FVoxelQueryResult& OutResult) const;
+
+	// Returns true if the centre of any solid voxel is within Radius of Center
+	bool OverlapSphere(const FVector& Center, float Radius, FVoxelQueryResult& OutResult) const;
+
+private:
+	// Looks for a solid voxel in the box that is also inside the shape, a chunk at a time
+	template<typename ShapeType>
+	bool OverlapVoxels(const FIntVector& Lower, const FIntVector& Upper, const ShapeType& Shape, FVoxelQueryResult& OutResult) const;
+
+	const FVoxelPaletteVolume* Volume;
+	FIntVector VolumeOffset;
+};
@@ -0,0 +1,62 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+
+// Everything here shows up with "stat VoxelTerrain". The counters are defined in VoxelTerrain.cpp.
+DECLARE_STATS_GROUP(TEXT("VoxelTerrain"), STATGROUP_VoxelTerrain, STATCAT_Advanced);
+
+// The stages of the pipeline. Generate Chunk is the whole of a worker's time on a chunk, and the stages below it are part of it.
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Tick"), STAT_VoxelTerrain_Tick, STATGROUP_VoxelTerrain, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Generate Chunk"), STAT_VoxelTerrain_GenerateChunk, STATGROUP_VoxelTerrain, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Noise"), STAT_VoxelTerrain_Noise, STATGROUP_VoxelTerrain, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Surface Extraction"), STAT_VoxelTerrain_Extract, STATGROUP_VoxelTerrain, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Mesh Conversion"), STAT_VoxelTerrain_BuildMesh, STATGROUP_VoxelTerrain, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Collision Merging"), STAT_VoxelTerrain_BuildCollision, STATGROUP_VoxelTerrain, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Visibility Flood Fill"), STAT_VoxelTerrain_BuildVisibility, STATGROUP_VoxelTerrain, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Page In"), STAT_VoxelTerrain_PageIn, STATGROUP_VoxelTerrain, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Decode Saved Chunk"), STAT_VoxelTerrain_DecodeChunk, STATGROUP_VoxelTerrain, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Page Out"), STAT_VoxelTerrain_PageOut, STATGROUP_VoxelTerrain, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Read Mesh Cache"), STAT_VoxelTerrain_ReadMeshCache, STATGROUP_VoxelTerrain, );
+
+// Raycasts, surface lookups and overlaps against the voxels, on whichever thread answered them
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Queries"), STAT_VoxelTerrain_Queries, STATGROUP_VoxelTerrain, );
+
+// Walking the chunks out from the viewers to find the ones that can't be seen
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Hide Buried Chunks"), STAT_VoxelTerrain_CullChunks, STATGROUP_VoxelTerrain, );
+
+// CreateMeshSection on the game thread. Collision is cooked asynchronously, so only handing it to the cooker is counted here.
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Create Mesh Sections"), STAT_VoxelTerrain_CreateMeshSections, STATGROUP_VoxelTerrain, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Create Collision Sections"), STAT_VoxelTerrain_CreateCollisionSections, STATGROUP_VoxelTerrain, );
+
+// Totals since the game started
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Chunks Generated"), STAT_VoxelTerrain_ChunksGenerated, STATGROUP_VoxelTerrain, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Chunks Skipped As Empty"), STAT_VoxelTerrain_ChunksSkipped, STATGROUP_VoxelTerrain, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Chunks Read From Mesh Cache"), STAT_VoxelTerrain_ChunksCached, STATGROUP_VoxelTerrain, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Net Edits Sent"), STAT_VoxelTerrain_NetEditsSent, STATGROUP_VoxelTerrain, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Net Edit Bytes Sent"), STAT_VoxelTerrain_NetEditBytesSent, STATGROUP_VoxelTerrain, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Net Snapshot Bytes Sent"), STAT_VoxelTerrain_NetSnapshotBytesSent, STATGROUP_VoxelTerrain, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Queries Answered"), STAT_VoxelTerrain_QueriesAnswered, STATGROUP_VoxelTerrain, );
+
+// What is loaded right now, over every terrain
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Triangles"), STAT_VoxelTerrain_Triangles, STATGROUP_VoxelTerrain, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Vertices"), STAT_VoxelTerrain_Vertices, STATGROUP_VoxelTerrain, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Mesh Sections"), STAT_VoxelTerrain_MeshSections, STATGROUP_VoxelTerrain, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Collidable Chunks"), STAT_VoxelTerrain_CollisionChunks, STATGROUP_VoxelTerrain, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Collision Triangles"), STAT_VoxelTerrain_CollisionTriangles, STATGROUP_VoxelTerrain, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Paged Volume Memory"), STAT_VoxelTerrain_VolumeMemory, STATGROUP_VoxelTerrain, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Mesh Memory"), STAT_VoxelTerrain_MeshMemory, STATGROUP_VoxelTerrain, );
+
+// Queue depths, counted every frame
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Pending Chunks"), STAT_VoxelTerrain_PendingChunks, STATGROUP_VoxelTerrain, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Chunks In Flight"), STAT_VoxelTerrain_ChunksInFlight, STATGROUP_VoxelTerrain, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Dirty Chunks"), STAT_VoxelTerrain_DirtyChunks, STATGROUP_VoxelTerrain, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Hidden Chunks"), STAT_VoxelTerrain_HiddenChunks, STATGROUP_VoxelTerrain, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Unmeshed Hidden Chunks"), STAT_VoxelTerrain_UnmeshedChunks, STATGROUP_VoxelTerrain, );
+
+// Times a stage with its cycle counter, and marks it with a named event so it shows up in external profilers as well
+#define VOXEL_TERRAIN_SCOPE(Stat) \
+	SCOPE_CYCLE_COUNTER(Stat); \
+	SCOPED_NAMED_EVENT(Stat, FColor::Emerald)
@@ -0,0 +1,85 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// The number of voxels along each side of a terrain chunk. This is set in VoxelTerrain.Build.cs, and has to be 16, 32 or 64.
+#ifndef VOXEL_TERRAIN_CHUNK_SIZE
+#define VOXEL_TERRAIN_CHUNK_SIZE 32
+#endif
+
+// The geometry of a cube of voxels that tiles the volume, known at compile time so all of the index math folds into shifts and masks.
+// This is used for the chunks the terrain is meshed in, and for the chunks the paged volume stores its voxels in.
+//
+// Chunk C covers the voxels from C * Size to C * Size + Size - 1 along each axis, so neighbouring chunks never overlap.
+// The blocky extractors generate the faces between every voxel and its neighbour on the negative side, so extracting a chunk
+// reads one extra voxel of apron on that side, and every face belongs to exactly one chunk.
+// Marching cubes instead owns the cells from the chunk's first voxel up to the first voxel of the next chunk, so neighbouring chunks
+// build the vertices on their shared side from the same voxels, and come out exactly the same without any stitching.
+template<int32 InSize>
+struct TVoxelChunkTraits
+{
+	static_assert(InSize >= 16 && InSize <= 64 && (InSize & (InSize - 1)) == 0, "Chunks have to be 16, 32 or 64 voxels wide");
+
+	// The number of voxels along each side
+	static constexpr int32 Size = InSize;
+
+	// log2(Size)
+	static constexpr int32 Shift = InSize == 16 ? 4 : InSize == 32 ? 5 : 6;
+
+	// The number of voxels in a chunk
+	static constexpr int32 NumVoxels = Size * Size * Size;
+
+	// The number of voxels outside of the chunk the blocky extractors read, on the negative side only
+	static constexpr int32 Apron = 1;
+
+	// The number of voxels along each side that are read to extract a chunk
+	static constexpr int32 ExtractedSize = Size + Apron;
+
+	// The number of voxels outside of the chunk marching cubes reads on each side. Its cells reach one voxel into the next chunk,
+	// and the normals are central differences of the densities, which read one more voxel around every corner of a cell.
+	static constexpr int32 SmoothApronBelow = 1;
+	static constexpr int32 SmoothApronAbove = 2;
+
+	// Returns the chunk that contains a voxel. This rounds towards negative infinity, so voxel -1 is in chunk -1.
+	static constexpr int32 VoxelToChunk(int32 Voxel) { return Voxel >> Shift; }
+
+	// Returns the first voxel of a chunk
+	static constexpr int32 ChunkToVoxel(int32 Chunk) { return Chunk * Size; }
+
+	// Returns the position of a voxel within its chunk, from 0 to Size - 1
+	static constexpr int32 VoxelToLocal(int32 Voxel) { return Voxel & (Size - 1); }
+
+	// Returns the index of a voxel within a chunk's voxels, with X varying fastest
+	static constexpr int32 LocalIndex(int32 X, int32 Y, int32 Z) { return X + (Y << Shift) + (Z << (2 * Shift)); }
+
+	static FORCEINLINE FIntVector VoxelToChunk(const FIntVector& Voxel) { return FIntVector(VoxelToChunk(Voxel.X), VoxelToChunk(Voxel.Y), VoxelToChunk(Voxel.Z)); }
+	static FORCEINLINE FIntVector ChunkToVoxel(const FIntVector& Chunk) { return FIntVector(ChunkToVoxel(Chunk.X), ChunkToVoxel(Chunk.Y), ChunkToVoxel(Chunk.Z)); }
+	static FORCEINLINE FIntVector VoxelToLocal(const FIntVector& Voxel) { return FIntVector(VoxelToLocal(Voxel.X), VoxelToLocal(Voxel.Y), VoxelToLocal(Voxel.Z)); }
+
+	// Returns the range of chunks whose meshes read any voxel in a box. Both corners are inclusive.
+	// A voxel is read by its own chunk, and by the chunk after it when it's in that chunk's apron.
+	// Smooth chunks have an apron on both sides, so a voxel can be read by the chunks before it as well.
+	static FORCEINLINE void GetChunksReadingVoxels(const FIntVector& Lower, const FIntVector& Upper, FIntVector& OutLowerChunk, FIntVector& OutUpperChunk, bool bSmooth = false)
+	{
+		OutLowerChunk = VoxelToChunk(bSmooth ? Lower - FIntVector(SmoothApronAbove) : Lower);
+		OutUpperChunk = VoxelToChunk(Upper + FIntVector(bSmooth ? SmoothApronBelow : Apron));
+	}
+};
+
+// Definitions for the constants, so they can be passed by reference without a link error
+template<int32 InSize> constexpr int32 TVoxelChunkTraits<InSize>::Size;
+template<int32 InSize> constexpr int32 TVoxelChunkTraits<InSize>::Shift;
+template<int32 InSize> constexpr int32 TVoxelChunkTraits<InSize>::NumVoxels;
+template<int32 InSize> constexpr int32 TVoxelChunkTraits<InSize>::Apron;
+template<int32 InSize> constexpr int32 TVoxelChunkTraits<InSize>::ExtractedSize;
+template<int32 InSize> constexpr int32 TVoxelChunkTraits<InSize>::SmoothApronBelow;
+template<int32 InSize> constexpr int32 TVoxelChunkTraits<InSize>::SmoothApronAbove;
+
+typedef TVoxelChunkTraits<16> FVoxelChunkTraits16;
+typedef TVoxelChunkTraits<32> FVoxelChunkTraits32;
+typedef TVoxelChunkTraits<64> FVoxelChunkTraits64;
+
+// The chunks the terrain is meshed and streamed in
+typedef TVoxelChunkTraits<VOXEL_TERRAIN_CHUNK_SIZE> FVoxelChunkTraits;
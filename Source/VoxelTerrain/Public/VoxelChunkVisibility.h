@@ -0,0 +1,64 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// PolyVox
+#include "PolyVox/MaterialDensityPair.h"
+
+// Which faces of a chunk can see each other through the air inside it. There is a bit for each of the 15 pairs of faces,
+// set when some pocket of air touches both of them. This is what decides whether a chunk can hide what is behind it.
+//
+// The faces are numbered -X, +X, -Y, +Y, -Z, +Z, which is also the order of the directions a traversal steps in.
+struct FVoxelChunkVisibility
+{
+	static const int32 NumFaces = 6;
+
+	// Every pair of faces connected, which is what a chunk that is all air or hasn't been built yet looks like
+	static const uint16 AllFaces = 0x7FFF;
+
+	// One bit per pair of faces. This starts out open, so a chunk that was never worked out can't hide anything.
+	uint16 Bits = AllFaces;
+
+	FVoxelChunkVisibility() {}
+	explicit FVoxelChunkVisibility(uint16 InBits) : Bits(InBits) {}
+
+	bool operator==(const FVoxelChunkVisibility& Other) const { return Bits == Other.Bits; }
+	bool operator!=(const FVoxelChunkVisibility& Other) const { return Bits != Other.Bits; }
+
+	// Returns true if something coming in through one face can be seen through the other
+	FORCEINLINE bool CanSeeThrough(int32 FromFace, int32 ToFace) const
+	{
+		return FromFace == ToFace || (Bits & GetPairBit(FromFace, ToFace)) != 0;
+	}
+
+	// Connects every pair of faces in a mask of faces, with a bit per face
+	void ConnectFaces(uint32 FaceMask);
+
+	// Returns the face on the other side of the chunk
+	static FORCEINLINE int32 GetOppositeFace(int32 Face) { return Face ^ 1; }
+
+	// Returns the step from a chunk to its neighbour through a face
+	static FIntVector GetFaceDirection(int32 Face);
+
+	// Returns the bit for a pair of different faces. The pairs are numbered in order, (0, 1) to (0, 5), then (1, 2) and so on.
+	static FORCEINLINE uint16 GetPairBit(int32 FaceA, int32 FaceB)
+	{
+		const int32 Lower = FMath::Min(FaceA, FaceB);
+		const int32 Upper = FMath::Max(FaceA, FaceB);
+		return uint16(1) << (Lower * (2 * NumFaces - 1 - Lower) / 2 + Upper - Lower - 1);
+	}
+
+	// Works out which faces of a chunk connect by flood filling the air from every air voxel on its boundary. Pockets that don't touch the
+	// boundary are never visited. Voxels has Size^3 voxels with X varying fastest, then Y, then Z. Any voxel with a material is solid.
+	// Visited and Stack are scratch memory that is kept between chunks.
+	static FVoxelChunkVisibility Compute(const PolyVox::MaterialDensityPair88* Voxels, int32 Size, TArray<uint8>& Visited, TArray<int32>& Stack);
+
+	// Finds every chunk that could be seen from the chunks the viewers are in, by stepping from chunk to chunk through the faces that connect.
+	// Like a ray, the traversal never turns back against a direction it has already stepped in, so looking out of a cave only sees
+	// what the cave opens on to. Chunks outside of the bounds are never visited; GetVisibility answers for the ones inside them.
+	// The chunks the viewers are in are always visible, whatever they contain.
+	static void FindVisibleChunks(const TArray<FIntVector>& ViewerChunks, const FIntVector& LowerBound, const FIntVector& UpperBound,
+		TFunctionRef<FVoxelChunkVisibility(const FIntVector& ChunkCoord)> GetVisibility, TSet<FIntVector>& OutVisibleChunks);
+};
@@ -0,0 +1,384 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeBool.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "HAL/ThreadSafeCounter64.h"
+#include "Templates/Atomic.h"
+
+// PolyVox
+#include "PolyVox/BaseVolume.h"
+#include "PolyVox/MaterialDensityPair.h"
+#include "PolyVox/Region.h"
+
+// A paged volume that takes the place of PolyVox::PagedVolume<MaterialDensityPair88>, with the same interface for the pager, the surface extractors and the game.
+//
+// Instead of two bytes for every voxel, each chunk keeps a palette of the distinct voxels in it and a packed array of indices into the palette.
+// The terrain only has a handful of materials and chunks are usually mostly one or two of them, so most chunks need one or two bits per voxel.
+// A chunk with only one voxel value in it, like the air above the terrain or the rock under it, doesn't store any indices at all.
+//
+// The memory budget is for what the chunks actually take up, so a lot more terrain fits in the same amount of memory than with PagedVolume.
+//
+// Unlike PagedVolume this is thread safe, so several workers can extract chunks while the game thread edits the voxels.
+// The chunk map is split into shards with a lock each, and every chunk has a reader/writer lock of its own. A chunk is paged in exactly once
+// however many threads ask for it at the same time: the first one pages it in and the rest wait on the chunk's lock.
+// ReadRegion and EditRegion lock every chunk they touch at once, so a region is always read as a consistent snapshot and edited all in one go.
+// Chunks that were used recently are found without taking any locks at all, so a single thread is barely slower than it would be without them.
+class FVoxelPaletteVolume : public PolyVox::BaseVolume<PolyVox::MaterialDensityPair88>
+{
+public:
+	// A cube of voxels, stored as a palette and packed indices into it
+	class Chunk
+	{
+		friend class FVoxelPaletteVolume;
+
+	public:
+		// Creates a chunk filled with empty voxels
+		Chunk(const FIntVector& InChunkKey, int32 InSideLength);
+
+		// The pin count of a chunk that has been evicted. It is so far below zero that threads pinning a stale pointer can never bring it back up.
+		static const int32 EvictedPinCount = MIN_int32 / 2;
+
+		// Returns the voxel at the given position within the chunk
+		FORCEINLINE VoxelType getVoxel(uint32 X, uint32 Y, uint32 Z) const
+		{
+			return Palette[GetPaletteIndex(X + (Y << SideLengthPower) + (Z << (SideLengthPower * 2)))];
+		}
+
+		// Sets the voxel at the given position within the chunk. This might have to make the indices wider if the voxel isn't in the palette yet.
+		void setVoxel(uint32 X, uint32 Y, uint32 Z, const VoxelType& Voxel);
+
+		// Sets every voxel in the chunk to the same value. This frees the indices.
+		void Fill(const VoxelType& Voxel);
+
+		// Sets every voxel in the chunk, with X varying fastest, then Y, then Z.
+		// This builds the palette from scratch, so the indices are as narrow as they can be.
+		void SetVoxels(const VoxelType* Voxels);
+
+		// Copies every voxel in the chunk out, with X varying fastest, then Y, then Z
+		void GetVoxels(VoxelType* OutVoxels) const;
+
+		// Copies a box of voxels out of the chunk. Voxel (x, y, z) of the box is written to OutVoxels[x + y * OutStrideY + z * OutStrideZ].
+		void ReadVoxels(const FIntVector& LocalLower, const FIntVector& Size, VoxelType* OutVoxels, int32 OutStrideY, int32 OutStrideZ) const;
+
+		// Returns true if every voxel in the chunk is the same
+		bool IsUniform() const { return BitsPerIndex == 0; }
+
+		// Returns the number of distinct voxels in the palette. Voxels that were overwritten stay in the palette until the chunk is paged in again.
+		int32 GetPaletteSize() const { return Palette.Num(); }
+
+		// Returns the number of bits used for each voxel's palette index
+		int32 GetBitsPerIndex() const { return BitsPerIndex; }
+
+		// Returns roughly how much memory the chunk takes up
+		uint32 calculateSizeInBytes() const;
+
+	private:
+		// Returns the palette index of the voxel at the given index
+		FORCEINLINE uint32 GetPaletteIndex(int32 VoxelIndex) const
+		{
+			if (BitsPerIndex == 0)
+				return 0;
+
+			const int32 Shift = (VoxelIndex & ((1 << IndicesPerWordPower) - 1)) * BitsPerIndex;
+			return (Indices[VoxelIndex >> IndicesPerWordPower] >> Shift) & IndexMask;
+		}
+
+		// Sets the palette index of the voxel at the given index
+		FORCEINLINE void SetPaletteIndex(int32 VoxelIndex, uint32 PaletteIndex)
+		{
+			const int32 Shift = (VoxelIndex & ((1 << IndicesPerWordPower) - 1)) * BitsPerIndex;
+			uint32& Word = Indices[VoxelIndex >> IndicesPerWordPower];
+			Word = (Word & ~(IndexMask << Shift)) | (PaletteIndex << Shift);
+		}
+
+		// Switches to indices of the given width, keeping every voxel the same
+		void Repack(int32 NewBitsPerIndex);
+
+		// Returns the narrowest index width that can address a palette of the given size. Widths are powers of two, so an index never straddles two words.
+		static int32 GetBitsForPaletteSize(int32 PaletteSize);
+
+		// The distinct voxels in the chunk
+		TArray<VoxelType> Palette;
+
+		// The palette index of every voxel, packed 32 / BitsPerIndex to a word. This is empty for a uniform chunk.
+		TArray<uint32> Indices;
+
+		// The width of each index: 0, 1, 2, 4, 8 or 16 bits
+		int32 BitsPerIndex;
+
+		// Log2 of the number of indices in each word, and the mask for a single index
+		int32 IndicesPerWordPower;
+		uint32 IndexMask;
+
+		// The number of voxels along each side, and its log2
+		int32 SideLength;
+		int32 SideLengthPower;
+
+		// The position of the chunk, counted in chunks
+		FIntVector ChunkKey;
+
+		// The volume's access clock when the chunk was last used. The chunks used least recently are paged out first.
+		TAtomic<uint64> LastAccessed;
+
+		// Set when the chunk has been changed since it was paged in, so it has to be paged out before it is thrown away
+		bool bDataModified;
+
+		// Held for reading while voxels are read, and for writing while they are changed or the chunk is being paged in
+		mutable FRWLock ChunkLock;
+
+		// The number of threads using the chunk. A pinned chunk is never evicted. Eviction swaps a count of zero for EvictedPinCount,
+		// so a thread that pins the chunk after that sees it has gone.
+		TAtomic<int32> PinCount;
+
+		// Set once the pager has filled the chunk in
+		FThreadSafeBool bPagedIn;
+	};
+
+	// Fills in chunks as they are needed and takes them back when they're thrown away. This has the same functions as PagedVolume::Pager.
+	class Pager
+	{
+	public:
+		virtual ~Pager() {}
+
+		// Called when a new chunk is needed. The chunk starts out empty.
+		virtual void pageIn(const PolyVox::Region& region, Chunk* pChunk) = 0;
+
+		// Called before a chunk that has been modified since it was paged in is thrown away
+		virtual void pageOut(const PolyVox::Region& region, Chunk* pChunk) = 0;
+	};
+
+	// Walks over the volume for the PolyVox surface extractors. This keeps hold of the chunk it is in, so most reads don't have to look it up.
+	// The chunks it reads stay paged in while it holds them, but they aren't locked, so nothing can be writing to the region while a sampler reads it.
+	// Take a snapshot with ReadRegion when that can't be guaranteed.
+	class Sampler : public PolyVox::BaseVolume<PolyVox::MaterialDensityPair88>::Sampler<FVoxelPaletteVolume>
+	{
+	public:
+		Sampler(FVoxelPaletteVolume* Volume);
+		Sampler(const Sampler& Other);
+		~Sampler();
+
+		Sampler& operator=(const Sampler& Other);
+
+		FORCEINLINE VoxelType getVoxel() const { return CurrentChunk->getVoxel(LocalX, LocalY, LocalZ); }
+
+		void setPosition(const PolyVox::Vector3DInt32& NewPosition) { setPosition(NewPosition.getX(), NewPosition.getY(), NewPosition.getZ()); }
+		void setPosition(int32 X, int32 Y, int32 Z);
+
+		FORCEINLINE void movePositiveX() { this->mXPosInVolume++; if (++LocalX == uint32(ChunkSideLength)) UpdateChunk(); }
+		FORCEINLINE void movePositiveY() { this->mYPosInVolume++; if (++LocalY == uint32(ChunkSideLength)) UpdateChunk(); }
+		FORCEINLINE void movePositiveZ() { this->mZPosInVolume++; if (++LocalZ == uint32(ChunkSideLength)) UpdateChunk(); }
+		FORCEINLINE void moveNegativeX() { this->mXPosInVolume--; if (LocalX-- == 0) UpdateChunk(); }
+		FORCEINLINE void moveNegativeY() { this->mYPosInVolume--; if (LocalY-- == 0) UpdateChunk(); }
+		FORCEINLINE void moveNegativeZ() { this->mZPosInVolume--; if (LocalZ-- == 0) UpdateChunk(); }
+
+		FORCEINLINE VoxelType peekVoxel1nx1ny1nz() const { return Peek(-1, -1, -1); }
+		FORCEINLINE VoxelType peekVoxel1nx1ny0pz() const { return Peek(-1, -1, 0); }
+		FORCEINLINE VoxelType peekVoxel1nx1ny1pz() const { return Peek(-1, -1, 1); }
+		FORCEINLINE VoxelType peekVoxel1nx0py1nz() const { return Peek(-1, 0, -1); }
+		FORCEINLINE VoxelType peekVoxel1nx0py0pz() const { return Peek(-1, 0, 0); }
+		FORCEINLINE VoxelType peekVoxel1nx0py1pz() const { return Peek(-1, 0, 1); }
+		FORCEINLINE VoxelType peekVoxel1nx1py1nz() const { return Peek(-1, 1, -1); }
+		FORCEINLINE VoxelType peekVoxel1nx1py0pz() const { return Peek(-1, 1, 0); }
+		FORCEINLINE VoxelType peekVoxel1nx1py1pz() const { return Peek(-1, 1, 1); }
+
+		FORCEINLINE VoxelType peekVoxel0px1ny1nz() const { return Peek(0, -1, -1); }
+		FORCEINLINE VoxelType peekVoxel0px1ny0pz() const { return Peek(0, -1, 0); }
+		FORCEINLINE VoxelType peekVoxel0px1ny1pz() const { return Peek(0, -1, 1); }
+		FORCEINLINE VoxelType peekVoxel0px0py1nz() const { return Peek(0, 0, -1); }
+		FORCEINLINE VoxelType peekVoxel0px0py0pz() const { return getVoxel(); }
+		FORCEINLINE VoxelType peekVoxel0px0py1pz() const { return Peek(0, 0, 1); }
+		FORCEINLINE VoxelType peekVoxel0px1py1nz() const { return Peek(0, 1, -1); }
+		FORCEINLINE VoxelType peekVoxel0px1py0pz() const { return Peek(0, 1, 0); }
+		FORCEINLINE VoxelType peekVoxel0px1py1pz() const { return Peek(0, 1, 1); }
+
+		FORCEINLINE VoxelType peekVoxel1px1ny1nz() const { return Peek(1, -1, -1); }
+		FORCEINLINE VoxelType peekVoxel1px1ny0pz() const { return Peek(1, -1, 0); }
+		FORCEINLINE VoxelType peekVoxel1px1ny1pz() const { return Peek(1, -1, 1); }
+		FORCEINLINE VoxelType peekVoxel1px0py1nz() const { return Peek(1, 0, -1); }
+		FORCEINLINE VoxelType peekVoxel1px0py0pz() const { return Peek(1, 0, 0); }
+		FORCEINLINE VoxelType peekVoxel1px0py1pz() const { return Peek(1, 0, 1); }
+		FORCEINLINE VoxelType peekVoxel1px1py1nz() const { return Peek(1, 1, -1); }
+		FORCEINLINE VoxelType peekVoxel1px1py0pz() const { return Peek(1, 1, 0); }
+		FORCEINLINE VoxelType peekVoxel1px1py1pz() const { return Peek(1, 1, 1); }
+
+	private:
+		// Reads a voxel next to the current one. Only voxels in another chunk have to go through the volume.
+		FORCEINLINE VoxelType Peek(int32 DX, int32 DY, int32 DZ) const
+		{
+			const uint32 X = LocalX + DX;
+			const uint32 Y = LocalY + DY;
+			const uint32 Z = LocalZ + DZ;
+
+			// Going below zero wraps around, so this catches both sides
+			if (X < uint32(ChunkSideLength) && Y < uint32(ChunkSideLength) && Z < uint32(ChunkSideLength))
+				return CurrentChunk->getVoxel(X, Y, Z);
+
+			return PeekNeighbour(this->mXPosInVolume + DX, this->mYPosInVolume + DY, this->mZPosInVolume + DZ);
+		}
+
+		// Reads a voxel in a chunk next to the current one
+		VoxelType PeekNeighbour(int32 X, int32 Y, int32 Z) const;
+
+		// Finds the chunk the sampler has moved into
+		void UpdateChunk();
+
+		// The chunk the sampler is in. It is pinned, so it stays paged in while the sampler is in use.
+		Chunk* CurrentChunk;
+
+		// The last neighbouring chunk that was peeked into, pinned as well. Peeks along a chunk's side all land in the same neighbour.
+		mutable Chunk* NeighbourChunk;
+
+		// The position of the sampler within CurrentChunk
+		uint32 LocalX;
+		uint32 LocalY;
+		uint32 LocalZ;
+
+		// The side length of the volume's chunks
+		int32 ChunkSideLength;
+	};
+
+	// The fewest chunks the volume keeps, whatever the memory budget. Chunks in use are never evicted, this just stops the volume from thrashing when the budget is tiny.
+	static const int32 MinResidentChunks = 64;
+
+	// The number of shards the chunk map is split into. Neighbouring chunks land in different shards, so threads reading nearby regions rarely wait on each other.
+	static const int32 NumShards = 64;
+
+	// The number of slots in the lock free cache of recently used chunks
+	static const int32 NumRecentChunks = 4096;
+
+	// Constructor. The memory budget is for the compressed chunks. The side length has to be a power of two.
+	FVoxelPaletteVolume(Pager* InPager, uint32 TargetMemoryUsageInBytes = 256 * 1024 * 1024, uint16 InChunkSideLength = 32);
+
+	// Destructor. This pages out every modified chunk.
+	~FVoxelPaletteVolume();
+
+	// Returns the voxel at the given position, paging its chunk in if it isn't loaded. This is safe to call from any thread.
+	VoxelType getVoxel(int32 X, int32 Y, int32 Z) const;
+	VoxelType getVoxel(const PolyVox::Vector3DInt32& Position) const { return getVoxel(Position.getX(), Position.getY(), Position.getZ()); }
+
+	// Sets the voxel at the given position, paging its chunk in if it isn't loaded. This is safe to call from any thread.
+	void setVoxel(int32 X, int32 Y, int32 Z, const VoxelType& Voxel);
+	void setVoxel(const PolyVox::Vector3DInt32& Position, const VoxelType& Voxel) { setVoxel(Position.getX(), Position.getY(), Position.getZ(), Voxel); }
+
+	// Pages in every chunk that overlaps the region, so reading it later doesn't have to. This is safe to call from any thread.
+	void prefetch(PolyVox::Region Region);
+
+	// Pages out every chunk. Nothing else can be using the volume while this runs.
+	void flushAll();
+
+	// Returns roughly how much memory the chunks take up
+	uint32 calculateSizeInBytes();
+
+	// Copies every voxel in the region out, with X varying fastest, then Y, then Z.
+	// This works a chunk at a time, so it is a lot faster than reading the voxels one by one. Uniform chunks are just a fill.
+	// Every chunk the region touches is locked for the whole copy, so the voxels are a consistent snapshot: an EditRegion is either all in it or not at all.
+	// This is safe to call from any thread.
+	void ReadRegion(const PolyVox::Region& Region, VoxelType* OutVoxels) const;
+
+	// Calls EditVoxel on every voxel in the region with the voxel's position, and writes back the voxels it changes.
+	// Every chunk the region touches is locked for the whole edit, so no ReadRegion sees it half done. The voxels are visited a chunk at a time,
+	// so EditVoxel can't rely on the order. It mustn't use the volume itself. This is safe to call from any thread.
+	void EditRegion(const PolyVox::Region& Region, TFunctionRef<void(int32 X, int32 Y, int32 Z, VoxelType& InOutVoxel)> EditVoxel);
+
+	// Pins and locks the chunk with the given key for reading, paging it in if it isn't loaded, so its voxels can be read straight out of it.
+	// Hand it back to UnlockChunkForReading, and never lock another chunk while holding one: unlike ReadRegion this doesn't lock chunks in order,
+	// so holding two could deadlock with an EditRegion. This is safe to call from any thread.
+	const Chunk* LockChunkForReading(const FIntVector& ChunkKey) const;
+
+	// Unlocks and unpins a chunk locked by LockChunkForReading
+	void UnlockChunkForReading(const Chunk* LockedChunk) const;
+
+	// Returns the number of voxels along each side of a chunk, and its log2
+	int32 GetChunkSideLength() const { return ChunkSideLength; }
+	int32 GetChunkSideLengthPower() const { return ChunkSideLengthPower; }
+
+	// Returns the number of chunks that are paged in, and how many of them are uniform
+	int32 GetNumChunks() const { return NumChunks.GetValue(); }
+	int32 GetNumUniformChunks() const;
+
+	// Returns how much memory the chunks that are paged in would take up uncompressed, as in PagedVolume
+	int64 GetUncompressedSizeInBytes() const { return int64(NumChunks.GetValue()) * (int64(1) << (ChunkSideLengthPower * 3)) * sizeof(VoxelType); }
+
+private:
+	// A part of the chunk map, with its own lock
+	struct FShard
+	{
+		FCriticalSection Lock;
+		TMap<FIntVector, TUniquePtr<Chunk>> Chunks;
+	};
+
+	// Returns the hash that picks a chunk's shard and its slot in RecentChunks
+	static uint32 GetChunkHash(const FIntVector& ChunkKey);
+
+	// Returns the shard a chunk belongs in
+	FShard& GetShard(uint32 ChunkHash) const { return Shards[ChunkHash & (NumShards - 1)]; }
+
+	// Returns the chunk with the given key, paging it in if it isn't loaded. The chunk is pinned so it can't be evicted, and has to be unpinned once it isn't needed.
+	// If another thread is paging the chunk in, this waits for it to finish.
+	Chunk* PinChunk(int32 ChunkX, int32 ChunkY, int32 ChunkZ) const;
+
+	// Lets a pinned chunk be evicted again
+	static void UnpinChunk(Chunk* PinnedChunk) { --PinnedChunk->PinCount; }
+
+	// Pins and returns the chunk with the given key if it is in RecentChunks, or returns null if it isn't. This doesn't take any locks.
+	Chunk* PinRecentChunk(const FIntVector& ChunkKey, uint32 ChunkHash) const;
+
+	// Takes an evicted chunk to reuse, or creates one, for the given key. The chunk comes back pinned. The key's shard must be locked.
+	TUniquePtr<Chunk> AllocateChunk(const FIntVector& ChunkKey) const;
+
+	// Marks a chunk as used just now
+	void TouchChunk(Chunk* UsedChunk) const;
+
+	// Pins every chunk that overlaps the region, in order of Z, then Y, then X. Every function that locks more than one chunk locks them in this order,
+	// so two of them can never end up waiting on each other.
+	void PinRegionChunks(const PolyVox::Region& Region, TArray<Chunk*>& OutChunks) const;
+
+	// Pages out the chunks used least recently until the volume fits in its memory budget again. Pinned chunks are skipped.
+	void EvictChunks() const;
+
+	// Pages the chunk out if it has been modified, and takes it off the total size
+	void ReleaseChunk(Chunk& ReleasedChunk) const;
+
+	// Returns the region of voxels the chunk covers
+	PolyVox::Region GetChunkRegion(const FIntVector& ChunkKey) const;
+
+	// Adds to the total size of the chunks
+	void AddSizeInBytes(int64 Bytes) const;
+
+	// Fills in and takes back the chunks
+	Pager* VolumePager;
+
+	// The number of voxels along each side of a chunk, and its log2
+	int32 ChunkSideLength;
+	int32 ChunkSideLengthPower;
+
+	// The memory the chunks are allowed to take up before the oldest ones are paged out
+	int64 TargetMemoryBytes;
+
+	// Every chunk that is paged in, split into shards
+	mutable FShard Shards[NumShards];
+
+	// The last chunk pinned in each slot, so most pins don't need the shard. A stale pointer is harmless: evicted chunks are kept around to be
+	// reused rather than deleted, and a thread pinning one sees from its pin count or its key that it isn't the chunk it was after.
+	mutable TAtomic<Chunk*> RecentChunks[NumRecentChunks];
+
+	// Chunks that have been evicted, ready to be reused
+	mutable TArray<TUniquePtr<Chunk>> FreeChunks;
+	mutable FCriticalSection FreeChunksLock;
+
+	// Ticks every time a chunk is paged in. Only the order of the chunks matters when evicting them, and chunks are only evicted
+	// when another one is paged in, so this is all the resolution LastAccessed needs.
+	mutable TAtomic<uint64> AccessClock;
+
+	// The number of chunks in every shard
+	mutable FThreadSafeCounter NumChunks;
+
+	// The total of calculateSizeInBytes over every chunk
+	mutable FThreadSafeCounter64 SizeInBytes;
+
+	// Held by the thread that is evicting chunks. Only one thread evicts at a time; the others carry on a little over budget rather than wait.
+	mutable FCriticalSection EvictionLock;
+};
@@ -3,85 +3,239 @@
 #pragma once
 
 // Polyvox Includes
-#include "PolyVox/PagedVolume.h"
 #include "PolyVox/MaterialDensityPair.h"
 #include "PolyVox/Vector.h"
 
+#include "VoxelPolyVoxVector.h"
+#include "VoxelTerrainPager.h"
+#include "VoxelChunkTraits.h"
+#include "VoxelChunkVisibility.h"
+#include "VoxelTerrainNet.h"
+
 #include "GameFramework/Actor.h"
 #include "ProceduralMeshComponent.h"
 #include "VoxelTerrainActor.generated.h"
 
-// Bridge between PolyVox Vector3DFloat and Unreal Engine 4 FVector
-struct FPolyVoxVector : public FVector
+struct FVoxelChunkRequest;
+struct FVoxelChunkMeshData;
+class FVoxelGenerationContext;
+class FQueuedThreadPool;
+class UVoxelTerrainNetComponent;
+
+// The algorithms that can be used to turn voxels into a mesh
+UENUM(BlueprintType)
+enum class EVoxelSurfaceExtractor : uint8
 {
-	FORCEINLINE FPolyVoxVector()
-	{}
+	// One quad for every exposed voxel face, using PolyVox's extractCubicMesh
+	Cubic,
+
+	// Merges neighbouring faces with the same material into as few rectangles as possible
+	Greedy,
+
+	// A smooth surface through the densities, using PolyVox's extractMarchingCubesMesh. Vertices are shared between triangles,
+	// the normals come from the gradient of the densities, and the collision follows the smooth surface.
+	// This is mostly intended for use on spherical terrain.
+	MarchingCubes
+};
+
+// How an edit changes the voxels it covers
+UENUM(BlueprintType)
+enum class EVoxelEditMode : uint8
+{
+	// Turns the voxels into air
+	Carve,
+
+	// Turns the voxels into solid voxels of the given material
+	Fill,
+
+	// Changes the material of the solid voxels and leaves the air alone
+	Paint
+};
+
+// The questions RunQueries and QueueQueries can ask about the terrain
+UENUM(BlueprintType)
+enum class EVoxelQueryType : uint8
+{
+	// The first solid voxel on the line from Start to End
+	Raycast,
+
+	// The top of the ground straight below Start, along the terrain's Z axis, looking at most Distance down
+	SurfaceHeight,
+
+	// Any solid voxel whose centre is within Distance of Start
+	OverlapSphere,
+
+	// Any solid voxel whose centre is in the box between Start and End. The box is aligned to the terrain.
+	OverlapBox
+};
+
+// Called every time a chunk has finished generating, whether or not it contained any triangles
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FVoxelChunkGeneratedSignature, int32, X, int32, Y, int32, Z);
+
+// Called once every queued chunk has finished generating
+DECLARE_DYNAMIC_MULTICAST_DELEGATE(FVoxelTerrainGenerationCompleteSignature);
+
+// A chunk that has finished generating
+USTRUCT()
+struct FVoxelLoadedChunk
+{
+	GENERATED_BODY()
+
+	// The component rendering the chunk. This is null if the chunk didn't have any triangles.
+	UPROPERTY() UProceduralMeshComponent* Mesh = nullptr;
+
+	// Roughly how much memory the chunk's mesh takes up
+	int64 MeshBytes = 0;
+
+	// The number of triangles in the chunk's mesh
+	int32 NumTriangles = 0;
+
+	// The number of vertices in the chunk's mesh
+	int32 NumVertices = 0;
+
+	// The number of sections in the chunk's mesh that have any triangles
+	int32 NumSections = 0;
+
+	// The hidden component holding the chunk's collision. This is null if the chunk has no collision, or its collision mesh was empty.
+	UPROPERTY() UProceduralMeshComponent* CollisionMesh = nullptr;
+
+	// The number of triangles in the chunk's collision mesh
+	int32 NumCollisionTriangles = 0;
+
+	// Which faces of the chunk its air connects. This stays open unless the terrain hides buried chunks.
+	FVoxelChunkVisibility Visibility;
+};
+
+// Identifies a chunk at a level of detail. Level 0 is a full resolution chunk, and a node at level L covers 2^L chunks along each axis
+// with the same number of voxels as a full resolution chunk.
+USTRUCT()
+struct FVoxelChunkKey
+{
+	GENERATED_BODY()
 
-	explicit FORCEINLINE FPolyVoxVector(EForceInit E)
-		: FVector(E)
+	// The coordinates of the node, counted in nodes of its own level
+	UPROPERTY() FIntVector Coord;
+
+	// The level of detail of the node
+	UPROPERTY() int32 Lod;
+
+	FVoxelChunkKey()
+		: Coord(FIntVector::ZeroValue)
+		, Lod(0)
 	{}
 
-	FORCEINLINE FPolyVoxVector(float InX, float InY, float InZ)
-		: FVector(InX, InY, InX)
+	FVoxelChunkKey(const FIntVector& InCoord, int32 InLod)
+		: Coord(InCoord)
+		, Lod(InLod)
 	{}
 
-	FORCEINLINE FPolyVoxVector(const FVector &InVec)
+	bool operator==(const FVoxelChunkKey& Other) const
 	{
-		FVector::operator=(InVec);
+		return Coord == Other.Coord && Lod == Other.Lod;
 	}
 
-	FORCEINLINE FPolyVoxVector(const PolyVox::Vector3DFloat &InVec)
+	friend uint32 GetTypeHash(const FVoxelChunkKey& Key)
 	{
-		FPolyVoxVector::operator=(InVec);
+		return HashCombine(GetTypeHash(Key.Coord), GetTypeHash(Key.Lod));
 	}
+};
 
-	FORCEINLINE FVector& operator=(const PolyVox::Vector3DFloat& Other)
-	{
-		this->X = Other.getX();
-		this->Y = Other.getY();
-		this->Z = Other.getZ();
+// What one level of detail is costing. Used to tune the load radius and the number of levels.
+USTRUCT(BlueprintType)
+struct FVoxelLodStats
+{
+	GENERATED_BODY()
 
-		DiagnosticCheckNaN();
+	// The number of loaded chunks at this level, including the ones without any triangles
+	UPROPERTY(Category = "Voxel Terrain", BlueprintReadOnly) int32 NumChunks = 0;
 
-		return *this;
-	}
+	// The number of triangles in the loaded chunks
+	UPROPERTY(Category = "Voxel Terrain", BlueprintReadOnly) int32 NumTriangles = 0;
+
+	// The number of mesh sections in the loaded chunks. Each one is a draw call, and more in every shadow pass.
+	UPROPERTY(Category = "Voxel Terrain", BlueprintReadOnly) int32 NumSections = 0;
+
+	// Roughly how much memory the meshes of the loaded chunks take up, in megabytes
+	UPROPERTY(Category = "Voxel Terrain", BlueprintReadOnly) float MeshMemoryMB = 0.f;
+
+	// The number of chunks generated at this level so far
+	UPROPERTY(Category = "Voxel Terrain", BlueprintReadOnly) int32 NumGenerated = 0;
+
+	// The average time a worker spent generating a chunk at this level, in milliseconds
+	UPROPERTY(Category = "Voxel Terrain", BlueprintReadOnly) float AverageGenerationMs = 0.f;
+
+	// The running totals the values above are worked out from
+	int64 MeshBytes = 0;
+	double TotalGenerationSeconds = 0;
 };
 
-class VoxelTerrainPager : public PolyVox::PagedVolume<PolyVox::MaterialDensityPair88>::Pager
+// A question about the voxels, answered straight from the volume without needing the chunk meshes or their collision.
+// Positions and distances are in world space.
+USTRUCT(BlueprintType)
+struct FVoxelQuery
 {
-public:
-	// Constructor
-	VoxelTerrainPager(bool bIsSphericalTerrain = false, uint32 NoiseSeed = 123, uint32 Octaves = 3, float Frequency = 0.01, float Scale = 32, float Offset = 0, float Height = 64);
+	GENERATED_BODY()
 
-	// Destructor
-	virtual ~VoxelTerrainPager() {};
+	// What to look for
+	UPROPERTY(Category = "Voxel Terrain - Queries", BlueprintReadWrite, EditAnywhere) EVoxelQueryType Type = EVoxelQueryType::Raycast;
 
-	// PagedVolume::Pager functions
-	virtual void pageIn(const PolyVox::Region& region, PolyVox::PagedVolume<PolyVox::MaterialDensityPair88>::Chunk* pChunk);
-	virtual void pageOut(const PolyVox::Region& region, PolyVox::PagedVolume<PolyVox::MaterialDensityPair88>::Chunk* pChunk);
+	// The start of a ray, the point to look down from, the centre of a sphere or a corner of a box
+	UPROPERTY(Category = "Voxel Terrain - Queries", BlueprintReadWrite, EditAnywhere) FVector Start = FVector::ZeroVector;
 
-private:
-	// Some variables to control our terrain generator
-	// Choose between a sphere and minecraft-like terrain
-	bool bIsSpherical;
+	// The end of a ray or the other corner of a box
+	UPROPERTY(Category = "Voxel Terrain - Queries", BlueprintReadWrite, EditAnywhere) FVector End = FVector::ZeroVector;
 
-	// The seed of our fractal
-	uint32 Seed = 123;
+	// How far down to look for the surface, or the radius of a sphere
+	UPROPERTY(Category = "Voxel Terrain - Queries", BlueprintReadWrite, EditAnywhere) float Distance = 0.f;
+};
 
-	// The number of octaves that the noise generator will use
-	uint32 NoiseOctaves = 3;
+// What a query found. Everything but bHit is only set when it found something.
+USTRUCT(BlueprintType)
+struct FVoxelQueryHit
+{
+	GENERATED_BODY()
 
-	// The frequency of the noise
-	float NoiseFrequency = 0.01;
+	// Set if the query found a solid voxel
+	UPROPERTY(Category = "Voxel Terrain - Queries", BlueprintReadOnly) bool bHit = false;
 
-	// The scale of the noise. The output of the TerrainFractal is multiplied by this.
-	float NoiseScale = 32;
+	// The solid voxel that was found. For overlaps this is any solid voxel in the shape, not necessarily the closest.
+	UPROPERTY(Category = "Voxel Terrain - Queries", BlueprintReadOnly) FIntVector Voxel = FIntVector::ZeroValue;
 
-	// The offset of the noise. This value is added to the output of the TerrainFractal.
-	float NoiseOffset = 0;
+	// Where a ray entered the voxel, the point on top of the surface straight below Start, or the centre of the voxel an overlap found
+	UPROPERTY(Category = "Voxel Terrain - Queries", BlueprintReadOnly) FVector Location = FVector::ZeroVector;
 
-	// The maximum height of the generated terrain in voxels. NOTE: Changing this will affect where the ground begins!
-	float TerrainHeight = 64;
+	// The face of the voxel a ray came in through, or the terrain's up for the surface. This is zero for overlaps, and for rays that started inside a solid voxel.
+	UPROPERTY(Category = "Voxel Terrain - Queries", BlueprintReadOnly) FVector Normal = FVector::ZeroVector;
+
+	// The distance from Start to Location
+	UPROPERTY(Category = "Voxel Terrain - Queries", BlueprintReadOnly) float Distance = 0.f;
+
+	// The material of the voxel
+	UPROPERTY(Category = "Voxel Terrain - Queries", BlueprintReadOnly) uint8 Material = 0;
+};
+
+// Called with the results of a batch of queries queued with QueueQueries, in the same order as the queries
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FVoxelQueriesCompleteSignature, int32, BatchId, const TArray<FVoxelQueryHit>&, Results);
+
+// The settings that decide which voxels the terrain generates. The server sends these to each client once, when the client first sees the terrain,
+// and clients don't generate anything until they have them, so every machine starts from the same voxels.
+USTRUCT()
+struct FVoxelTerrainNetSettings
+{
+	GENERATED_BODY()
+
+	// Set by the server. Settings that match the defaults aren't sent at all, so this makes sure they always are.
+	UPROPERTY() bool bIsSet = false;
+
+	UPROPERTY() bool bIsSpherical = false;
+	UPROPERTY() int32 Seed = 0;
+	UPROPERTY() int32 NoiseOctaves = 0;
+	UPROPERTY() float NoiseFrequency = 0.f;
+	UPROPERTY() float NoiseScale = 0.f;
+	UPROPERTY() float NoiseOffset = 0.f;
+	UPROPERTY() float TerrainHeight = 0.f;
+	UPROPERTY() FIntVector MaxChunks = FIntVector::ZeroValue;
+	UPROPERTY() bool bUseBatchedNoise = false;
 };
 
 UCLASS()
@@ -99,18 +253,154 @@ public:
 	// Called when the actor has begun playing in the level
 	virtual void BeginPlay() override;
 
-	// Called to generate and render a new chunk of voxels at the given location
+	// Called when the actor is being removed from the level
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	// Called every frame. This is where finished chunks are turned into mesh components.
+	virtual void Tick(float DeltaSeconds) override;
+
+	// Replicates the generation settings
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	// Called to generate and render a new chunk of voxels at the given location.
+	// This runs the whole pipeline on the calling thread, so prefer QueueChunk for anything but a handful of chunks.
 	UFUNCTION(Category = "Voxel Terrain", BlueprintCallable) virtual bool GenerateChunk(int32 X, int32 Y, int32 Z = 0);
 
+	// Queues a chunk to be generated on the worker threads. Chunks closest to the viewer are generated first.
+	UFUNCTION(Category = "Voxel Terrain", BlueprintCallable) virtual bool QueueChunk(int32 X, int32 Y, int32 Z = 0);
+
+	// Stops generating any chunks that are queued or in progress. Chunks that have already been created are kept.
+	UFUNCTION(Category = "Voxel Terrain", BlueprintCallable) void CancelGeneration();
+
+	// Returns true while there are queued chunks that haven't been created yet
+	UFUNCTION(Category = "Voxel Terrain", BlueprintPure) bool IsGenerating() const;
+
+	// Returns how far along the queued chunks are, from 0 to 1
+	UFUNCTION(Category = "Voxel Terrain", BlueprintPure) float GetGenerationProgress() const;
+
+	// Unloads a chunk and recycles its mesh component. Returns false if the chunk wasn't loaded.
+	UFUNCTION(Category = "Voxel Terrain", BlueprintCallable) bool UnloadChunk(int32 X, int32 Y, int32 Z = 0);
+
+	// Returns the mesh component of a loaded chunk, or null if the chunk isn't loaded or has no triangles
+	UFUNCTION(Category = "Voxel Terrain", BlueprintPure) UProceduralMeshComponent* GetChunkMesh(int32 X, int32 Y, int32 Z = 0) const;
+
+	// Returns the number of chunks that are loaded, including the ones without any triangles
+	UFUNCTION(Category = "Voxel Terrain", BlueprintPure) int32 GetNumLoadedChunks() const { return Chunks.Num(); }
+
+	// Returns roughly how much memory the meshes of the loaded chunks take up, in megabytes
+	UFUNCTION(Category = "Voxel Terrain", BlueprintPure) float GetMeshMemoryMB() const { return MeshMemoryBytes / (1024.f * 1024.f); }
+
+	// Returns the number of loaded chunks that are hidden because they are buried out of sight of every viewer
+	UFUNCTION(Category = "Voxel Terrain", BlueprintPure) int32 GetNumHiddenChunks() const { return NumHiddenChunks; }
+
+	// Returns how many chunks and triangles a level of detail has loaded, and how long its chunks take to generate. Level 0 is the full resolution chunks.
+	UFUNCTION(Category = "Voxel Terrain", BlueprintPure) FVoxelLodStats GetLodStats(int32 Lod) const;
+
+	// Switches the surface extractor while the terrain is running. Every loaded chunk and node is remeshed in place on the workers,
+	// so the old meshes stay up until their replacements are ready.
+	UFUNCTION(Category = "Voxel Terrain", BlueprintCallable) void SetSurfaceExtractor(EVoxelSurfaceExtractor NewSurfaceExtractor);
+
+	// Sets a single voxel. Material 0 is air, and material N is drawn with TerrainMaterials[N - 1].
+	// The chunks the voxel touches are remeshed on the workers, at most once per frame however many edits land in them.
+	// A replicated terrain can only be edited on the server, which sends every edit on to the clients. Editing it on a client does nothing and returns false.
+	UFUNCTION(Category = "Voxel Terrain - Editing", BlueprintCallable) bool SetVoxel(int32 X, int32 Y, int32 Z, uint8 Material);
+
+	// Returns the material of a voxel. Material 0 is air.
+	UFUNCTION(Category = "Voxel Terrain - Editing", BlueprintPure) uint8 GetVoxel(int32 X, int32 Y, int32 Z) const;
+
+	// Edits every voxel whose centre is inside a sphere. The centre and radius are in world space. Returns true if any voxel changed.
+	// The centre and radius are rounded to a sixteenth of a voxel, so the server and the clients always agree on which voxels are inside.
+	UFUNCTION(Category = "Voxel Terrain - Editing", BlueprintCallable) bool EditSphere(FVector Center, float Radius, EVoxelEditMode Mode, uint8 Material = 1);
+
+	// Edits every voxel whose centre is inside a box. The corners are in world space, and the box is aligned to the terrain. Returns true if any voxel changed.
+	UFUNCTION(Category = "Voxel Terrain - Editing", BlueprintCallable) bool EditBox(FVector Min, FVector Max, EVoxelEditMode Mode, uint8 Material = 1);
+
+	// Returns the voxel that contains the given world location
+	UFUNCTION(Category = "Voxel Terrain - Editing", BlueprintPure) FIntVector WorldToVoxel(FVector WorldLocation) const;
+
+	// Returns the world location of the centre of a voxel
+	UFUNCTION(Category = "Voxel Terrain - Editing", BlueprintPure) FVector VoxelToWorld(FIntVector Voxel) const;
+
+	// Returns the number of edited chunks waiting to be remeshed
+	UFUNCTION(Category = "Voxel Terrain - Editing", BlueprintPure) int32 GetNumDirtyChunks() const { return DirtyChunks.Num(); }
+
+	// Starts streaming chunks in around the given actor. If no viewers are added, chunks stream in around the local players' cameras.
+	UFUNCTION(Category = "Voxel Terrain", BlueprintCallable) void AddStreamingViewer(AActor* Viewer);
+
+	// Stops streaming chunks in around the given actor
+	UFUNCTION(Category = "Voxel Terrain", BlueprintCallable) void RemoveStreamingViewer(AActor* Viewer);
+
+	// Returns the first solid voxel on the line from Start to End. This reads the voxels directly, so it works whether or not the chunks have collision.
+	UFUNCTION(Category = "Voxel Terrain - Queries", BlueprintCallable, BlueprintPure = false) bool RaycastVoxels(FVector Start, FVector End, FVoxelQueryHit& OutHit) const;
+
+	// Finds the top of the ground straight below a location, along the terrain's Z axis, at most MaxDistance down.
+	// If the location is inside the ground, this is the top of the voxel it is in.
+	UFUNCTION(Category = "Voxel Terrain - Queries", BlueprintCallable, BlueprintPure = false) bool GetSurfaceHeight(FVector Location, float MaxDistance, FVoxelQueryHit& OutHit) const;
+
+	// Returns true if the centre of any solid voxel is inside a sphere
+	UFUNCTION(Category = "Voxel Terrain - Queries", BlueprintCallable, BlueprintPure = false) bool OverlapsSolidSphere(FVector Center, float Radius) const;
+
+	// Returns true if the centre of any solid voxel is inside a box. The corners are in world space, and the box is aligned to the terrain.
+	UFUNCTION(Category = "Voxel Terrain - Queries", BlueprintCallable, BlueprintPure = false) bool OverlapsSolidBox(FVector Min, FVector Max) const;
+
+	// Answers a batch of queries, spread over every core, and waits for them all. Results are in the same order as the queries.
+	UFUNCTION(Category = "Voxel Terrain - Queries", BlueprintCallable, BlueprintPure = false) void RunQueries(const TArray<FVoxelQuery>& Queries, TArray<FVoxelQueryHit>& OutResults) const;
+
+	// Queues a batch of queries to be answered on the worker threads, so the game thread doesn't wait for them. OnQueriesComplete is called with the
+	// results in a later frame. The queries see the terrain as it is while they run, so edits made in the meantime might show up in them.
+	// Returns the batch's id, or -1 if the terrain hasn't started generating yet.
+	UFUNCTION(Category = "Voxel Terrain - Queries", BlueprintCallable) int32 QueueQueries(const TArray<FVoxelQuery>& Queries);
+
+	// The same, but OnComplete is called with the results instead of OnQueriesComplete. It is called on the game thread.
+	int32 QueueQueryBatch(const TArray<FVoxelQuery>& Queries, TFunction<void(int32 BatchId, const TArray<FVoxelQueryHit>& Results)> OnComplete);
+
+	// Builds collision for the chunks around the given actor. If no collision actors are added, collision is built around the streaming viewers.
+	UFUNCTION(Category = "Voxel Terrain - Collision", BlueprintCallable) void AddCollisionActor(AActor* Actor);
+
+	// Stops building collision around the given actor
+	UFUNCTION(Category = "Voxel Terrain - Collision", BlueprintCallable) void RemoveCollisionActor(AActor* Actor);
+
+	// Returns true if a chunk is loaded and its collision has been built
+	UFUNCTION(Category = "Voxel Terrain - Collision", BlueprintPure) bool HasChunkCollision(int32 X, int32 Y, int32 Z = 0) const { return CollisionChunks.Contains(FIntVector(X, Y, Z)); }
+
+	// Returns the number of loaded chunks whose collision has been built, including the ones with nothing to collide with
+	UFUNCTION(Category = "Voxel Terrain - Collision", BlueprintPure) int32 GetNumCollidableChunks() const { return CollisionChunks.Num(); }
+
+	// Bakes the full resolution chunks between the two corners, inclusive, into the mesh cache. Chunks that are already baked are skipped unless bRebuildAll is set,
+	// so after an edit only the chunks it touched are built again. This blocks until every chunk is done, and is what the VoxelTerrainBake commandlet runs.
+	// Chunks are always baked from the noise, never from saved or edited chunks, which the terrain builds itself instead of reading them from the cache.
+	// Returns the number of chunks that were baked.
+	UFUNCTION(Category = "Voxel Terrain - Saving", BlueprintCallable) int32 BakeMeshCache(FIntVector LowerChunk, FIntVector UpperChunk, bool bRebuildAll = false);
+
+	// Called every time a queued chunk has finished generating
+	UPROPERTY(Category = "Voxel Terrain", BlueprintAssignable) FVoxelChunkGeneratedSignature OnChunkGenerated;
+
+	// Called once all of the queued chunks have finished generating
+	UPROPERTY(Category = "Voxel Terrain", BlueprintAssignable) FVoxelTerrainGenerationCompleteSignature OnGenerationComplete;
+
+	// Called with the results of every batch queued with QueueQueries
+	UPROPERTY(Category = "Voxel Terrain - Queries", BlueprintAssignable) FVoxelQueriesCompleteSignature OnQueriesComplete;
+
+	// Sends a batch of edits from the server to every client. The server calls this once a frame with the edits made since the last one.
+	UFUNCTION(NetMulticast, Reliable) void MulticastApplyEdits(const TArray<uint8>& Data);
+
 	// Scene component used to position the terrain in the world
 	UPROPERTY(Category = "Voxel Terrain", BlueprintReadWrite, VisibleAnywhere) class USceneComponent* Scene;
 
-	// The procedurally generated mesh that represents our voxels
-	UPROPERTY(Category = "Voxel Terrain", BlueprintReadOnly, VisibleAnywhere) TArray<class UProceduralMeshComponent*> Meshes;
-
 	// The material to apply to our voxel terrain
 	UPROPERTY(Category = "Voxel Terrain - Terrain Settings", BlueprintReadWrite, EditAnywhere) TArray<UMaterialInterface*> TerrainMaterials;
 
+	// Draw every material of a chunk in one mesh section with SingleSectionMaterial, instead of one section per material.
+	// The red channel of the vertex colors holds the index into TerrainMaterials, which the material uses to pick its texture.
+	// This turns a chunk with several materials in it into a single draw call.
+	UPROPERTY(Category = "Voxel Terrain - Terrain Settings", BlueprintReadWrite, EditAnywhere) bool bSingleMeshSection;
+
+	// The material that draws every terrain material when bSingleMeshSection is set. The first of the TerrainMaterials is used if this isn't set.
+	UPROPERTY(Category = "Voxel Terrain - Terrain Settings", BlueprintReadWrite, EditAnywhere, meta = (EditCondition = "bSingleMeshSection")) UMaterialInterface* SingleSectionMaterial;
+
+	// The algorithm used to turn the voxels into a mesh. Use SetSurfaceExtractor to change it once the terrain has started, so the loaded chunks are remeshed.
+	UPROPERTY(Category = "Voxel Terrain - Terrain Settings", BlueprintReadWrite, EditAnywhere) EVoxelSurfaceExtractor SurfaceExtractor;
+
 	// Some variables to control our terrain generator
 	// Choose between a sphere and minecraft-like terrain
 	UPROPERTY(Category = "Voxel Terrain - Terrain Settings", BlueprintReadWrite, EditAnywhere) bool bIsSpherical;
@@ -142,15 +432,411 @@ public:
 	// The maximum number of chunks that can be generated in the Z direction
 	UPROPERTY(Category = "Voxel Terrain - Size", BlueprintReadWrite, EditAnywhere) int32 ChunksToGenerateZ;
 
-	// The maximum number of chunks that can be generated in the X direction
+	// Flat terrain samples its noise this many 32 voxel blocks away from the origin in the X direction. Changing this changes the world.
+	// This used to be the maximum size of the terrain, but chunks stream in without any limit now.
 	UPROPERTY(Category = "Voxel Terrain - Size", BlueprintReadWrite, EditAnywhere) int32 MaxChunksX;
 
-	// The maximum number of chunks that can be generated in the Y direction
+	// Flat terrain samples its noise this many 32 voxel blocks away from the origin in the Y direction. Changing this changes the world.
 	UPROPERTY(Category = "Voxel Terrain - Size", BlueprintReadWrite, EditAnywhere) int32 MaxChunksY;
 
-	// The maximum number of chunks that can be generated in the Z direction
+	// Flat terrain samples its noise this many 32 voxel blocks away from the origin in the Z direction. Changing this changes the world.
 	UPROPERTY(Category = "Voxel Terrain - Size", BlueprintReadWrite, EditAnywhere) int32 MaxChunksZ;
-	
+
+	// Load and unload chunks around the viewers as they move. Otherwise the ChunksToGenerate area is generated once in BeginPlay.
+	UPROPERTY(Category = "Voxel Terrain - Streaming", BlueprintReadWrite, EditAnywhere) bool bStreamChunks;
+
+	// Chunks closer than this to a viewer are loaded, in chunks
+	UPROPERTY(Category = "Voxel Terrain - Streaming", BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "1")) float StreamingLoadRadius;
+
+	// Chunks further than this from every viewer are unloaded, in chunks. This is kept at least a chunk further out than the load radius,
+	// so chunks on the edge don't load and unload over and over as the viewer moves back and forth.
+	UPROPERTY(Category = "Voxel Terrain - Streaming", BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "2")) float StreamingUnloadRadius;
+
+	// The number of coarser levels of detail streamed in around the full resolution chunks. Each level samples every other voxel of the one below it
+	// and reaches twice as far, so the terrain can be seen out to StreamingLoadRadius * 2^NumLodLevels chunks. Zero turns level of detail off.
+	// Only used when bStreamChunks is set.
+	// Coarse levels are sampled straight from the noise, so edits and saved chunks only show up at full resolution and disappear past the load radius.
+	// Full resolution chunks don't have skirts like the coarse levels do; they only rely on their voxel apron, so small gaps can show where they meet the first coarse level.
+	UPROPERTY(Category = "Voxel Terrain - Streaming", BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "0", ClampMax = "6")) int32 NumLodLevels;
+
+	// The amount of memory the voxel volume can use to hold voxels, in megabytes. Chunks are palette compressed, so this goes a lot further than two bytes a voxel.
+	UPROPERTY(Category = "Voxel Terrain - Streaming", BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "16")) int32 VolumeMemoryMB;
+
+	// The amount of memory the chunk meshes can use, in megabytes. The furthest chunks are unloaded and the load radius shrinks when this is exceeded.
+	UPROPERTY(Category = "Voxel Terrain - Streaming", BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "16")) int32 MeshMemoryBudgetMB;
+
+	// Build collision for the chunks around the collision actors. The render meshes never have collision, so nothing collides with the terrain when this is off.
+	UPROPERTY(Category = "Voxel Terrain - Collision", BlueprintReadWrite, EditAnywhere) bool bGenerateCollision;
+
+	// Chunks closer than this to a collision actor get collision, in chunks. Their collision is dropped again once they are a chunk further out than this.
+	UPROPERTY(Category = "Voxel Terrain - Collision", BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "0")) float CollisionRadius;
+
+	// Generate the starting chunks on worker threads instead of stalling the game thread in BeginPlay
+	UPROPERTY(Category = "Voxel Terrain - Performance", BlueprintReadWrite, EditAnywhere) bool bGenerateAsynchronously;
+
+	// The number of worker threads used to generate chunks. Zero picks a number based on the CPU.
+	UPROPERTY(Category = "Voxel Terrain - Performance", BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "0")) int32 NumWorkerThreads;
+
+	// The maximum time in milliseconds the game thread spends creating chunk components each frame
+	UPROPERTY(Category = "Voxel Terrain - Performance", BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "0.1")) float GameThreadBudgetMs;
+
+	// Save modified chunks to disk when they are paged out, so they don't lose their changes
+	UPROPERTY(Category = "Voxel Terrain - Saving", BlueprintReadWrite, EditAnywhere) bool bSaveChunks;
+
+	// The name of the folder under Saved/VoxelTerrain that chunks are saved in. The actor's name is used if this is empty.
+	UPROPERTY(Category = "Voxel Terrain - Saving", BlueprintReadWrite, EditAnywhere) FString SaveName;
+
+	// Load full resolution chunks from the meshes baked by the VoxelTerrainBake commandlet instead of generating them. The baked meshes are only used
+	// if they were baked with the same settings, and chunks are dropped from the cache as soon as they are edited.
+	UPROPERTY(Category = "Voxel Terrain - Saving", BlueprintReadWrite, EditAnywhere) bool bUseMeshCache;
+
+	// Generate the terrain with vectorized noise instead of ANL, which is several times faster. It is checked against ANL when the terrain starts,
+	// and the terrain falls back to ANL if it doesn't match, so the same seed makes the same world either way. Saved chunks and baked meshes are kept apart for each.
+	UPROPERTY(Category = "Voxel Terrain - Performance", BlueprintReadWrite, EditAnywhere) bool bUseBatchedNoise;
+
+	// The most bytes a second the server sends a client that has just joined, while it catches up on the edits made before it did.
+	// Only the chunks that have been edited are sent, and only the voxels in them that are different from what the terrain generates.
+	UPROPERTY(Category = "Voxel Terrain - Networking", BlueprintReadWrite, EditAnywhere, meta = (ClampMin = "1024")) int32 NetSnapshotBytesPerSecond;
+
+	// Hide the full resolution chunks that can't be seen from any viewer because solid terrain is in the way, like caves deep underground.
+	// Every chunk works out which of its faces are connected by its air when it is built, and the terrain walks out from the viewers' chunks
+	// through those connections whenever a viewer moves into another chunk or a chunk is loaded, unloaded or edited.
+	UPROPERTY(Category = "Voxel Terrain - Performance", BlueprintReadWrite, EditAnywhere) bool bHideBuriedChunks;
+
+	// Don't build the render mesh of a chunk that is already hidden when it is generated. It still loads, with its collision, and is meshed
+	// as soon as an edit or a viewer opens up a way to it. This only applies to chunks generated on the workers.
+	UPROPERTY(Category = "Voxel Terrain - Performance", BlueprintReadWrite, EditAnywhere, meta = (EditCondition = "bHideBuriedChunks")) bool bDeferBuriedChunkMeshes;
+
+	// Write how long every chunk took to Saved/Profiling/VoxelTerrain/<actor name>.csv. The -VoxelChunkCsv switch turns this on as well, for commandlets and headless runs.
+	UPROPERTY(Category = "Voxel Terrain - Performance", BlueprintReadWrite, EditAnywhere) bool bWriteChunkCsv;
+
+	// Works out which part of the volume the given chunk covers
+	FVoxelChunkRequest MakeChunkRequest(int32 X, int32 Y, int32 Z) const;
+
+	// Works out which part of the volume the given chunk or level of detail node covers
+	FVoxelChunkRequest MakeChunkRequest(const FVoxelChunkKey& Key) const;
+
+	// Returns the position of a voxel in the volume
+	FIntVector VoxelToVolume(const FIntVector& Voxel) const;
+
+	// Returns the state shared with the worker threads. Mostly useful for tools and benchmarks.
+	TSharedPtr<FVoxelGenerationContext, ESPMode::ThreadSafe> GetGenerationContext() const { return GenerationContext; }
+
+	// Returns true on a client of a replicated terrain. Clients get their voxels from the server, and can't edit them themselves.
+	bool IsNetClient() const;
+
+	// Returns the sequence of the last replicated edit that changed each chunk
+	const TMap<FIntVector, uint32>& GetNetChunkVersions() const { return NetReplicator.GetChunkVersions(); }
+
+	// Returns the chunks a client's snapshot has to hold: the ones edited since the terrain started, and the ones saved by an earlier game.
+	// Called on the server by UVoxelTerrainNetComponent.
+	void GetNetSnapshotChunks(TArray<FIntVector>& OutChunks) const { NetReplicator.GetSnapshotChunks(OutChunks); }
+
+	// Appends a chunk to a client's snapshot, as the voxels that are different from what the terrain generates there.
+	// Called on the server by UVoxelTerrainNetComponent.
+	void WriteNetSnapshotChunk(const FIntVector& ChunkCoord, TArray<uint8>& OutData);
+
+	// Called on a client with the next part of its snapshot. The chunks in it are applied as soon as they have all arrived.
+	void ReceiveNetSnapshot(const TArray<uint8>& Data);
+
+	// Called on a client once the server has sent all of its snapshot. The edits that arrived in the meantime are applied after it.
+	void FinishNetSnapshot();
+
 private:
-	TSharedPtr<PolyVox::PagedVolume<PolyVox::MaterialDensityPair88>> VoxelVolume;
+	// Creates the volume, its pager and the state shared with the worker threads from the current settings
+	void InitializeGeneration();
+
+	// Creates a pager, a volume and the state the worker threads share from the current settings. The saved chunks are only loaded when
+	// bLoadSavedChunks is set; without them the chunks are generated purely from the noise.
+	TSharedRef<FVoxelGenerationContext, ESPMode::ThreadSafe> CreateGenerationContext(bool bLoadSavedChunks) const;
+
+	// Starts the worker threads and queues the first chunks. This is the part of BeginPlay a client puts off until it has the server's settings.
+	void StartGeneration();
+
+	// Called on a client when the server's settings arrive
+	UFUNCTION() void OnRep_NetSettings();
+
+	// Returns the folder the terrain saves its chunks and baked meshes in
+	FString GetSaveDirectory() const;
+
+	// Returns a hash of every setting that affects the chunk meshes. Baked meshes are only used if this matches.
+	uint32 GetMeshCacheHash() const;
+
+	// Returns the material to draw a section of a chunk mesh with
+	UMaterialInterface* GetSectionMaterial(int32 SectionIndex) const;
+
+	// Marks a chunk that has finished generating as loaded, and gives it a mesh component if it has any triangles.
+	// Returns false if the chunk had no triangles.
+	bool CreateChunkComponent(const FVoxelChunkMeshData& MeshData);
+
+	// Swaps the mesh of a chunk that has been remeshed after an edit. The component is kept, and sections whose triangles haven't changed are updated in place.
+	void UpdateChunkComponent(const FVoxelChunkMeshData& MeshData);
+
+	// Stores the visibility a worker worked out for a loaded chunk, and walks out from the viewers again if it changed
+	void UpdateChunkVisibility(const FVoxelChunkMeshData& MeshData);
+
+	// Walks out from the viewers' chunks through the faces each chunk's air connects, and hides the meshes of the chunks it doesn't reach.
+	// Buried chunks that were left without a mesh are queued to be meshed as soon as they are reached.
+	void HideBuriedChunks(const TArray<FIntVector>& ViewerChunks);
+
+	// Returns true if the last walk out from the viewers covered a chunk but couldn't reach it
+	bool IsChunkBuried(const FIntVector& ChunkCoord) const;
+
+	// Gives a loaded chunk the collision mesh that came back from the workers. The collision is cooked asynchronously,
+	// so the chunk keeps its old collision, or none, until the new one is ready.
+	void UpdateChunkCollision(const FVoxelChunkMeshData& MeshData);
+
+	// Removes a chunk's collision and recycles its collision component
+	void ClearChunkCollision(const FIntVector& ChunkCoord);
+
+	// Works out which chunks the collision actors want collision for, drops it from the ones they've moved away from,
+	// and sends the loaded chunks that still need it to the workers
+	void UpdateCollisionStreaming();
+
+	// Sends a loaded chunk to the workers to build only its collision
+	void QueueChunkCollision(const FIntVector& ChunkCoord);
+
+	// Returns true if a chunk should be built with collision
+	bool IsCollisionWanted(const FIntVector& ChunkCoord) const;
+
+	// Returns the chunks the collision actors are currently in
+	void GetCollisionActorChunks(TArray<FIntVector>& OutActorChunks) const;
+
+	// Returns the chunk that contains the given world location
+	FIntVector WorldToChunk(const FVector& WorldLocation) const;
+
+	// Returns true on the server of a replicated terrain, when there are clients to send edits to
+	bool IsReplicatingEdits() const;
+
+	// Makes an edit from one of the editing functions. The server numbers the edit and queues it to send to the clients.
+	// Returns true if any voxel changed.
+	bool SubmitEdit(FVoxelNetEdit Edit);
+
+	// Sends the edits made since the last frame to the clients
+	void SendPendingEdits();
+
+	// Gives every remote player controller a component to send it the snapshot of this terrain
+	void UpdateNetClients();
+
+	// Applies the chunks of the snapshot that have all arrived, and the edits that were held back once the whole snapshot is in
+	void ProcessNetSnapshot();
+
+	// Returns true once the volume is the one the queries should read
+	bool CanRunQueries() const;
+
+	// Answers a single query on the calling thread. Returns true if it found a solid voxel.
+	bool RunSingleQuery(const FVoxelQuery& Query, FVoxelQueryHit& OutHit) const;
+
+	// Hands the results of the query batches the workers have finished to their callbacks
+	void DeliverQueryResults();
+
+	// Marks the loaded chunks whose meshes read any of the voxels in a box as dirty
+	void MarkVoxelsDirty(const FIntVector& Lower, const FIntVector& Upper);
+
+	// Sends the dirty chunks and nodes off to be remeshed. Chunks that are still being generated stay dirty until they're done.
+	void RemeshDirtyChunks();
+
+	// Sends a loaded chunk or level of detail node off to be remeshed, or remeshes it now if there are no workers
+	void RemeshChunkNode(const FVoxelChunkKey& Key);
+
+	// Queues a chunk or level of detail node to be generated on the worker threads
+	bool QueueChunkNode(const FVoxelChunkKey& Key);
+
+	// Unloads a chunk or level of detail node and recycles its mesh component. Returns false if it wasn't loaded.
+	bool UnloadChunkNode(const FVoxelChunkKey& Key);
+
+	// Returns true if a chunk or level of detail node has finished generating
+	bool IsChunkNodeLoaded(const FVoxelChunkKey& Key) const;
+
+	// Takes a mesh component from the pool, or creates one if the pool is empty
+	UProceduralMeshComponent* AcquireMeshComponent();
+
+	// Clears a mesh component and puts it back in the pool
+	void ReleaseMeshComponent(UProceduralMeshComponent* Mesh);
+
+	// Takes a hidden collision component from the pool, or creates one if the pool is empty
+	UProceduralMeshComponent* AcquireCollisionComponent();
+
+	// Clears a collision component and puts it back in the pool
+	void ReleaseCollisionComponent(UProceduralMeshComponent* Mesh);
+
+	// Hands queued chunks to the worker threads, closest chunks first
+	void DispatchPendingChunks();
+
+	// Adds a line about a finished chunk to the CSV, if there is one
+	void WriteChunkCsvRow(const FVoxelChunkMeshData& MeshData, bool bRemesh, double CreateSeconds);
+
+	// Queues the chunks that have come into range of the viewers and unloads the ones that have gone out of range
+	void UpdateStreaming();
+
+	// Picks the level of detail of every node around the viewers, and queues the ones that aren't loaded yet
+	void UpdateLodStreaming(const TArray<FIntVector>& ViewerChunks, float LoadRadius);
+
+	// Adds the given node to DesiredChunks, or its children if a viewer is close enough for them
+	void SelectLodNodes(const FVoxelChunkKey& Key, const TArray<FIntVector>& ViewerChunks, float LoadRadius);
+
+	// Unloads the chunks and nodes the level of detail selection no longer wants, once whatever replaces them has loaded.
+	// Returns true if nothing is left waiting to be unloaded.
+	bool UnloadStaleChunks();
+
+	// Returns true if everything DesiredChunks has in place of the given node has loaded.
+	// Finer nodes only count if every one of them has loaded, so a coarse node is never unloaded while it would leave a hole.
+	bool IsReplacementLoaded(const FVoxelChunkKey& Key) const;
+
+	// Returns true if every descendant of the node that DesiredChunks wants has loaded
+	bool AreDescendantsLoaded(const FVoxelChunkKey& Key) const;
+
+	// Unloads the furthest chunks until the meshes fit in the memory budget again
+	void EnforceMeshMemoryBudget(const TArray<FIntVector>& ViewerChunks);
+
+	// Returns true if a chunk should stay loaded, given where the viewers are
+	bool IsChunkInRange(const FIntVector& ChunkCoord, const TArray<FIntVector>& ViewerChunks) const;
+
+	// Returns true if a chunk or level of detail node that has just finished generating is still wanted
+	bool IsChunkWanted(const FVoxelChunkKey& Key, const TArray<FIntVector>& ViewerChunks) const;
+
+	// Returns the chunks that the viewers are currently in
+	void GetViewerChunks(TArray<FIntVector>& OutViewerChunks) const;
+
+	// Returns the squared distance from a chunk to the closest viewer, in chunks
+	static int32 GetDistanceSquaredToViewers(const FIntVector& ChunkCoord, const TArray<FIntVector>& ViewerChunks);
+
+	// Returns the squared distance from the closest chunk of a level of detail node to the closest viewer, in chunks
+	static int32 GetDistanceSquaredToViewers(const FVoxelChunkKey& Key, const TArray<FIntVector>& ViewerChunks);
+
+	// Divides every component of a coordinate, rounding towards negative infinity
+	static FIntVector DivideAndRoundDown(const FIntVector& Coord, int32 Divisor);
+
+	TSharedPtr<VoxelTerrainPager, ESPMode::ThreadSafe> VoxelPager;
+	TSharedPtr<FVoxelPaletteVolume, ESPMode::ThreadSafe> VoxelVolume;
+
+	// State shared with the worker threads
+	TSharedPtr<FVoxelGenerationContext, ESPMode::ThreadSafe> GenerationContext;
+
+	// The worker threads that generate chunks
+	FQueuedThreadPool* WorkerPool;
+
+	// Every chunk that has finished generating, including the ones without any triangles
+	UPROPERTY() TMap<FIntVector, FVoxelLoadedChunk> Chunks;
+
+	// Every level of detail node above full resolution that has finished generating, including the ones without any triangles
+	UPROPERTY() TMap<FVoxelChunkKey, FVoxelLoadedChunk> LodNodes;
+
+	// Every chunk and node the last level of detail selection wants loaded
+	TSet<FVoxelChunkKey> DesiredChunks;
+
+	// Every node the last selection split into its children. Anything that isn't in here, in DesiredChunks or under one of them is out of range.
+	TSet<FVoxelChunkKey> SplitNodes;
+
+	// Set when there might be chunks or nodes that the selection no longer wants, and that can be unloaded once their replacements have loaded
+	bool bUnloadStaleChunks;
+
+	// Loaded chunks that have been edited and need to be remeshed
+	TSet<FIntVector> DirtyChunks;
+
+	// Loaded level of detail nodes that need to be remeshed. Edits never reach them, so these only come from changing the surface extractor.
+	TSet<FVoxelChunkKey> DirtyLodNodes;
+
+	// The surface extractor the mesh cache was opened with. The cache is only read while the terrain uses the same one.
+	EVoxelSurfaceExtractor MeshCacheSurfaceExtractor;
+
+	// The chunks the last walk out from the viewers reached, and the box of chunks it covered. Chunks in the box that it didn't reach are buried.
+	TSet<FIntVector> VisibleChunks;
+	FIntVector VisibleLowerBound;
+	FIntVector VisibleUpperBound;
+
+	// The viewer chunks the last walk started from
+	TArray<FIntVector> LastVisibilityViewerChunks;
+
+	// Set when a chunk has been loaded, unloaded or had its visibility change since the last walk
+	bool bChunkVisibilityChanged;
+
+	// Loaded chunks that were buried when they were generated, so only their visibility was built. They are remeshed once they can be seen.
+	TSet<FIntVector> UnmeshedChunks;
+
+	// The number of loaded chunks the last walk hid
+	int32 NumHiddenChunks;
+
+	// The running costs of each level of detail
+	TArray<FVoxelLodStats> LodStats;
+
+	// Mesh components from unloaded chunks, waiting to be reused
+	UPROPERTY() TArray<UProceduralMeshComponent*> MeshPool;
+
+	// Collision components from chunks that have lost their collision, waiting to be reused
+	UPROPERTY() TArray<UProceduralMeshComponent*> CollisionMeshPool;
+
+	// The actors collision is built around
+	TArray<TWeakObjectPtr<AActor>> CollisionActors;
+
+	// The collision actor chunks the last collision update was done for
+	TArray<FIntVector> LastCollisionActorChunks;
+
+	// Every chunk within the collision radius of a collision actor, loaded or not
+	TSet<FIntVector> DesiredCollisionChunks;
+
+	// Loaded chunks whose collision has been built, including the ones whose collision mesh came out empty
+	TSet<FIntVector> CollisionChunks;
+
+	// The actors chunks are streamed in around
+	TArray<TWeakObjectPtr<AActor>> StreamingViewers;
+
+	// The viewer chunks the last streaming update was done for. Streaming is only updated again once these change.
+	TArray<FIntVector> LastViewerChunks;
+
+	// The total of MeshBytes over every loaded chunk
+	int64 MeshMemoryBytes;
+
+	// The load radius after being shrunk to fit the mesh memory budget
+	float BudgetLoadRadius;
+
+	// The number of mesh and collision components created so far. Used to give each one a unique name.
+	int32 NumMeshComponentsCreated;
+
+	// Chunks and level of detail nodes waiting to be handed to the worker threads
+	TArray<FVoxelChunkKey> PendingChunks;
+
+	// Every chunk and node that is pending or in flight. This stops the same chunk from being queued twice.
+	TSet<FVoxelChunkKey> QueuedChunks;
+
+	// Set when PendingChunks needs to be sorted by distance before the next dispatch
+	bool bPendingChunksNeedSort;
+
+	// The number of chunks currently being generated by the worker threads
+	int32 ChunksInFlight;
+
+	// The number of chunks queued and finished since generation last started
+	int32 ChunksQueuedTotal;
+	int32 ChunksCompleted;
+
+	// The id of the last batch of queries queued
+	int32 LastQueryBatchId;
+
+	// The number of query batches the workers are still answering
+	int32 QueryBatchesInFlight;
+
+	// The per chunk timings, while bWriteChunkCsv is on
+	TUniquePtr<FArchive> ChunkCsv;
+
+	// The settings the terrain was generated with. The server fills these in, and they are sent to each client once.
+	UPROPERTY(ReplicatedUsing = OnRep_NetSettings) FVoxelTerrainNetSettings NetSettings;
+
+	// Set on a client once the server's settings have arrived
+	bool bHasNetSettings;
+
+	// Set on a client whose BeginPlay was put off until the server's settings arrive
+	bool bWaitingForNetSettings;
+
+	// The sequence of the last edit the server made
+	uint32 NetEditSequence;
+
+	// Applies the edits and snapshots against the version of each chunk, and holds back a client's edits until its snapshot is in
+	FVoxelNetReplicator NetReplicator;
+
+	// The edits the server has made since it last sent them
+	TArray<FVoxelNetEdit> PendingNetEdits;
+
+	// The components sending snapshots to the clients, one for each remote player controller
+	UPROPERTY() TArray<UVoxelTerrainNetComponent*> NetClients;
+
 };
\ No newline at end of file
@@ -0,0 +1,210 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// PolyVox
+#include "PolyVox/MaterialDensityPair.h"
+#include "PolyVox/Region.h"
+
+class VoxelTerrainPager;
+class FVoxelPaletteVolume;
+
+// A voxel edit the way the server sends it to clients. The server turns every edit into one of these before applying it, and applies it
+// with exactly the same integer math the clients do, so every machine ends up with the same voxels without any of them being sent.
+// Positions are in voxels, relative to the terrain, like the rest of the editing functions.
+struct FVoxelNetEdit
+{
+	// The shapes an edit can have
+	enum class EShape : uint8
+	{
+		// Every voxel from Lower to Upper, inclusive
+		Box,
+
+		// Every voxel whose centre is within Radius of Center
+		Sphere
+	};
+
+	// Sphere centres and radii are rounded to this many steps per voxel
+	static const int32 SubVoxelSteps = 16;
+
+	// Numbers the edits the server has made, starting at 1. Edits that aren't replicated are left at 0.
+	uint32 Sequence = 0;
+
+	EShape Shape = EShape::Box;
+
+	// An EVoxelEditMode
+	uint8 Mode = 0;
+
+	// The material the edit fills or paints with
+	uint8 Material = 0;
+
+	// The corners of a box
+	FIntVector Lower = FIntVector::ZeroValue;
+	FIntVector Upper = FIntVector::ZeroValue;
+
+	// The centre and radius of a sphere, in steps of 1 / SubVoxelSteps voxels
+	FIntVector Center = FIntVector::ZeroValue;
+	int32 Radius = 0;
+
+	// Makes a box edit
+	static FVoxelNetEdit MakeBox(const FIntVector& InLower, const FIntVector& InUpper, uint8 InMode, uint8 InMaterial);
+
+	// Makes a sphere edit. The centre and radius are in voxels, and are rounded to the nearest step.
+	static FVoxelNetEdit MakeSphere(const FVector& InCenter, float InRadius, uint8 InMode, uint8 InMaterial);
+
+	// Returns the box of voxels the edit can change. Both corners are inclusive, and Lower is past Upper if it can't change anything.
+	void GetBounds(FIntVector& OutLower, FIntVector& OutUpper) const;
+
+	// Returns true if the edit covers a voxel
+	bool Contains(const FIntVector& Voxel) const;
+
+	// Applies the edit to a voxel at the given position. Voxels the edit doesn't cover are left alone.
+	FORCEINLINE void Apply(const FIntVector& Voxel, PolyVox::MaterialDensityPair88& InOutVoxel) const
+	{
+		if (Contains(Voxel))
+			ApplyMode(Mode, Material, InOutVoxel);
+	}
+
+	// Changes a single voxel the way an EVoxelEditMode does
+	static void ApplyMode(uint8 Mode, uint8 Material, PolyVox::MaterialDensityPair88& InOutVoxel);
+};
+
+// Packs a batch of edits for sending. Each edit is written as the difference from the one before it, so edits that follow each other around,
+// like a player digging a tunnel, only take a few bytes each. A batch has to be read back in one go with FVoxelNetCodec::ReadEdits.
+class FVoxelNetEditWriter
+{
+public:
+	// Appends an edit to the batch
+	void Write(const FVoxelNetEdit& Edit);
+
+	// Empties the batch, so the next edit is written on its own
+	void Reset();
+
+	// The edits written so far
+	const TArray<uint8>& GetData() const { return Data; }
+
+	// The number of edits written so far
+	int32 Num() const { return NumEdits; }
+
+private:
+	TArray<uint8> Data;
+	int32 NumEdits = 0;
+
+	// The edit the next one is written relative to
+	FVoxelNetEdit Previous;
+};
+
+// Reads and writes the bytes the terrain replicates
+struct FVoxelNetCodec
+{
+	// The most bytes the terrain puts in one RPC. Edit batches and snapshots are split into pieces this big, so no single RPC holds up the connection.
+	static const int32 MaxPayloadBytes = 1024;
+
+	// Reads back a batch written by FVoxelNetEditWriter, adding its edits to OutEdits. Returns false if the data is corrupt.
+	static bool ReadEdits(const uint8* Data, int32 DataSize, TArray<FVoxelNetEdit>& OutEdits);
+
+	// Appends a chunk to a snapshot, as the runs of voxels that are different from what the terrain generates there.
+	// A chunk nobody has edited much comes out at a few bytes. Both sets of voxels are in chunk order, with X varying fastest.
+	// Version is the sequence of the last edit the voxels include.
+	static void WriteChunkDiff(const FIntVector& ChunkCoord, uint32 Version, const PolyVox::MaterialDensityPair88* Voxels, const PolyVox::MaterialDensityPair88* Baseline, int32 NumVoxels, TArray<uint8>& OutData);
+
+	// Reads the header of the next chunk in a snapshot. OutDiff and OutDiffSize are the runs to hand to ApplyChunkDiff.
+	// Returns the number of bytes the whole chunk takes up, 0 if it hasn't all arrived yet, or INDEX_NONE if the data is corrupt.
+	static int32 ReadChunkDiff(const uint8* Data, int32 DataSize, FIntVector& OutChunkCoord, uint32& OutVersion, const uint8*& OutDiff, int32& OutDiffSize);
+
+	// Writes the runs of a chunk over its generated voxels. Returns false if the runs are corrupt or run past NumVoxels.
+	static bool ApplyChunkDiff(const uint8* Diff, int32 DiffSize, PolyVox::MaterialDensityPair88* InOutVoxels, int32 NumVoxels);
+};
+
+// Keeps a terrain's voxels in step with the server's: applies edits against the version of each chunk, writes and applies the snapshots
+// late joiners catch up from, and holds back the edits a client gets while its snapshot is still on its way.
+// This is everything about replication that doesn't need the engine, so the actor and the loopback tool share it.
+//
+// Chunks are FVoxelChunkTraits chunks of terrain voxels. Everything here has to be called from the thread that edits the terrain.
+class FVoxelNetReplicator
+{
+public:
+	// Points the replicator at the voxels of a terrain, which it reads and edits through the volume. VolumeOffset is added to a terrain voxel
+	// to find it in the volume. This has to be called again whenever the volume is made again; the versions and anything held back are kept.
+	void SetVolume(VoxelTerrainPager* InPager, FVoxelPaletteVolume* InVolume, const FIntVector& InVolumeOffset);
+
+	// Called with the box of terrain voxels, both corners inclusive, that an edit or a snapshot chunk changed
+	TFunction<void(const FIntVector& Lower, const FIntVector& Upper)> OnVoxelsChanged;
+
+	// Applies an edit. Replicated edits skip the chunks that already have a newer version, and move the chunks they change up to the
+	// edit's sequence. Chunks the edit covers but doesn't change are left at the version they were. Returns true if any voxel changed.
+	bool ApplyEdit(const FVoxelNetEdit& Edit);
+
+	// Returns the sequence of the last replicated edit that changed each chunk
+	const TMap<FIntVector, uint32>& GetChunkVersions() const { return ChunkVersions; }
+
+	// Returns every chunk a client needs in its snapshot on the server: the ones edits have changed, and the ones the pager's chunk store
+	// has saved, which are different from what the client generates even if no edit has touched them since the terrain started.
+	// Saved chunks are listed instead of versioned when they're paged in, as the server may never page in a chunk a client needs. A saved
+	// chunk no edit has changed is sent at version 0, which is safe because a client holds its edits back until its snapshot is in.
+	void GetSnapshotChunks(TArray<FIntVector>& OutChunks) const;
+
+	// Appends a chunk to a snapshot, as the voxels that are different from what the terrain generates there, at the chunk's current version
+	void WriteSnapshotChunk(const FIntVector& ChunkCoord, TArray<uint8>& OutData);
+
+	// Called on a client before it has been sent anything. Edits are held back from then on, until the snapshot has been applied.
+	void WaitForSnapshot() { bWaitingForSnapshot = true; }
+
+	// Returns true on a client until its snapshot has been applied
+	bool IsWaitingForSnapshot() const { return bWaitingForSnapshot; }
+
+	// Reads a batch of edits from the server and applies them, or holds them back if the snapshot hasn't been applied yet.
+	// Returns false if the data is corrupt.
+	bool ReceiveEdits(const uint8* Data, int32 DataSize);
+
+	// Adds the next part of a snapshot. Nothing is applied until ApplySnapshot is called.
+	void ReceiveSnapshot(const uint8* Data, int32 DataSize);
+
+	// Called once the server has sent all of the snapshot
+	void FinishSnapshot() { bSnapshotComplete = true; }
+
+	// Applies the chunks of the snapshot that have all arrived. Once the whole snapshot is in, the edits that were held back are applied after it.
+	// Returns false if any of the snapshot was corrupt.
+	bool ApplySnapshot();
+
+	// What the snapshot has brought in so far
+	int32 GetNumSnapshotChunks() const { return NumSnapshotChunks; }
+	int64 GetNumSnapshotBytes() const { return NumSnapshotBytes; }
+
+	// The number of edits that were held back while the snapshot was on its way
+	int32 GetNumHeldBackEdits() const { return NumHeldBackEdits; }
+
+private:
+	// Runs EditVoxel over every voxel in a box of terrain voxels, and tells the pager and OnVoxelsChanged about the ones that changed.
+	// The chunks with changed voxels are added to OutChangedChunks if it is given. Returns true if any voxel changed.
+	bool EditVoxels(const FIntVector& Lower, const FIntVector& Upper, TFunctionRef<void(const FIntVector& Voxel, PolyVox::MaterialDensityPair88& InOutVoxel)> EditVoxel, TSet<FIntVector>* OutChangedChunks);
+
+	// Returns the box of volume voxels a chunk covers
+	PolyVox::Region GetChunkRegion(const FIntVector& ChunkCoord) const;
+
+	VoxelTerrainPager* Pager = nullptr;
+	FVoxelPaletteVolume* Volume = nullptr;
+	FIntVector VolumeOffset = FIntVector::ZeroValue;
+
+	// The sequence of the last replicated edit that changed each chunk. A chunk no replicated edit has changed isn't in here,
+	// unless it came in a snapshot.
+	TMap<FIntVector, uint32> ChunkVersions;
+
+	// Set on a client until its snapshot has been applied
+	bool bWaitingForSnapshot = false;
+
+	// Set on a client once the server has sent all of its snapshot
+	bool bSnapshotComplete = false;
+
+	// The part of the snapshot that hasn't been applied yet
+	TArray<uint8> SnapshotData;
+
+	// The edits that arrived while the snapshot was still on its way
+	TArray<FVoxelNetEdit> HeldBackEdits;
+
+	int32 NumSnapshotChunks = 0;
+	int64 NumSnapshotBytes = 0;
+	int32 NumHeldBackEdits = 0;
+};
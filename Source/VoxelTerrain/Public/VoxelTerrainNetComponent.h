@@ -0,0 +1,69 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "VoxelTerrainNetComponent.generated.h"
+
+class AVoxelTerrainActor;
+
+// Catches a client up on the edits made to a terrain before it joined. The server adds one of these to each remote player controller for
+// each replicated terrain, so the snapshot goes over that player's own connection and nobody else's. The client asks for the snapshot once
+// it can see the terrain, and the server streams it every chunk that has been edited, as the voxels that are different from what the
+// terrain generates there. Edits made while the snapshot is on its way reach the client as usual, and it holds them back until the end.
+UCLASS()
+class VOXELTERRAIN_API UVoxelTerrainNetComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this component's properties
+	UVoxelTerrainNetComponent();
+
+	// Replicates the terrain
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	// Called every frame. This is where the server sends the next part of the snapshot.
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	// Sets the terrain the snapshot is of. Called on the server when the component is created.
+	void SetTerrain(AVoxelTerrainActor* InTerrain) { Terrain = InTerrain; }
+
+private:
+	// Called on the client when it can see the terrain
+	UFUNCTION() void OnRep_Terrain();
+
+	// Asks the server to start sending the snapshot
+	UFUNCTION(Server, Reliable, WithValidation) void ServerRequestSnapshot();
+
+	// Sends the client the next part of the snapshot. A chunk can be split across several of these.
+	UFUNCTION(Client, Reliable) void ClientReceiveSnapshot(const TArray<uint8>& Data);
+
+	// Tells the client the whole snapshot has been sent
+	UFUNCTION(Client, Reliable) void ClientFinishSnapshot();
+
+	// The terrain the snapshot is of
+	UPROPERTY(ReplicatedUsing = OnRep_Terrain) AVoxelTerrainActor* Terrain;
+
+	// Set on the client once it has asked for the snapshot
+	bool bRequestedSnapshot;
+
+	// Set on the server while it is sending the snapshot
+	bool bSendingSnapshot;
+
+	// The edited chunks that haven't been sent yet
+	TArray<FIntVector> ChunksToSend;
+
+	// Chunks that have been written but not all sent yet, and how much of them has been sent
+	TArray<uint8> PendingData;
+	int32 PendingOffset;
+
+	// The number of bytes that can be sent before going over the terrain's NetSnapshotBytesPerSecond
+	float ByteAllowance;
+
+	// What has been sent so far, for the log
+	int32 NumChunksSent;
+	int64 NumBytesSent;
+	double SnapshotStartTime;
+};
@@ -0,0 +1,244 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#pragma once
+
+// Polyvox Includes
+#include "PolyVox/MaterialDensityPair.h"
+
+#include "CoreMinimal.h"
+#include "VoxelChunkTraits.h"
+#include "VoxelPaletteVolume.h"
+
+// ANL
+namespace anl
+{
+	class CNoiseExecutor;
+}
+
+// The compiled ANL noise program for a terrain. This is defined in VoxelTerrainPager.cpp so the ANL headers stay out of here.
+struct FVoxelTerrainProgram;
+
+// Vectorized noise, used instead of ANL when the terrain asks for it and it matches ANL
+class FVoxelBatchedNoise;
+enum class EVoxelNoiseInstructionSet : uint8;
+
+// Saves chunks to disk when they are paged out
+class FVoxelChunkStore;
+
+// The terrain height of a square of voxel columns.
+// The height only depends on X and Y, so it is shared by every chunk stacked on top of each other.
+struct FVoxelColumnTile
+{
+	// One height per column, with X varying fastest
+	TArray<double> Heights;
+
+	// When this tile was last used. The least recently used tile is evicted when the cache is full.
+	uint64 LastUsed = 0;
+};
+
+// How closely the batched noise follows ANL over a set of voxels, from VoxelTerrainPager::CompareBatchedNoise
+struct FVoxelNoiseComparison
+{
+	// The largest difference from ANL over every voxel and every fractal the batched noise stands in for.
+	// This is negative if the batched noise couldn't be set up at all.
+	float MaxError = -1.f;
+
+	// How long the batched noise and ANL took to evaluate the same voxels
+	double BatchedSeconds = 0;
+	double AnlSeconds = 0;
+};
+
+class VoxelTerrainPager : public FVoxelPaletteVolume::Pager
+{
+public:
+	// The side length of the chunks in the paged volume. This is passed to the volume when it is created.
+	static const int32 VolumeChunkSideLength = 32;
+
+	// The index math for the chunks in the paged volume
+	typedef TVoxelChunkTraits<VolumeChunkSideLength> FVolumeChunkTraits;
+
+	// The number of column tiles kept around. Each tile holds the heights of a chunk's worth of columns.
+	static const int32 ColumnCacheCapacity = 256;
+
+	// The number of chunks that can be staged but not paged in yet. Each one holds a full chunk of voxels.
+	static const int32 StagedChunkCapacity = 512;
+
+	// Constructor
+	// When bBatchedNoise is set the terrain is generated with FVoxelBatchedNoise instead of ANL, which is much faster.
+	// It is checked against ANL first and only used if it matches to within FVoxelBatchedNoise::AnlTolerance, so the same seed still makes the same world.
+	// That only holds within FVoxelBatchedNoise::AnlToleranceExtent voxels of the origin, so ANL still generates the terrain further out.
+	VoxelTerrainPager(bool bIsSphericalTerrain = false, uint32 NoiseSeed = 123, uint32 Octaves = 3, float Frequency = 0.01, float Scale = 32, float Offset = 0, float Height = 64, bool bBatchedNoise = false);
+
+	// Destructor
+	virtual ~VoxelTerrainPager();
+
+	// FVoxelPaletteVolume::Pager functions
+	virtual void pageIn(const PolyVox::Region& region, FVoxelPaletteVolume::Chunk* pChunk);
+	virtual void pageOut(const PolyVox::Region& region, FVoxelPaletteVolume::Chunk* pChunk);
+
+	// Returns true if the terrain is being generated with the batched noise
+	bool IsUsingBatchedNoise() const { return bUseBatchedNoise; }
+
+	// Evaluates every fractal the batched noise stands in for at NumPoints voxels, with both the batched noise and ANL, and compares them.
+	// This works whenever the terrain asked for the batched noise, even if it turned out not to match.
+	FVoxelNoiseComparison CompareBatchedNoise(int32 NumPoints, EVoxelNoiseInstructionSet InstructionSet) const;
+
+	// Saves chunks to the given store when they are paged out, and loads them from it instead of regenerating them.
+	// This has to be set before the volume starts paging chunks in.
+	void SetChunkStore(const TSharedPtr<FVoxelChunkStore, ESPMode::ThreadSafe>& InChunkStore) { ChunkStore = InChunkStore; }
+
+	// Returns the chunk store, if there is one
+	const TSharedPtr<FVoxelChunkStore, ESPMode::ThreadSafe>& GetChunkStore() const { return ChunkStore; }
+
+	// Tells the pager how many chunks the volume can hold at once. The pager only remembers about this many chunks as being paged in,
+	// so its bookkeeping doesn't grow without limit as the viewer moves around.
+	void SetMaxResidentChunks(int32 InMaxResidentChunks) { MaxResidentChunks = FMath::Max(1, InMaxResidentChunks); }
+
+	// Returns a hash of every setting that affects the generated voxels. Saved chunks are only used if this matches.
+	uint32 GetSettingsHash() const;
+
+	// Generates the voxels of every volume chunk that overlaps the given region ahead of time, so that a later pageIn only has to copy them.
+	// This doesn't touch the volume, so it is safe to call from several threads at once.
+	void StageRegion(const PolyVox::Region& Region);
+
+	// Generates the voxels for the given region. The voxels are written with X varying fastest, then Y, then Z.
+	// This is safe to call from several threads at once.
+	void GenerateRegion(const PolyVox::Region& Region, PolyVox::MaterialDensityPair88* OutVoxels);
+
+	// Generates voxels spaced Step voxels apart, for the coarser levels of detail. Sample (i, j, k) is the voxel at Origin + (i, j, k) * Step.
+	// The samples are written with X varying fastest, then Y, then Z. This is safe to call from several threads at once.
+	void GenerateSampledRegion(const FIntVector& Origin, const FIntVector& NumSamples, int32 Step, PolyVox::MaterialDensityPair88* OutVoxels);
+
+	// Works out whether every voxel in a volume chunk is the same from the bounds of the noise alone, without evaluating any of it.
+	// This is conservative, so a chunk that could possibly have a surface in it is never reported as uniform.
+	// Returns true and sets OutVoxel if the chunk is uniform.
+	bool ClassifyChunk(const FIntVector& ChunkKey, PolyVox::MaterialDensityPair88& OutVoxel) const;
+
+	// The same as ClassifyChunk, but for any box of voxels. Both corners are inclusive.
+	bool ClassifyBox(const FIntVector& Lower, const FIntVector& Upper, PolyVox::MaterialDensityPair88& OutVoxel) const;
+
+	// Returns true if every volume chunk the surface extractors would read for the given region is uniform, and they are either all solid or all air.
+	// There can't be a surface in a region like that, so there is no need to extract it.
+	bool IsRegionFeatureless(const PolyVox::Region& Region) const;
+
+	// Returns true if any volume chunk the surface extractors would read for the given region has been saved or edited,
+	// which means its voxels might not be the ones the noise makes.
+	bool IsRegionModified(const PolyVox::Region& Region) const;
+
+	// Tells the pager that voxels in the given region have been edited, so the noise bounds no longer say anything about the chunks they're in.
+	// This is safe to call from any thread.
+	void MarkRegionModified(const PolyVox::Region& Region);
+
+private:
+	// Returns the key of the volume chunk that contains the given voxel position
+	static FIntVector GetVolumeChunkKey(int32 X, int32 Y, int32 Z);
+
+	// Records that a chunk has been staged or paged in, and forgets the chunks that were used least recently once there are too many.
+	// The staging lock must be held.
+	void MarkChunkKnown(const FIntVector& ChunkKey);
+
+	// Throws away the staged chunk that was used least recently. The staging lock must be held.
+	void EvictOldestStagedChunk();
+
+	// Returns the range of volume chunk keys the surface extractors read for a region.
+	// This includes the chunks on the lower side, since the extractors peek one voxel outside of the region.
+	static void GetRegionChunkKeys(const PolyVox::Region& Region, FIntVector& OutLowerKey, FIntVector& OutUpperKey);
+
+	// Generates samples of spherical terrain
+	void GenerateSphericalRegion(const FIntVector& Origin, const FIntVector& NumSamples, int32 Step, PolyVox::MaterialDensityPair88* OutVoxels, anl::CNoiseExecutor& Executor);
+
+	// Generates samples of flat, minecraft-like terrain
+	void GenerateFlatRegion(const FIntVector& Origin, const FIntVector& NumSamples, int32 Step, PolyVox::MaterialDensityPair88* OutVoxels, anl::CNoiseExecutor& Executor);
+
+	// Generates samples of spherical terrain with the batched noise
+	void GenerateBatchedSphericalRegion(const FIntVector& Origin, const FIntVector& NumSamples, int32 Step, PolyVox::MaterialDensityPair88* OutVoxels);
+
+	// Generates samples of flat terrain with the batched noise
+	void GenerateBatchedFlatRegion(const FIntVector& Origin, const FIntVector& NumSamples, int32 Step, PolyVox::MaterialDensityPair88* OutVoxels);
+
+	// Returns the flat terrain heights of the sampled columns, with X varying fastest.
+	// Full resolution columns come from the tile cache. The heights come from the batched noise when Executor is null.
+	void GetColumnHeights(const FIntVector& Origin, const FIntVector& NumSamples, int32 Step, anl::CNoiseExecutor* Executor, TArray<double>& OutHeights);
+
+	// Evaluates the flat terrain heights of columns spaced Step voxels apart, with X varying fastest.
+	// The heights come from the batched noise when Executor is null.
+	void EvaluateColumnHeights(const FIntPoint& Origin, const FIntPoint& NumColumns, int32 Step, anl::CNoiseExecutor* Executor, double* OutHeights);
+
+	// Returns the column heights for the tile at the given tile coordinates, evaluating them if they aren't cached.
+	// The heights come from the batched noise when Executor is null.
+	TSharedRef<FVoxelColumnTile, ESPMode::ThreadSafe> GetColumnTile(int32 TileX, int32 TileY, anl::CNoiseExecutor* Executor);
+
+	// The noise program. This is built once in the constructor and only read after that, so every thread can share it.
+	TUniquePtr<FVoxelTerrainProgram> Program;
+
+	// Sets up the batched noise in the program, and uses it if it matches ANL
+	void SetUpBatchedNoise();
+
+	// Returns true if the voxels in the box between Lower and Upper, both inclusive, should come from the batched noise
+	bool CanUseBatchedNoise(const FIntVector& Lower, const FIntVector& Upper) const;
+
+	// Whether the terrain is generated with the batched noise in the program instead of ANL
+	bool bUseBatchedNoise = false;
+
+	// Where modified chunks are saved. This can be null, in which case modified chunks are lost when they are paged out.
+	TSharedPtr<FVoxelChunkStore, ESPMode::ThreadSafe> ChunkStore;
+
+	// Chunks that have been generated ahead of time and are waiting to be paged in
+	TMap<FIntVector, TArray<PolyVox::MaterialDensityPair88>> StagedChunks;
+
+	// Chunks that have been staged or paged in recently, and when they were last used. This stops two workers from generating the same chunk.
+	// PolyVox doesn't say when it throws away a chunk that wasn't modified, so this only remembers about as many chunks as the volume can hold.
+	// Forgetting a chunk that is still paged in just means it might be staged again for nothing, which is harmless.
+	TMap<FIntVector, uint64> KnownChunks;
+
+	// Incremented every time a known chunk is used
+	uint64 KnownChunksClock = 0;
+
+	// The number of chunks the volume can hold at once
+	int32 MaxResidentChunks = 4096;
+
+	// Protects StagedChunks and KnownChunks
+	FCriticalSection StagingLock;
+
+	// Volume chunks that have been edited since they were paged in. They stay in here until they're paged out, after which the chunk store has them.
+	TSet<FIntVector> ModifiedChunks;
+
+	// Protects ModifiedChunks
+	mutable FCriticalSection ModifiedChunksLock;
+
+	// Recently used column tiles
+	TMap<FIntPoint, TSharedRef<FVoxelColumnTile, ESPMode::ThreadSafe>> ColumnCache;
+
+	// Incremented every time a column tile is used, to keep track of which tile was used least recently
+	uint64 ColumnCacheClock = 0;
+
+	// Protects ColumnCache and ColumnCacheClock
+	FCriticalSection ColumnCacheLock;
+
+	// Some variables to control our terrain generator
+	// Choose between a sphere and minecraft-like terrain
+	bool bIsSpherical;
+
+	// The seed of our fractal
+	uint32 Seed = 123;
+
+	// The number of octaves that the noise generator will use
+	uint32 NoiseOctaves = 3;
+
+	// The frequency of the noise
+	float NoiseFrequency = 0.01;
+
+	// The scale of the noise. The output of the TerrainFractal is multiplied by this.
+	float NoiseScale = 32;
+
+	// The offset of the noise. This value is added to the output of the TerrainFractal.
+	float NoiseOffset = 0;
+
+	// The maximum height of the generated terrain in voxels. NOTE: Changing this will affect where the ground begins!
+	float TerrainHeight = 64;
+
+	// The lowest and highest values the scaled and offset terrain fractal can produce.
+	// These are worked out from the noise settings in the constructor and are used to classify chunks without evaluating the noise.
+	double MinTerrainScale = 0;
+	double MaxTerrainScale = 0;
+};
@@ -16,6 +16,9 @@ public class VoxelTerrain : ModuleRules
         PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "ProceduralMeshComponent" });
         PrivateDependencyModuleNames.AddRange(new string[] {  });
 
+        // The number of voxels along each side of a terrain chunk: 16, 32 or 64. Smaller chunks remesh faster after an edit, bigger ones mean fewer components.
+        PublicDefinitions.Add("VOXEL_TERRAIN_CHUNK_SIZE=32");
+
         ////////////////////// Custom Voxel Terrain Stuff Starts Here //////////////////////////////////////
         // You will need to compile and add additional libraries if you want to use this on platforms not listed below!
         switch (Target.Platform)
@@ -1,5 +1,43 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 #include "VoxelTerrain.h"
+#include "VoxelTerrainStats.h"
+
+DEFINE_LOG_CATEGORY(LogVoxelTerrain);
+
+DEFINE_STAT(STAT_VoxelTerrain_Tick);
+DEFINE_STAT(STAT_VoxelTerrain_GenerateChunk);
+DEFINE_STAT(STAT_VoxelTerrain_Noise);
+DEFINE_STAT(STAT_VoxelTerrain_Extract);
+DEFINE_STAT(STAT_VoxelTerrain_BuildMesh);
+DEFINE_STAT(STAT_VoxelTerrain_BuildCollision);
+DEFINE_STAT(STAT_VoxelTerrain_BuildVisibility);
+DEFINE_STAT(STAT_VoxelTerrain_PageIn);
+DEFINE_STAT(STAT_VoxelTerrain_DecodeChunk);
+DEFINE_STAT(STAT_VoxelTerrain_PageOut);
+DEFINE_STAT(STAT_VoxelTerrain_ReadMeshCache);
+DEFINE_STAT(STAT_VoxelTerrain_Queries);
+DEFINE_STAT(STAT_VoxelTerrain_CullChunks);
+DEFINE_STAT(STAT_VoxelTerrain_CreateMeshSections);
+DEFINE_STAT(STAT_VoxelTerrain_CreateCollisionSections);
+DEFINE_STAT(STAT_VoxelTerrain_ChunksGenerated);
+DEFINE_STAT(STAT_VoxelTerrain_ChunksSkipped);
+DEFINE_STAT(STAT_VoxelTerrain_ChunksCached);
+DEFINE_STAT(STAT_VoxelTerrain_NetEditsSent);
+DEFINE_STAT(STAT_VoxelTerrain_NetEditBytesSent);
+DEFINE_STAT(STAT_VoxelTerrain_NetSnapshotBytesSent);
+DEFINE_STAT(STAT_VoxelTerrain_QueriesAnswered);
+DEFINE_STAT(STAT_VoxelTerrain_Triangles);
+DEFINE_STAT(STAT_VoxelTerrain_Vertices);
+DEFINE_STAT(STAT_VoxelTerrain_MeshSections);
+DEFINE_STAT(STAT_VoxelTerrain_CollisionChunks);
+DEFINE_STAT(STAT_VoxelTerrain_CollisionTriangles);
+DEFINE_STAT(STAT_VoxelTerrain_VolumeMemory);
+DEFINE_STAT(STAT_VoxelTerrain_MeshMemory);
+DEFINE_STAT(STAT_VoxelTerrain_PendingChunks);
+DEFINE_STAT(STAT_VoxelTerrain_ChunksInFlight);
+DEFINE_STAT(STAT_VoxelTerrain_DirtyChunks);
+DEFINE_STAT(STAT_VoxelTerrain_HiddenChunks);
+DEFINE_STAT(STAT_VoxelTerrain_UnmeshedChunks);
 
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, VoxelTerrain, "VoxelTerrain" );
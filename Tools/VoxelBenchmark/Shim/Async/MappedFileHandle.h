@@ -0,0 +1,26 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#pragma once
+
+// Stands in for the engine header of the same name. The shim's platform file never maps anything, so the region store
+// always falls back to loading whole files, the same as it does on platforms that can't map them.
+
+#include "CoreMinimal.h"
+
+class IMappedFileRegion
+{
+public:
+	virtual ~IMappedFileRegion() {}
+
+	virtual const uint8* GetMappedPtr() = 0;
+	virtual int64 GetMappedSize() = 0;
+};
+
+class IMappedFileHandle
+{
+public:
+	virtual ~IMappedFileHandle() {}
+
+	virtual int64 GetFileSize() = 0;
+	virtual IMappedFileRegion* MapRegion(int64 Offset = 0, int64 BytesToMap = MAX_int64) = 0;
+};
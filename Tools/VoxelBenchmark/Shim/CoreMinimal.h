@@ -0,0 +1,961 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#pragma once
+
+// The part of the engine's core API that the pager, the noise and the mesh builders use, implemented on the standard library.
+// This stands in for the engine's CoreMinimal.h when the terrain code is built outside of Unreal, so it can be benchmarked
+// without the editor. Only what those files actually call is here, and everything behaves the way the engine's version does.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+typedef int8_t int8;
+typedef int16_t int16;
+typedef int32_t int32;
+typedef int64_t int64;
+typedef uint8_t uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+typedef uint64_t uint64;
+
+// The engine uses UTF-16 on Linux, but nothing here needs more than plain strings
+typedef char TCHAR;
+#define TEXT(x) x
+
+#define FORCEINLINE inline __attribute__((always_inline))
+#define FORCENOINLINE __attribute__((noinline))
+
+#define INDEX_NONE (-1)
+#define MAX_uint8 ((uint8)0xff)
+#define MAX_uint16 ((uint16)0xffff)
+#define MAX_uint32 ((uint32)0xffffffff)
+#define MAX_uint64 ((uint64)0xffffffffffffffff)
+#define MAX_int32 ((int32)0x7fffffff)
+#define MIN_int32 ((int32)0x80000000)
+#define MAX_int64 ((int64)0x7fffffffffffffff)
+#define MAX_flt (3.402823466e+38F)
+
+#define ARRAY_COUNT(Array) (sizeof(Array) / sizeof((Array)[0]))
+
+#define check(expr) do { if (!(expr)) { std::fprintf(stderr, "Assertion failed: %s [%s:%d]\n", #expr, __FILE__, __LINE__); std::abort(); } } while (0)
+#define checkf(expr, ...) check(expr)
+#define verify(expr) check(expr)
+#define ensure(expr) (expr)
+
+// Logging. Every category and verbosity goes to stderr, so it never mixes with the benchmark's output.
+#define DECLARE_LOG_CATEGORY_EXTERN(CategoryName, DefaultVerbosity, CompileTimeVerbosity)
+#define DEFINE_LOG_CATEGORY(CategoryName)
+#define UE_LOG(CategoryName, Verbosity, Format, ...) ShimLog(#CategoryName, #Verbosity, Format, ##__VA_ARGS__)
+
+inline void ShimLog(const char* Category, const char* Verbosity, const char* Format, ...)
+{
+	std::fprintf(stderr, "%s: %s: ", Category, Verbosity);
+
+	va_list Args;
+	va_start(Args, Format);
+	std::vfprintf(stderr, Format, Args);
+	va_end(Args);
+
+	std::fputc('\n', stderr);
+}
+
+template<typename T>
+FORCEINLINE typename std::remove_reference<T>::type&& MoveTemp(T&& Value)
+{
+	return std::move(Value);
+}
+
+template<typename T>
+FORCEINLINE void Swap(T& A, T& B)
+{
+	std::swap(A, B);
+}
+
+struct FMemory
+{
+	static FORCEINLINE void* Memcpy(void* Dest, const void* Src, size_t Count) { return std::memcpy(Dest, Src, Count); }
+	static FORCEINLINE void* Memmove(void* Dest, const void* Src, size_t Count) { return std::memmove(Dest, Src, Count); }
+	static FORCEINLINE void* Memset(void* Dest, uint8 Char, size_t Count) { return std::memset(Dest, Char, Count); }
+	static FORCEINLINE void Memzero(void* Dest, size_t Count) { std::memset(Dest, 0, Count); }
+	static FORCEINLINE int32 Memcmp(const void* A, const void* B, size_t Count) { return std::memcmp(A, B, Count); }
+};
+
+struct FMath
+{
+	template<typename T> static constexpr FORCEINLINE T Abs(const T A) { return A >= (T)0 ? A : -A; }
+	template<typename T> static constexpr FORCEINLINE T Min(const T A, const T B) { return A <= B ? A : B; }
+	template<typename T> static constexpr FORCEINLINE T Max(const T A, const T B) { return A >= B ? A : B; }
+	template<typename T> static constexpr FORCEINLINE T Min3(const T A, const T B, const T C) { return Min(Min(A, B), C); }
+	template<typename T> static constexpr FORCEINLINE T Max3(const T A, const T B, const T C) { return Max(Max(A, B), C); }
+	template<typename T> static constexpr FORCEINLINE T Clamp(const T X, const T Lower, const T Upper) { return X < Lower ? Lower : X < Upper ? X : Upper; }
+	template<typename T> static constexpr FORCEINLINE T Square(const T A) { return A * A; }
+	template<typename T> static constexpr FORCEINLINE T DivideAndRoundUp(T Dividend, T Divisor) { return (Dividend + Divisor - 1) / Divisor; }
+	template<typename T> static constexpr FORCEINLINE bool IsPowerOfTwo(T Value) { return (Value & (Value - 1)) == (T)0; }
+	static FORCEINLINE uint32 FloorLog2(uint32 Value) { uint32 Log = 0; while (Value >>= 1) Log++; return Log; }
+	template<typename T> static constexpr FORCEINLINE T Sign(const T A) { return (A > (T)0) ? (T)1 : ((A < (T)0) ? (T)-1 : (T)0); }
+
+	static FORCEINLINE float Sqrt(float Value) { return std::sqrt(Value); }
+	static FORCEINLINE double Sqrt(double Value) { return std::sqrt(Value); }
+	static FORCEINLINE float Pow(float A, float B) { return std::pow(A, B); }
+	static FORCEINLINE double Pow(double A, double B) { return std::pow(A, B); }
+	static FORCEINLINE float Loge(float Value) { return std::log(Value); }
+	static FORCEINLINE double Loge(double Value) { return std::log(Value); }
+
+	static FORCEINLINE int32 TruncToInt(float F) { return (int32)F; }
+	static FORCEINLINE float TruncToFloat(float F) { return std::trunc(F); }
+	static FORCEINLINE int32 FloorToInt(float F) { return (int32)std::floor(F); }
+	static FORCEINLINE int32 FloorToInt(double F) { return (int32)std::floor(F); }
+	static FORCEINLINE float FloorToFloat(float F) { return std::floor(F); }
+	static FORCEINLINE double FloorToFloat(double F) { return std::floor(F); }
+	static FORCEINLINE int32 CeilToInt(float F) { return (int32)std::ceil(F); }
+	static FORCEINLINE int32 CeilToInt(double F) { return (int32)std::ceil(F); }
+	static FORCEINLINE int32 RoundToInt(float F) { return FloorToInt(F + 0.5f); }
+	static FORCEINLINE int32 RoundToInt(double F) { return FloorToInt(F + 0.5); }
+	static FORCEINLINE float Fractional(float Value) { return Value - TruncToFloat(Value); }
+};
+
+// Hashing, with the same combine function as the engine
+FORCEINLINE uint32 HashCombine(uint32 A, uint32 C)
+{
+	uint32 B = 0x9e3779b9;
+	A += B;
+
+	A -= B; A -= C; A ^= (C >> 13);
+	B -= C; B -= A; B ^= (A << 8);
+	C -= A; C -= B; C ^= (B >> 13);
+	A -= B; A -= C; A ^= (C >> 12);
+	B -= C; B -= A; B ^= (A << 16);
+	C -= A; C -= B; C ^= (B >> 5);
+	A -= B; A -= C; A ^= (C >> 3);
+	B -= C; B -= A; B ^= (A << 10);
+	C -= A; C -= B; C ^= (B >> 15);
+
+	return C;
+}
+
+FORCEINLINE uint32 GetTypeHash(int32 Value) { return (uint32)Value; }
+FORCEINLINE uint32 GetTypeHash(uint32 Value) { return Value; }
+FORCEINLINE uint32 GetTypeHash(uint64 Value) { return (uint32)Value + ((uint32)(Value >> 32) * 23); }
+FORCEINLINE uint32 GetTypeHash(int64 Value) { return GetTypeHash((uint64)Value); }
+
+FORCEINLINE uint32 GetTypeHash(float Value)
+{
+	uint32 Bits;
+	std::memcpy(&Bits, &Value, sizeof(Bits));
+	return Bits;
+}
+
+// Lets the standard containers hash keys with GetTypeHash
+struct FShimKeyHash
+{
+	template<typename KeyType>
+	size_t operator()(const KeyType& Key) const { return GetTypeHash(Key); }
+};
+
+enum EForceInit
+{
+	ForceInit,
+	ForceInitToZero
+};
+
+class FString;
+
+struct FIntVector
+{
+	int32 X = 0;
+	int32 Y = 0;
+	int32 Z = 0;
+
+	static const FIntVector ZeroValue;
+
+	FIntVector() {}
+	explicit FIntVector(int32 InValue) : X(InValue), Y(InValue), Z(InValue) {}
+	FIntVector(int32 InX, int32 InY, int32 InZ) : X(InX), Y(InY), Z(InZ) {}
+
+	int32& operator[](int32 Index) { return (&X)[Index]; }
+	int32 operator[](int32 Index) const { return (&X)[Index]; }
+
+	bool operator==(const FIntVector& Other) const { return X == Other.X && Y == Other.Y && Z == Other.Z; }
+	bool operator!=(const FIntVector& Other) const { return !(*this == Other); }
+
+	FIntVector operator+(const FIntVector& Other) const { return FIntVector(X + Other.X, Y + Other.Y, Z + Other.Z); }
+	FIntVector operator-(const FIntVector& Other) const { return FIntVector(X - Other.X, Y - Other.Y, Z - Other.Z); }
+	FIntVector operator*(int32 Scale) const { return FIntVector(X * Scale, Y * Scale, Z * Scale); }
+	FIntVector operator/(int32 Divisor) const { return FIntVector(X / Divisor, Y / Divisor, Z / Divisor); }
+	FIntVector& operator+=(const FIntVector& Other) { X += Other.X; Y += Other.Y; Z += Other.Z; return *this; }
+	FIntVector& operator-=(const FIntVector& Other) { X -= Other.X; Y -= Other.Y; Z -= Other.Z; return *this; }
+
+	int32 GetMax() const { return FMath::Max3(X, Y, Z); }
+	int32 GetMin() const { return FMath::Min3(X, Y, Z); }
+
+	FString ToString() const;
+};
+
+inline const FIntVector FIntVector::ZeroValue(0, 0, 0);
+
+FORCEINLINE uint32 GetTypeHash(const FIntVector& Vector)
+{
+	return HashCombine(HashCombine((uint32)Vector.X, (uint32)Vector.Y), (uint32)Vector.Z);
+}
+
+struct FIntPoint
+{
+	int32 X = 0;
+	int32 Y = 0;
+
+	FIntPoint() {}
+	explicit FIntPoint(int32 InValue) : X(InValue), Y(InValue) {}
+	FIntPoint(int32 InX, int32 InY) : X(InX), Y(InY) {}
+
+	bool operator==(const FIntPoint& Other) const { return X == Other.X && Y == Other.Y; }
+	bool operator!=(const FIntPoint& Other) const { return !(*this == Other); }
+
+	FIntPoint operator+(const FIntPoint& Other) const { return FIntPoint(X + Other.X, Y + Other.Y); }
+	FIntPoint operator-(const FIntPoint& Other) const { return FIntPoint(X - Other.X, Y - Other.Y); }
+	FIntPoint operator*(int32 Scale) const { return FIntPoint(X * Scale, Y * Scale); }
+};
+
+FORCEINLINE uint32 GetTypeHash(const FIntPoint& Point)
+{
+	return HashCombine((uint32)Point.X, (uint32)Point.Y);
+}
+
+struct FVector
+{
+	float X;
+	float Y;
+	float Z;
+
+	static const FVector ZeroVector;
+
+	FVector() {}
+	explicit FVector(EForceInit) : X(0), Y(0), Z(0) {}
+	explicit FVector(float InF) : X(InF), Y(InF), Z(InF) {}
+	FVector(float InX, float InY, float InZ) : X(InX), Y(InY), Z(InZ) {}
+	explicit FVector(const FIntVector& InVector) : X((float)InVector.X), Y((float)InVector.Y), Z((float)InVector.Z) {}
+
+	float& operator[](int32 Index) { return (&X)[Index]; }
+	float operator[](int32 Index) const { return (&X)[Index]; }
+
+	bool operator==(const FVector& V) const { return X == V.X && Y == V.Y && Z == V.Z; }
+	bool operator!=(const FVector& V) const { return !(*this == V); }
+
+	FVector operator-() const { return FVector(-X, -Y, -Z); }
+	FVector operator+(const FVector& V) const { return FVector(X + V.X, Y + V.Y, Z + V.Z); }
+	FVector operator-(const FVector& V) const { return FVector(X - V.X, Y - V.Y, Z - V.Z); }
+	FVector operator*(const FVector& V) const { return FVector(X * V.X, Y * V.Y, Z * V.Z); }
+	FVector operator*(float Scale) const { return FVector(X * Scale, Y * Scale, Z * Scale); }
+	FVector operator/(float Scale) const { const float RScale = 1.f / Scale; return FVector(X * RScale, Y * RScale, Z * RScale); }
+	FVector& operator+=(const FVector& V) { X += V.X; Y += V.Y; Z += V.Z; return *this; }
+	FVector& operator-=(const FVector& V) { X -= V.X; Y -= V.Y; Z -= V.Z; return *this; }
+	FVector& operator*=(float Scale) { X *= Scale; Y *= Scale; Z *= Scale; return *this; }
+
+	// Cross product
+	FVector operator^(const FVector& V) const { return FVector(Y * V.Z - Z * V.Y, Z * V.X - X * V.Z, X * V.Y - Y * V.X); }
+
+	// Dot product
+	float operator|(const FVector& V) const { return X * V.X + Y * V.Y + Z * V.Z; }
+
+	float Size() const { return std::sqrt(X * X + Y * Y + Z * Z); }
+	float SizeSquared() const { return X * X + Y * Y + Z * Z; }
+	FVector GetAbs() const { return FVector(FMath::Abs(X), FMath::Abs(Y), FMath::Abs(Z)); }
+	float GetMax() const { return FMath::Max3(X, Y, Z); }
+	float GetMin() const { return FMath::Min3(X, Y, Z); }
+	bool IsZero() const { return X == 0.f && Y == 0.f && Z == 0.f; }
+	FVector ComponentMin(const FVector& V) const { return FVector(FMath::Min(X, V.X), FMath::Min(Y, V.Y), FMath::Min(Z, V.Z)); }
+	FVector ComponentMax(const FVector& V) const { return FVector(FMath::Max(X, V.X), FMath::Max(Y, V.Y), FMath::Max(Z, V.Z)); }
+
+	FVector GetSafeNormal(float Tolerance = 1.e-8f) const
+	{
+		const float SquareSum = SizeSquared();
+		if (SquareSum == 1.f)
+			return *this;
+		if (SquareSum < Tolerance)
+			return FVector(0.f);
+
+		return *this * (1.f / std::sqrt(SquareSum));
+	}
+
+	static float DistSquared(const FVector& A, const FVector& B) { return (B - A).SizeSquared(); }
+
+	void DiagnosticCheckNaN() const {}
+};
+
+inline const FVector FVector::ZeroVector(0.f, 0.f, 0.f);
+
+FORCEINLINE FVector operator*(float Scale, const FVector& V)
+{
+	return V * Scale;
+}
+
+struct FVector2D
+{
+	float X;
+	float Y;
+
+	FVector2D() {}
+	FVector2D(float InX, float InY) : X(InX), Y(InY) {}
+
+	bool operator==(const FVector2D& V) const { return X == V.X && Y == V.Y; }
+	bool operator!=(const FVector2D& V) const { return !(*this == V); }
+};
+
+struct FColor
+{
+	uint8 B;
+	uint8 G;
+	uint8 R;
+	uint8 A;
+
+	FColor() {}
+	FColor(uint8 InR, uint8 InG, uint8 InB, uint8 InA = 255) : B(InB), G(InG), R(InR), A(InA) {}
+
+	bool operator==(const FColor& C) const { return R == C.R && G == C.G && B == C.B && A == C.A; }
+	bool operator!=(const FColor& C) const { return !(*this == C); }
+};
+
+// Leaves trivial elements uninitialized when an array grows, like the engine's SetNumUninitialized does
+template<typename T>
+struct TShimDefaultInitAllocator : public std::allocator<T>
+{
+	template<typename U>
+	struct rebind { typedef TShimDefaultInitAllocator<U> other; };
+
+	using std::allocator<T>::allocator;
+
+	template<typename U>
+	void construct(U* Ptr) noexcept(std::is_nothrow_default_constructible<U>::value) { ::new((void*)Ptr) U; }
+
+	template<typename U, typename... ArgTypes>
+	void construct(U* Ptr, ArgTypes&&... Args) { ::new((void*)Ptr) U(std::forward<ArgTypes>(Args)...); }
+};
+
+template<typename ElementType>
+class TArray
+{
+	typedef std::vector<ElementType, TShimDefaultInitAllocator<ElementType>> FStorage;
+
+public:
+	TArray() {}
+	TArray(std::initializer_list<ElementType> InitList) : Storage(InitList) {}
+
+	FORCEINLINE int32 Num() const { return (int32)Storage.size(); }
+	FORCEINLINE int32 Max() const { return (int32)Storage.capacity(); }
+	FORCEINLINE ElementType* GetData() { return Storage.data(); }
+	FORCEINLINE const ElementType* GetData() const { return Storage.data(); }
+	FORCEINLINE bool IsValidIndex(int32 Index) const { return Index >= 0 && Index < Num(); }
+	FORCEINLINE uint32 GetTypeSize() const { return sizeof(ElementType); }
+	FORCEINLINE size_t GetAllocatedSize() const { return Storage.capacity() * sizeof(ElementType); }
+
+	FORCEINLINE ElementType& operator[](int32 Index) { return Storage[Index]; }
+	FORCEINLINE const ElementType& operator[](int32 Index) const { return Storage[Index]; }
+	FORCEINLINE ElementType& Last(int32 IndexFromTheEnd = 0) { return Storage[Storage.size() - 1 - IndexFromTheEnd]; }
+	FORCEINLINE const ElementType& Last(int32 IndexFromTheEnd = 0) const { return Storage[Storage.size() - 1 - IndexFromTheEnd]; }
+
+	FORCEINLINE int32 Add(const ElementType& Item) { Storage.push_back(Item); return Num() - 1; }
+	FORCEINLINE int32 Add(ElementType&& Item) { Storage.push_back(std::move(Item)); return Num() - 1; }
+
+	template<typename... ArgTypes>
+	FORCEINLINE int32 Emplace(ArgTypes&&... Args) { Storage.emplace_back(std::forward<ArgTypes>(Args)...); return Num() - 1; }
+
+	int32 AddUnique(const ElementType& Item)
+	{
+		const int32 Index = Find(Item);
+		return Index != INDEX_NONE ? Index : Add(Item);
+	}
+
+	int32 AddUninitialized(int32 Count = 1) { const int32 Index = Num(); Storage.resize(Storage.size() + Count); return Index; }
+	int32 AddZeroed(int32 Count = 1) { const int32 Index = Num(); Storage.resize(Storage.size() + Count); FMemory::Memzero(GetData() + Index, Count * sizeof(ElementType)); return Index; }
+	int32 AddDefaulted(int32 Count = 1) { const int32 Index = Num(); for (int32 i = 0; i < Count; i++) Storage.emplace_back(); return Index; }
+
+	void Append(const TArray& Other) { Storage.insert(Storage.end(), Other.Storage.begin(), Other.Storage.end()); }
+	void Append(const ElementType* Ptr, int32 Count) { Storage.insert(Storage.end(), Ptr, Ptr + Count); }
+	void Insert(const ElementType& Item, int32 Index) { Storage.insert(Storage.begin() + Index, Item); }
+
+	// Value-initializes new elements, so trivial types are zeroed like the engine's SetNum
+	void SetNum(int32 NewNum, bool bAllowShrinking = true) { const int32 OldNum = Num(); Storage.resize(NewNum); for (int32 i = OldNum; i < NewNum; i++) Storage[i] = ElementType(); }
+	void SetNumUninitialized(int32 NewNum, bool bAllowShrinking = true) { Storage.resize(NewNum); }
+	void SetNumZeroed(int32 NewNum, bool bAllowShrinking = true) { const int32 OldNum = Num(); Storage.resize(NewNum); if (NewNum > OldNum) FMemory::Memzero(GetData() + OldNum, (NewNum - OldNum) * sizeof(ElementType)); }
+
+	void Init(const ElementType& Element, int32 Number) { Storage.assign(Number, Element); }
+	void Reserve(int32 Number) { Storage.reserve(Number); }
+	void Reset(int32 NewSize = 0) { Storage.clear(); Storage.reserve(NewSize); }
+	void Empty(int32 Slack = 0) { FStorage().swap(Storage); Storage.reserve(Slack); }
+	void Shrink() { Storage.shrink_to_fit(); }
+
+	ElementType Pop(bool bAllowShrinking = true) { ElementType Result = std::move(Storage.back()); Storage.pop_back(); return Result; }
+
+	void RemoveAt(int32 Index, int32 Count = 1, bool bAllowShrinking = true) { Storage.erase(Storage.begin() + Index, Storage.begin() + Index + Count); }
+
+	void RemoveAtSwap(int32 Index, int32 Count = 1, bool bAllowShrinking = true)
+	{
+		for (int32 i = 0; i < Count; i++)
+		{
+			if (Index != Num() - 1)
+				Storage[Index] = std::move(Storage.back());
+			Storage.pop_back();
+		}
+	}
+
+	int32 Remove(const ElementType& Item)
+	{
+		const int32 OldNum = Num();
+		Storage.erase(std::remove(Storage.begin(), Storage.end(), Item), Storage.end());
+		return OldNum - Num();
+	}
+
+	int32 Find(const ElementType& Item) const
+	{
+		auto It = std::find(Storage.begin(), Storage.end(), Item);
+		return It == Storage.end() ? INDEX_NONE : (int32)(It - Storage.begin());
+	}
+
+	template<typename KeyType> int32 IndexOfByKey(const KeyType& Key) const { return Find(Key); }
+	bool Contains(const ElementType& Item) const { return Find(Item) != INDEX_NONE; }
+
+	// The engine's sort is not stable either
+	void Sort() { std::sort(Storage.begin(), Storage.end()); }
+
+	template<typename PredicateType>
+	void Sort(const PredicateType& Predicate) { std::sort(Storage.begin(), Storage.end(), Predicate); }
+
+	bool operator==(const TArray& Other) const { return Storage == Other.Storage; }
+	bool operator!=(const TArray& Other) const { return Storage != Other.Storage; }
+
+	FORCEINLINE typename FStorage::iterator begin() { return Storage.begin(); }
+	FORCEINLINE typename FStorage::iterator end() { return Storage.end(); }
+	FORCEINLINE typename FStorage::const_iterator begin() const { return Storage.begin(); }
+	FORCEINLINE typename FStorage::const_iterator end() const { return Storage.end(); }
+
+private:
+	FStorage Storage;
+};
+
+template<typename KeyType, typename ValueType>
+struct TPair
+{
+	KeyType Key;
+	ValueType Value;
+
+	TPair() {}
+	TPair(const KeyType& InKey, const ValueType& InValue) : Key(InKey), Value(InValue) {}
+	TPair(const KeyType& InKey, ValueType&& InValue) : Key(InKey), Value(std::move(InValue)) {}
+
+	bool operator==(const TPair& Other) const { return Key == Other.Key && Value == Other.Value; }
+};
+
+// Iterating a map gives pairs with Key and Value members, like the engine's maps
+template<typename KeyType, typename ValueType>
+class TMap
+{
+	typedef TPair<KeyType, ValueType> FElement;
+	typedef std::unordered_map<KeyType, FElement, FShimKeyHash> FStorage;
+
+	template<typename BaseIteratorType, typename ElementRefType>
+	struct TIterator
+	{
+		BaseIteratorType It;
+
+		ElementRefType operator*() const { return It->second; }
+		auto operator->() const { return &It->second; }
+		TIterator& operator++() { ++It; return *this; }
+		bool operator!=(const TIterator& Other) const { return It != Other.It; }
+		bool operator==(const TIterator& Other) const { return It == Other.It; }
+	};
+
+public:
+	typedef TIterator<typename FStorage::iterator, FElement&> FIterator;
+	typedef TIterator<typename FStorage::const_iterator, const FElement&> FConstIterator;
+
+	FORCEINLINE int32 Num() const { return (int32)Storage.size(); }
+
+	ValueType& Add(const KeyType& Key, const ValueType& Value) { return Emplace(Key, ValueType(Value)); }
+	ValueType& Add(const KeyType& Key, ValueType&& Value) { return Emplace(Key, std::move(Value)); }
+	ValueType& Add(const KeyType& Key) { return Emplace(Key, ValueType()); }
+
+	ValueType& Emplace(const KeyType& Key, ValueType&& Value)
+	{
+		auto It = Storage.find(Key);
+		if (It != Storage.end())
+		{
+			It->second.Value = std::move(Value);
+			return It->second.Value;
+		}
+
+		return Storage.emplace(Key, FElement(Key, std::move(Value))).first->second.Value;
+	}
+
+	ValueType& FindOrAdd(const KeyType& Key)
+	{
+		auto It = Storage.find(Key);
+		if (It != Storage.end())
+			return It->second.Value;
+
+		return Storage.emplace(Key, FElement(Key, ValueType())).first->second.Value;
+	}
+
+	ValueType* Find(const KeyType& Key) { auto It = Storage.find(Key); return It != Storage.end() ? &It->second.Value : nullptr; }
+	const ValueType* Find(const KeyType& Key) const { auto It = Storage.find(Key); return It != Storage.end() ? &It->second.Value : nullptr; }
+	ValueType& FindChecked(const KeyType& Key) { ValueType* Value = Find(Key); check(Value); return *Value; }
+	const ValueType& FindChecked(const KeyType& Key) const { const ValueType* Value = Find(Key); check(Value); return *Value; }
+	bool Contains(const KeyType& Key) const { return Storage.find(Key) != Storage.end(); }
+
+	int32 Remove(const KeyType& Key) { return (int32)Storage.erase(Key); }
+
+	bool RemoveAndCopyValue(const KeyType& Key, ValueType& OutRemovedValue)
+	{
+		auto It = Storage.find(Key);
+		if (It == Storage.end())
+			return false;
+
+		OutRemovedValue = std::move(It->second.Value);
+		Storage.erase(It);
+		return true;
+	}
+
+	void Reset() { Storage.clear(); }
+	void Empty(int32 ExpectedNumElements = 0) { FStorage().swap(Storage); Storage.reserve(ExpectedNumElements); }
+	void Reserve(int32 Number) { Storage.reserve(Number); }
+
+	FIterator begin() { return FIterator{ Storage.begin() }; }
+	FIterator end() { return FIterator{ Storage.end() }; }
+	FConstIterator begin() const { return FConstIterator{ Storage.begin() }; }
+	FConstIterator end() const { return FConstIterator{ Storage.end() }; }
+
+private:
+	FStorage Storage;
+};
+
+template<typename ElementType>
+class TSet
+{
+	typedef std::unordered_set<ElementType, FShimKeyHash> FStorage;
+
+public:
+	FORCEINLINE int32 Num() const { return (int32)Storage.size(); }
+
+	void Add(const ElementType& Element, bool* bIsAlreadyInSetPtr = nullptr)
+	{
+		const bool bAdded = Storage.insert(Element).second;
+		if (bIsAlreadyInSetPtr)
+			*bIsAlreadyInSetPtr = !bAdded;
+	}
+
+	bool Contains(const ElementType& Element) const { return Storage.find(Element) != Storage.end(); }
+	const ElementType* Find(const ElementType& Element) const { auto It = Storage.find(Element); return It != Storage.end() ? &*It : nullptr; }
+	int32 Remove(const ElementType& Element) { return (int32)Storage.erase(Element); }
+	void Reset() { Storage.clear(); }
+	void Empty(int32 ExpectedNumElements = 0) { FStorage().swap(Storage); Storage.reserve(ExpectedNumElements); }
+	void Reserve(int32 Number) { Storage.reserve(Number); }
+
+	TArray<ElementType> Array() const
+	{
+		TArray<ElementType> Result;
+		Result.Reserve(Num());
+		for (const ElementType& Element : Storage)
+			Result.Add(Element);
+
+		return Result;
+	}
+
+	typename FStorage::const_iterator begin() const { return Storage.begin(); }
+	typename FStorage::const_iterator end() const { return Storage.end(); }
+
+private:
+	FStorage Storage;
+};
+
+template<typename OptionalType>
+class TOptional
+{
+public:
+	TOptional() {}
+	TOptional(const OptionalType& InValue) : Value(InValue) {}
+
+	template<typename... ArgTypes>
+	void Emplace(ArgTypes&&... Args) { Value.emplace(std::forward<ArgTypes>(Args)...); }
+
+	bool IsSet() const { return Value.has_value(); }
+	explicit operator bool() const { return IsSet(); }
+	void Reset() { Value.reset(); }
+
+	OptionalType& GetValue() { check(IsSet()); return *Value; }
+	const OptionalType& GetValue() const { check(IsSet()); return *Value; }
+	const OptionalType& Get(const OptionalType& DefaultValue) const { return IsSet() ? *Value : DefaultValue; }
+
+private:
+	std::optional<OptionalType> Value;
+};
+
+// Smart pointers. The standard library's are always thread safe, which is what the terrain asks for anyway.
+enum class ESPMode
+{
+	NotThreadSafe,
+	Fast,
+	ThreadSafe
+};
+
+template<typename ObjectType, ESPMode Mode = ESPMode::Fast> class TSharedRef;
+
+template<typename ObjectType, ESPMode Mode = ESPMode::Fast>
+class TSharedPtr : public std::shared_ptr<ObjectType>
+{
+	typedef std::shared_ptr<ObjectType> FBase;
+
+public:
+	TSharedPtr() {}
+	TSharedPtr(std::nullptr_t) {}
+	TSharedPtr(const FBase& Base) : FBase(Base) {}
+	TSharedPtr(FBase&& Base) : FBase(std::move(Base)) {}
+
+	template<typename OtherType>
+	TSharedPtr(const TSharedPtr<OtherType, Mode>& Other) : FBase(Other) {}
+
+	template<typename OtherType>
+	TSharedPtr(const TSharedRef<OtherType, Mode>& Other) : FBase(Other) {}
+
+	FORCEINLINE bool IsValid() const { return FBase::get() != nullptr; }
+	FORCEINLINE ObjectType* Get() const { return FBase::get(); }
+	FORCEINLINE void Reset() { FBase::reset(); }
+	TSharedRef<ObjectType, Mode> ToSharedRef() const { check(IsValid()); return TSharedRef<ObjectType, Mode>(static_cast<const FBase&>(*this)); }
+};
+
+template<typename ObjectType, ESPMode Mode>
+class TSharedRef : public std::shared_ptr<ObjectType>
+{
+	typedef std::shared_ptr<ObjectType> FBase;
+
+public:
+	explicit TSharedRef(const FBase& Base) : FBase(Base) { check(FBase::get()); }
+
+	template<typename OtherType>
+	TSharedRef(const TSharedRef<OtherType, Mode>& Other) : FBase(Other) {}
+
+	FORCEINLINE ObjectType& Get() const { return *FBase::get(); }
+};
+
+// What MakeShareable returns. It converts to a shared pointer or reference of any mode.
+template<typename ObjectType>
+struct TRawPtrProxy
+{
+	ObjectType* Object;
+
+	template<typename OtherType, ESPMode Mode>
+	operator TSharedPtr<OtherType, Mode>() const { return TSharedPtr<OtherType, Mode>(std::shared_ptr<OtherType>(Object)); }
+
+	template<typename OtherType, ESPMode Mode>
+	operator TSharedRef<OtherType, Mode>() const { return TSharedRef<OtherType, Mode>(std::shared_ptr<OtherType>(Object)); }
+};
+
+template<typename ObjectType>
+FORCEINLINE TRawPtrProxy<ObjectType> MakeShareable(ObjectType* Object)
+{
+	return TRawPtrProxy<ObjectType>{ Object };
+}
+
+template<typename ObjectType, ESPMode Mode = ESPMode::Fast, typename... ArgTypes>
+FORCEINLINE TSharedRef<ObjectType, Mode> MakeShared(ArgTypes&&... Args)
+{
+	return TSharedRef<ObjectType, Mode>(std::make_shared<ObjectType>(std::forward<ArgTypes>(Args)...));
+}
+
+template<typename ObjectType>
+class TUniquePtr : public std::unique_ptr<ObjectType>
+{
+	typedef std::unique_ptr<ObjectType> FBase;
+
+public:
+	using FBase::FBase;
+
+	TUniquePtr() {}
+	TUniquePtr(FBase&& Base) : FBase(std::move(Base)) {}
+
+	FORCEINLINE bool IsValid() const { return FBase::get() != nullptr; }
+	FORCEINLINE ObjectType* Get() const { return FBase::get(); }
+	FORCEINLINE void Reset(ObjectType* NewObject = nullptr) { FBase::reset(NewObject); }
+};
+
+template<typename ObjectType, typename... ArgTypes>
+FORCEINLINE TUniquePtr<ObjectType> MakeUnique(ArgTypes&&... Args)
+{
+	return TUniquePtr<ObjectType>(new ObjectType(std::forward<ArgTypes>(Args)...));
+}
+
+// The engine's TFunctionRef doesn't own its callable. std::function copies it instead, which is fine for the few places that take one.
+template<typename FuncType>
+using TFunctionRef = std::function<FuncType>;
+
+template<typename FuncType>
+using TFunction = std::function<FuncType>;
+
+// A lock that can be taken again by the thread that holds it, like the engine's critical section
+class FCriticalSection
+{
+public:
+	FORCEINLINE void Lock() { Mutex.lock(); }
+	FORCEINLINE bool TryLock() { return Mutex.try_lock(); }
+	FORCEINLINE void Unlock() { Mutex.unlock(); }
+
+private:
+	std::recursive_mutex Mutex;
+};
+
+class FScopeLock
+{
+public:
+	explicit FScopeLock(FCriticalSection* InSynchObject)
+		: SynchObject(InSynchObject)
+	{
+		SynchObject->Lock();
+	}
+
+	~FScopeLock()
+	{
+		SynchObject->Unlock();
+	}
+
+	FScopeLock(const FScopeLock&) = delete;
+	FScopeLock& operator=(const FScopeLock&) = delete;
+
+private:
+	FCriticalSection* SynchObject;
+};
+
+class FThreadSafeCounter
+{
+public:
+	FThreadSafeCounter(int32 InValue = 0) : Counter(InValue) {}
+
+	int32 Increment() { return ++Counter; }
+	int32 Decrement() { return --Counter; }
+	int32 Add(int32 Amount) { return Counter.fetch_add(Amount); }
+	int32 Set(int32 Value) { return Counter.exchange(Value); }
+	int32 Reset() { return Counter.exchange(0); }
+	int32 GetValue() const { return Counter.load(); }
+
+private:
+	std::atomic<int32> Counter;
+};
+
+class FThreadSafeCounter64
+{
+public:
+	FThreadSafeCounter64(int64 InValue = 0) : Counter(InValue) {}
+
+	int64 Increment() { return ++Counter; }
+	int64 Decrement() { return --Counter; }
+	int64 Add(int64 Amount) { return Counter.fetch_add(Amount); }
+	int64 Set(int64 Value) { return Counter.exchange(Value); }
+	int64 Reset() { return Counter.exchange(0); }
+	int64 GetValue() const { return Counter.load(); }
+
+private:
+	std::atomic<int64> Counter;
+};
+
+class FThreadSafeBool
+{
+public:
+	FThreadSafeBool(bool bInValue = false) : bValue(bInValue) {}
+
+	operator bool() const { return bValue.load(); }
+	FThreadSafeBool& operator=(bool bInValue) { bValue.store(bInValue); return *this; }
+
+private:
+	std::atomic<bool> bValue;
+};
+
+enum class EMemoryOrder
+{
+	Relaxed,
+	SequentiallyConsistent
+};
+
+// The engine's atomic wrapper, with the same member functions
+template<typename T>
+class TAtomic
+{
+public:
+	TAtomic() = default;
+	constexpr TAtomic(T Value) : Element(Value) {}
+
+	TAtomic(const TAtomic&) = delete;
+	TAtomic& operator=(const TAtomic&) = delete;
+
+	T Load(EMemoryOrder Order = EMemoryOrder::SequentiallyConsistent) const { return Element.load(ToStd(Order)); }
+	void Store(T Value, EMemoryOrder Order = EMemoryOrder::SequentiallyConsistent) { Element.store(Value, ToStd(Order)); }
+	T Exchange(T Value) { return Element.exchange(Value); }
+	bool CompareExchange(T& Expected, T Value) { return Element.compare_exchange_strong(Expected, Value); }
+
+	operator T() const { return Load(); }
+	T operator=(T Value) { Store(Value); return Value; }
+
+	T operator++() { return ++Element; }
+	T operator--() { return --Element; }
+	T operator++(int) { return Element++; }
+	T operator--(int) { return Element--; }
+	T operator+=(T Value) { return Element += Value; }
+	T operator-=(T Value) { return Element -= Value; }
+
+private:
+	static std::memory_order ToStd(EMemoryOrder Order) { return Order == EMemoryOrder::Relaxed ? std::memory_order_relaxed : std::memory_order_seq_cst; }
+
+	std::atomic<T> Element;
+};
+
+// A lock many readers can hold at once, or a single writer. Like the engine's, it can't be taken again by the thread that holds it.
+class FRWLock
+{
+public:
+	FORCEINLINE void ReadLock() { Mutex.lock_shared(); }
+	FORCEINLINE void ReadUnlock() { Mutex.unlock_shared(); }
+	FORCEINLINE void WriteLock() { Mutex.lock(); }
+	FORCEINLINE void WriteUnlock() { Mutex.unlock(); }
+
+private:
+	std::shared_mutex Mutex;
+};
+
+struct FPlatformTime
+{
+	static FORCEINLINE double Seconds()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static FORCEINLINE uint64 Cycles64()
+	{
+		return (uint64)std::chrono::steady_clock::now().time_since_epoch().count();
+	}
+};
+
+struct FPlatformMisc
+{
+	static int32 NumberOfCoresIncludingHyperthreads() { return FMath::Max(1, (int32)std::thread::hardware_concurrency()); }
+};
+
+// The same generator as the engine's, so seeded shuffles come out the same as they do in the editor
+struct FRandomStream
+{
+	FRandomStream() : InitialSeed(0), Seed(0) {}
+	FRandomStream(int32 InSeed) { Initialize(InSeed); }
+
+	void Initialize(int32 InSeed)
+	{
+		InitialSeed = InSeed;
+		Seed = (uint32)InSeed;
+	}
+
+	void Reset() const { Seed = (uint32)InitialSeed; }
+
+	float GetFraction() const
+	{
+		MutateSeed();
+
+		const float SRandTemp = 1.0f;
+		uint32 TempBits;
+		std::memcpy(&TempBits, &SRandTemp, sizeof(TempBits));
+
+		const uint32 ResultBits = (TempBits & 0xff800000) | (Seed & 0x007fffff);
+		float Result;
+		std::memcpy(&Result, &ResultBits, sizeof(Result));
+
+		return FMath::Fractional(Result);
+	}
+
+	float FRand() const { return GetFraction(); }
+	int32 RandHelper(int32 A) const { return A > 0 ? FMath::TruncToInt(GetFraction() * (float)A) : 0; }
+	int32 RandRange(int32 Min, int32 Max) const { return Min + RandHelper(Max - Min + 1); }
+	float FRandRange(float InMin, float InMax) const { return InMin + (InMax - InMin) * FRand(); }
+
+private:
+	void MutateSeed() const { Seed = (Seed * 196314165) + 907633515; }
+
+	int32 InitialSeed;
+	mutable uint32 Seed;
+};
+
+// Only what the chunk store's header needs
+class FString
+{
+public:
+	FString() {}
+	FString(const TCHAR* InString) : String(InString) {}
+
+	const TCHAR* operator*() const { return String.c_str(); }
+	int32 Len() const { return (int32)String.size(); }
+	bool IsEmpty() const { return String.empty(); }
+
+	bool operator==(const TCHAR* Other) const { return String == Other; }
+
+	// Splits the string wherever Delimiter appears, leaving out empty parts. Returns the number of parts.
+	int32 ParseIntoArray(TArray<FString>& OutArray, const TCHAR* Delimiter) const
+	{
+		OutArray.Reset();
+
+		size_t Start = 0;
+		while (Start <= String.size())
+		{
+			size_t End = String.find(Delimiter, Start);
+			if (End == std::string::npos)
+				End = String.size();
+
+			if (End > Start)
+				OutArray.Add(FString(String.substr(Start, End - Start).c_str()));
+
+			Start = End + std::strlen(Delimiter);
+		}
+
+		return OutArray.Num();
+	}
+
+	FString operator+(const FString& Other) const { FString Result; Result.String = String + Other.String; return Result; }
+	FString operator+(const TCHAR* Other) const { FString Result; Result.String = String + Other; return Result; }
+
+	static FString Printf(const TCHAR* Format, ...)
+	{
+		va_list Args;
+		va_start(Args, Format);
+		va_list SizeArgs;
+		va_copy(SizeArgs, Args);
+		const int32 Size = std::vsnprintf(nullptr, 0, Format, SizeArgs);
+		va_end(SizeArgs);
+
+		FString Result;
+		Result.String.resize(Size > 0 ? Size : 0);
+		std::vsnprintf(&Result.String[0], Result.String.size() + 1, Format, Args);
+		va_end(Args);
+		return Result;
+	}
+
+private:
+	std::string String;
+};
+
+struct FCString
+{
+	static int32 Atoi(const TCHAR* String) { return std::atoi(String); }
+};
+
+inline FString FIntVector::ToString() const
+{
+	return FString::Printf(TEXT("X=%d Y=%d Z=%d"), X, Y, Z);
+}
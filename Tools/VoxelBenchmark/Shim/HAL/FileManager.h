@@ -0,0 +1,31 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#pragma once
+
+// Stands in for the engine header of the same name, with the directory listing the region store uses, implemented on std::filesystem
+
+#include "CoreMinimal.h"
+#include <filesystem>
+
+class IFileManager
+{
+public:
+	static IFileManager& Get()
+	{
+		static IFileManager FileManager;
+		return FileManager;
+	}
+
+	// Adds the names, without the directory, of the files in Directory that end in the given extension
+	void FindFiles(TArray<FString>& FoundFiles, const TCHAR* Directory, const TCHAR* FileExtension)
+	{
+		const std::string Extension = std::string(".") + FileExtension;
+
+		std::error_code Error;
+		for (std::filesystem::directory_iterator It(Directory, Error), End; !Error && It != End; It.increment(Error))
+		{
+			if (It->is_regular_file(Error) && It->path().extension() == Extension)
+				FoundFiles.Add(FString(It->path().filename().string().c_str()));
+		}
+	}
+};
@@ -0,0 +1,59 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#pragma once
+
+// Stands in for the engine header of the same name, with the few platform file functions the region store calls,
+// implemented on std::filesystem.
+
+#include "CoreMinimal.h"
+#include <filesystem>
+
+class IMappedFileHandle;
+
+class IPlatformFile
+{
+public:
+	bool FileExists(const TCHAR* Filename)
+	{
+		std::error_code Error;
+		return std::filesystem::is_regular_file(Filename, Error);
+	}
+
+	bool DeleteFile(const TCHAR* Filename)
+	{
+		std::error_code Error;
+		return std::filesystem::remove(Filename, Error);
+	}
+
+	bool MoveFile(const TCHAR* To, const TCHAR* From)
+	{
+		std::error_code Error;
+		std::filesystem::rename(From, To, Error);
+		return !Error;
+	}
+
+	bool CreateDirectoryTree(const TCHAR* Directory)
+	{
+		std::error_code Error;
+		std::filesystem::create_directories(Directory, Error);
+		return std::filesystem::is_directory(Directory, Error);
+	}
+
+	// Files are never mapped, like on a platform that can't
+	IMappedFileHandle* OpenMapped(const TCHAR* Filename) { return nullptr; }
+};
+
+class FPlatformFileManager
+{
+public:
+	static FPlatformFileManager& Get()
+	{
+		static FPlatformFileManager Manager;
+		return Manager;
+	}
+
+	IPlatformFile& GetPlatformFile() { return PlatformFile; }
+
+private:
+	IPlatformFile PlatformFile;
+};
@@ -0,0 +1,7 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#pragma once
+
+// Stands in for the engine header of the same name. What it declares is in the shim's CoreMinimal.h.
+
+#include "CoreMinimal.h"
@@ -0,0 +1,28 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#pragma once
+
+// Stands in for the engine header of the same name, with the whole file reads and writes the region store uses
+
+#include "CoreMinimal.h"
+#include <fstream>
+
+struct FFileHelper
+{
+	static bool LoadFileToArray(TArray<uint8>& Result, const TCHAR* Filename)
+	{
+		std::ifstream File(Filename, std::ios::binary | std::ios::ate);
+		if (!File)
+			return false;
+
+		Result.SetNumUninitialized(int32(File.tellg()));
+		File.seekg(0);
+		return bool(File.read(reinterpret_cast<char*>(Result.GetData()), Result.Num()));
+	}
+
+	static bool SaveArrayToFile(const TArray<uint8>& Array, const TCHAR* Filename)
+	{
+		std::ofstream File(Filename, std::ios::binary | std::ios::trunc);
+		return File && File.write(reinterpret_cast<const char*>(Array.GetData()), Array.Num()) && File.flush();
+	}
+};
@@ -0,0 +1,18 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#pragma once
+
+// Stands in for the engine header of the same name
+
+#include "CoreMinimal.h"
+
+struct FPaths
+{
+	template<typename... PathTypes>
+	static FString Combine(const FString& First, const PathTypes&... Rest)
+	{
+		FString Result = First;
+		((Result = Result + TEXT("/") + FString(Rest)), ...);
+		return Result;
+	}
+};
@@ -0,0 +1,32 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#pragma once
+
+// Stands in for the procedural mesh component's header when the terrain code is built outside of Unreal.
+// The mesh builders only need the tangent type.
+
+#include "CoreMinimal.h"
+
+struct FProcMeshTangent
+{
+	// Direction of X tangent for this vertex
+	FVector TangentX;
+
+	// Bool that indicates whether we should flip the Y tangent when we compute it using cross product
+	bool bFlipTangentY;
+
+	FProcMeshTangent()
+		: TangentX(1.f, 0.f, 0.f)
+		, bFlipTangentY(false)
+	{}
+
+	FProcMeshTangent(float X, float Y, float Z)
+		: TangentX(X, Y, Z)
+		, bFlipTangentY(false)
+	{}
+
+	FProcMeshTangent(FVector InTangentX, bool bInFlipTangentY)
+		: TangentX(InTangentX)
+		, bFlipTangentY(bInFlipTangentY)
+	{}
+};
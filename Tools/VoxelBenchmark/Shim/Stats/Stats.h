@@ -0,0 +1,26 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#pragma once
+
+// Stands in for the engine's stats header when the terrain code is built outside of Unreal.
+// The benchmark does its own timing, so every stat compiles away to nothing.
+
+#include "CoreMinimal.h"
+
+#define STATS 0
+
+#define DECLARE_STATS_GROUP(GroupDesc, GroupId, GroupCat)
+#define DECLARE_CYCLE_STAT_EXTERN(CounterName, StatId, GroupId, API)
+#define DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(CounterName, StatId, GroupId, API)
+#define DECLARE_DWORD_COUNTER_STAT_EXTERN(CounterName, StatId, GroupId, API)
+#define DECLARE_MEMORY_STAT_EXTERN(CounterName, StatId, GroupId, API)
+#define DEFINE_STAT(Stat)
+
+#define SCOPE_CYCLE_COUNTER(Stat)
+#define SCOPED_NAMED_EVENT(Name, Color)
+
+#define INC_DWORD_STAT(StatId)
+#define INC_DWORD_STAT_BY(StatId, Amount)
+#define DEC_DWORD_STAT_BY(StatId, Amount)
+#define INC_MEMORY_STAT_BY(StatId, Amount)
+#define DEC_MEMORY_STAT_BY(StatId, Amount)
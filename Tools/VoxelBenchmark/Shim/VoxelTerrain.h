@@ -0,0 +1,9 @@
+// Copyright (c) 2016 Brandon Garvin
+
+#pragma once
+
+// Stands in for the module header when the terrain code is built outside of Unreal
+
+#include "CoreMinimal.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogVoxelTerrain, Log, All);
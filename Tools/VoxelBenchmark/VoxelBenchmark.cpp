@@ -0,0 +1,632 @@
+// Copyright (c) 2016 Brandon Garvin
+
+// Measures the terrain's hot paths without the engine: noise generation, pageIn, surface extraction and mesh building.
+// It runs every combination of the seeds, octaves, chunk sizes and thread counts it is given and writes the results as JSON,
+// so they can be compared between builds.
+//
+// Usage: VoxelBenchmark [--seeds 123,456] [--octaves 3,6] [--chunk-sizes 16,32,64] [--threads 1,4] [--size Voxels] [--batched-noise] [--single-section] [--spherical] [--json Path]
+//
+// Each run builds a fresh pager and volume, then meshes a block of flat terrain Size voxels across, tall enough to hold the surface.
+// With --spherical the block is a cube Size voxels across around a planet that fills half of it instead.
+// The block is always split into whole 64 voxel chunks' worth of voxels, so every chunk size meshes exactly the same voxels.
+
+#include "VoxelTerrainPager.h"
+#include "VoxelTerrain.h"
+#include "VoxelChunkMeshBuilder.h"
+#include "VoxelGreedyMesher.h"
+
+// PolyVox
+#include "PolyVox/CubicSurfaceExtractor.h"
+#include "PolyVox/MarchingCubesSurfaceExtractor.h"
+#include "PolyVox/RawVolume.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace PolyVox;
+
+// Counts the voxels paged in and the time spent doing it
+class FBenchmarkPager : public VoxelTerrainPager
+{
+public:
+	using VoxelTerrainPager::VoxelTerrainPager;
+
+	virtual void pageIn(const PolyVox::Region& region, FVoxelPaletteVolume::Chunk* pChunk) override
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		VoxelTerrainPager::pageIn(region, pChunk);
+		PageInSeconds += FPlatformTime::Seconds() - StartTime;
+
+		PageInCalls++;
+		PageInVoxels += int64(region.getWidthInVoxels()) * region.getHeightInVoxels() * region.getDepthInVoxels();
+	}
+
+	// The chunks are only paged in from one thread, so these don't need to be atomic
+	int64 PageInCalls = 0;
+	int64 PageInVoxels = 0;
+	double PageInSeconds = 0;
+};
+
+// The settings for a single run
+struct FBenchmarkConfig
+{
+	uint32 Seed = 123;
+	uint32 Octaves = 3;
+	int32 ChunkSize = 32;
+	int32 NumThreads = 1;
+};
+
+// The time and output of one surface extractor
+struct FExtractorResult
+{
+	double Seconds = 0;
+	int64 NumTriangles = 0;
+
+	// The vertices and memory of the component buffers built from the meshes, for the extractors that go through the mesh build
+	int64 MeshVertices = 0;
+	int64 MeshBytes = 0;
+};
+
+// Everything measured in a single run
+struct FBenchmarkResult
+{
+	FBenchmarkConfig Config;
+
+	int32 NumChunks = 0;
+	int64 NumVoxels = 0;
+
+	// Staging the noise for every chunk, spread over the threads
+	double GenerationSeconds = 0;
+
+	// Paging the staged chunks into the volume, on one thread
+	int64 PageInCalls = 0;
+	int64 PageInVoxels = 0;
+	double PageInSeconds = 0;
+
+	FExtractorResult Cubic;
+	FExtractorResult Greedy;
+	FExtractorResult MarchingCubes;
+
+	// The greedy mesher merging across materials, the way chunk collision is built
+	FExtractorResult GreedyCollision;
+
+	// Building the component buffers from the cubic and marching cubes meshes, spread over the threads
+	double MeshBuildSeconds = 0;
+	int64 MeshBuildTriangles = 0;
+	int64 MeshBytes = 0;
+
+	// The sections with any triangles in them, over every chunk and both extractors. Each one is a draw call in the engine.
+	int64 MeshSections = 0;
+
+	// What the paged in chunks take up in the palette volume, what they would take up at two bytes a voxel, and how many of them are uniform
+	int64 VolumeBytes = 0;
+	int64 VolumeUncompressedBytes = 0;
+	int32 VolumeChunks = 0;
+	int32 VolumeUniformChunks = 0;
+
+	// The most memory the process had resident during the run
+	int64 PeakMemoryBytes = 0;
+};
+
+// The settings that stay the same for every run
+struct FBenchmarkOptions
+{
+	TArray<uint32> Seeds;
+	TArray<uint32> Octaves;
+	TArray<int32> ChunkSizes;
+	TArray<int32> ThreadCounts;
+
+	// The width of the block of terrain, in voxels
+	int32 BlockSize = 256;
+
+	bool bBatchedNoise = false;
+
+	// Build every chunk mesh as one section, with the materials in the vertex colors
+	bool bSingleSection = false;
+
+	// Mesh a spherical planet instead of flat terrain
+	bool bSpherical = false;
+
+	// Where to write the JSON. Empty means stdout.
+	std::string JsonPath;
+};
+
+// The flat terrain's surface is between z = 0 and z = TerrainHeight with the default settings, so this block of chunks holds all of it
+static const int32 BlockLowerZ = -64;
+static const int32 BlockHeight = 192;
+
+// Returns the first voxel of the block and its size along each axis
+static void GetBlockBounds(const FBenchmarkOptions& Options, FIntVector& OutLower, FIntVector& OutSize)
+{
+	if (Options.bSpherical)
+	{
+		// The planet is centred on the origin
+		OutLower = FIntVector(-Options.BlockSize / 2);
+		OutSize = FIntVector(Options.BlockSize);
+	}
+	else
+	{
+		OutLower = FIntVector(0, 0, BlockLowerZ);
+		OutSize = FIntVector(Options.BlockSize, Options.BlockSize, BlockHeight);
+	}
+}
+
+// How much memory the volume can use for voxels, which is enough for the largest block
+static const uint32 VolumeMemoryBytes = 512 * 1024 * 1024;
+
+// Resets the peak resident memory the kernel reports, so each run only sees its own peak
+static void ResetPeakMemory()
+{
+	std::ofstream ClearRefs("/proc/self/clear_refs");
+	if (ClearRefs)
+		ClearRefs << "5";
+}
+
+// Returns the peak resident memory of the process, or zero if the kernel doesn't say
+static int64 GetPeakMemoryBytes()
+{
+	std::ifstream Status("/proc/self/status");
+	std::string Line;
+
+	while (std::getline(Status, Line))
+	{
+		if (Line.compare(0, 6, "VmHWM:") == 0)
+			return int64(std::stoll(Line.substr(6))) * 1024;
+	}
+
+	return 0;
+}
+
+// Runs Work(Index) for every index below Count, spread over NumThreads threads
+template<typename WorkType>
+static void ParallelFor(int32 Count, int32 NumThreads, const WorkType& Work)
+{
+	std::atomic<int32> NextIndex(0);
+
+	auto Worker = [&]()
+	{
+		for (int32 Index = NextIndex++; Index < Count; Index = NextIndex++)
+			Work(Index);
+	};
+
+	TArray<std::thread> Threads;
+	for (int32 i = 1; i < NumThreads; i++)
+		Threads.Emplace(Worker);
+
+	Worker();
+
+	for (std::thread& Thread : Threads)
+		Thread.join();
+}
+
+// Returns the voxels marching cubes reads to extract a chunk: its cells run up to the first voxel of the next chunk, with one more voxel around them for the normals
+template<typename ChunkTraits>
+static PolyVox::Region GetSmoothSnapshotRegion(const PolyVox::Region& Region)
+{
+	const int32 Below = ChunkTraits::SmoothApronBelow;
+	const int32 Above = ChunkTraits::SmoothApronAbove;
+	return PolyVox::Region(Region.getLowerCorner() - Vector3DInt32(Below, Below, Below), Region.getUpperCorner() + Vector3DInt32(Above, Above, Above));
+}
+
+template<typename ChunkTraits>
+static FBenchmarkResult RunBenchmark(const FBenchmarkConfig& Config, const FBenchmarkOptions& Options)
+{
+	FBenchmarkResult Result;
+	Result.Config = Config;
+
+	ResetPeakMemory();
+
+	// The default terrain settings of the actor, apart from the ones being measured.
+	// The planet's diameter is TerrainHeight, so it is made half as wide as the block, which leaves room for the noise to move its surface.
+	const float TerrainHeight = Options.bSpherical ? Options.BlockSize / 2.f : 64.f;
+	TSharedPtr<FBenchmarkPager, ESPMode::ThreadSafe> Pager = MakeShareable(new FBenchmarkPager(Options.bSpherical, Config.Seed, Config.Octaves, 0.01f, 32.f, 0.f, TerrainHeight, Options.bBatchedNoise));
+	TSharedPtr<FVoxelPaletteVolume, ESPMode::ThreadSafe> Volume = MakeShareable(new FVoxelPaletteVolume(Pager.Get(), VolumeMemoryBytes, VoxelTerrainPager::VolumeChunkSideLength));
+	Pager->SetMaxResidentChunks(int32(VolumeMemoryBytes / (VoxelTerrainPager::FVolumeChunkTraits::NumVoxels / 8)));
+
+	FIntVector BlockLower, BlockSize;
+	GetBlockBounds(Options, BlockLower, BlockSize);
+
+	const int32 ChunksPerAxis = BlockSize.X / ChunkTraits::Size;
+	const int32 ChunksHigh = BlockSize.Z / ChunkTraits::Size;
+	const FIntVector FirstChunk = ChunkTraits::VoxelToChunk(BlockLower);
+
+	TArray<PolyVox::Region> Regions;
+	for (int32 X = FirstChunk.X; X < FirstChunk.X + ChunksPerAxis; X++)
+	{
+		for (int32 Y = FirstChunk.Y; Y < FirstChunk.Y + ChunksPerAxis; Y++)
+		{
+			for (int32 Z = FirstChunk.Z; Z < FirstChunk.Z + ChunksHigh; Z++)
+			{
+				const FIntVector Lower = ChunkTraits::ChunkToVoxel(FIntVector(X, Y, Z));
+				const FIntVector Upper = Lower + FIntVector(ChunkTraits::Size - 1);
+				Regions.Emplace(Vector3DInt32(Lower.X, Lower.Y, Lower.Z), Vector3DInt32(Upper.X, Upper.Y, Upper.Z));
+			}
+		}
+	}
+
+	Result.NumChunks = Regions.Num();
+	Result.NumVoxels = int64(BlockSize.X) * BlockSize.Y * BlockSize.Z;
+
+	// Stage and page in one slice of chunks along X at a time, so the staged chunks never outgrow the pager's staging capacity
+	const int32 ChunksPerSlice = ChunksPerAxis * ChunksHigh;
+	for (int32 Slice = 0; Slice < ChunksPerAxis; Slice++)
+	{
+		const int32 FirstRegion = Slice * ChunksPerSlice;
+
+		double StartTime = FPlatformTime::Seconds();
+		ParallelFor(ChunksPerSlice, Config.NumThreads, [&](int32 Index)
+		{
+			Pager->StageRegion(Regions[FirstRegion + Index]);
+		});
+		Result.GenerationSeconds += FPlatformTime::Seconds() - StartTime;
+
+		// Marching cubes reads the furthest out of the extractors, so this pages in everything any of them reads
+		for (int32 Index = 0; Index < ChunksPerSlice; Index++)
+		{
+			const PolyVox::Region& Region = Regions[FirstRegion + Index];
+			Volume->prefetch(GetSmoothSnapshotRegion<ChunkTraits>(Region));
+		}
+	}
+
+	Result.PageInCalls = Pager->PageInCalls;
+	Result.PageInVoxels = Pager->PageInVoxels;
+	Result.PageInSeconds = Pager->PageInSeconds;
+
+	Result.VolumeBytes = Volume->calculateSizeInBytes();
+	Result.VolumeUncompressedBytes = Volume->GetUncompressedSizeInBytes();
+	Result.VolumeChunks = Volume->GetNumChunks();
+	Result.VolumeUniformChunks = Volume->GetNumUniformChunks();
+
+	// Extraction runs on one thread, so the times can be compared with earlier builds. VoxelVolumeStress measures the volume under contention.
+	// The meshes are kept so building them can be timed on its own, and so are the snapshots marching cubes takes its normals from.
+	TArray<Mesh<CubicVertex<MaterialDensityPair88>>> CubicMeshes;
+	TArray<Mesh<MarchingCubesVertex<MaterialDensityPair88>>> MarchingCubesMeshes;
+	TArray<TArray<MaterialDensityPair88>> MarchingCubesSnapshots;
+	CubicMeshes.SetNum(Regions.Num());
+	MarchingCubesMeshes.SetNum(Regions.Num());
+	MarchingCubesSnapshots.SetNum(Regions.Num());
+
+	double StartTime = FPlatformTime::Seconds();
+	for (int32 Index = 0; Index < Regions.Num(); Index++)
+	{
+		CubicMeshes[Index] = extractCubicMesh(Volume.Get(), Regions[Index]);
+		Result.Cubic.NumTriangles += CubicMeshes[Index].getNoOfIndices() / 3;
+	}
+	Result.Cubic.Seconds = FPlatformTime::Seconds() - StartTime;
+
+	FVoxelGreedyMesher GreedyMesher;
+	StartTime = FPlatformTime::Seconds();
+	for (const PolyVox::Region& Region : Regions)
+	{
+		GreedyMesher.GatherVoxels(Volume.Get(), Region);
+		Result.Greedy.NumTriangles += GreedyMesher.ExtractMesh().getNoOfIndices() / 3;
+	}
+	Result.Greedy.Seconds = FPlatformTime::Seconds() - StartTime;
+
+	StartTime = FPlatformTime::Seconds();
+	for (const PolyVox::Region& Region : Regions)
+	{
+		GreedyMesher.GatherVoxels(Volume.Get(), Region);
+		Result.GreedyCollision.NumTriangles += GreedyMesher.ExtractMesh(true).getNoOfIndices() / 3;
+	}
+	Result.GreedyCollision.Seconds = FPlatformTime::Seconds() - StartTime;
+
+	// The same snapshot and cells the terrain's smooth chunks use, so the chunks meet without any seams
+	StartTime = FPlatformTime::Seconds();
+	for (int32 Index = 0; Index < Regions.Num(); Index++)
+	{
+		const PolyVox::Region& Region = Regions[Index];
+		const PolyVox::Region SnapshotRegion = GetSmoothSnapshotRegion<ChunkTraits>(Region);
+
+		TArray<MaterialDensityPair88>& Snapshot = MarchingCubesSnapshots[Index];
+		Snapshot.SetNumUninitialized(SnapshotRegion.getWidthInVoxels() * SnapshotRegion.getHeightInVoxels() * SnapshotRegion.getDepthInVoxels());
+		Volume->ReadRegion(SnapshotRegion, Snapshot.GetData());
+
+		RawVolume<MaterialDensityPair88> SnapshotVolume(SnapshotRegion);
+		int32 VoxelIndex = 0;
+		for (int32 z = SnapshotRegion.getLowerZ(); z <= SnapshotRegion.getUpperZ(); z++)
+			for (int32 y = SnapshotRegion.getLowerY(); y <= SnapshotRegion.getUpperY(); y++)
+				for (int32 x = SnapshotRegion.getLowerX(); x <= SnapshotRegion.getUpperX(); x++)
+					SnapshotVolume.setVoxel(x, y, z, Snapshot[VoxelIndex++]);
+
+		MarchingCubesMeshes[Index] = extractMarchingCubesMesh(&SnapshotVolume, PolyVox::Region(Region.getLowerCorner(), Region.getUpperCorner() + Vector3DInt32(1, 1, 1)));
+		Result.MarchingCubes.NumTriangles += MarchingCubesMeshes[Index].getNoOfIndices() / 3;
+	}
+	Result.MarchingCubes.Seconds = FPlatformTime::Seconds() - StartTime;
+
+	// Every thread gets its own builder and mesh data, like the workspaces in the actor
+	const int32 NumMaterials = 4;
+	TArray<TUniquePtr<FVoxelChunkMeshBuilder>> Builders;
+	TArray<TUniquePtr<FVoxelChunkMeshData>> MeshData;
+	for (int32 i = 0; i < Config.NumThreads; i++)
+	{
+		Builders.Add(MakeUnique<FVoxelChunkMeshBuilder>());
+		MeshData.Add(MakeUnique<FVoxelChunkMeshData>());
+	}
+
+	std::atomic<int32> NextThreadIndex(0);
+	std::atomic<int64> MeshBuildTriangles(0);
+	std::atomic<int64> MeshSections(0);
+	std::atomic<int64> CubicVertices(0);
+	std::atomic<int64> CubicBytes(0);
+	std::atomic<int64> MarchingCubesVertices(0);
+	std::atomic<int64> MarchingCubesBytes(0);
+
+	StartTime = FPlatformTime::Seconds();
+	ParallelFor(Config.NumThreads, Config.NumThreads, [&](int32)
+	{
+		const int32 ThreadIndex = NextThreadIndex++;
+		FVoxelChunkMeshBuilder& Builder = *Builders[ThreadIndex];
+		FVoxelChunkMeshData& ChunkMeshData = *MeshData[ThreadIndex];
+
+		// Each thread takes every NumThreads-th chunk
+		for (int32 Index = ThreadIndex; Index < Regions.Num(); Index += Config.NumThreads)
+		{
+			const FVector OffsetLocation(float(Regions[Index].getLowerX()), float(Regions[Index].getLowerY()), float(Regions[Index].getLowerZ()));
+
+			ChunkMeshData.Reset(NumMaterials, Options.bSingleSection);
+			if (CubicMeshes[Index].getNoOfIndices() > 0)
+				Builder.BuildCubicMesh(CubicMeshes[Index], OffsetLocation, ChunkMeshData);
+			MeshBuildTriangles += ChunkMeshData.GetNumTriangles();
+			MeshSections += ChunkMeshData.GetNumSections();
+			CubicVertices += ChunkMeshData.GetNumVertices();
+			CubicBytes += ChunkMeshData.GetMeshBytes();
+
+			// The snapshot starts one voxel before the chunk, like the mesh's positions do in the terrain
+			const FVoxelDensityField DensityField(MarchingCubesSnapshots[Index].GetData(), FIntVector(-ChunkTraits::SmoothApronBelow), FIntVector(ChunkTraits::Size + ChunkTraits::SmoothApronBelow + ChunkTraits::SmoothApronAbove));
+
+			ChunkMeshData.Reset(NumMaterials, Options.bSingleSection);
+			if (MarchingCubesMeshes[Index].getNoOfIndices() > 0)
+				Builder.BuildMarchingCubesMesh(MarchingCubesMeshes[Index], OffsetLocation, ChunkMeshData, 1.f, &DensityField);
+			MeshBuildTriangles += ChunkMeshData.GetNumTriangles();
+			MeshSections += ChunkMeshData.GetNumSections();
+			MarchingCubesVertices += ChunkMeshData.GetNumVertices();
+			MarchingCubesBytes += ChunkMeshData.GetMeshBytes();
+		}
+	});
+	Result.MeshBuildSeconds = FPlatformTime::Seconds() - StartTime;
+	Result.MeshBuildTriangles = MeshBuildTriangles;
+	Result.MeshBytes = CubicBytes + MarchingCubesBytes;
+	Result.MeshSections = MeshSections;
+	Result.Cubic.MeshVertices = CubicVertices;
+	Result.Cubic.MeshBytes = CubicBytes;
+	Result.MarchingCubes.MeshVertices = MarchingCubesVertices;
+	Result.MarchingCubes.MeshBytes = MarchingCubesBytes;
+
+	Result.PeakMemoryBytes = GetPeakMemoryBytes();
+
+	// The volume pages chunks out when it is destroyed, so it has to go before the pager
+	Volume.Reset();
+	Pager.Reset();
+
+	return Result;
+}
+
+static double PerSecond(double Count, double Seconds)
+{
+	return Seconds > 0 ? Count / Seconds : 0;
+}
+
+static void WriteExtractorJson(std::ostream& Out, const char* Name, const FExtractorResult& Result, bool bLast)
+{
+	Out << "        \"" << Name << "\": { \"seconds\": " << Result.Seconds << ", \"triangles\": " << Result.NumTriangles
+		<< ", \"triangles_per_second\": " << PerSecond(double(Result.NumTriangles), Result.Seconds);
+
+	if (Result.MeshVertices > 0)
+		Out << ", \"mesh_vertices\": " << Result.MeshVertices << ", \"mesh_bytes\": " << Result.MeshBytes;
+
+	Out << " }" << (bLast ? "\n" : ",\n");
+}
+
+static void WriteJson(std::ostream& Out, const FBenchmarkOptions& Options, const TArray<FBenchmarkResult>& Results)
+{
+	Out.precision(9);
+
+	Out << "{\n";
+	FIntVector BlockLower, BlockSize;
+	GetBlockBounds(Options, BlockLower, BlockSize);
+
+	Out << "  \"block_size\": " << BlockSize.X << ",\n";
+	Out << "  \"block_height\": " << BlockSize.Z << ",\n";
+	Out << "  \"spherical\": " << (Options.bSpherical ? "true" : "false") << ",\n";
+	Out << "  \"batched_noise\": " << (Options.bBatchedNoise ? "true" : "false") << ",\n";
+	Out << "  \"single_section\": " << (Options.bSingleSection ? "true" : "false") << ",\n";
+	Out << "  \"results\": [\n";
+
+	for (int32 i = 0; i < Results.Num(); i++)
+	{
+		const FBenchmarkResult& Result = Results[i];
+
+		Out << "    {\n";
+		Out << "      \"seed\": " << Result.Config.Seed << ",\n";
+		Out << "      \"octaves\": " << Result.Config.Octaves << ",\n";
+		Out << "      \"chunk_size\": " << Result.Config.ChunkSize << ",\n";
+		Out << "      \"threads\": " << Result.Config.NumThreads << ",\n";
+		Out << "      \"chunks\": " << Result.NumChunks << ",\n";
+		Out << "      \"voxels\": " << Result.NumVoxels << ",\n";
+		Out << "      \"generation\": { \"seconds\": " << Result.GenerationSeconds << ", \"voxels_per_second\": " << PerSecond(double(Result.NumVoxels), Result.GenerationSeconds) << " },\n";
+		Out << "      \"page_in\": { \"calls\": " << Result.PageInCalls << ", \"voxels\": " << Result.PageInVoxels << ", \"seconds\": " << Result.PageInSeconds
+			<< ", \"voxels_per_second\": " << PerSecond(double(Result.PageInVoxels), Result.PageInSeconds) << " },\n";
+		Out << "      \"volume\": { \"chunks\": " << Result.VolumeChunks << ", \"uniform_chunks\": " << Result.VolumeUniformChunks << ", \"bytes\": " << Result.VolumeBytes
+			<< ", \"uncompressed_bytes\": " << Result.VolumeUncompressedBytes << ", \"compression_ratio\": " << double(Result.VolumeUncompressedBytes) / FMath::Max<int64>(Result.VolumeBytes, 1) << " },\n";
+		Out << "      \"extraction\": {\n";
+		WriteExtractorJson(Out, "cubic", Result.Cubic, false);
+		WriteExtractorJson(Out, "greedy", Result.Greedy, false);
+		WriteExtractorJson(Out, "greedy_collision", Result.GreedyCollision, false);
+		WriteExtractorJson(Out, "marching_cubes", Result.MarchingCubes, true);
+		Out << "      },\n";
+		Out << "      \"mesh_build\": { \"seconds\": " << Result.MeshBuildSeconds << ", \"triangles\": " << Result.MeshBuildTriangles
+			<< ", \"triangles_per_second\": " << PerSecond(double(Result.MeshBuildTriangles), Result.MeshBuildSeconds) << ", \"mesh_bytes\": " << Result.MeshBytes << ", \"sections\": " << Result.MeshSections << " },\n";
+		Out << "      \"peak_memory_bytes\": " << Result.PeakMemoryBytes << "\n";
+		Out << "    }" << (i + 1 < Results.Num() ? ",\n" : "\n");
+	}
+
+	Out << "  ]\n";
+	Out << "}\n";
+}
+
+// Parses a comma separated list of positive numbers. Returns false if any of them isn't one.
+template<typename NumberType>
+static bool ParseList(const char* Text, TArray<NumberType>& OutValues)
+{
+	OutValues.Reset();
+
+	std::stringstream Stream(Text);
+	std::string Item;
+
+	while (std::getline(Stream, Item, ','))
+	{
+		char* End = nullptr;
+		const long long Value = std::strtoll(Item.c_str(), &End, 10);
+
+		if (Item.empty() || *End != '\0' || Value <= 0)
+			return false;
+
+		OutValues.Add(NumberType(Value));
+	}
+
+	return OutValues.Num() > 0;
+}
+
+static void PrintUsage()
+{
+	std::cerr << "Usage: VoxelBenchmark [--seeds 123,456] [--octaves 3,6] [--chunk-sizes 16,32,64] [--threads 1,4] [--size Voxels] [--batched-noise] [--single-section] [--spherical] [--json Path]\n";
+}
+
+int main(int argc, char** argv)
+{
+	FBenchmarkOptions Options;
+	Options.Seeds.Add(123);
+	Options.Octaves.Add(3);
+	Options.ChunkSizes.Add(16);
+	Options.ChunkSizes.Add(32);
+	Options.ChunkSizes.Add(64);
+	Options.ThreadCounts.Add(1);
+	if (FPlatformMisc::NumberOfCoresIncludingHyperthreads() > 1)
+		Options.ThreadCounts.Add(FPlatformMisc::NumberOfCoresIncludingHyperthreads());
+
+	for (int32 i = 1; i < argc; i++)
+	{
+		const std::string Arg = argv[i];
+		const char* Value = i + 1 < argc ? argv[i + 1] : nullptr;
+		bool bValid = true;
+
+		if (Arg == "--batched-noise")
+		{
+			Options.bBatchedNoise = true;
+			continue;
+		}
+
+		if (Arg == "--single-section")
+		{
+			Options.bSingleSection = true;
+			continue;
+		}
+
+		if (Arg == "--spherical")
+		{
+			Options.bSpherical = true;
+			continue;
+		}
+
+		if (!Value)
+		{
+			bValid = false;
+		}
+		else if (Arg == "--seeds")
+		{
+			bValid = ParseList(Value, Options.Seeds);
+		}
+		else if (Arg == "--octaves")
+		{
+			bValid = ParseList(Value, Options.Octaves);
+		}
+		else if (Arg == "--chunk-sizes")
+		{
+			bValid = ParseList(Value, Options.ChunkSizes);
+			for (int32 ChunkSize : Options.ChunkSizes)
+				bValid = bValid && (ChunkSize == 16 || ChunkSize == 32 || ChunkSize == 64);
+		}
+		else if (Arg == "--threads")
+		{
+			bValid = ParseList(Value, Options.ThreadCounts);
+		}
+		else if (Arg == "--size")
+		{
+			// Whole 64 voxel chunks, and no more than the staging capacity can hold a slice of
+			TArray<int32> Sizes;
+			bValid = ParseList(Value, Sizes) && Sizes.Num() == 1;
+			if (bValid)
+				Options.BlockSize = FMath::Clamp(FMath::DivideAndRoundUp(Sizes[0], 64) * 64, 64, 512);
+		}
+		else if (Arg == "--json")
+		{
+			Options.JsonPath = Value;
+		}
+		else
+		{
+			bValid = false;
+		}
+
+		if (!bValid)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		i++;
+	}
+
+	// A slice of the planet's cube is as tall as it is wide, so a wider block wouldn't fit in the staging capacity
+	if (Options.bSpherical)
+		Options.BlockSize = FMath::Min(Options.BlockSize, 256);
+
+	TArray<FBenchmarkResult> Results;
+
+	for (uint32 Seed : Options.Seeds)
+	{
+		for (uint32 Octaves : Options.Octaves)
+		{
+			for (int32 ChunkSize : Options.ChunkSizes)
+			{
+				for (int32 NumThreads : Options.ThreadCounts)
+				{
+					FBenchmarkConfig Config;
+					Config.Seed = Seed;
+					Config.Octaves = Octaves;
+					Config.ChunkSize = ChunkSize;
+					Config.NumThreads = NumThreads;
+
+					std::cerr << "Seed " << Seed << ", " << Octaves << " octaves, " << ChunkSize << " voxel chunks, " << NumThreads << " threads\n";
+
+					switch (ChunkSize)
+					{
+					case 16: Results.Add(RunBenchmark<FVoxelChunkTraits16>(Config, Options)); break;
+					case 32: Results.Add(RunBenchmark<FVoxelChunkTraits32>(Config, Options)); break;
+					default: Results.Add(RunBenchmark<FVoxelChunkTraits64>(Config, Options)); break;
+					}
+				}
+			}
+		}
+	}
+
+	if (Options.JsonPath.empty())
+	{
+		WriteJson(std::cout, Options, Results);
+	}
+	else
+	{
+		std::ofstream JsonFile(Options.JsonPath);
+		if (!JsonFile)
+		{
+			std::cerr << "Couldn't open " << Options.JsonPath << " for writing\n";
+			return 1;
+		}
+
+		WriteJson(JsonFile, Options, Results);
+	}
+
+	return 0;
+}
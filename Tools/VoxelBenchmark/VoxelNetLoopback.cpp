@@ -0,0 +1,349 @@
+// Copyright (c) 2016 Brandon Garvin
+
+// Runs the terrain's replication over a loopback, without the engine or a real connection, and checks every peer ends up with the same voxels.
+// Each peer keeps its voxels in step through FVoxelNetReplicator, the same as the actor does.
+//
+// Before the game starts, the server plays an earlier game on its own and saves it to a chunk store, so the game starts with chunks that are
+// different from the noise without any edit having touched them. A client that is there from the start and a second client that joins partway
+// through both catch up from a snapshot of chunk diffs, streamed a little each frame while the server carries on making edits and sending them
+// in one batch a frame. At the end the voxels of all three are compared.
+//
+// Usage: VoxelNetLoopback [--frames Frames] [--edits-per-frame Edits] [--join-frame Frame] [--snapshot-bytes-per-frame Bytes] [--saved-edits Edits] [--seed Seed]
+//
+// It reports the bytes each edit took to send, and the size of each snapshot against the raw voxels of the chunks in it. Returns 1 if the
+// peers don't match.
+
+#include "VoxelTerrainNet.h"
+#include "VoxelTerrainPager.h"
+#include "VoxelChunkStore.h"
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+using namespace PolyVox;
+
+// The chunks the edits are versioned and the snapshots are sent in
+typedef FVoxelChunkTraits FNetChunkTraits;
+
+// Everything one machine has of the terrain. The loopback's voxels are the volume's, so there is no offset between them.
+struct FLoopbackPeer
+{
+	// The pager is declared before the volume so it is destroyed after it; the volume pages its edited chunks out when it is destroyed.
+	TUniquePtr<VoxelTerrainPager> Pager;
+	TUniquePtr<FVoxelPaletteVolume> Volume;
+
+	FVoxelNetReplicator Replicator;
+
+	// Chunks are saved to SaveDirectory if it is given, and loaded from there instead of the noise
+	FLoopbackPeer(uint32 Seed, const FString& SaveDirectory = FString())
+	{
+		// The settings the actor replicates. The batched noise is used because it is quick, and the diffs don't care which noise made the baseline.
+		Pager = MakeUnique<VoxelTerrainPager>(false, Seed, 3, 0.01f, 32.f, 0.f, 64.f, true);
+
+		if (!SaveDirectory.IsEmpty())
+			Pager->SetChunkStore(MakeShareable(new FVoxelChunkStore(SaveDirectory, VoxelTerrainPager::VolumeChunkSideLength, Pager->GetSettingsHash())));
+
+		Volume = MakeUnique<FVoxelPaletteVolume>(Pager.Get(), 64 * 1024 * 1024, VoxelTerrainPager::VolumeChunkSideLength);
+		Replicator.SetVolume(Pager.Get(), Volume.Get(), FIntVector::ZeroValue);
+	}
+};
+
+// The server's side of one client's snapshot, like UVoxelTerrainNetComponent
+struct FLoopbackSnapshot
+{
+	// The chunks that haven't been sent yet
+	TArray<FIntVector> ChunksToSend;
+
+	bool bFinished = false;
+	int32 NumChunks = 0;
+	int64 NumBytes = 0;
+	int32 NumFrames = 0;
+
+	explicit FLoopbackSnapshot(const FLoopbackPeer& Server)
+	{
+		Server.Replicator.GetSnapshotChunks(ChunksToSend);
+	}
+
+	// Sends up to about BytesPerFrame of chunks. Returns the data to send this frame.
+	TArray<uint8> Tick(FLoopbackPeer& Server, int32 BytesPerFrame)
+	{
+		TArray<uint8> Data;
+		NumFrames++;
+
+		// Chunks are written at their version when they're sent, which includes any edits made since the snapshot started
+		while (Data.Num() < BytesPerFrame && ChunksToSend.Num() > 0)
+		{
+			Server.Replicator.WriteSnapshotChunk(ChunksToSend.Pop(), Data);
+			NumChunks++;
+		}
+
+		bFinished = ChunksToSend.Num() == 0;
+		NumBytes += Data.Num();
+		return Data;
+	}
+};
+
+// A client, and the snapshot the server is sending it while it catches up
+struct FLoopbackClient
+{
+	FLoopbackPeer Peer;
+	TUniquePtr<FLoopbackSnapshot> Snapshot;
+
+	// What the snapshot took, once it is done
+	int32 SnapshotChunks = 0;
+	int64 SnapshotBytes = 0;
+	int32 FramesToCatchUp = 0;
+
+	explicit FLoopbackClient(uint32 Seed) : Peer(Seed) {}
+
+	// Starts the client's snapshot. Its edits are held back until the whole snapshot is in.
+	void Join(const FLoopbackPeer& Server)
+	{
+		Peer.Replicator.WaitForSnapshot();
+		Snapshot = MakeUnique<FLoopbackSnapshot>(Server);
+	}
+
+	// Sends the client this frame's part of its snapshot. Returns false if any of it was corrupt.
+	bool TickSnapshot(FLoopbackPeer& Server, int32 BytesPerFrame)
+	{
+		if (!Snapshot.IsValid())
+			return true;
+
+		const TArray<uint8> Data = Snapshot->Tick(Server, BytesPerFrame);
+		Peer.Replicator.ReceiveSnapshot(Data.GetData(), Data.Num());
+
+		if (Snapshot->bFinished)
+		{
+			Peer.Replicator.FinishSnapshot();
+
+			SnapshotChunks = Snapshot->NumChunks;
+			SnapshotBytes = Snapshot->NumBytes;
+			FramesToCatchUp = Snapshot->NumFrames;
+			Snapshot.Reset();
+		}
+
+		return Peer.Replicator.ApplySnapshot();
+	}
+};
+
+// Returns the number of voxels that are different between the server and a client, over every chunk the server would send in a snapshot
+// and every chunk the client has had an edit or a snapshot for
+static int64 CountMismatches(const FLoopbackPeer& Server, const FLoopbackPeer& Client)
+{
+	TArray<FIntVector> SnapshotChunks;
+	Server.Replicator.GetSnapshotChunks(SnapshotChunks);
+
+	TSet<FIntVector> Chunks;
+	for (const FIntVector& ChunkCoord : SnapshotChunks)
+		Chunks.Add(ChunkCoord);
+	for (const TPair<FIntVector, uint32>& Pair : Client.Replicator.GetChunkVersions())
+		Chunks.Add(Pair.Key);
+
+	TArray<MaterialDensityPair88> ServerVoxels;
+	TArray<MaterialDensityPair88> ClientVoxels;
+	ServerVoxels.SetNumUninitialized(FNetChunkTraits::NumVoxels);
+	ClientVoxels.SetNumUninitialized(FNetChunkTraits::NumVoxels);
+
+	int64 NumMismatches = 0;
+
+	for (const FIntVector& ChunkCoord : Chunks)
+	{
+		const FIntVector Lower = FNetChunkTraits::ChunkToVoxel(ChunkCoord);
+		const FIntVector Upper = Lower + FIntVector(FNetChunkTraits::Size - 1);
+		const PolyVox::Region Region(Vector3DInt32(Lower.X, Lower.Y, Lower.Z), Vector3DInt32(Upper.X, Upper.Y, Upper.Z));
+
+		Server.Pager->StageRegion(Region);
+		Client.Pager->StageRegion(Region);
+		Server.Volume->ReadRegion(Region, ServerVoxels.GetData());
+		Client.Volume->ReadRegion(Region, ClientVoxels.GetData());
+
+		for (int32 i = 0; i < FNetChunkTraits::NumVoxels; i++)
+		{
+			if (ServerVoxels[i] != ClientVoxels[i])
+				NumMismatches++;
+		}
+	}
+
+	return NumMismatches;
+}
+
+// Makes the next edit of a player wandering around near the surface, mostly digging and building with small spheres
+static FVoxelNetEdit MakeRandomEdit(FRandomStream& Random, FVector& InOutPosition)
+{
+	InOutPosition += FVector(Random.FRandRange(-3.f, 3.f), Random.FRandRange(-3.f, 3.f), Random.FRandRange(-1.5f, 1.5f));
+	InOutPosition.Z = FMath::Clamp(InOutPosition.Z, 16.f, 112.f);
+
+	const uint8 Mode = uint8(Random.RandHelper(100) < 60 ? 0 : Random.RandHelper(100) < 75 ? 1 : 2);
+	const uint8 Material = uint8(Random.RandRange(1, 3));
+
+	if (Random.RandHelper(100) < 80)
+		return FVoxelNetEdit::MakeSphere(InOutPosition, Random.FRandRange(1.5f, 6.f), Mode, Material);
+
+	const FIntVector Lower(FMath::FloorToInt(InOutPosition.X), FMath::FloorToInt(InOutPosition.Y), FMath::FloorToInt(InOutPosition.Z));
+	const FIntVector Size(Random.RandRange(0, 4), Random.RandRange(0, 4), Random.RandRange(0, 4));
+	return FVoxelNetEdit::MakeBox(Lower, Lower + Size, Mode, Material);
+}
+
+static void PrintSnapshot(const char* Name, int32 Frame, const FLoopbackClient& Client)
+{
+	const int64 RawBytes = int64(Client.SnapshotChunks) * FNetChunkTraits::NumVoxels * sizeof(MaterialDensityPair88);
+
+	std::cout << Name << " snapshot at frame " << Frame << ": " << Client.SnapshotChunks << " chunks in " << Client.SnapshotBytes << " bytes over "
+		<< Client.FramesToCatchUp << " frames, " << RawBytes << " bytes raw (" << (Client.SnapshotBytes > 0 ? double(RawBytes) / Client.SnapshotBytes : 0.0) << "x smaller)\n";
+}
+
+static void PrintUsage()
+{
+	std::cerr << "Usage: VoxelNetLoopback [--frames Frames] [--edits-per-frame Edits] [--join-frame Frame] [--snapshot-bytes-per-frame Bytes] [--saved-edits Edits] [--seed Seed]\n";
+}
+
+int main(int argc, char** argv)
+{
+	int32 NumFrames = 600;
+	int32 MaxEditsPerFrame = 4;
+	int32 JoinFrame = 300;
+	int32 NumSavedEdits = 300;
+
+	// 64KB a second at 30 frames a second, the actor's default
+	int32 SnapshotBytesPerFrame = 65536 / 30;
+	int32 Seed = 123;
+
+	for (int32 i = 1; i < argc; i += 2)
+	{
+		const std::string Arg = argv[i];
+		const char* Value = i + 1 < argc ? argv[i + 1] : nullptr;
+		bool bValid = Value != nullptr;
+
+		if (bValid && Arg == "--frames")
+		{
+			NumFrames = std::atoi(Value);
+			bValid = NumFrames > 0;
+		}
+		else if (bValid && Arg == "--edits-per-frame")
+		{
+			MaxEditsPerFrame = std::atoi(Value);
+			bValid = MaxEditsPerFrame > 0;
+		}
+		else if (bValid && Arg == "--join-frame")
+		{
+			JoinFrame = std::atoi(Value);
+			bValid = JoinFrame >= 0;
+		}
+		else if (bValid && Arg == "--snapshot-bytes-per-frame")
+		{
+			SnapshotBytesPerFrame = std::atoi(Value);
+			bValid = SnapshotBytesPerFrame > 0;
+		}
+		else if (bValid && Arg == "--saved-edits")
+		{
+			NumSavedEdits = std::atoi(Value);
+			bValid = NumSavedEdits >= 0;
+		}
+		else if (bValid && Arg == "--seed")
+		{
+			Seed = std::atoi(Value);
+		}
+		else
+		{
+			bValid = false;
+		}
+
+		if (!bValid)
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (JoinFrame >= NumFrames)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	const std::filesystem::path SaveDirectory = std::filesystem::temp_directory_path() / "VoxelNetLoopback";
+	std::filesystem::remove_all(SaveDirectory);
+
+	FRandomStream Random(Seed);
+	FVector Position(16.f, 16.f, 40.f);
+
+	// The earlier game isn't replicated, so its edits aren't numbered. Its chunks are saved when its volume goes away.
+	{
+		FLoopbackPeer EarlierServer(Seed, FString(SaveDirectory.string().c_str()));
+
+		for (int32 i = 0; i < NumSavedEdits; i++)
+			EarlierServer.Replicator.ApplyEdit(MakeRandomEdit(Random, Position));
+	}
+
+	int64 NumEdits = 0;
+	int64 NumEditBytes = 0;
+	int32 NumErrors = 0;
+
+	{
+		FLoopbackPeer Server(Seed, FString(SaveDirectory.string().c_str()));
+		FLoopbackClient Client(Seed);
+		FLoopbackClient LateClient(Seed);
+		uint32 Sequence = 0;
+
+		FVoxelNetEditWriter Writer;
+
+		// Keeps going after the last edit until both clients have caught up
+		for (int32 Frame = 0; Frame < NumFrames || Client.Snapshot.IsValid() || LateClient.Snapshot.IsValid(); Frame++)
+		{
+			if (Frame == 0)
+				Client.Join(Server);
+
+			if (Frame == JoinFrame)
+				LateClient.Join(Server);
+
+			// The server applies its edits as they're made, and sends them all at the end of the frame
+			if (Frame < NumFrames)
+			{
+				const int32 NumFrameEdits = Random.RandRange(0, MaxEditsPerFrame);
+
+				for (int32 i = 0; i < NumFrameEdits; i++)
+				{
+					FVoxelNetEdit Edit = MakeRandomEdit(Random, Position);
+					Edit.Sequence = ++Sequence;
+					Server.Replicator.ApplyEdit(Edit);
+					Writer.Write(Edit);
+				}
+			}
+
+			if (Writer.Num() > 0)
+			{
+				NumEdits += Writer.Num();
+				NumEditBytes += Writer.GetData().Num();
+
+				if (!Client.Peer.Replicator.ReceiveEdits(Writer.GetData().GetData(), Writer.GetData().Num()))
+					NumErrors++;
+
+				if (Frame >= JoinFrame && !LateClient.Peer.Replicator.ReceiveEdits(Writer.GetData().GetData(), Writer.GetData().Num()))
+					NumErrors++;
+
+				Writer.Reset();
+			}
+
+			if (!Client.TickSnapshot(Server, SnapshotBytesPerFrame))
+				NumErrors++;
+
+			if (!LateClient.TickSnapshot(Server, SnapshotBytesPerFrame))
+				NumErrors++;
+		}
+
+		const int64 ClientMismatches = CountMismatches(Server, Client.Peer);
+		const int64 LateClientMismatches = CountMismatches(Server, LateClient.Peer);
+		NumErrors += int32(FMath::Min<int64>(ClientMismatches + LateClientMismatches, MAX_int32 - NumErrors));
+
+		std::cout << "Edits: " << NumEdits << " in " << NumEditBytes << " bytes, " << (NumEdits > 0 ? double(NumEditBytes) / NumEdits : 0.0) << " bytes per edit\n";
+		std::cout << "Chunks versioned by the edits: " << Server.Replicator.GetChunkVersions().Num() << "\n";
+		PrintSnapshot("Client", 0, Client);
+		PrintSnapshot("Late client", JoinFrame, LateClient);
+		std::cout << "Mismatched voxels: " << ClientMismatches << " on the client, " << LateClientMismatches << " on the late client\n";
+	}
+
+	std::filesystem::remove_all(SaveDirectory);
+
+	return NumErrors > 0 ? 1 : 0;
+}
@@ -0,0 +1,330 @@
+// Copyright (c) 2016 Brandon Garvin
+
+// Checks the direct voxel queries against brute force reads of the same volume, and measures how many of them a second it can answer.
+// Raycasts are checked against every voxel in the ray's bounds, surface lookups against a plain column walk and overlaps against every voxel
+// in the shape. Then the same raycasts are timed on one thread and on several, with another thread carving the terrain at the same time
+// the way the game thread would, which also makes sure a query and an edit can never deadlock.
+//
+// Usage: VoxelQueryCheck [--queries Queries] [--threads Threads] [--seed Seed]
+//
+// Returns 1 if any query disagrees with the brute force answer.
+
+#include "VoxelTerrainQuery.h"
+#include "VoxelTerrainPager.h"
+
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace PolyVox;
+
+// Where voxel 0 is in the volume. It isn't zero, so the queries have to get the offset right.
+static const FIntVector VolumeOffset(5, -7, 3);
+
+// The queries start in a box this many voxels across, reaching from under the ground up into the air
+static const float QueryAreaSize = 256.f;
+static const float QueryAreaHeight = 128.f;
+
+// Returns true if a voxel is solid, read straight from the volume
+static bool IsSolid(const FVoxelPaletteVolume& Volume, const FIntVector& Voxel)
+{
+	const FIntVector VolumeVoxel = Voxel + VolumeOffset;
+	return Volume.getVoxel(VolumeVoxel.X, VolumeVoxel.Y, VolumeVoxel.Z).getMaterial() != 0;
+}
+
+// Returns the time the segment enters a voxel, or a negative number if it misses it. A segment that starts inside the voxel enters it at time 0.
+static float GetEntryTime(const FVector& Start, const FVector& Delta, const FIntVector& Voxel)
+{
+	float Entry = 0.f;
+	float Exit = 1.f;
+
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		const float Lower = Voxel[Axis] - 0.5f;
+		const float Upper = Voxel[Axis] + 0.5f;
+
+		if (Delta[Axis] == 0.f)
+		{
+			if (Start[Axis] < Lower || Start[Axis] >= Upper)
+				return -1.f;
+
+			continue;
+		}
+
+		float Near = (Lower - Start[Axis]) / Delta[Axis];
+		float Far = (Upper - Start[Axis]) / Delta[Axis];
+		if (Near > Far)
+			Swap(Near, Far);
+
+		Entry = FMath::Max(Entry, Near);
+		Exit = FMath::Min(Exit, Far);
+	}
+
+	return Entry <= Exit ? Entry : -1.f;
+}
+
+// The earliest time the segment enters a solid voxel, found by trying every voxel in its bounds
+static bool BruteForceRaycast(const FVoxelPaletteVolume& Volume, const FVector& Start, const FVector& End, float& OutTime)
+{
+	const FVector Delta = End - Start;
+	const FVector Lower = Start.ComponentMin(End);
+	const FVector Upper = Start.ComponentMax(End);
+
+	bool bHit = false;
+	OutTime = MAX_flt;
+
+	for (int32 Z = FMath::RoundToInt(Lower.Z); Z <= FMath::RoundToInt(Upper.Z); Z++)
+	{
+		for (int32 Y = FMath::RoundToInt(Lower.Y); Y <= FMath::RoundToInt(Upper.Y); Y++)
+		{
+			for (int32 X = FMath::RoundToInt(Lower.X); X <= FMath::RoundToInt(Upper.X); X++)
+			{
+				const float Time = GetEntryTime(Start, Delta, FIntVector(X, Y, Z));
+
+				if (Time >= 0.f && Time < OutTime && IsSolid(Volume, FIntVector(X, Y, Z)))
+				{
+					OutTime = Time;
+					bHit = true;
+				}
+			}
+		}
+	}
+
+	return bHit;
+}
+
+// Returns a random point in the area the queries are made in
+static FVector RandomPoint(FRandomStream& Random)
+{
+	return FVector(Random.FRandRange(0.f, QueryAreaSize), Random.FRandRange(0.f, QueryAreaSize), Random.FRandRange(0.f, QueryAreaHeight));
+}
+
+// Returns a random ray up to 100 voxels long. Most go downwards, like something looking for the ground.
+static void RandomRay(FRandomStream& Random, FVector& OutStart, FVector& OutEnd)
+{
+	OutStart = RandomPoint(Random);
+	OutEnd = OutStart + FVector(Random.FRandRange(-50.f, 50.f), Random.FRandRange(-50.f, 50.f), Random.FRandRange(-80.f, 20.f));
+}
+
+static void PrintUsage()
+{
+	std::cerr << "Usage: VoxelQueryCheck [--queries Queries] [--threads Threads] [--seed Seed]\n";
+}
+
+int main(int argc, char** argv)
+{
+	int32 NumQueries = 2000;
+	int32 NumThreads = FMath::Max(1, FPlatformMisc::NumberOfCoresIncludingHyperthreads() - 1);
+	int32 Seed = 123;
+
+	for (int32 i = 1; i < argc; i += 2)
+	{
+		const std::string Arg = argv[i];
+		const char* Value = i + 1 < argc ? argv[i + 1] : nullptr;
+		bool bValid = Value != nullptr;
+
+		if (bValid && Arg == "--queries")
+		{
+			NumQueries = std::atoi(Value);
+			bValid = NumQueries > 0;
+		}
+		else if (bValid && Arg == "--threads")
+		{
+			NumThreads = std::atoi(Value);
+			bValid = NumThreads > 0;
+		}
+		else if (bValid && Arg == "--seed")
+		{
+			Seed = std::atoi(Value);
+		}
+		else
+		{
+			bValid = false;
+		}
+
+		if (!bValid)
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	VoxelTerrainPager Pager(false, Seed, 3, 0.01f, 32.f, 0.f, 64.f, true);
+	FVoxelPaletteVolume Volume(&Pager, 256 * 1024 * 1024, VoxelTerrainPager::VolumeChunkSideLength);
+	const FVoxelTerrainQuery Query(Volume, VolumeOffset);
+	FRandomStream Random(Seed);
+
+	// Carve some caves, so rays go in and out of the ground and some chunks are neither all air nor all solid
+	for (int32 i = 0; i < 64; i++)
+	{
+		const FVector Center = RandomPoint(Random) - FVector(0.f, 0.f, QueryAreaHeight / 2.f);
+		const float Radius = Random.FRandRange(3.f, 12.f);
+		const FIntVector Lower = FIntVector(FMath::FloorToInt(Center.X - Radius), FMath::FloorToInt(Center.Y - Radius), FMath::FloorToInt(Center.Z - Radius)) + VolumeOffset;
+		const FIntVector Upper = FIntVector(FMath::CeilToInt(Center.X + Radius), FMath::CeilToInt(Center.Y + Radius), FMath::CeilToInt(Center.Z + Radius)) + VolumeOffset;
+
+		Volume.EditRegion(PolyVox::Region(Vector3DInt32(Lower.X, Lower.Y, Lower.Z), Vector3DInt32(Upper.X, Upper.Y, Upper.Z)), [&Center, Radius](int32 X, int32 Y, int32 Z, MaterialDensityPair88& InOutVoxel)
+		{
+			if ((FVector(FIntVector(X, Y, Z) - VolumeOffset) - Center).SizeSquared() <= Radius * Radius)
+				InOutVoxel = MaterialDensityPair88(0, 0);
+		});
+	}
+
+	int32 NumErrors = 0;
+	int32 NumRayHits = 0;
+	int32 NumSurfaceHits = 0;
+	int32 NumOverlaps = 0;
+
+	for (int32 i = 0; i < NumQueries; i++)
+	{
+		// Raycasts have to hit the same voxel boundary as the brute force search. Where the ray passes exactly through an edge or corner
+		// either voxel is right, so only the time is compared.
+		FVector Start, End;
+		RandomRay(Random, Start, End);
+
+		FVoxelQueryResult Result;
+		float ExpectedTime;
+		const bool bHit = Query.Raycast(Start, End, Result);
+		const bool bExpectedHit = BruteForceRaycast(Volume, Start, End, ExpectedTime);
+
+		if (bHit != bExpectedHit || (bHit && (FMath::Abs(Result.Time - ExpectedTime) > 1e-3f || !IsSolid(Volume, Result.Voxel))))
+		{
+			if (NumErrors++ < 10)
+				std::cout << "Raycast " << i << " came back " << bHit << " at " << Result.Time << ", expected " << bExpectedHit << " at " << ExpectedTime << "\n";
+		}
+
+		NumRayHits += bHit ? 1 : 0;
+
+		// Surface lookups have to find the first solid voxel in the column
+		const FIntVector Column(FMath::RoundToInt(Start.X), FMath::RoundToInt(Start.Y), FMath::RoundToInt(Start.Z));
+		const int32 MaxDepth = Random.RandRange(0, 200);
+		int32 ExpectedZ = MIN_int32;
+
+		for (int32 Z = Column.Z; Z >= Column.Z - MaxDepth; Z--)
+		{
+			if (IsSolid(Volume, FIntVector(Column.X, Column.Y, Z)))
+			{
+				ExpectedZ = Z;
+				break;
+			}
+		}
+
+		const bool bSurface = Query.FindSurfaceBelow(Column, MaxDepth, Result);
+		if (bSurface != (ExpectedZ != MIN_int32) || (bSurface && Result.Voxel != FIntVector(Column.X, Column.Y, ExpectedZ)))
+		{
+			if (NumErrors++ < 10)
+				std::cout << "Surface lookup " << i << " came back " << bSurface << " at " << Result.Voxel.Z << ", expected " << ExpectedZ << "\n";
+		}
+
+		NumSurfaceHits += bSurface ? 1 : 0;
+
+		// Overlaps have to agree on whether there is any solid voxel in the shape, and the one they found has to be solid and inside it
+		const FVector Center = RandomPoint(Random);
+		const float Radius = Random.FRandRange(0.f, 6.f);
+		const FIntVector SphereLower(FMath::CeilToInt(Center.X - Radius), FMath::CeilToInt(Center.Y - Radius), FMath::CeilToInt(Center.Z - Radius));
+		const FIntVector SphereUpper(FMath::FloorToInt(Center.X + Radius), FMath::FloorToInt(Center.Y + Radius), FMath::FloorToInt(Center.Z + Radius));
+		bool bExpectedOverlap = false;
+
+		for (int32 Z = SphereLower.Z; Z <= SphereUpper.Z; Z++)
+			for (int32 Y = SphereLower.Y; Y <= SphereUpper.Y; Y++)
+				for (int32 X = SphereLower.X; X <= SphereUpper.X; X++)
+					bExpectedOverlap |= (FVector(FIntVector(X, Y, Z)) - Center).SizeSquared() <= Radius * Radius && IsSolid(Volume, FIntVector(X, Y, Z));
+
+		const bool bOverlap = Query.OverlapSphere(Center, Radius, Result);
+		if (bOverlap != bExpectedOverlap || (bOverlap && (!IsSolid(Volume, Result.Voxel) || (FVector(Result.Voxel) - Center).SizeSquared() > Radius * Radius)))
+		{
+			if (NumErrors++ < 10)
+				std::cout << "Sphere overlap " << i << " came back " << bOverlap << ", expected " << bExpectedOverlap << "\n";
+		}
+
+		const FIntVector BoxLower(FMath::RoundToInt(Center.X), FMath::RoundToInt(Center.Y), FMath::RoundToInt(Center.Z));
+		const FIntVector BoxUpper = BoxLower + FIntVector(Random.RandRange(0, 40), Random.RandRange(0, 40), Random.RandRange(0, 4));
+		bool bExpectedBoxOverlap = false;
+
+		for (int32 Z = BoxLower.Z; Z <= BoxUpper.Z; Z++)
+			for (int32 Y = BoxLower.Y; Y <= BoxUpper.Y; Y++)
+				for (int32 X = BoxLower.X; X <= BoxUpper.X; X++)
+					bExpectedBoxOverlap |= IsSolid(Volume, FIntVector(X, Y, Z));
+
+		const bool bBoxOverlap = Query.OverlapBox(BoxLower, BoxUpper, Result);
+		if (bBoxOverlap != bExpectedBoxOverlap || (bBoxOverlap && !IsSolid(Volume, Result.Voxel)))
+		{
+			if (NumErrors++ < 10)
+				std::cout << "Box overlap " << i << " came back " << bBoxOverlap << ", expected " << bExpectedBoxOverlap << "\n";
+		}
+
+		NumOverlaps += (bOverlap ? 1 : 0) + (bBoxOverlap ? 1 : 0);
+	}
+
+	std::cout << "Checked " << NumQueries << " of each query: " << NumRayHits << " rays hit, " << NumSurfaceHits << " surfaces found, "
+		<< NumOverlaps << " overlaps, " << NumErrors << " wrong\n";
+
+	// Time the raycasts. The rays are made up front so only the queries are timed.
+	const int32 NumTimedRays = NumQueries * 50;
+	TArray<FVector> RayStarts;
+	TArray<FVector> RayEnds;
+	RayStarts.SetNumUninitialized(NumTimedRays);
+	RayEnds.SetNumUninitialized(NumTimedRays);
+
+	for (int32 i = 0; i < NumTimedRays; i++)
+		RandomRay(Random, RayStarts[i], RayEnds[i]);
+
+	for (int32 ThreadCount : { 1, NumThreads })
+	{
+		std::atomic<bool> bStopEditing(false);
+		std::atomic<int32> NumEdits(0);
+
+		// Carve tiny holes all over the query area while the queries run, like players digging
+		std::thread Editor([&Volume, &bStopEditing, &NumEdits, Seed]()
+		{
+			FRandomStream EditRandom(Seed + 1);
+			while (!bStopEditing)
+			{
+				const FIntVector Voxel = FIntVector(EditRandom.RandRange(0, int32(QueryAreaSize)), EditRandom.RandRange(0, int32(QueryAreaSize)), EditRandom.RandRange(0, int32(QueryAreaHeight))) + VolumeOffset;
+				Volume.EditRegion(PolyVox::Region(Vector3DInt32(Voxel.X, Voxel.Y, Voxel.Z), Vector3DInt32(Voxel.X + 2, Voxel.Y + 2, Voxel.Z + 2)), [](int32 X, int32 Y, int32 Z, MaterialDensityPair88& InOutVoxel)
+				{
+					InOutVoxel = MaterialDensityPair88(0, 0);
+				});
+				NumEdits++;
+				std::this_thread::yield();
+			}
+		});
+
+		std::atomic<int32> NextRay(0);
+		std::atomic<int32> NumHits(0);
+		const double StartTime = FPlatformTime::Seconds();
+
+		TArray<std::thread> Threads;
+		for (int32 ThreadIndex = 0; ThreadIndex < ThreadCount; ThreadIndex++)
+		{
+			Threads.Add(std::thread([&]()
+			{
+				// Rays are handed out in batches, like the actor's query tasks
+				static const int32 RaysPerBatch = 64;
+				FVoxelQueryResult ThreadResult;
+				int32 ThreadHits = 0;
+
+				for (int32 First = NextRay.fetch_add(RaysPerBatch); First < NumTimedRays; First = NextRay.fetch_add(RaysPerBatch))
+				{
+					for (int32 i = First; i < FMath::Min(First + RaysPerBatch, NumTimedRays); i++)
+						ThreadHits += Query.Raycast(RayStarts[i], RayEnds[i], ThreadResult) ? 1 : 0;
+				}
+
+				NumHits += ThreadHits;
+			}));
+		}
+
+		for (std::thread& Thread : Threads)
+			Thread.join();
+
+		const double Seconds = FPlatformTime::Seconds() - StartTime;
+		bStopEditing = true;
+		Editor.join();
+
+		std::cout << "Raycasts on " << ThreadCount << (ThreadCount == 1 ? " thread: " : " threads: ") << NumTimedRays << " rays (" << NumHits << " hits) in "
+			<< Seconds * 1000.0 << " ms, " << NumTimedRays / FMath::Max(Seconds, 1e-9) / 1000000.0 << " million a second, with "
+			<< NumEdits << " edits running alongside\n";
+	}
+
+	return NumErrors > 0 ? 1 : 0;
+}
@@ -0,0 +1,292 @@
+// Copyright (c) 2016 Brandon Garvin
+
+// Checks the chunk visibility the terrain uses to hide buried chunks, and measures what it costs.
+// The flood fill is checked against a separate search from every face on random chunks, from solid rock to open air. The walk out from
+// the viewers is checked on a small world built by hand, with a shaft and a sealed cave under solid ground. Then real terrain with caves
+// carved into it is worked out chunk by chunk and walked from above the ground and from inside it, to see how much each would hide.
+//
+// Usage: VoxelVisibilityCheck [--chunks Chunks] [--seed Seed]
+//
+// Returns 1 if any visibility disagrees with the search, or the walk hides or shows the wrong chunks.
+
+#include "VoxelChunkVisibility.h"
+#include "VoxelTerrainPager.h"
+
+#include <iostream>
+#include <string>
+
+using namespace PolyVox;
+
+static const int32 ChunkSize = FVoxelChunkTraits::Size;
+
+// Returns true if the air touching one face of a chunk reaches another, by flooding from that face alone
+static bool BruteForceConnects(const TArray<MaterialDensityPair88>& Voxels, int32 FaceA, int32 FaceB)
+{
+	TArray<uint8> Visited;
+	Visited.SetNumZeroed(FVoxelChunkTraits::NumVoxels);
+	TArray<FIntVector> Stack;
+
+	auto IsOnFace = [](const FIntVector& Voxel, int32 Face)
+	{
+		return Voxel[Face / 2] == ((Face & 1) ? ChunkSize - 1 : 0);
+	};
+
+	for (int32 Z = 0; Z < ChunkSize; Z++)
+	{
+		for (int32 Y = 0; Y < ChunkSize; Y++)
+		{
+			for (int32 X = 0; X < ChunkSize; X++)
+			{
+				const int32 Index = FVoxelChunkTraits::LocalIndex(X, Y, Z);
+				if (IsOnFace(FIntVector(X, Y, Z), FaceA) && Voxels[Index].getMaterial() == 0)
+				{
+					Visited[Index] = 1;
+					Stack.Add(FIntVector(X, Y, Z));
+				}
+			}
+		}
+	}
+
+	while (Stack.Num() > 0)
+	{
+		const FIntVector Voxel = Stack.Pop(false);
+		if (IsOnFace(Voxel, FaceB))
+			return true;
+
+		for (int32 Face = 0; Face < FVoxelChunkVisibility::NumFaces; Face++)
+		{
+			const FIntVector Next = Voxel + FVoxelChunkVisibility::GetFaceDirection(Face);
+			if (Next.X < 0 || Next.Y < 0 || Next.Z < 0 || Next.X >= ChunkSize || Next.Y >= ChunkSize || Next.Z >= ChunkSize)
+				continue;
+
+			const int32 Index = FVoxelChunkTraits::LocalIndex(Next.X, Next.Y, Next.Z);
+			if (!Visited[Index] && Voxels[Index].getMaterial() == 0)
+			{
+				Visited[Index] = 1;
+				Stack.Add(Next);
+			}
+		}
+	}
+
+	return false;
+}
+
+// Fills a chunk with scattered rock at the given density, with a few straight tunnels through it so some faces connect even in dense rock
+static void MakeRandomChunk(FRandomStream& Random, float SolidFraction, TArray<MaterialDensityPair88>& OutVoxels)
+{
+	OutVoxels.SetNumUninitialized(FVoxelChunkTraits::NumVoxels);
+	for (MaterialDensityPair88& Voxel : OutVoxels)
+		Voxel = Random.FRand() < SolidFraction ? MaterialDensityPair88(1, 255) : MaterialDensityPair88(0, 0);
+
+	const int32 NumTunnels = Random.RandRange(0, 2);
+	for (int32 i = 0; i < NumTunnels; i++)
+	{
+		const int32 Axis = Random.RandRange(0, 2);
+		FIntVector Voxel(Random.RandRange(0, ChunkSize - 1), Random.RandRange(0, ChunkSize - 1), Random.RandRange(0, ChunkSize - 1));
+		const int32 Start = Random.RandRange(0, ChunkSize / 2);
+		const int32 End = Random.RandRange(ChunkSize / 2, ChunkSize - 1);
+
+		for (int32 Step = Start; Step <= End; Step++)
+		{
+			Voxel[Axis] = Step;
+			OutVoxels[FVoxelChunkTraits::LocalIndex(Voxel.X, Voxel.Y, Voxel.Z)] = MaterialDensityPair88(0, 0);
+		}
+	}
+}
+
+// The hand built world: solid ground up to chunk Z 3 with air above it, a shaft of open chunks down the middle to chunk Z 1,
+// and a cave sealed off under the ground that connects every face but can't be reached
+static const FIntVector WorldSize(8, 8, 8);
+static const int32 GroundTopZ = 3;
+static const FIntVector ShaftBottom(4, 4, 1);
+static const FIntVector SealedCave(1, 1, 1);
+
+static FVoxelChunkVisibility GetWorldChunk(const FIntVector& ChunkCoord)
+{
+	const bool bShaft = ChunkCoord.X == ShaftBottom.X && ChunkCoord.Y == ShaftBottom.Y && ChunkCoord.Z >= ShaftBottom.Z;
+	const bool bOpen = ChunkCoord.Z > GroundTopZ || bShaft || ChunkCoord == SealedCave;
+	return bOpen ? FVoxelChunkVisibility() : FVoxelChunkVisibility(0);
+}
+
+static void PrintUsage()
+{
+	std::cerr << "Usage: VoxelVisibilityCheck [--chunks Chunks] [--seed Seed]\n";
+}
+
+int main(int argc, char** argv)
+{
+	int32 NumChunks = 200;
+	int32 Seed = 123;
+
+	for (int32 i = 1; i < argc; i += 2)
+	{
+		const std::string Arg = argv[i];
+		const char* Value = i + 1 < argc ? argv[i + 1] : nullptr;
+		bool bValid = Value != nullptr;
+
+		if (bValid && Arg == "--chunks")
+		{
+			NumChunks = std::atoi(Value);
+			bValid = NumChunks > 0;
+		}
+		else if (bValid && Arg == "--seed")
+		{
+			Seed = std::atoi(Value);
+		}
+		else
+		{
+			bValid = false;
+		}
+
+		if (!bValid)
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	FRandomStream Random(Seed);
+	TArray<MaterialDensityPair88> Voxels;
+	TArray<uint8> Visited;
+	TArray<int32> Stack;
+	int32 NumErrors = 0;
+	int32 NumConnectedPairs = 0;
+
+	// Every pair of faces has to connect exactly when a flood from one of them reaches the other.
+	// The densities go from open air, through the rock that only just lets the air through, to solid rock.
+	static const float SolidFractions[] = { 0.f, 0.3f, 0.6f, 0.68f, 0.72f, 0.8f, 1.f };
+
+	for (int32 ChunkIndex = 0; ChunkIndex < NumChunks; ChunkIndex++)
+	{
+		MakeRandomChunk(Random, SolidFractions[ChunkIndex % 7], Voxels);
+		const FVoxelChunkVisibility Visibility = FVoxelChunkVisibility::Compute(Voxels.GetData(), ChunkSize, Visited, Stack);
+
+		for (int32 FaceA = 0; FaceA < FVoxelChunkVisibility::NumFaces; FaceA++)
+		{
+			for (int32 FaceB = FaceA + 1; FaceB < FVoxelChunkVisibility::NumFaces; FaceB++)
+			{
+				const bool bExpected = BruteForceConnects(Voxels, FaceA, FaceB);
+				NumConnectedPairs += bExpected ? 1 : 0;
+
+				if (Visibility.CanSeeThrough(FaceA, FaceB) != bExpected || Visibility.CanSeeThrough(FaceB, FaceA) != bExpected)
+				{
+					if (NumErrors++ < 10)
+						std::cout << "Chunk " << ChunkIndex << " has faces " << FaceA << " and " << FaceB << (bExpected ? " apart" : " connected") << " when they aren't\n";
+				}
+			}
+		}
+	}
+
+	std::cout << "Checked " << NumChunks << " random chunks: " << NumConnectedPairs << " of " << NumChunks * 15 << " pairs of faces connect, " << NumErrors << " wrong\n";
+
+	// From the air, the walk has to see the top of the ground and down the shaft, including the ground right next to the shaft.
+	// The sealed cave and the ground away from the shaft stay hidden.
+	TSet<FIntVector> VisibleChunks;
+	TArray<FIntVector> ViewerChunks;
+	ViewerChunks.Add(FIntVector(2, 6, 6));
+	FVoxelChunkVisibility::FindVisibleChunks(ViewerChunks, FIntVector::ZeroValue, WorldSize - FIntVector(1), GetWorldChunk, VisibleChunks);
+
+	const FIntVector ExpectedVisible[] = { FIntVector(0, 0, 7), FIntVector(7, 7, 4), FIntVector(0, 0, GroundTopZ), FIntVector(6, 1, GroundTopZ), ShaftBottom, ShaftBottom + FIntVector(1, 0, 0), ShaftBottom - FIntVector(0, 0, 1) };
+	const FIntVector ExpectedHidden[] = { SealedCave, FIntVector(0, 0, 0), FIntVector(0, 0, GroundTopZ - 1), ShaftBottom + FIntVector(2, 0, 0), ShaftBottom + FIntVector(1, 1, 0), FIntVector(7, 7, 1) };
+
+	for (const FIntVector& ChunkCoord : ExpectedVisible)
+	{
+		if (!VisibleChunks.Contains(ChunkCoord) && NumErrors++ < 20)
+			std::cout << "Chunk " << ChunkCoord.X << "," << ChunkCoord.Y << "," << ChunkCoord.Z << " should be visible from the air\n";
+	}
+
+	for (const FIntVector& ChunkCoord : ExpectedHidden)
+	{
+		if (VisibleChunks.Contains(ChunkCoord) && NumErrors++ < 20)
+			std::cout << "Chunk " << ChunkCoord.X << "," << ChunkCoord.Y << "," << ChunkCoord.Z << " should be hidden from the air\n";
+	}
+
+	// From inside the sealed cave, only the cave and the rock around it can be seen
+	ViewerChunks[0] = SealedCave;
+	FVoxelChunkVisibility::FindVisibleChunks(ViewerChunks, FIntVector::ZeroValue, WorldSize - FIntVector(1), GetWorldChunk, VisibleChunks);
+
+	if (VisibleChunks.Num() != 7)
+	{
+		if (NumErrors++ < 20)
+			std::cout << "The sealed cave sees " << VisibleChunks.Num() << " chunks, instead of itself and its 6 neighbours\n";
+	}
+
+	std::cout << "Walked the hand built world: " << NumErrors << " wrong so far\n";
+
+	// Real terrain with caves in it, a chunk at a time like the workers build it. Most of the chunks are under the ground.
+	const FIntVector LowerTerrainChunk(0, 0, -4);
+	const FIntVector UpperTerrainChunk(11, 11, 2);
+	VoxelTerrainPager Pager(false, Seed, 3, 0.01f, 32.f, 0.f, 64.f, true);
+	FVoxelPaletteVolume Volume(&Pager, 256 * 1024 * 1024, VoxelTerrainPager::VolumeChunkSideLength);
+
+	for (int32 i = 0; i < 96; i++)
+	{
+		const FVector Center(Random.FRandRange(0.f, 12.f * ChunkSize), Random.FRandRange(0.f, 12.f * ChunkSize), Random.FRandRange(-4.f * ChunkSize, 64.f));
+		const float Radius = Random.FRandRange(3.f, 12.f);
+		const FIntVector Lower(FMath::FloorToInt(Center.X - Radius), FMath::FloorToInt(Center.Y - Radius), FMath::FloorToInt(Center.Z - Radius));
+		const FIntVector Upper(FMath::CeilToInt(Center.X + Radius), FMath::CeilToInt(Center.Y + Radius), FMath::CeilToInt(Center.Z + Radius));
+
+		Volume.EditRegion(PolyVox::Region(Vector3DInt32(Lower.X, Lower.Y, Lower.Z), Vector3DInt32(Upper.X, Upper.Y, Upper.Z)), [&Center, Radius](int32 X, int32 Y, int32 Z, MaterialDensityPair88& InOutVoxel)
+		{
+			if ((FVector(FIntVector(X, Y, Z)) - Center).SizeSquared() <= Radius * Radius)
+				InOutVoxel = MaterialDensityPair88(0, 0);
+		});
+	}
+
+	TMap<FIntVector, FVoxelChunkVisibility> TerrainChunks;
+	double ReadSeconds = 0.0;
+	double ComputeSeconds = 0.0;
+
+	for (int32 Z = LowerTerrainChunk.Z; Z <= UpperTerrainChunk.Z; Z++)
+	{
+		for (int32 Y = LowerTerrainChunk.Y; Y <= UpperTerrainChunk.Y; Y++)
+		{
+			for (int32 X = LowerTerrainChunk.X; X <= UpperTerrainChunk.X; X++)
+			{
+				const FIntVector Lower = FVoxelChunkTraits::ChunkToVoxel(FIntVector(X, Y, Z));
+				const FIntVector Upper = Lower + FIntVector(ChunkSize - 1);
+
+				double StartTime = FPlatformTime::Seconds();
+				Voxels.SetNumUninitialized(FVoxelChunkTraits::NumVoxels);
+				Volume.ReadRegion(PolyVox::Region(Vector3DInt32(Lower.X, Lower.Y, Lower.Z), Vector3DInt32(Upper.X, Upper.Y, Upper.Z)), Voxels.GetData());
+				ReadSeconds += FPlatformTime::Seconds() - StartTime;
+
+				StartTime = FPlatformTime::Seconds();
+				TerrainChunks.Add(FIntVector(X, Y, Z), FVoxelChunkVisibility::Compute(Voxels.GetData(), ChunkSize, Visited, Stack));
+				ComputeSeconds += FPlatformTime::Seconds() - StartTime;
+			}
+		}
+	}
+
+	const int32 NumTerrain = TerrainChunks.Num();
+	std::cout << "Worked out " << NumTerrain << " terrain chunks: " << ComputeSeconds * 1000000.0 / NumTerrain << " us each for the flood fill, "
+		<< ReadSeconds * 1000000.0 / NumTerrain << " us each to read the voxels\n";
+
+	auto GetTerrainChunk = [&TerrainChunks](const FIntVector& ChunkCoord)
+	{
+		const FVoxelChunkVisibility* Visibility = TerrainChunks.Find(ChunkCoord);
+		return Visibility ? *Visibility : FVoxelChunkVisibility();
+	};
+
+	const FIntVector Viewers[] = { FIntVector(6, 6, UpperTerrainChunk.Z), FIntVector(6, 6, LowerTerrainChunk.Z + 1) };
+
+	for (int32 ViewerIndex = 0; ViewerIndex < 2; ViewerIndex++)
+	{
+		ViewerChunks[0] = Viewers[ViewerIndex];
+
+		const int32 NumWalks = 100;
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 Walk = 0; Walk < NumWalks; Walk++)
+			FVoxelChunkVisibility::FindVisibleChunks(ViewerChunks, LowerTerrainChunk - FIntVector(1), UpperTerrainChunk + FIntVector(1), GetTerrainChunk, VisibleChunks);
+		const double Seconds = (FPlatformTime::Seconds() - StartTime) / NumWalks;
+
+		int32 NumHidden = 0;
+		for (const TPair<FIntVector, FVoxelChunkVisibility>& Pair : TerrainChunks)
+			NumHidden += VisibleChunks.Contains(Pair.Key) ? 0 : 1;
+
+		std::cout << "From " << (ViewerIndex == 0 ? "above" : "under") << " the ground, " << NumHidden << " of " << NumTerrain << " chunks are hidden, walked in "
+			<< Seconds * 1000.0 << " ms\n";
+	}
+
+	return NumErrors > 0 ? 1 : 0;
+}
@@ -0,0 +1,425 @@
+// Copyright (c) 2016 Brandon Garvin
+
+// Hammers the palette volume from several threads at once and checks it holds up: every chunk is paged in exactly once however many threads
+// ask for it together, a chunk is never paged in while it is still being paged out, and ReadRegion never sees an EditRegion half done.
+// It also measures how many regions a second the volume can read and edit at each thread count, with and without writers.
+//
+// Usage: VoxelVolumeStress [--threads 1,2,4,8] [--seconds Seconds]
+//
+// The world is split into cells two chunks across, offset by half a chunk so neighbouring cells share chunks. Writers fill a whole cell
+// with a new material in one EditRegion, and readers read a whole cell and check every voxel in it has the same material.
+// The memory budget is tiny, so chunks are evicted and paged back in all the time. Returns 1 if anything went wrong.
+
+#include "VoxelPaletteVolume.h"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace PolyVox;
+
+// The chunks are small so each cell touches a lot of them
+static const int32 ChunkSideLength = 16;
+
+// The cells are two chunks across, and start half a chunk into the first chunk
+static const int32 CellSize = ChunkSideLength * 2;
+static const int32 CellOffset = ChunkSideLength / 2;
+static const int32 CellsPerAxis = 4;
+static const int32 NumCells = CellsPerAxis * CellsPerAxis * CellsPerAxis;
+
+// Less than the chunks of the world take up, so the volume is always evicting
+static const uint32 StressMemoryBytes = 128 * 1024;
+
+// The material every chunk starts out as
+static const uint8 InitialMaterial = 1;
+
+// Keeps paged out chunks in memory, and notices if the volume ever pages a chunk in or out twice at the same time
+class FStressPager : public FVoxelPaletteVolume::Pager
+{
+public:
+	virtual void pageIn(const PolyVox::Region& region, FVoxelPaletteVolume::Chunk* pChunk) override
+	{
+		const FIntVector ChunkKey = GetChunkKey(region);
+		BeginChunk(ChunkKey);
+
+		TArray<MaterialDensityPair88> Voxels;
+		{
+			std::lock_guard<std::mutex> Lock(Mutex);
+			PageIns.FindOrAdd(ChunkKey)++;
+
+			if (const TArray<MaterialDensityPair88>* SavedVoxels = SavedChunks.Find(ChunkKey))
+				Voxels = *SavedVoxels;
+		}
+
+		// Give any other thread that wrongly thinks it should page the chunk in a chance to get here too
+		std::this_thread::yield();
+
+		if (Voxels.Num() > 0)
+			pChunk->SetVoxels(Voxels.GetData());
+		else
+			pChunk->Fill(MaterialDensityPair88(InitialMaterial, 0));
+
+		EndChunk(ChunkKey);
+	}
+
+	virtual void pageOut(const PolyVox::Region& region, FVoxelPaletteVolume::Chunk* pChunk) override
+	{
+		const FIntVector ChunkKey = GetChunkKey(region);
+		BeginChunk(ChunkKey);
+
+		TArray<MaterialDensityPair88> Voxels;
+		Voxels.SetNumUninitialized(ChunkSideLength * ChunkSideLength * ChunkSideLength);
+		pChunk->GetVoxels(Voxels.GetData());
+
+		{
+			std::lock_guard<std::mutex> Lock(Mutex);
+			SavedChunks.Add(ChunkKey, MoveTemp(Voxels));
+			NumPageOuts++;
+		}
+
+		EndChunk(ChunkKey);
+	}
+
+	// Returns the number of times each chunk has been paged in
+	TMap<FIntVector, int32> GetPageIns() const
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		return PageIns;
+	}
+
+	int64 GetNumPageOuts() const
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		return NumPageOuts;
+	}
+
+	// The number of times a chunk was paged in or out while it was already being paged in or out
+	std::atomic<int32> NumOverlaps{ 0 };
+
+private:
+	static FIntVector GetChunkKey(const PolyVox::Region& Region)
+	{
+		return FIntVector(Region.getLowerX() / ChunkSideLength, Region.getLowerY() / ChunkSideLength, Region.getLowerZ() / ChunkSideLength);
+	}
+
+	void BeginChunk(const FIntVector& ChunkKey)
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+
+		bool bAlreadyInFlight = false;
+		ChunksInFlight.Add(ChunkKey, &bAlreadyInFlight);
+
+		if (bAlreadyInFlight)
+			NumOverlaps++;
+	}
+
+	void EndChunk(const FIntVector& ChunkKey)
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		ChunksInFlight.Remove(ChunkKey);
+	}
+
+	mutable std::mutex Mutex;
+
+	// Every chunk that has been paged out, and the chunks being paged in or out right now
+	TMap<FIntVector, TArray<MaterialDensityPair88>> SavedChunks;
+	TSet<FIntVector> ChunksInFlight;
+
+	TMap<FIntVector, int32> PageIns;
+	int64 NumPageOuts = 0;
+};
+
+// Returns the voxels a cell covers
+static PolyVox::Region GetCellRegion(int32 CellIndex)
+{
+	const FIntVector Cell(CellIndex % CellsPerAxis, (CellIndex / CellsPerAxis) % CellsPerAxis, CellIndex / (CellsPerAxis * CellsPerAxis));
+	const FIntVector Lower = Cell * CellSize + FIntVector(CellOffset);
+	const FIntVector Upper = Lower + FIntVector(CellSize - 1);
+
+	return PolyVox::Region(Vector3DInt32(Lower.X, Lower.Y, Lower.Z), Vector3DInt32(Upper.X, Upper.Y, Upper.Z));
+}
+
+// Runs Work(ThreadIndex) on NumThreads threads, all starting together
+template<typename WorkType>
+static void RunThreads(int32 NumThreads, const WorkType& Work)
+{
+	std::atomic<int32> NumReady(0);
+
+	auto Worker = [&](int32 ThreadIndex)
+	{
+		// Spin until every thread is up, so they really do hit the volume at the same time
+		NumReady++;
+		while (NumReady.load() < NumThreads)
+			std::this_thread::yield();
+
+		Work(ThreadIndex);
+	};
+
+	TArray<std::thread> Threads;
+	for (int32 i = 1; i < NumThreads; i++)
+		Threads.Emplace(Worker, i);
+
+	Worker(0);
+
+	for (std::thread& Thread : Threads)
+		Thread.join();
+}
+
+// Every thread reads every voxel of the same block of chunks in a different order, with plenty of memory so nothing is evicted.
+// Each chunk has to be paged in exactly once. Returns the number of errors.
+static int32 TestPageInOnce(int32 NumThreads)
+{
+	FStressPager Pager;
+	FVoxelPaletteVolume Volume(&Pager, 256 * 1024 * 1024, ChunkSideLength);
+
+	const int32 BlockChunks = 4;
+	const int32 BlockVoxels = BlockChunks * ChunkSideLength;
+
+	std::atomic<int32> NumBadVoxels(0);
+
+	RunThreads(NumThreads, [&](int32 ThreadIndex)
+	{
+		// Each thread starts at a different corner of the block
+		FRandomStream Random(ThreadIndex);
+		const int32 Start = Random.RandHelper(BlockVoxels * BlockVoxels * BlockVoxels);
+
+		for (int32 i = 0; i < BlockVoxels * BlockVoxels * BlockVoxels; i += 7)
+		{
+			const int32 VoxelIndex = (Start + i) % (BlockVoxels * BlockVoxels * BlockVoxels);
+			const int32 X = VoxelIndex % BlockVoxels;
+			const int32 Y = (VoxelIndex / BlockVoxels) % BlockVoxels;
+			const int32 Z = VoxelIndex / (BlockVoxels * BlockVoxels);
+
+			if (Volume.getVoxel(X, Y, Z).getMaterial() != InitialMaterial)
+				NumBadVoxels++;
+		}
+	});
+
+	int32 NumErrors = NumBadVoxels + Pager.NumOverlaps;
+
+	const TMap<FIntVector, int32> PageIns = Pager.GetPageIns();
+	if (PageIns.Num() != BlockChunks * BlockChunks * BlockChunks)
+		NumErrors++;
+
+	for (const TPair<FIntVector, int32>& Pair : PageIns)
+	{
+		if (Pair.Value != 1)
+			NumErrors++;
+	}
+
+	std::cout << "Page in once, " << NumThreads << " threads: " << PageIns.Num() << " chunks paged in, " << NumErrors << " errors\n";
+	return NumErrors;
+}
+
+// What one run of readers and writers did
+struct FStressResult
+{
+	int64 NumReads = 0;
+	int64 NumWrites = 0;
+	double Seconds = 0;
+	int32 NumErrors = 0;
+};
+
+// Reads and edits random cells for a while. A WritePercent of zero only reads.
+static FStressResult RunReadersAndWriters(int32 NumThreads, int32 WritePercent, double Seconds)
+{
+	FStressPager Pager;
+	FVoxelPaletteVolume Volume(&Pager, StressMemoryBytes, ChunkSideLength);
+
+	// The material each cell was last filled with. A writer holds the cell's mutex from the edit until it has recorded it.
+	TArray<uint8> CellMaterials;
+	CellMaterials.Init(InitialMaterial, NumCells);
+	std::mutex CellMutexes[NumCells];
+
+	std::atomic<int64> NumReads(0);
+	std::atomic<int64> NumWrites(0);
+	std::atomic<int32> NumTornReads(0);
+	std::atomic<bool> bStop(false);
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	RunThreads(NumThreads, [&](int32 ThreadIndex)
+	{
+		FRandomStream Random(ThreadIndex + 1);
+		TArray<MaterialDensityPair88> Voxels;
+		Voxels.SetNumUninitialized(CellSize * CellSize * CellSize);
+
+		int64 ThreadReads = 0;
+		int64 ThreadWrites = 0;
+
+		while (!bStop.load(std::memory_order_relaxed))
+		{
+			const int32 CellIndex = Random.RandHelper(NumCells);
+			const PolyVox::Region Region = GetCellRegion(CellIndex);
+
+			if (Random.RandHelper(100) < WritePercent)
+			{
+				std::lock_guard<std::mutex> Lock(CellMutexes[CellIndex]);
+
+				// Materials go from 1 to 255, so a cell never gets the material it already has
+				const uint8 Material = uint8(CellMaterials[CellIndex] % 255 + 1);
+				Volume.EditRegion(Region, [Material](int32, int32, int32, MaterialDensityPair88& InOutVoxel)
+				{
+					InOutVoxel.setMaterial(Material);
+				});
+
+				CellMaterials[CellIndex] = Material;
+				ThreadWrites++;
+			}
+			else
+			{
+				Volume.ReadRegion(Region, Voxels.GetData());
+
+				for (const MaterialDensityPair88& Voxel : Voxels)
+				{
+					if (Voxel.getMaterial() != Voxels[0].getMaterial())
+					{
+						NumTornReads++;
+						break;
+					}
+				}
+
+				ThreadReads++;
+			}
+
+			// Only the first thread keeps time, so the others don't all call the clock
+			if (ThreadIndex == 0 && (ThreadReads + ThreadWrites) % 64 == 0 && FPlatformTime::Seconds() - StartTime >= Seconds)
+				bStop = true;
+		}
+
+		NumReads += ThreadReads;
+		NumWrites += ThreadWrites;
+	});
+
+	FStressResult Result;
+	Result.Seconds = FPlatformTime::Seconds() - StartTime;
+	Result.NumReads = NumReads;
+	Result.NumWrites = NumWrites;
+	Result.NumErrors = NumTornReads + Pager.NumOverlaps;
+
+	// Every cell has to have kept the last material written to it, both while it is paged in and after it has been paged out and back in again
+	TArray<MaterialDensityPair88> Voxels;
+	Voxels.SetNumUninitialized(CellSize * CellSize * CellSize);
+
+	for (int32 Pass = 0; Pass < 2; Pass++)
+	{
+		for (int32 CellIndex = 0; CellIndex < NumCells; CellIndex++)
+		{
+			Volume.ReadRegion(GetCellRegion(CellIndex), Voxels.GetData());
+
+			for (const MaterialDensityPair88& Voxel : Voxels)
+			{
+				if (Voxel.getMaterial() != CellMaterials[CellIndex])
+				{
+					Result.NumErrors++;
+					break;
+				}
+			}
+		}
+
+		Volume.flushAll();
+	}
+
+	if (WritePercent > 0 && Pager.GetNumPageOuts() == 0)
+	{
+		std::cerr << "Nothing was paged out, so eviction wasn't tested\n";
+		Result.NumErrors++;
+	}
+
+	return Result;
+}
+
+// Parses a comma separated list of positive numbers. Returns false if any of them isn't one.
+static bool ParseList(const char* Text, TArray<int32>& OutValues)
+{
+	OutValues.Reset();
+
+	std::stringstream Stream(Text);
+	std::string Item;
+
+	while (std::getline(Stream, Item, ','))
+	{
+		char* End = nullptr;
+		const long long Value = std::strtoll(Item.c_str(), &End, 10);
+
+		if (Item.empty() || *End != '\0' || Value <= 0)
+			return false;
+
+		OutValues.Add(int32(Value));
+	}
+
+	return OutValues.Num() > 0;
+}
+
+static void PrintUsage()
+{
+	std::cerr << "Usage: VoxelVolumeStress [--threads 1,2,4,8] [--seconds Seconds]\n";
+}
+
+int main(int argc, char** argv)
+{
+	TArray<int32> ThreadCounts;
+	ThreadCounts.Add(1);
+	ThreadCounts.Add(2);
+	ThreadCounts.Add(4);
+	ThreadCounts.Add(8);
+
+	double Seconds = 1.0;
+
+	for (int32 i = 1; i < argc; i += 2)
+	{
+		const std::string Arg = argv[i];
+		const char* Value = i + 1 < argc ? argv[i + 1] : nullptr;
+		bool bValid = Value != nullptr;
+
+		if (bValid && Arg == "--threads")
+		{
+			bValid = ParseList(Value, ThreadCounts);
+		}
+		else if (bValid && Arg == "--seconds")
+		{
+			Seconds = std::atof(Value);
+			bValid = Seconds > 0;
+		}
+		else
+		{
+			bValid = false;
+		}
+
+		if (!bValid)
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	int32 NumErrors = 0;
+
+	for (int32 NumThreads : ThreadCounts)
+		NumErrors += TestPageInOnce(FMath::Max(NumThreads, 2));
+
+	// Reads only, then one edit in every ten operations
+	const int32 WritePercents[] = { 0, 10 };
+
+	for (int32 WritePercent : WritePercents)
+	{
+		for (int32 NumThreads : ThreadCounts)
+		{
+			const FStressResult Result = RunReadersAndWriters(NumThreads, WritePercent, Seconds);
+			NumErrors += Result.NumErrors;
+
+			std::cout << NumThreads << " threads, " << WritePercent << "% writes: "
+				<< int64((Result.NumReads + Result.NumWrites) / Result.Seconds) << " cells/s ("
+				<< Result.NumReads << " reads, " << Result.NumWrites << " writes), " << Result.NumErrors << " errors\n";
+		}
+	}
+
+	if (NumErrors > 0)
+	{
+		std::cout << NumErrors << " errors\n";
+		return 1;
+	}
+
+	std::cout << "No errors\n";
+	return 0;
+}